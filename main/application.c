@@ -84,6 +84,7 @@ static void on_wake_word_detected(const char* wake_word, void* user_data);
 static void on_protocol_connected(void* user_data);
 static void on_protocol_error(const char* message, void* user_data);
 static void on_protocol_text(const char* text, void* user_data);
+static void on_state_action(device_action_t action, device_event_t event, void* user_data);
 
 // WiFi event group
 static EventGroupHandle_t s_wifi_event_group = NULL;
@@ -216,15 +217,13 @@ int application_init(application_t* app) {
     };
     log_init(&log_cfg);
 
-    // Initialize event system
-    event_system_init();
-
     // Initialize state machine
     app->state_machine = device_state_machine_create();
     if (app->state_machine == NULL) {
         ESP_LOGE(TAG, "Failed to create state machine");
         return -1;
     }
+    device_state_machine_set_action_callback(app->state_machine, on_state_action, app);
 
     // Initialize display (use LCD as default)
     app->display = display_create(DISPLAY_TYPE_LCD);
@@ -334,6 +333,7 @@ int application_start(application_t* app) {
 
     // Set state to connecting
     set_state(app, APP_STATE_WIFI_CONNECTING);
+    device_state_machine_dispatch(app->state_machine, DEVICE_EVENT_WIFI_CONFIG);
 
     // Start WiFi connection
     if (app->config.wifi_ssid != NULL && strlen(app->config.wifi_ssid) > 0) {
@@ -374,6 +374,7 @@ int application_start(application_t* app) {
         ESP_LOGW(TAG, "No WiFi credentials, skipping WiFi connection");
         set_state(app, APP_STATE_WIFI_CONNECTED);
     }
+    device_state_machine_dispatch(app->state_machine, DEVICE_EVENT_NETWORK_CONNECTED);
 
     // Start wake word detection
     if (app->wake_word != NULL) {
@@ -621,8 +622,45 @@ static void on_wake_word_detected(const char* wake_word, void* user_data) {
 
     // Update state machine
     if (app->state_machine != NULL) {
-        device_state_machine_transition(app->state_machine, DEVICE_STATE_LISTENING);
+        device_state_machine_dispatch(app->state_machine, DEVICE_EVENT_WAKE_WORD);
+    }
+}
+
+// State machine action callback
+static void on_state_action(device_action_t action, device_event_t event, void* user_data) {
+    application_t* app = (application_t*)user_data;
+    if (app == NULL) return;
+
+    switch (action) {
+        case DEVICE_ACTION_ABORT_SPEAKING:
+            if (app->audio_mgr != NULL) {
+                audio_manager_stop_playback(app->audio_mgr);
+                audio_manager_start_recording(app->audio_mgr);
+            }
+            break;
+        case DEVICE_ACTION_START_LISTENING:
+            if (app->audio_mgr != NULL) {
+                audio_manager_start_recording(app->audio_mgr);
+            }
+            break;
+        case DEVICE_ACTION_STOP_LISTENING:
+        case DEVICE_ACTION_START_SPEAKING:
+            if (app->audio_mgr != NULL) {
+                audio_manager_stop_recording(app->audio_mgr);
+            }
+            break;
+        case DEVICE_ACTION_MARK_UPLINK: {
+            int64_t latency = device_state_machine_trace_latency_us(app->state_machine,
+                DEVICE_EVENT_WAKE_WORD, DEVICE_EVENT_UPLINK_PACKET);
+            if (latency >= 0) {
+                ESP_LOGI(TAG, "Wake word to first uplink packet: %lld us", (long long)latency);
+            }
+            break;
+        }
+        default:
+            break;
     }
+    ESP_LOGD(TAG, "State action %d on %s", action, device_state_machine_event_name(event));
 }
 
 // Protocol callbacks
@@ -680,6 +718,6 @@ static void on_protocol_text(const char* text, void* user_data) {
 
     // Update state
     if (app->state_machine != NULL) {
-        device_state_machine_transition(app->state_machine, DEVICE_STATE_SPEAKING);
+        device_state_machine_dispatch(app->state_machine, DEVICE_EVENT_TTS_START);
     }
 }
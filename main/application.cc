@@ -9,6 +9,7 @@
 #include "mcp_server.h"
 #include "assets.h"
 #include "settings.h"
+#include "boot_graph.h"
 
 #include <cstring>
 #include <esp_log.h>
@@ -62,29 +63,6 @@ void Application::Initialize() {
     auto& board = Board::GetInstance();
     SetDeviceState(kDeviceStateStarting);
 
-    // Setup the display
-    auto display = board.GetDisplay();
-    display->SetupUI();
-    // Print board name/version info
-    display->SetChatMessage("system", SystemInfo::GetUserAgent().c_str());
-
-    // Setup the audio service
-    auto codec = board.GetAudioCodec();
-    audio_service_.Initialize(codec);
-    audio_service_.Start();
-
-    AudioServiceCallbacks callbacks;
-    callbacks.on_send_queue_available = [this]() {
-        xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
-    };
-    callbacks.on_wake_word_detected = [this](const std::string& wake_word) {
-        xEventGroupSetBits(event_group_, MAIN_EVENT_WAKE_WORD_DETECTED);
-    };
-    callbacks.on_vad_change = [this](bool speaking) {
-        xEventGroupSetBits(event_group_, MAIN_EVENT_VAD_CHANGE);
-    };
-    audio_service_.SetCallbacks(callbacks);
-
     // Add state change listeners
     state_machine_.AddStateChangeListener([this](DeviceState old_state, DeviceState new_state) {
         xEventGroupSetBits(event_group_, MAIN_EVENT_STATE_CHANGED);
@@ -93,73 +71,113 @@ void Application::Initialize() {
     // Start the clock timer to update the status bar
     esp_timer_start_periodic(clock_timer_handle_, 1000000);
 
-    // Add MCP common tools (only once during initialization)
-    auto& mcp_server = McpServer::GetInstance();
-    mcp_server.AddCommonTools();
-    mcp_server.AddUserOnlyTools();
+    // Independent steps overlap: the assets partition is mapped and checked on the other core
+    // while the display comes up and Wi-Fi associates. See the boot timeline in the log.
+    BootGraph boot;
+    boot.AddStep("display", {}, [&board]() {
+        auto display = board.GetDisplay();
+        display->SetupUI();
+        // Print board name/version info
+        display->SetChatMessage("system", SystemInfo::GetUserAgent().c_str());
+    });
 
-    // Set network event callback for UI updates and network state handling
-    board.SetNetworkEventCallback([this](NetworkEvent event, const std::string& data) {
-        auto display = Board::GetInstance().GetDisplay();
+    boot.AddStep("network", {"display"}, [this, &board]() {
+        // Set network event callback for UI updates and network state handling
+        board.SetNetworkEventCallback([this](NetworkEvent event, const std::string& data) {
+            auto display = Board::GetInstance().GetDisplay();
         
-        switch (event) {
-            case NetworkEvent::Scanning:
-                display->ShowNotification(Lang::Strings::SCANNING_WIFI, 30000);
-                xEventGroupSetBits(event_group_, MAIN_EVENT_NETWORK_DISCONNECTED);
-                break;
-            case NetworkEvent::Connecting: {
-                if (data.empty()) {
-                    // Cellular network - registering without carrier info yet
-                    display->SetStatus(Lang::Strings::REGISTERING_NETWORK);
-                } else {
-                    // WiFi or cellular with carrier info
-                    std::string msg = Lang::Strings::CONNECT_TO;
+            switch (event) {
+                case NetworkEvent::Scanning:
+                    display->ShowNotification(Lang::Strings::SCANNING_WIFI, 30000);
+                    xEventGroupSetBits(event_group_, MAIN_EVENT_NETWORK_DISCONNECTED);
+                    break;
+                case NetworkEvent::Connecting: {
+                    if (data.empty()) {
+                        // Cellular network - registering without carrier info yet
+                        display->SetStatus(Lang::Strings::REGISTERING_NETWORK);
+                    } else {
+                        // WiFi or cellular with carrier info
+                        std::string msg = Lang::Strings::CONNECT_TO;
+                        msg += data;
+                        msg += "...";
+                        display->ShowNotification(msg.c_str(), 30000);
+                    }
+                    break;
+                }
+                case NetworkEvent::Connected: {
+                    std::string msg = Lang::Strings::CONNECTED_TO;
                     msg += data;
-                    msg += "...";
                     display->ShowNotification(msg.c_str(), 30000);
+                    xEventGroupSetBits(event_group_, MAIN_EVENT_NETWORK_CONNECTED);
+                    break;
                 }
-                break;
-            }
-            case NetworkEvent::Connected: {
-                std::string msg = Lang::Strings::CONNECTED_TO;
-                msg += data;
-                display->ShowNotification(msg.c_str(), 30000);
-                xEventGroupSetBits(event_group_, MAIN_EVENT_NETWORK_CONNECTED);
-                break;
+                case NetworkEvent::Disconnected:
+                    xEventGroupSetBits(event_group_, MAIN_EVENT_NETWORK_DISCONNECTED);
+                    break;
+                case NetworkEvent::WifiConfigModeEnter:
+                    // WiFi config mode enter is handled by WifiBoard internally
+                    break;
+                case NetworkEvent::WifiConfigModeExit:
+                    // WiFi config mode exit is handled by WifiBoard internally
+                    break;
+                // Cellular modem specific events
+                case NetworkEvent::ModemDetecting:
+                    display->SetStatus(Lang::Strings::DETECTING_MODULE);
+                    break;
+                case NetworkEvent::ModemErrorNoSim:
+                    Alert(Lang::Strings::ERROR, Lang::Strings::PIN_ERROR, "triangle_exclamation", Lang::Sounds::OGG_ERR_PIN);
+                    break;
+                case NetworkEvent::ModemErrorRegDenied:
+                    Alert(Lang::Strings::ERROR, Lang::Strings::REG_ERROR, "triangle_exclamation", Lang::Sounds::OGG_ERR_REG);
+                    break;
+                case NetworkEvent::ModemErrorInitFailed:
+                    Alert(Lang::Strings::ERROR, Lang::Strings::MODEM_INIT_ERROR, "triangle_exclamation", Lang::Sounds::OGG_EXCLAMATION);
+                    break;
+                case NetworkEvent::ModemErrorTimeout:
+                    display->SetStatus(Lang::Strings::REGISTERING_NETWORK);
+                    break;
             }
-            case NetworkEvent::Disconnected:
-                xEventGroupSetBits(event_group_, MAIN_EVENT_NETWORK_DISCONNECTED);
-                break;
-            case NetworkEvent::WifiConfigModeEnter:
-                // WiFi config mode enter is handled by WifiBoard internally
-                break;
-            case NetworkEvent::WifiConfigModeExit:
-                // WiFi config mode exit is handled by WifiBoard internally
-                break;
-            // Cellular modem specific events
-            case NetworkEvent::ModemDetecting:
-                display->SetStatus(Lang::Strings::DETECTING_MODULE);
-                break;
-            case NetworkEvent::ModemErrorNoSim:
-                Alert(Lang::Strings::ERROR, Lang::Strings::PIN_ERROR, "triangle_exclamation", Lang::Sounds::OGG_ERR_PIN);
-                break;
-            case NetworkEvent::ModemErrorRegDenied:
-                Alert(Lang::Strings::ERROR, Lang::Strings::REG_ERROR, "triangle_exclamation", Lang::Sounds::OGG_ERR_REG);
-                break;
-            case NetworkEvent::ModemErrorInitFailed:
-                Alert(Lang::Strings::ERROR, Lang::Strings::MODEM_INIT_ERROR, "triangle_exclamation", Lang::Sounds::OGG_EXCLAMATION);
-                break;
-            case NetworkEvent::ModemErrorTimeout:
-                display->SetStatus(Lang::Strings::REGISTERING_NETWORK);
-                break;
-        }
+        });
+
+        // Start network asynchronously
+        board.StartNetwork();
     });
 
-    // Start network asynchronously
-    board.StartNetwork();
+    boot.AddStep("audio", {}, [this, &board]() {
+        auto codec = board.GetAudioCodec();
+        audio_service_.Initialize(codec);
+        audio_service_.Start();
+
+        AudioServiceCallbacks callbacks;
+        callbacks.on_send_queue_available = [this]() {
+            xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
+        };
+        callbacks.on_wake_word_detected = [this](const std::string& wake_word) {
+            xEventGroupSetBits(event_group_, MAIN_EVENT_WAKE_WORD_DETECTED);
+        };
+        callbacks.on_vad_change = [this](bool speaking) {
+            xEventGroupSetBits(event_group_, MAIN_EVENT_VAD_CHANGE);
+        };
+        audio_service_.SetCallbacks(callbacks);
+    });
+
+    boot.AddStep("assets", {}, []() {
+        Assets::GetInstance();
+    }, 1, 4096 * 2);
+
+    // Some tools are only added when the display or the assets partition support them
+    boot.AddStep("mcp", {"display", "assets"}, []() {
+        // Add MCP common tools (only once during initialization)
+        auto& mcp_server = McpServer::GetInstance();
+        mcp_server.AddCommonTools();
+        mcp_server.AddUserOnlyTools();
+    });
+
+    boot.Run();
+    BootTimeline::GetInstance().Print();
 
     // Update the status bar immediately to show the network state
-    display->UpdateStatusBar(true);
+    board.GetDisplay()->UpdateStatusBar(true);
 }
 
 void Application::Run() {
@@ -298,6 +316,11 @@ void Application::HandleNetworkDisconnectedEvent() {
 
 void Application::HandleActivationDoneEvent() {
     ESP_LOGI(TAG, "Activation done");
+    // Time to idle depends mostly on whether the check version response came from the cache
+    int64_t idle_time = esp_timer_get_time();
+    ESP_LOGI(TAG, "Idle %d ms after boot, check version from %s", (int)(idle_time / 1000), ota_->GetCheckVersionSource());
+    BootTimeline::GetInstance().Record(std::string("idle_") + ota_->GetCheckVersionSource(), 0, idle_time);
+    BootTimeline::GetInstance().Print();
 
     SystemInfo::PrintHeapStats();
     SetDeviceState(kDeviceStateIdle);
@@ -323,15 +346,22 @@ void Application::HandleActivationDoneEvent() {
 void Application::ActivationTask() {
     // Create OTA object for activation process
     ota_ = std::make_unique<Ota>();
+    auto& timeline = BootTimeline::GetInstance();
 
     // Check for new assets version
+    int64_t start_time = esp_timer_get_time();
     CheckAssetsVersion();
+    timeline.Record("check_assets", start_time, esp_timer_get_time());
 
     // Check for new firmware version
+    start_time = esp_timer_get_time();
     CheckNewVersion();
+    timeline.Record("check_version", start_time, esp_timer_get_time());
 
     // Initialize the protocol
+    start_time = esp_timer_get_time();
     InitializeProtocol();
+    timeline.Record("protocol", start_time, esp_timer_get_time());
 
     // Signal completion to main loop
     xEventGroupSetBits(event_group_, MAIN_EVENT_ACTIVATION_DONE);
@@ -356,6 +386,9 @@ void Application::CheckAssetsVersion() {
     Settings settings("assets", true);
     // Check if there is a new assets need to be downloaded
     std::string download_url = settings.GetString("download_url");
+    if (download_url.empty()) {
+        download_url = assets.GetInterruptedDownloadUrl();
+    }
 
     if (!download_url.empty()) {
         settings.EraseKey("download_url");
@@ -529,7 +562,8 @@ void Application::InitializeProtocol() {
                     SetDeviceState(kDeviceStateSpeaking);
                 });
             } else if (strcmp(state->valuestring, "stop") == 0) {
-                Schedule([this]() {
+                Schedule([this, display]() {
+                    display->EndChatTurn();
                     if (GetDeviceState() == kDeviceStateSpeaking) {
                         if (listening_mode_ == kListeningModeManualStop) {
                             SetDeviceState(kDeviceStateIdle);
@@ -869,6 +903,8 @@ void Application::HandleStateChangedEvent() {
             display->SetEmotion("neutral"); // Then set emotion (wechat mode checks child count)
             audio_service_.EnableVoiceProcessing(false);
             audio_service_.EnableWakeWordDetection(true);
+            // Commit settings changed while busy, e.g. by activation
+            Settings::Flush();
             break;
         case kDeviceStateConnecting:
             display->SetStatus(Lang::Strings::CONNECTING);
@@ -990,13 +1026,15 @@ bool Application::UpgradeFirmware(const std::string& url, const std::string& ver
     audio_service_.Stop();
     vTaskDelay(pdMS_TO_TICKS(1000));
 
+    // A patch only exists for the version announced by the server, not for manual upgrades
+    std::string delta_url = (ota_ && upgrade_url == ota_->GetFirmwareUrl()) ? ota_->GetFirmwareDeltaUrl() : "";
     bool upgrade_success = Ota::Upgrade(upgrade_url, [this, display](int progress, size_t speed) {
         char buffer[32];
         snprintf(buffer, sizeof(buffer), "%d%% %uKB/s", progress, speed / 1024);
         Schedule([display, message = std::string(buffer)]() {
             display->SetChatMessage("system", message.c_str());
         });
-    });
+    }, delta_url);
 
     if (!upgrade_success) {
         // Upgrade failed, restart audio service and continue running
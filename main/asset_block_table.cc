@@ -0,0 +1,157 @@
+#include "asset_block_table.h"
+#include "settings.h"
+
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+#include <freertos/task.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#define TAG "AssetBlockTable"
+// NVS 中的块表以十六进制字符串保存
+#define ASSETS_HASH_NAMESPACE "assets_hash"
+
+void AssetBlockTable::Reset(const char* root, size_t image_size) {
+    StopScan();
+    root_ = root;
+    image_size_ = image_size;
+    block_size_ = kBlockSize;
+    while ((image_size_ + block_size_ - 1) / block_size_ > kMaxBlocks) {
+        block_size_ *= 2;
+    }
+    crcs_.clear();
+    verified_.clear();
+}
+
+void AssetBlockTable::Clear() {
+    Reset(nullptr, 0);
+}
+
+uint32_t AssetBlockTable::Hash() {
+    // 一次读取同时计算每个块的 CRC32 和头部中的 16 位累加和（从第 12 字节开始）
+    size_t block_count = (image_size_ + block_size_ - 1) / block_size_;
+    crcs_.assign(block_count, 0);
+    uint32_t checksum = 0;
+    for (size_t i = 0; i < block_count; i++) {
+        auto block = reinterpret_cast<const uint8_t*>(root_) + i * block_size_;
+        size_t size = std::min(block_size_, image_size_ - i * block_size_);
+        crcs_[i] = esp_rom_crc32_le(0, block, size);
+        for (size_t j = (i == 0 ? 12 : 0); j < size; j++) {
+            checksum += block[j];
+        }
+    }
+    verified_.assign(block_count, true);
+    return checksum & 0xFFFF;
+}
+
+bool AssetBlockTable::Load(uint32_t stored_files, uint32_t stored_chksum, uint32_t stored_len) {
+    Settings settings(ASSETS_HASH_NAMESPACE, false);
+    if ((uint32_t)settings.GetInt("files") != stored_files || (uint32_t)settings.GetInt("checksum") != stored_chksum ||
+        (uint32_t)settings.GetInt("length") != stored_len || (size_t)settings.GetInt("block_size") != block_size_) {
+        return false;
+    }
+
+    std::string blocks = settings.GetString("blocks");
+    size_t block_count = (image_size_ + block_size_ - 1) / block_size_;
+    if (blocks.size() != block_count * 8) {
+        return false;
+    }
+    crcs_.resize(block_count);
+    for (size_t i = 0; i < block_count; i++) {
+        crcs_[i] = strtoul(blocks.substr(i * 8, 8).c_str(), nullptr, 16);
+    }
+    // 根哈希保护块表本身
+    uint32_t root = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(crcs_.data()), block_count * sizeof(uint32_t));
+    if ((uint32_t)settings.GetInt("root") != root) {
+        crcs_.clear();
+        return false;
+    }
+    verified_.assign(block_count, false);
+    return true;
+}
+
+void AssetBlockTable::Save(uint32_t stored_files, uint32_t stored_chksum, uint32_t stored_len) {
+    std::string blocks;
+    blocks.reserve(crcs_.size() * 8);
+    char hex[9];
+    for (auto crc : crcs_) {
+        snprintf(hex, sizeof(hex), "%08lx", (unsigned long)crc);
+        blocks += hex;
+    }
+    uint32_t root = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(crcs_.data()), crcs_.size() * sizeof(uint32_t));
+
+    Settings settings(ASSETS_HASH_NAMESPACE, true);
+    settings.SetInt("files", stored_files);
+    settings.SetInt("checksum", stored_chksum);
+    settings.SetInt("length", stored_len);
+    settings.SetInt("block_size", block_size_);
+    settings.SetString("blocks", blocks);
+    settings.SetInt("root", root);
+}
+
+void AssetBlockTable::Drop() {
+    Settings settings(ASSETS_HASH_NAMESPACE, true);
+    settings.EraseAll();
+}
+
+bool AssetBlockTable::VerifyBlock(size_t index) {
+    auto block = reinterpret_cast<const uint8_t*>(root_) + index * block_size_;
+    size_t size = std::min(block_size_, image_size_ - index * block_size_);
+    if (esp_rom_crc32_le(0, block, size) != crcs_[index]) {
+        ESP_LOGE(TAG, "Assets block %u at 0x%x is corrupted", (unsigned)index, (unsigned)(index * block_size_));
+        // 下次启动时重新完整校验
+        Drop();
+        return false;
+    }
+    verified_[index] = true;
+    return true;
+}
+
+bool AssetBlockTable::Verify(size_t offset, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = offset / block_size_; i < crcs_.size() && i * block_size_ < offset + size; i++) {
+        if (!verified_[i] && !VerifyBlock(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void AssetBlockTable::StartScan() {
+    scan_stop_ = false;
+    scan_done_ = xSemaphoreCreateBinary();
+    xTaskCreate([](void* arg) {
+        auto table = static_cast<AssetBlockTable*>(arg);
+        auto start_time = esp_timer_get_time();
+        size_t corrupted = 0;
+        for (size_t i = 0; i < table->crcs_.size() && !table->scan_stop_; i++) {
+            {
+                std::lock_guard<std::mutex> lock(table->mutex_);
+                if (!table->verified_[i] && !table->VerifyBlock(i)) {
+                    corrupted++;
+                }
+            }
+            vTaskDelay(1);
+        }
+        if (!table->scan_stop_) {
+            ESP_LOGI(TAG, "Background scan of %u blocks finished in %d ms, %u corrupted", (unsigned)table->crcs_.size(),
+                int((esp_timer_get_time() - start_time) / 1000), (unsigned)corrupted);
+        }
+        xSemaphoreGive(table->scan_done_);
+        vTaskDelete(NULL);
+    }, "assets_scan", 3072, this, 1, nullptr);
+}
+
+void AssetBlockTable::StopScan() {
+    if (scan_done_ == nullptr) {
+        return;
+    }
+    scan_stop_ = true;
+    xSemaphoreTake(scan_done_, portMAX_DELAY);
+    vSemaphoreDelete(scan_done_);
+    scan_done_ = nullptr;
+}
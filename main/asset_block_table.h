@@ -0,0 +1,66 @@
+#ifndef _ASSET_BLOCK_TABLE_H
+#define _ASSET_BLOCK_TABLE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+/**
+ * CRC32 of each block of a mmapped assets image, so the whole image is only read once after it
+ * has been written. Later boots load the table from NVS and check each block on the first use of
+ * an asset in it (Verify()) and in a low priority background scan.
+ *
+ * The saved table is tied to the image header (file count, checksum and length) and protected by
+ * a CRC32 over the block CRCs. A corrupted block drops the saved table, so the next boot checks
+ * the whole image again. Drop() has to be called before the partition is written.
+ */
+class AssetBlockTable {
+public:
+    static constexpr size_t kBlockSize = 64 * 1024;
+    // The table is saved as one hex string, this keeps it within an NVS string
+    static constexpr size_t kMaxBlocks = 384;
+
+    ~AssetBlockTable() { StopScan(); }
+
+    // Start over for the image at `root`, `image_size` bytes including the 12 byte header
+    void Reset(const char* root, size_t image_size);
+    void Clear();
+
+    // Compute the CRC of every block, returns the 16-bit sum of the bytes after the header
+    uint32_t Hash();
+    // Use the saved table when it belongs to the image with this header
+    bool Load(uint32_t stored_files, uint32_t stored_chksum, uint32_t stored_len);
+    void Save(uint32_t stored_files, uint32_t stored_chksum, uint32_t stored_len);
+
+    // Check the blocks covering [offset, offset + size) that have not been checked yet
+    bool Verify(size_t offset, size_t size);
+
+    void StartScan();
+    void StopScan();
+
+    // Forget the saved table
+    static void Drop();
+
+    size_t block_count() const { return crcs_.size(); }
+    size_t block_size() const { return block_size_; }
+
+private:
+    // Must be called with mutex_ held
+    bool VerifyBlock(size_t index);
+
+    const char* root_ = nullptr;
+    size_t image_size_ = 0;
+    size_t block_size_ = kBlockSize;
+    std::vector<uint32_t> crcs_;
+    std::vector<bool> verified_;
+    std::mutex mutex_;
+    std::atomic<bool> scan_stop_{false};
+    SemaphoreHandle_t scan_done_ = nullptr;
+};
+
+#endif // _ASSET_BLOCK_TABLE_H
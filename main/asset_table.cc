@@ -0,0 +1,76 @@
+#include "asset_table.h"
+
+#include <cstring>
+
+// 资源索引（由 scripts/build_default_assets.py 生成，是资源表的第一项）：最小完美哈希，
+// 桶 b = Hash(name, 0) % bucket_count，槽位 = Hash(name, seeds[b]) % key_count，
+// 其余资源按槽位顺序排列在资源表中，查找时不需要在启动时建立索引
+struct asset_index_header {
+    char magic[4];                /*!< "XZPH" */
+    uint32_t version;             /*!< 1 */
+    uint32_t key_count;           /*!< Number of assets after the index entry */
+    uint32_t bucket_count;        /*!< Number of little endian uint16 seeds that follow */
+};
+
+uint32_t AssetTable::Hash(std::string_view name, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (unsigned char c : name) {
+        hash ^= c;
+        hash *= 16777619u;
+    }
+    hash ^= hash >> 15;
+    hash *= 0x2C1B3C6Du;
+    hash ^= hash >> 12;
+    return hash;
+}
+
+bool AssetTable::NameEquals(const mmap_assets_table* item, std::string_view name) {
+    return name.size() <= sizeof(item->asset_name) && memcmp(item->asset_name, name.data(), name.size()) == 0 &&
+        (name.size() == sizeof(item->asset_name) || item->asset_name[name.size()] == '\0');
+}
+
+void AssetTable::Load(const char* root, uint32_t file_count) {
+    table_ = reinterpret_cast<const mmap_assets_table*>(root + 12);
+    entries_ = file_count;
+    data_offset_ = 12 + sizeof(mmap_assets_table) * file_count;
+    index_seeds_ = nullptr;
+    index_buckets_ = 0;
+
+    asset_index_header index;
+    if (file_count > 1 && NameEquals(&table_[0], kIndexName) && table_[0].asset_size >= sizeof(index)) {
+        auto data = reinterpret_cast<const uint8_t*>(root + data_offset_ + table_[0].asset_offset + 2);
+        memcpy(&index, data, sizeof(index));
+        if (memcmp(index.magic, "XZPH", 4) == 0 && index.version == 1 && index.key_count == file_count - 1 &&
+            index.bucket_count > 0 && table_[0].asset_size >= sizeof(index) + index.bucket_count * 2) {
+            index_seeds_ = data + sizeof(index);
+            index_buckets_ = index.bucket_count;
+        }
+    }
+}
+
+void AssetTable::Clear() {
+    table_ = nullptr;
+    entries_ = 0;
+    data_offset_ = 0;
+    index_seeds_ = nullptr;
+    index_buckets_ = 0;
+}
+
+const mmap_assets_table* AssetTable::Find(std::string_view name) const {
+    if (table_ == nullptr) {
+        return nullptr;
+    }
+    if (index_seeds_ != nullptr) {
+        uint32_t bucket = Hash(name, 0) % index_buckets_;
+        // 种子按小端保存，映射的数据不一定对齐
+        uint32_t seed = index_seeds_[bucket * 2] | (index_seeds_[bucket * 2 + 1] << 8);
+        auto item = &table_[1 + Hash(name, seed) % (entries_ - 1)];
+        return NameEquals(item, name) ? item : nullptr;
+    }
+    for (uint32_t i = 0; i < entries_; i++) {
+        if (NameEquals(&table_[i], name)) {
+            return &table_[i];
+        }
+    }
+    return nullptr;
+}
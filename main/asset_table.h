@@ -0,0 +1,56 @@
+#ifndef _ASSET_TABLE_H
+#define _ASSET_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+struct mmap_assets_table {
+    char asset_name[32];          /*!< Name of the asset */
+    uint32_t asset_size;          /*!< Size of the asset */
+    uint32_t asset_offset;        /*!< Offset of the asset */
+    uint16_t asset_width;         /*!< Width of the asset */
+    uint16_t asset_height;        /*!< Height of the asset */
+};
+
+/**
+ * Name lookup in the table of a mmapped assets image, as packed by scripts/build_default_assets.py.
+ *
+ *   header: u32 file_count, u32 checksum, u32 length
+ *   table:  file_count mmap_assets_table entries
+ *   data:   for each asset "ZZ" followed by asset_size bytes at data_offset() + asset_offset
+ *
+ * When the first entry is the "assets.phash" index (a minimal perfect hash over the other names,
+ * which follow in slot order), a lookup hashes the name twice and compares one entry. Otherwise
+ * the table is scanned. Nothing is copied, the table has to stay mapped while it is used.
+ */
+class AssetTable {
+public:
+    static constexpr const char* kIndexName = "assets.phash";
+
+    // `root` points at the image header, `file_count` is the count stored in it
+    void Load(const char* root, uint32_t file_count);
+    void Clear();
+
+    const mmap_assets_table* Find(std::string_view name) const;
+
+    bool loaded() const { return table_ != nullptr; }
+    bool has_index() const { return index_seeds_ != nullptr; }
+    uint32_t size() const { return entries_; }
+    // Offset of the asset data area from the image header
+    size_t data_offset() const { return data_offset_; }
+
+    // Seeded FNV-1a with a final mix, asset_hash() in the packer must stay identical
+    static uint32_t Hash(std::string_view name, uint32_t seed);
+    // Table names are NUL padded to 32 bytes and not terminated when they use all of them
+    static bool NameEquals(const mmap_assets_table* item, std::string_view name);
+
+private:
+    const mmap_assets_table* table_ = nullptr;
+    uint32_t entries_ = 0;
+    size_t data_offset_ = 0;
+    const uint8_t* index_seeds_ = nullptr;
+    uint32_t index_buckets_ = 0;
+};
+
+#endif // _ASSET_TABLE_H
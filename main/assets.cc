@@ -1,4 +1,5 @@
 #include "assets.h"
+#include "assets_update.h"
 #include "board.h"
 #include "display.h"
 #include "application.h"
@@ -19,14 +20,6 @@
 #define TAG "Assets"
 #define PARTITION_LABEL "assets"
 
-struct mmap_assets_table {
-    char asset_name[32];          /*!< Name of the asset */
-    uint32_t asset_size;          /*!< Size of the asset */
-    uint32_t asset_offset;        /*!< Offset of the asset */
-    uint16_t asset_width;         /*!< Width of the asset */
-    uint16_t asset_height;        /*!< Height of the asset */
-};
-
 Assets::Assets() {
 #if HAVE_LVGL
     strategy_ = std::make_unique<Assets::LvglStrategy>();
@@ -64,7 +57,7 @@ void Assets::UnApplyPartition() {
     }
 }
 
-bool Assets::GetAssetData(const std::string& name, void*& ptr, size_t& size) {
+bool Assets::GetAssetData(std::string_view name, void*& ptr, size_t& size) {
     return strategy_ ? strategy_->GetAssetData(this, name, ptr, size) : false;
 }
 
@@ -96,10 +89,20 @@ bool Assets::LoadSrmodelsFromIndex(Assets* assets, cJSON* root) {
                 esp_srmodel_deinit(assets->models_list_);
                 assets->models_list_ = nullptr;
             }
-            assets->models_list_ = srmodel_load(static_cast<uint8_t*>(ptr));
-            if (assets->models_list_ != nullptr) {
+            // 启动时只解析模型目录，模型列表在唤醒词或音频处理器第一次使用时才创建
+            SrmodelDirectory directory;
+            if (directory.Parse(static_cast<uint8_t*>(ptr), size)) {
+                for (const auto& model : directory.models()) {
+                    ESP_LOGI(TAG, "Found model %s, %u bytes", model.name.c_str(), (unsigned)model.size);
+                }
+                auto data = static_cast<uint8_t*>(ptr);
                 auto& app = Application::GetInstance();
-                app.GetAudioService().SetModelsList(assets->models_list_);
+                app.GetAudioService().SetModelsDirectory(directory, [assets, data]() {
+                    if (assets->models_list_ == nullptr) {
+                        assets->models_list_ = srmodel_load(data);
+                    }
+                    return assets->models_list_;
+                });
                 if (need_delete_root) {
                     cJSON_Delete(root);
                 }
@@ -119,17 +122,9 @@ bool Assets::LoadSrmodelsFromIndex(Assets* assets, cJSON* root) {
 }
 
 #if HAVE_LVGL
-uint32_t Assets::LvglStrategy::CalculateChecksum(const char* data, uint32_t length) {
-    uint32_t checksum = 0;
-    for (uint32_t i = 0; i < length; i++) {
-        checksum += data[i];
-    }
-    return checksum & 0xFFFF;
-}
-
 bool Assets::LvglStrategy::InitializePartition(Assets* assets) {
     assets->partition_valid_ = false;
-    assets_.clear();
+    table_.Clear();
 
     if (!Assets::FindPartition(assets)) {
         return false;
@@ -161,53 +156,66 @@ bool Assets::LvglStrategy::InitializePartition(Assets* assets) {
         return false;
     }
 
+    // 已经完整校验过的分区直接使用保存的块表，各个块在首次使用时和后台扫描中校验
+    blocks_.Reset(mmap_root_, 12 + stored_len);
     auto start_time = esp_timer_get_time();
-    uint32_t calculated_checksum = CalculateChecksum(mmap_root_ + 12, stored_len);
-    auto end_time = esp_timer_get_time();
-    ESP_LOGI(TAG, "The checksum calculation time is %d ms", int((end_time - start_time) / 1000));
+    if (blocks_.Load(stored_files, stored_chksum, stored_len)) {
+        ESP_LOGI(TAG, "Loaded %u block hashes in %d ms, full check skipped", (unsigned)blocks_.block_count(),
+            int((esp_timer_get_time() - start_time) / 1000));
+        blocks_.StartScan();
+    } else {
+        uint32_t calculated_checksum = blocks_.Hash();
+        auto end_time = esp_timer_get_time();
+        ESP_LOGI(TAG, "The checksum calculation time is %d ms", int((end_time - start_time) / 1000));
 
-    if (calculated_checksum != stored_chksum) {
-        ESP_LOGE(TAG, "The calculated checksum (0x%lx) does not match the stored checksum (0x%lx)", calculated_checksum, stored_chksum);
-        return false;
+        if (calculated_checksum != stored_chksum) {
+            ESP_LOGE(TAG, "The calculated checksum (0x%lx) does not match the stored checksum (0x%lx)", calculated_checksum, stored_chksum);
+            blocks_.Clear();
+            return false;
+        }
+        blocks_.Save(stored_files, stored_chksum, stored_len);
     }
 
     checksum_valid_ = true;
 
-    for (uint32_t i = 0; i < stored_files; i++) {
-        auto item = (const mmap_assets_table*)(mmap_root_ + 12 + i * sizeof(mmap_assets_table));
-        auto asset = Asset{
-            .size = static_cast<size_t>(item->asset_size),
-            .offset = static_cast<size_t>(12 + sizeof(mmap_assets_table) * stored_files + item->asset_offset)
-        };
-        assets_[item->asset_name] = asset;
+    // 资源直接在映射的资源表中查找，只需要找到索引
+    table_.Load(mmap_root_, stored_files);
+    if (!table_.has_index()) {
+        ESP_LOGW(TAG, "No asset index, looking up %lu assets by name", stored_files);
     }
     return checksum_valid_;
 }
 
 void Assets::LvglStrategy::UnApplyPartition(Assets* assets) {
+    blocks_.Clear();
     if (mmap_handle_ != 0) {
         esp_partition_munmap(mmap_handle_);
         mmap_handle_ = 0;
         mmap_root_ = nullptr;
     }
     checksum_valid_ = false;
-    assets_.clear();
+    table_.Clear();
     (void)assets; // Unused parameter
 }
 
-bool Assets::LvglStrategy::GetAssetData(Assets* assets, const std::string& name, void*& ptr, size_t& size) {
-    auto asset = assets_.find(name);
-    if (asset == assets_.end()) {
+bool Assets::LvglStrategy::GetAssetData(Assets* assets, std::string_view name, void*& ptr, size_t& size) {
+    auto item = table_.Find(name);
+    if (item == nullptr) {
+        return false;
+    }
+    size_t offset = table_.data_offset() + item->asset_offset;
+    if (!blocks_.Verify(offset, item->asset_size + 2)) {
+        ESP_LOGE(TAG, "The asset %.*s is corrupted", (int)name.size(), name.data());
         return false;
     }
-    auto data = (const char*)(mmap_root_ + asset->second.offset);
+    auto data = (const char*)(mmap_root_ + offset);
     if (data[0] != 'Z' || data[1] != 'Z') {
-        ESP_LOGE(TAG, "The asset %s is not valid with magic %02x%02x", name.c_str(), data[0], data[1]);
+        ESP_LOGE(TAG, "The asset %.*s is not valid with magic %02x%02x", (int)name.size(), name.data(), data[0], data[1]);
         return false;
     }
 
     ptr = static_cast<void*>(const_cast<char*>(data + 2));
-    size = asset->second.size;
+    size = item->asset_size;
     return true;
 }
 
@@ -393,18 +401,19 @@ void Assets::EmoteStrategy::UnApplyPartition(Assets* assets) {
     (void)assets; // Unused parameter
 }
 
-bool Assets::EmoteStrategy::GetAssetData(Assets* assets, const std::string& name, void*& ptr, size_t& size) {
+bool Assets::EmoteStrategy::GetAssetData(Assets* assets, std::string_view name, void*& ptr, size_t& size) {
     auto display = Board::GetInstance().GetDisplay();
     auto* emote_display = dynamic_cast<emote::EmoteDisplay*>(display);
     if (emote_display && emote_display->GetEmoteHandle() != nullptr) {
         const uint8_t* data = nullptr;
         size_t data_size = 0;
-        if (ESP_OK == emote_get_asset_data_by_name(emote_display->GetEmoteHandle(), name.c_str(), &data, &data_size)) {
+        std::string asset_name(name);
+        if (ESP_OK == emote_get_asset_data_by_name(emote_display->GetEmoteHandle(), asset_name.c_str(), &data, &data_size)) {
             ptr = const_cast<void*>(static_cast<const void*>(data));
             size = data_size;
             return true;
         }
-        ESP_LOGE(TAG, "Failed to get asset data by name: %s", name.c_str());
+        ESP_LOGE(TAG, "Failed to get asset data by name: %s", asset_name.c_str());
         return false;
     }
     (void)assets; // Unused parameter
@@ -429,127 +438,10 @@ bool Assets::Download(std::string url, std::function<void(int progress, size_t s
     // 取消当前资源分区的内存映射
     UnApplyPartition();
 
-    // 下载新的资源文件
-    auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(0);
-    
-    if (!http->Open("GET", url)) {
-        ESP_LOGE(TAG, "Failed to open HTTP connection");
-        return false;
-    }
-
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get assets, status code: %d", http->GetStatusCode());
-        return false;
-    }
-
-    size_t content_length = http->GetBodyLength();
-    if (content_length == 0) {
-        ESP_LOGE(TAG, "Failed to get content length");
+    if (!AssetsUpdate(partition_).Download(url, progress_callback)) {
         return false;
     }
 
-    if (content_length > partition_->size) {
-        ESP_LOGE(TAG, "Assets file size (%u) is larger than partition size (%lu)", content_length, partition_->size);
-        return false;
-    }
-
-    // 定义扇区大小为4KB（ESP32的标准扇区大小）
-    const size_t SECTOR_SIZE = esp_partition_get_main_flash_sector_size();
-    
-    // 计算需要擦除的扇区数量
-    size_t sectors_to_erase = (content_length + SECTOR_SIZE - 1) / SECTOR_SIZE; // 向上取整
-    size_t total_erase_size = sectors_to_erase * SECTOR_SIZE;
-    
-    ESP_LOGI(TAG, "Sector size: %u, content length: %u, sectors to erase: %u, total erase size: %u", 
-             SECTOR_SIZE, content_length, sectors_to_erase, total_erase_size);
-    
-    // 写入新的资源文件到分区，一边erase一边写入
-    char* buffer = (char*)heap_caps_malloc(SECTOR_SIZE, MALLOC_CAP_INTERNAL);
-    if (buffer == nullptr) {
-        ESP_LOGE(TAG, "Failed to allocate buffer");
-        return false;
-    }
-    size_t total_written = 0;
-    size_t recent_written = 0;
-    size_t current_sector = 0;
-    auto last_calc_time = esp_timer_get_time();
-    
-    while (true) {
-        int ret = http->Read(buffer, SECTOR_SIZE);
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
-            heap_caps_free(buffer);
-            return false;
-        }
-
-        if (ret == 0) {
-            break;
-        }
-
-        // 检查是否需要擦除新的扇区
-        size_t write_end_offset = total_written + ret;
-        size_t needed_sectors = (write_end_offset + SECTOR_SIZE - 1) / SECTOR_SIZE;
-        
-        // 擦除需要的新扇区
-        while (current_sector < needed_sectors) {
-            size_t sector_start = current_sector * SECTOR_SIZE;
-            size_t sector_end = (current_sector + 1) * SECTOR_SIZE;
-            
-            // 确保擦除范围不超过分区大小
-            if (sector_end > partition_->size) {
-                ESP_LOGE(TAG, "Sector end (%u) exceeds partition size (%lu)", sector_end, partition_->size);
-                heap_caps_free(buffer);
-                return false;
-            }
-            
-            ESP_LOGD(TAG, "Erasing sector %u (offset: %u, size: %u)", current_sector, sector_start, SECTOR_SIZE);
-            esp_err_t err = esp_partition_erase_range(partition_, sector_start, SECTOR_SIZE);
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to erase sector %u at offset %u: %s", current_sector, sector_start, esp_err_to_name(err));
-                heap_caps_free(buffer);
-                return false;
-            }
-            
-            current_sector++;
-        }
-
-        // 写入数据到分区
-        esp_err_t err = esp_partition_write(partition_, total_written, buffer, ret);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write to assets partition at offset %u: %s", total_written, esp_err_to_name(err));
-            heap_caps_free(buffer);
-            return false;
-        }
-
-        total_written += ret;
-        recent_written += ret;
-
-        // 计算进度和速度
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || total_written == content_length || ret == 0) {
-            size_t progress = total_written * 100 / content_length;
-            size_t speed = recent_written; // 每秒的字节数
-            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %u B/s, Sectors erased: %u", 
-                     progress, total_written, content_length, speed, current_sector);
-            if (progress_callback) {
-                progress_callback(progress, speed);
-            }
-            last_calc_time = esp_timer_get_time();
-            recent_written = 0; // 重置最近写入的字节数
-        }
-    }
-    
-    http->Close();
-    heap_caps_free(buffer);
-
-    if (total_written != content_length) {
-        ESP_LOGE(TAG, "Downloaded size (%u) does not match expected size (%u)", total_written, content_length);
-        return false;
-    }
-
-    ESP_LOGI(TAG, "Assets download completed, total written: %u bytes, total sectors erased: %u", 
-             total_written, current_sector);
-
     // 重新初始化资源分区
     if (!InitializePartition()) {
         ESP_LOGE(TAG, "Failed to re-initialize assets partition");
@@ -558,3 +450,7 @@ bool Assets::Download(std::string url, std::function<void(int progress, size_t s
 
     return true;
 }
+
+std::string Assets::GetInterruptedDownloadUrl() {
+    return AssetsUpdate::GetInterruptedDownloadUrl();
+}
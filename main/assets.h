@@ -2,24 +2,21 @@
 #define ASSETS_H
 
 #include <string>
+#include <string_view>
 #include <functional>
 #include <memory>
 
 #include <cJSON.h>
 #include <esp_partition.h>
 #include <model_path.h>
-#include <map>
-#include <string>
+
+#include "asset_table.h"
+#include "asset_block_table.h"
 
 #if HAVE_LVGL
 #include <spi_flash_mmap.h>
 #endif
 
-struct Asset {
-    size_t size;
-    size_t offset;
-};
-
 class Assets {
 public:
     static Assets& GetInstance() {
@@ -29,8 +26,10 @@ public:
     ~Assets();
 
     bool Download(std::string url, std::function<void(int progress, size_t speed)> progress_callback);
+    // URL of an update that was interrupted by a reset, the partition is unusable until it is finished
+    std::string GetInterruptedDownloadUrl();
     bool Apply();
-    bool GetAssetData(const std::string& name, void*& ptr, size_t& size);
+    bool GetAssetData(std::string_view name, void*& ptr, size_t& size);
 
     inline bool partition_valid() const { return partition_valid_; }
     inline std::string default_assets_url() const { return default_assets_url_; }
@@ -51,7 +50,7 @@ private:
         virtual bool Apply(Assets* assets) = 0;
         virtual bool InitializePartition(Assets* assets) = 0;
         virtual void UnApplyPartition(Assets* assets) = 0;
-        virtual bool GetAssetData(Assets* assets, const std::string& name, void*& ptr, size_t& size) = 0;
+        virtual bool GetAssetData(Assets* assets, std::string_view name, void*& ptr, size_t& size) = 0;
     };
     
     class LvglStrategy : public AssetStrategy {
@@ -59,13 +58,13 @@ private:
         bool Apply(Assets* assets) override;
         bool InitializePartition(Assets* assets) override;
         void UnApplyPartition(Assets* assets) override;
-        bool GetAssetData(Assets* assets, const std::string& name, void*& ptr, size_t& size) override;
+        bool GetAssetData(Assets* assets, std::string_view name, void*& ptr, size_t& size) override;
     private:
-        static uint32_t CalculateChecksum(const char* data, uint32_t length);
-        std::map<std::string, Asset> assets_;
+        AssetTable table_;
         esp_partition_mmap_handle_t mmap_handle_ = 0;
         const char* mmap_root_ = nullptr;
         bool checksum_valid_ = false;
+        AssetBlockTable blocks_;
     };
     
     class EmoteStrategy : public AssetStrategy {
@@ -73,7 +72,7 @@ private:
         bool Apply(Assets* assets) override;
         bool InitializePartition(Assets* assets) override;
         void UnApplyPartition(Assets* assets) override;
-        bool GetAssetData(Assets* assets, const std::string& name, void*& ptr, size_t& size) override;
+        bool GetAssetData(Assets* assets, std::string_view name, void*& ptr, size_t& size) override;
     };
     
     // Strategy instance
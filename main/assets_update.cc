@@ -0,0 +1,211 @@
+#include "assets_update.h"
+#include "asset_block_table.h"
+#include "board.h"
+#include "download_pipeline.h"
+#include "settings.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <mbedtls/sha256.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#define TAG "AssetsUpdate"
+
+// 资源清单（由 scripts/build_default_assets.py 生成，与 assets.bin 放在一起，文件名加 .manifest 后缀）
+// 头部之后是每个块的 SHA-256 前 16 字节，然后是每个资源的名称、位置和哈希（设备上不使用）
+struct assets_manifest_header {
+    char magic[4];                /*!< "XZAM" */
+    uint32_t version;             /*!< 1 */
+    uint32_t image_size;          /*!< Size of assets.bin */
+    uint32_t block_size;          /*!< Size of each hashed block, a multiple of the flash sector size */
+    uint32_t block_count;         /*!< Number of blocks covering assets.bin */
+    uint32_t asset_count;         /*!< Number of asset entries after the block hashes */
+    uint8_t image_sha256[32];     /*!< SHA-256 of assets.bin */
+};
+
+#define MANIFEST_BLOCK_HASH_SIZE 16
+// 相邻变化块之间的间隔不超过这个数量时合并为一个请求，少量多余的数据比多一次请求更快
+#define MANIFEST_MAX_GAP_BLOCKS 4
+
+static bool CalculatePartitionHash(const esp_partition_t* partition, size_t size, uint8_t* buffer, size_t buffer_size, uint8_t digest[32]) {
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    bool success = true;
+    for (size_t offset = 0; offset < size; offset += buffer_size) {
+        size_t length = std::min(buffer_size, size - offset);
+        if (esp_partition_read(partition, offset, buffer, length) != ESP_OK) {
+            success = false;
+            break;
+        }
+        mbedtls_sha256_update(&ctx, buffer, length);
+    }
+    mbedtls_sha256_finish(&ctx, digest);
+    mbedtls_sha256_free(&ctx);
+    return success;
+}
+
+bool AssetsUpdate::DownloadChangedBlocks(const std::string& url, ProgressCallback progress_callback) {
+    auto network = Board::GetInstance().GetNetwork();
+    auto http = network->CreateHttp(0);
+    std::string manifest_url = url + ".manifest";
+    if (!http->Open("GET", manifest_url)) {
+        return false;
+    }
+    if (http->GetStatusCode() != 200) {
+        ESP_LOGI(TAG, "No manifest for %s, downloading the whole file", url.c_str());
+        http->Close();
+        return false;
+    }
+    std::string manifest = http->ReadAll();
+    http->Close();
+
+    assets_manifest_header header;
+    if (manifest.size() < sizeof(header)) {
+        ESP_LOGE(TAG, "The manifest is too short");
+        return false;
+    }
+    memcpy(&header, manifest.data(), sizeof(header));
+    size_t sector_size = esp_partition_get_main_flash_sector_size();
+    if (memcmp(header.magic, "XZAM", 4) != 0 || header.version != 1 || header.block_size == 0 ||
+        header.block_size % sector_size != 0 || header.image_size > partition_->size ||
+        header.block_count != (header.image_size + header.block_size - 1) / header.block_size ||
+        manifest.size() < sizeof(header) + (size_t)header.block_count * MANIFEST_BLOCK_HASH_SIZE) {
+        ESP_LOGE(TAG, "The manifest is not valid");
+        return false;
+    }
+    auto block_hashes = reinterpret_cast<const uint8_t*>(manifest.data()) + sizeof(header);
+
+    uint8_t* buffer = static_cast<uint8_t*>(heap_caps_malloc(header.block_size, MALLOC_CAP_8BIT));
+    if (buffer == nullptr) {
+        return false;
+    }
+
+    // 比较闪存中已有的块，只下载内容不同的块
+    struct Range {
+        size_t offset;
+        size_t size;
+    };
+    std::vector<Range> ranges;
+    size_t changed_blocks = 0;
+    size_t total_size = 0;
+    auto start_time = esp_timer_get_time();
+    for (size_t i = 0; i < header.block_count; i++) {
+        size_t offset = i * header.block_size;
+        size_t size = std::min((size_t)header.block_size, (size_t)header.image_size - offset);
+        uint8_t digest[32];
+        if (esp_partition_read(partition_, offset, buffer, size) != ESP_OK ||
+            mbedtls_sha256(buffer, size, digest, 0) != 0) {
+            heap_caps_free(buffer);
+            return false;
+        }
+        if (memcmp(digest, block_hashes + i * MANIFEST_BLOCK_HASH_SIZE, MANIFEST_BLOCK_HASH_SIZE) == 0) {
+            continue;
+        }
+        changed_blocks++;
+        if (!ranges.empty() && ranges.back().offset + ranges.back().size + MANIFEST_MAX_GAP_BLOCKS * header.block_size >= offset) {
+            total_size += offset + size - (ranges.back().offset + ranges.back().size);
+            ranges.back().size = offset + size - ranges.back().offset;
+        } else {
+            ranges.push_back({offset, size});
+            total_size += size;
+        }
+    }
+    ESP_LOGI(TAG, "%u of %u blocks changed, %u bytes in %u requests to download (compared in %d ms)",
+        (unsigned)changed_blocks, (unsigned)header.block_count, (unsigned)total_size, (unsigned)ranges.size(),
+        int((esp_timer_get_time() - start_time) / 1000));
+
+    // 变化太多时下载完整文件更快
+    if (total_size > header.image_size / 2) {
+        heap_caps_free(buffer);
+        return false;
+    }
+
+    DownloadPipeline pipeline(partition_);
+    size_t downloaded = 0;
+    size_t recent_read = 0;
+    auto last_calc_time = esp_timer_get_time();
+    bool success = true;
+    for (auto& range : ranges) {
+        http = network->CreateHttp(0);
+        http->SetHeader("Range", "bytes=" + std::to_string(range.offset) + "-" + std::to_string(range.offset + range.size - 1));
+        if (!http->Open("GET", url)) {
+            success = false;
+            break;
+        }
+        if (http->GetStatusCode() != 206 || http->GetBodyLength() != range.size) {
+            ESP_LOGE(TAG, "Failed to download range, status code: %d", http->GetStatusCode());
+            http->Close();
+            success = false;
+            break;
+        }
+
+        // 整体进度按所有需要下载的字节计算
+        success = pipeline.Run([&](uint8_t* data, size_t size) {
+            int ret = http->Read(reinterpret_cast<char*>(data), size);
+            if (ret > 0) {
+                downloaded += ret;
+                recent_read += ret;
+                if (esp_timer_get_time() - last_calc_time >= 1000000 || downloaded == total_size) {
+                    if (progress_callback) {
+                        progress_callback((uint64_t)downloaded * 100 / total_size, recent_read);
+                    }
+                    last_calc_time = esp_timer_get_time();
+                    recent_read = 0;
+                }
+            }
+            return ret;
+        }, range.offset, range.size, nullptr);
+        http->Close();
+        if (!success) {
+            break;
+        }
+    }
+
+    if (success) {
+        uint8_t digest[32];
+        success = CalculatePartitionHash(partition_, header.image_size, buffer, header.block_size, digest) &&
+            memcmp(digest, header.image_sha256, sizeof(digest)) == 0;
+        if (!success) {
+            ESP_LOGE(TAG, "The updated assets do not match the manifest");
+        }
+    }
+    heap_caps_free(buffer);
+    return success;
+}
+
+std::string AssetsUpdate::GetInterruptedDownloadUrl() {
+    Settings settings("assets_update", false);
+    return settings.GetString("url");
+}
+
+bool AssetsUpdate::Download(const std::string& url, ProgressCallback progress_callback) {
+    // 记录正在进行的更新，更新中断后重新启动时继续
+    {
+        Settings settings("assets_update", true);
+        settings.SetString("url", url);
+    }
+    // 写入分区之前删除保存的块表，否则更新中断后会用旧的块表信任新写入的内容
+    AssetBlockTable::Drop();
+    Settings::Flush();
+
+    // 优先只下载变化的块，没有清单或者失败时下载完整的资源文件
+    if (!DownloadChangedBlocks(url, progress_callback)) {
+        // 下载新的资源文件，网络中断后从 NVS 中记录的位置继续下载
+        DownloadPipeline pipeline(partition_);
+        size_t total_written = 0;
+        if (!pipeline.Download(url, "assets_journal", progress_callback, total_written)) {
+            ESP_LOGE(TAG, "Failed to download assets");
+            return false;
+        }
+        ESP_LOGI(TAG, "Assets download completed, total written: %u bytes", (unsigned)total_written);
+    }
+
+    Settings settings("assets_update", true);
+    settings.EraseKey("url");
+    return true;
+}
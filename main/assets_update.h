@@ -0,0 +1,41 @@
+#ifndef _ASSETS_UPDATE_H
+#define _ASSETS_UPDATE_H
+
+#include <functional>
+#include <string>
+
+#include <esp_partition.h>
+
+/**
+ * Writes a new assets.bin into the assets partition, which must not be mapped meanwhile.
+ *
+ * When the server has a manifest next to the file (url + ".manifest", made by
+ * scripts/build_default_assets.py) only the blocks whose hash differs from the partition are
+ * fetched with Range requests, otherwise the whole file is downloaded with resuming.
+ *
+ *   header: "XZAM", u32 version, u32 image_size, u32 block_size, u32 block_count,
+ *           u32 asset_count, u8 image_sha256[32]
+ *   blocks: the first 16 bytes of the SHA-256 of each block
+ *   assets: name, position and hash of each asset (not used on the device)
+ *
+ * The URL is recorded in NVS until the update has finished, so an update cut short by a reset is
+ * found with GetInterruptedDownloadUrl() and done again, skipping the blocks already written.
+ */
+class AssetsUpdate {
+public:
+    using ProgressCallback = std::function<void(int progress, size_t speed)>;
+
+    explicit AssetsUpdate(const esp_partition_t* partition) : partition_(partition) {}
+
+    bool Download(const std::string& url, ProgressCallback progress_callback);
+
+    // URL of an update that was interrupted by a reset, the partition is unusable until it is finished
+    static std::string GetInterruptedDownloadUrl();
+
+private:
+    bool DownloadChangedBlocks(const std::string& url, ProgressCallback progress_callback);
+
+    const esp_partition_t* partition_;
+};
+
+#endif // _ASSETS_UPDATE_H
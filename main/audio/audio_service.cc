@@ -1,5 +1,6 @@
 #include "audio_service.h"
 #include <esp_log.h>
+#include <esp_heap_caps.h>
 #include <cstring>
 
 #define RATE_CVT_CFG(_src_rate, _dest_rate, _channel)        \
@@ -554,7 +555,12 @@ void AudioService::EnableWakeWordDetection(bool enable) {
     ESP_LOGD(TAG, "%s wake word detection", enable ? "Enabling" : "Disabling");
     if (enable) {
         if (!wake_word_initialized_) {
-            if (!wake_word_->Initialize(codec_, models_list_)) {
+            auto models_list = GetModelsList();
+            if (models_list == nullptr && models_load_failed_) {
+                ESP_LOGE(TAG, "No models loaded, wake word detection is skipped");
+                return;
+            }
+            if (!wake_word_->Initialize(codec_, models_list)) {
                 ESP_LOGE(TAG, "Failed to initialize wake word");
                 return;
             }
@@ -580,7 +586,7 @@ void AudioService::EnableVoiceProcessing(bool enable) {
     ESP_LOGD(TAG, "%s voice processing", enable ? "Enabling" : "Disabling");
     if (enable) {
         if (!audio_processor_initialized_) {
-            audio_processor_->Initialize(codec_, OPUS_FRAME_DURATION_MS, models_list_);
+            audio_processor_->Initialize(codec_, OPUS_FRAME_DURATION_MS, GetModelsList());
             audio_processor_initialized_ = true;
         }
 
@@ -619,7 +625,7 @@ void AudioService::EnableAudioTesting(bool enable) {
 void AudioService::EnableDeviceAec(bool enable) {
     ESP_LOGI(TAG, "%s device AEC", enable ? "Enabling" : "Disabling");
     if (!audio_processor_initialized_) {
-        audio_processor_->Initialize(codec_, OPUS_FRAME_DURATION_MS, models_list_);
+        audio_processor_->Initialize(codec_, OPUS_FRAME_DURATION_MS, GetModelsList());
         audio_processor_initialized_ = true;
     }
 
@@ -696,17 +702,47 @@ void AudioService::CheckAndUpdateAudioPowerState() {
 
 void AudioService::SetModelsList(srmodel_list_t* models_list) {
     models_list_ = models_list;
+    models_loader_ = nullptr;
+    models_load_failed_ = false;
+    CreateWakeWord(esp_srmodel_filter(models_list_, ESP_MN_PREFIX, NULL) != nullptr,
+        esp_srmodel_filter(models_list_, ESP_WN_PREFIX, NULL) != nullptr);
+}
+
+void AudioService::SetModelsDirectory(const SrmodelDirectory& directory, std::function<srmodel_list_t*()> loader) {
+    models_list_ = nullptr;
+    models_loader_ = loader;
+    models_load_failed_ = false;
+    CreateWakeWord(directory.Find(ESP_MN_PREFIX) != nullptr, directory.Find(ESP_WN_PREFIX) != nullptr);
+}
+
+srmodel_list_t* AudioService::GetModelsList() {
+    if (models_list_ == nullptr && models_loader_) {
+        int64_t start_time = esp_timer_get_time();
+        size_t free_before = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        models_list_ = models_loader_();
+        models_loader_ = nullptr;
+        if (models_list_ != nullptr) {
+            ESP_LOGI(TAG, "Loaded %d models in %d ms, %d bytes of heap", models_list_->num,
+                (int)((esp_timer_get_time() - start_time) / 1000), (int)(free_before - heap_caps_get_free_size(MALLOC_CAP_8BIT)));
+        } else {
+            ESP_LOGE(TAG, "Failed to load models");
+            models_load_failed_ = true;
+        }
+    }
+    return models_list_;
+}
 
+void AudioService::CreateWakeWord(bool has_multinet, bool has_wakenet) {
 #if CONFIG_IDF_TARGET_ESP32S3 || CONFIG_IDF_TARGET_ESP32P4
-    if (esp_srmodel_filter(models_list_, ESP_MN_PREFIX, NULL) != nullptr) {
+    if (has_multinet) {
         wake_word_ = std::make_unique<CustomWakeWord>();
-    } else if (esp_srmodel_filter(models_list_, ESP_WN_PREFIX, NULL) != nullptr) {
+    } else if (has_wakenet) {
         wake_word_ = std::make_unique<AfeWakeWord>();
     } else {
         wake_word_ = nullptr;
     }
 #else
-    if (esp_srmodel_filter(models_list_, ESP_WN_PREFIX, NULL) != nullptr) {
+    if (has_wakenet) {
         wake_word_ = std::make_unique<EspWakeWord>();
     } else {
         wake_word_ = nullptr;
@@ -6,6 +6,7 @@
 #include <condition_variable>
 #include <chrono>
 #include <mutex>
+#include <functional>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -24,6 +25,7 @@
 #include "wake_word.h"
 #include "protocol.h"
 #include "ogg_demuxer.h"
+#include "srmodel_directory.h"
 
 /*
  * There are two types of audio data flow:
@@ -133,6 +135,8 @@ public:
     bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
     void ResetDecoder();
     void SetModelsList(srmodel_list_t* models_list);
+    // Pick the wake word from the directory only, `loader` builds the model list on first use
+    void SetModelsDirectory(const SrmodelDirectory& directory, std::function<srmodel_list_t*()> loader);
 
 private:
     AudioCodec* codec_ = nullptr;
@@ -157,6 +161,9 @@ private:
     int decoder_frame_size_ = 0;
     DebugStatistics debug_statistics_;
     srmodel_list_t* models_list_ = nullptr;
+    std::function<srmodel_list_t*()> models_loader_;
+    // The loader returned no models, nullptr would make the wake word fall back to the "model" partition
+    bool models_load_failed_ = false;
 
     EventGroupHandle_t event_group_;
 
@@ -190,6 +197,8 @@ private:
     void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm);
     void SetDecodeSampleRate(int sample_rate, int frame_duration);
     void CheckAndUpdateAudioPowerState();
+    void CreateWakeWord(bool has_multinet, bool has_wakenet);
+    srmodel_list_t* GetModelsList();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "srmodel_directory.h"
+
+#include <cstring>
+
+static constexpr size_t kNameSize = 32;
+
+static uint32_t ReadLe32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+bool SrmodelDirectory::Parse(const uint8_t* data, size_t size) {
+    models_.clear();
+    if (data == nullptr || size < 4) {
+        return false;
+    }
+
+    size_t pos = 0;
+    uint32_t model_count = ReadLe32(data);
+    pos += 4;
+    // Every model takes at least a name and a file count
+    if (model_count > (size - pos) / (kNameSize + 4)) {
+        return false;
+    }
+
+    models_.reserve(model_count);
+    for (uint32_t i = 0; i < model_count; i++) {
+        if (size - pos < kNameSize + 4) {
+            models_.clear();
+            return false;
+        }
+        Model model;
+        model.name.assign(reinterpret_cast<const char*>(data + pos), strnlen(reinterpret_cast<const char*>(data + pos), kNameSize));
+        uint32_t file_count = ReadLe32(data + pos + kNameSize);
+        pos += kNameSize + 4;
+        if (file_count > (size - pos) / (kNameSize + 8)) {
+            models_.clear();
+            return false;
+        }
+
+        model.size = 0;
+        for (uint32_t j = 0; j < file_count; j++) {
+            uint32_t offset = ReadLe32(data + pos + kNameSize);
+            uint32_t length = ReadLe32(data + pos + kNameSize + 4);
+            pos += kNameSize + 8;
+            if (offset > size || length > size - offset) {
+                models_.clear();
+                return false;
+            }
+            model.size += length;
+        }
+        models_.push_back(std::move(model));
+    }
+    return true;
+}
+
+const SrmodelDirectory::Model* SrmodelDirectory::Find(const char* keyword1, const char* keyword2) const {
+    for (const auto& model : models_) {
+        if (keyword1 != nullptr && strstr(model.name.c_str(), keyword1) == nullptr) {
+            continue;
+        }
+        if (keyword2 != nullptr && strstr(model.name.c_str(), keyword2) == nullptr) {
+            continue;
+        }
+        return &model;
+    }
+    return nullptr;
+}
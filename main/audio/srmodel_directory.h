@@ -0,0 +1,38 @@
+#ifndef SRMODEL_DIRECTORY_H
+#define SRMODEL_DIRECTORY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+ * Read-only view of the directory at the start of a packed srmodels.bin, so the models it holds
+ * can be known without srmodel_load() building the list. The layout is the one written by
+ * pack_models() in scripts/build_default_assets.py, all integers little endian:
+ *
+ *   u32 model_count
+ *   model_count x { char name[32], u32 file_count, file_count x { char name[32], u32 offset, u32 size } }
+ *
+ * Offsets are from the start of srmodels.bin.
+ */
+class SrmodelDirectory {
+public:
+    struct Model {
+        std::string name;
+        size_t size;  // Sum of the file sizes
+    };
+
+    // Returns false if the directory or any file it lists does not fit in `size` bytes
+    bool Parse(const uint8_t* data, size_t size);
+
+    // Same matching as esp_srmodel_filter(): the first model whose name contains both keywords
+    const Model* Find(const char* keyword1, const char* keyword2 = nullptr) const;
+
+    const std::vector<Model>& models() const { return models_; }
+
+private:
+    std::vector<Model> models_;
+};
+
+#endif // SRMODEL_DIRECTORY_H
@@ -0,0 +1,233 @@
+#include "camera_pipeline.h"
+#include "board.h"
+#include "display.h"
+#include "lvgl_display.h"
+#include "system_info.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <algorithm>
+
+#define TAG "CameraPipeline"
+
+CameraExplainUploader::CameraExplainUploader(const std::string& url, const std::string& token)
+    : url_(url), token_(token) {
+}
+
+std::string CameraExplainUploader::Upload(const std::string& question, EncodeFunction encode, const Timing& timing) {
+    // 40 entries of encoder blocks, the encoder waits when the upload falls behind
+    QueueHandle_t jpeg_queue = xQueueCreate(kQueueDepth, sizeof(JpegChunk));
+    if (jpeg_queue == nullptr) {
+        ESP_LOGE(TAG, "Failed to create JPEG queue");
+        throw std::runtime_error("Failed to create JPEG queue");
+    }
+
+    struct EncoderState {
+        QueueHandle_t queue;
+        bool failed = false;
+        int64_t start_us = 0;
+        int64_t first_chunk_us = 0;
+        int64_t end_us = 0;
+    } encoder = { jpeg_queue };
+
+    // Encode on a separate thread, so connecting and uploading overlap with encoding
+    std::thread encoder_thread([&encoder, &encode]() {
+        encoder.start_us = esp_timer_get_time();
+        bool ok = encode([](void* arg, size_t index, const void* data, size_t len) -> size_t {
+            auto encoder = static_cast<EncoderState*>(arg);
+            if (index != 0 || data == nullptr || len == 0) {
+                return len;  // The end marker is queued once encode() returns
+            }
+            if (encoder->first_chunk_us == 0) {
+                encoder->first_chunk_us = esp_timer_get_time();
+            }
+            JpegChunk chunk = {.data = nullptr, .len = len, .failed = false};
+            chunk.data = (uint8_t*)heap_caps_aligned_alloc(16, len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+            if (chunk.data == nullptr) {
+                // Returning less than len stops the encoder, the image would be truncated
+                ESP_LOGE(TAG, "Failed to allocate %zu bytes for JPEG chunk", len);
+                encoder->failed = true;
+                return 0;
+            }
+            memcpy(chunk.data, data, len);
+            xQueueSend(encoder->queue, &chunk, portMAX_DELAY);
+            return len;
+        }, &encoder);
+
+        JpegChunk end = {.data = nullptr, .len = 0, .failed = !ok || encoder.failed};
+        xQueueSend(encoder.queue, &end, portMAX_DELAY);
+        encoder.end_us = esp_timer_get_time();
+    });
+
+    // Drain the queue until the end marker, so the encoder thread can always finish
+    auto drain_queue = [&]() {
+        JpegChunk chunk;
+        while (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) == pdPASS) {
+            if (chunk.data == nullptr) {
+                break;
+            }
+            heap_caps_free(chunk.data);
+        }
+        encoder_thread.join();
+        vQueueDelete(jpeg_queue);
+    };
+
+    int64_t connect_start_us = esp_timer_get_time();
+    auto network = Board::GetInstance().GetNetwork();
+    auto http = network->CreateHttp(3);
+    // 构造multipart/form-data请求体
+    std::string boundary = "----ESP32_CAMERA_BOUNDARY";
+
+    // 配置HTTP客户端，使用分块传输编码
+    http->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
+    http->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
+    if (!token_.empty()) {
+        http->SetHeader("Authorization", "Bearer " + token_);
+    }
+    http->SetHeader("Content-Type", "multipart/form-data; boundary=" + boundary);
+    http->SetHeader("Transfer-Encoding", "chunked");
+    if (!http->Open("POST", url_)) {
+        ESP_LOGE(TAG, "Failed to connect to explain URL");
+        drain_queue();
+        throw std::runtime_error("Failed to connect to explain URL");
+    }
+    int64_t connect_end_us = esp_timer_get_time();
+
+    {
+        // 第一块：question字段
+        std::string question_field;
+        question_field += "--" + boundary + "\r\n";
+        question_field += "Content-Disposition: form-data; name=\"question\"\r\n";
+        question_field += "\r\n";
+        question_field += question + "\r\n";
+        http->Write(question_field.c_str(), question_field.size());
+    }
+    {
+        // 第二块：文件字段头部
+        std::string file_header;
+        file_header += "--" + boundary + "\r\n";
+        file_header += "Content-Disposition: form-data; name=\"file\"; filename=\"camera.jpg\"\r\n";
+        file_header += "Content-Type: image/jpeg\r\n";
+        file_header += "\r\n";
+        http->Write(file_header.c_str(), file_header.size());
+    }
+
+    // 第三块：JPEG数据，边编码边上传。一直读到结束标记，编码线程才不会阻塞在满队列上
+    size_t total_sent = 0;
+    bool encode_failed = true;
+    bool write_failed = false;
+    JpegChunk chunk;
+    while (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) == pdPASS) {
+        if (chunk.data == nullptr) {
+            encode_failed = chunk.failed;
+            break;
+        }
+        // 上传失败后继续读取并释放剩余的块
+        if (!write_failed && http->Write((const char*)chunk.data, chunk.len) < 0) {
+            ESP_LOGE(TAG, "Failed to upload JPEG chunk");
+            write_failed = true;
+        }
+        total_sent += chunk.len;
+        heap_caps_free(chunk.data);
+    }
+    // Wait for the encoder thread to finish
+    encoder_thread.join();
+    // 清理队列
+    vQueueDelete(jpeg_queue);
+
+    if (encode_failed || total_sent == 0) {
+        ESP_LOGE(TAG, "JPEG encoder failed or produced empty output");
+        throw std::runtime_error("Failed to encode image to JPEG");
+    }
+    if (write_failed) {
+        throw std::runtime_error("Failed to upload photo");
+    }
+
+    {
+        // 第四块：multipart尾部
+        std::string multipart_footer;
+        multipart_footer += "\r\n--" + boundary + "--\r\n";
+        http->Write(multipart_footer.c_str(), multipart_footer.size());
+    }
+    // 结束块
+    http->Write("", 0);
+    int64_t upload_end_us = esp_timer_get_time();
+
+    if (http->GetStatusCode() != 200) {
+        ESP_LOGE(TAG, "Failed to upload photo, status code: %d", http->GetStatusCode());
+        throw std::runtime_error("Failed to upload photo");
+    }
+
+    std::string result = http->ReadAll();
+    http->Close();
+    int64_t answer_us = esp_timer_get_time();
+
+    // Stages overlap: encode and connect both start right after capture, upload ends after both
+    int64_t origin_us = timing.capture_start_us != 0 ? timing.capture_start_us : connect_start_us;
+    ESP_LOGI(TAG, "Explain timing (ms): capture=%d, encode=%d (first chunk %d), connect=%d, "
+             "upload done=%d, answer=%d, total=%d",
+             (int)((timing.capture_end_us - timing.capture_start_us) / 1000),
+             (int)((encoder.end_us - encoder.start_us) / 1000),
+             (int)((encoder.first_chunk_us - encoder.start_us) / 1000),
+             (int)((connect_end_us - connect_start_us) / 1000),
+             (int)((upload_end_us - origin_us) / 1000),
+             (int)((answer_us - upload_end_us) / 1000),
+             (int)((answer_us - origin_us) / 1000));
+
+    // Get remain task stack size
+    size_t remain_stack_size = uxTaskGetStackHighWaterMark(nullptr);
+    ESP_LOGI(TAG, "Explain compressed size=%d, remain stack size=%d, question=%s\n%s",
+             (int)total_sent, (int)remain_stack_size, question.c_str(), result.c_str());
+    return result;
+}
+
+bool CameraPreview::Show(const uint8_t* data, uint16_t width, uint16_t height, size_t stride, bool swap_bytes) {
+    auto display = dynamic_cast<LvglDisplay*>(Board::GetInstance().GetDisplay());
+    if (display == nullptr || data == nullptr) {
+        return false;
+    }
+
+    // Smallest integer factor that fits the frame into the display
+    int scale = 1;
+    if (display->width() > 0 && display->height() > 0) {
+        scale = std::max((width + display->width() - 1) / display->width(),
+                         (height + display->height() - 1) / display->height());
+        scale = std::max(scale, 1);
+    }
+    uint16_t out_w = width / scale;
+    uint16_t out_h = height / scale;
+    size_t out_stride = out_w * 2;
+    size_t out_size = out_stride * out_h;
+
+    uint8_t* out = (uint8_t*)heap_caps_malloc(out_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (out == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate memory for preview image");
+        return false;
+    }
+
+    for (int y = 0; y < out_h; y++) {
+        auto src = reinterpret_cast<const uint16_t*>(data + (size_t)y * scale * stride);
+        auto dst = reinterpret_cast<uint16_t*>(out + (size_t)y * out_stride);
+        if (scale == 1 && !swap_bytes) {
+            memcpy(dst, src, out_stride);
+        } else if (swap_bytes) {
+            for (int x = 0; x < out_w; x++) {
+                dst[x] = __builtin_bswap16(src[x * scale]);
+            }
+        } else {
+            for (int x = 0; x < out_w; x++) {
+                dst[x] = src[x * scale];
+            }
+        }
+    }
+
+    display->SetPreviewImage(std::make_unique<LvglAllocatedImage>(out, out_size, out_w, out_h, out_stride,
+        LV_COLOR_FORMAT_RGB565));
+    return true;
+}
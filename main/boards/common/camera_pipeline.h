@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <functional>
+#include <cstdint>
+
+#include "jpg/image_to_jpeg.h"
+
+// A chunk with data == nullptr is always the last one; `failed` tells whether encoding completed
+struct JpegChunk {
+    uint8_t* data;
+    size_t len;
+    bool failed;
+};
+
+/**
+ * Streams a camera photo to the explain server while it is being encoded.
+ *
+ * The JPEG encoder runs on its own thread and pushes chunks through a bounded
+ * queue, while the calling thread connects to the server, sends the question
+ * and uploads the chunks as they arrive (chunked transfer encoding). Connecting,
+ * encoding and uploading therefore overlap, and at most kQueueDepth chunks are
+ * buffered. Every stage is timed and logged together with the capture time.
+ */
+class CameraExplainUploader {
+public:
+    // Encode the photo, passing JPEG data to `cb`. Runs on the encoder thread.
+    using EncodeFunction = std::function<bool(jpg_out_cb cb, void* arg)>;
+
+    struct Timing {
+        int64_t capture_start_us = 0;   // When the frame was requested from the sensor
+        int64_t capture_end_us = 0;     // When the frame was ready for encoding
+    };
+
+    CameraExplainUploader(const std::string& url, const std::string& token);
+
+    /**
+     * Encode and upload the photo with `question`, return the server response.
+     * Throws std::runtime_error on failure, like Camera::Explain.
+     */
+    std::string Upload(const std::string& question, EncodeFunction encode, const Timing& timing);
+
+private:
+    static constexpr int kQueueDepth = 40;
+
+    std::string url_;
+    std::string token_;
+};
+
+/**
+ * Camera preview helper. The preview is built from a copy decimated to fit the
+ * display, so it costs a fraction of a full-frame copy and can run on its own
+ * thread while the photo is being encoded and uploaded.
+ */
+class CameraPreview {
+public:
+    /**
+     * Show an RGB565 frame on the display, scaled down by an integer factor to fit it.
+     * `swap_bytes` swaps the pixel byte order on the way (camera big endian to LVGL).
+     * Takes ownership of nothing, `data` can be released once this returns.
+     */
+    static bool Show(const uint8_t* data, uint16_t width, uint16_t height, size_t stride, bool swap_bytes);
+};
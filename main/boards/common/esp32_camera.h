@@ -10,15 +10,10 @@
 #include <freertos/queue.h>
 
 #include "camera.h"
+#include "camera_pipeline.h"
 #include "esp_camera.h"
 #include "jpg/image_to_jpeg.h"
 
-struct JpegChunk
-{
-    uint8_t *data;
-    size_t len;
-};
-
 class Esp32Camera : public Camera
 {
 private:
@@ -26,10 +21,9 @@ private:
     bool swap_bytes_enabled_ = true;  // Swap pixel byte order for RGB565, enabled by default
     std::string explain_url_;
     std::string explain_token_;
-    std::thread encoder_thread_;
+    std::thread preview_thread_;  // Renders the preview while the photo is encoded and uploaded
     camera_fb_t *current_fb_ = nullptr;
-    uint8_t *encode_buf_ = nullptr;  // Buffer for JPEG encoding (with optional byte swap)
-    size_t encode_buf_size_ = 0;
+    CameraExplainUploader::Timing capture_timing_;
 
 public:
     Esp32Camera(const camera_config_t &config);
@@ -9,6 +9,7 @@
 #include <esp_heap_caps.h>
 #include <cstdio>
 #include <cstring>
+#include <esp_timer.h>
 
 #include "esp_imgfx_color_convert.h"
 #include "esp_video_device.h"
@@ -363,6 +364,9 @@ EspVideo::EspVideo(const esp_video_init_config_t& config) {
 }
 
 EspVideo::~EspVideo() {
+    if (preview_thread_.joinable()) {
+        preview_thread_.join();
+    }
     if (streaming_on_ && video_fd_ >= 0) {
         int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
         ioctl(video_fd_, VIDIOC_STREAMOFF, &type);
@@ -386,14 +390,16 @@ void EspVideo::SetExplainUrl(const std::string& url, const std::string& token) {
 }
 
 bool EspVideo::Capture() {
-    if (encoder_thread_.joinable()) {
-        encoder_thread_.join();
+    // The preview of the last photo may still be reading frame_
+    if (preview_thread_.joinable()) {
+        preview_thread_.join();
     }
 
     if (!streaming_on_ || video_fd_ < 0) {
         return false;
     }
 
+    capture_timing_.capture_start_us = esp_timer_get_time();
     for (int i = 0; i < 3; i++) {
         struct v4l2_buffer buf = {};
         buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -729,115 +735,104 @@ bool EspVideo::Capture() {
         }
     }
 
-    // 显示预览图片
-    auto display = dynamic_cast<LvglDisplay*>(Board::GetInstance().GetDisplay());
-    if (display != nullptr) {
-        if (!frame_.data) {
-            ESP_LOGE(TAG, "frame.data is null");
-            return false;
-        }
-        uint16_t w = frame_.width;
-        uint16_t h = frame_.height;
-        size_t lvgl_image_size = frame_.len;
-        size_t stride = ((w * 2) + 3) & ~3;  // 4字节对齐
-        lv_color_format_t color_format = LV_COLOR_FORMAT_RGB565;
-        uint8_t* data = nullptr;
-
-        switch (frame_.format) {
-            // LVGL 显示 YUV 系的图像似乎都有问题，暂时转换为 RGB565 显示
-            case V4L2_PIX_FMT_YUYV:
-            case V4L2_PIX_FMT_YUV420:
-            case V4L2_PIX_FMT_RGB24: {
-                color_format = LV_COLOR_FORMAT_RGB565;
-                data = (uint8_t*)heap_caps_malloc(w * h * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-                if (data == nullptr) {
-                    ESP_LOGE(TAG, "Failed to allocate memory for preview image");
-                    return false;
-                }
-                esp_imgfx_color_convert_cfg_t convert_cfg = {
-                    .in_res = {.width = static_cast<int16_t>(frame_.width),
-                               .height = static_cast<int16_t>(frame_.height)},
-                    .in_pixel_fmt = static_cast<esp_imgfx_pixel_fmt_t>(frame_.format),
-                    .out_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_LE,
-                    .color_space_std = ESP_IMGFX_COLOR_SPACE_STD_BT601,
-                };
-                esp_imgfx_color_convert_handle_t convert_handle = nullptr;
-                esp_imgfx_err_t err = esp_imgfx_color_convert_open(&convert_cfg, &convert_handle);
-                if (err != ESP_IMGFX_ERR_OK || convert_handle == nullptr) {
-                    ESP_LOGE(TAG, "esp_imgfx_color_convert_open failed");
-                    heap_caps_free(data);
-                    data = nullptr;
-                    return false;
-                }
-                esp_imgfx_data_t convert_input_data = {
-                    .data = frame_.data,
-                    .data_len = frame_.len,
-                };
-                esp_imgfx_data_t convert_output_data = {
-                    .data = data,
-                    .data_len = static_cast<uint32_t>(w * h * 2),
-                };
-                err = esp_imgfx_color_convert_process(convert_handle, &convert_input_data, &convert_output_data);
-                if (err != ESP_IMGFX_ERR_OK) {
-                    ESP_LOGE(TAG, "esp_imgfx_color_convert_process failed");
-                    heap_caps_free(data);
-                    data = nullptr;
-                    esp_imgfx_color_convert_close(convert_handle);
-                    convert_handle = nullptr;
-                    return false;
-                }
-                esp_imgfx_color_convert_close(convert_handle);
-                convert_handle = nullptr;
-                lvgl_image_size = w * h * 2;
-                break;
+    capture_timing_.capture_end_us = esp_timer_get_time();
+
+    if (!frame_.data) {
+        ESP_LOGE(TAG, "frame.data is null");
+        return false;
+    }
+
+    // 预览在独立线程中生成，与 Explain 的编码和上传并行
+    if (dynamic_cast<LvglDisplay*>(Board::GetInstance().GetDisplay()) != nullptr) {
+        preview_thread_ = std::thread([this]() { ShowPreview(); });
+    }
+    return true;
+}
+
+// 显示预览图片，frame_ 在下一次 Capture 之前保持不变
+void EspVideo::ShowPreview() {
+    uint16_t w = frame_.width;
+    uint16_t h = frame_.height;
+    size_t stride = w * 2;
+    uint8_t* data = nullptr;
+
+    switch (frame_.format) {
+        // LVGL 显示 YUV 系的图像似乎都有问题，暂时转换为 RGB565 显示
+        case V4L2_PIX_FMT_YUYV:
+        case V4L2_PIX_FMT_YUV420:
+        case V4L2_PIX_FMT_RGB24: {
+            data = (uint8_t*)heap_caps_malloc(w * h * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+            if (data == nullptr) {
+                ESP_LOGE(TAG, "Failed to allocate memory for preview image");
+                return;
+            }
+            esp_imgfx_color_convert_cfg_t convert_cfg = {
+                .in_res = {.width = static_cast<int16_t>(frame_.width),
+                           .height = static_cast<int16_t>(frame_.height)},
+                .in_pixel_fmt = static_cast<esp_imgfx_pixel_fmt_t>(frame_.format),
+                .out_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_LE,
+                .color_space_std = ESP_IMGFX_COLOR_SPACE_STD_BT601,
+            };
+            esp_imgfx_color_convert_handle_t convert_handle = nullptr;
+            esp_imgfx_err_t err = esp_imgfx_color_convert_open(&convert_cfg, &convert_handle);
+            if (err != ESP_IMGFX_ERR_OK || convert_handle == nullptr) {
+                ESP_LOGE(TAG, "esp_imgfx_color_convert_open failed");
+                heap_caps_free(data);
+                return;
+            }
+            esp_imgfx_data_t convert_input_data = {
+                .data = frame_.data,
+                .data_len = frame_.len,
+            };
+            esp_imgfx_data_t convert_output_data = {
+                .data = data,
+                .data_len = static_cast<uint32_t>(w * h * 2),
+            };
+            err = esp_imgfx_color_convert_process(convert_handle, &convert_input_data, &convert_output_data);
+            esp_imgfx_color_convert_close(convert_handle);
+            if (err != ESP_IMGFX_ERR_OK) {
+                ESP_LOGE(TAG, "esp_imgfx_color_convert_process failed");
+                heap_caps_free(data);
+                return;
             }
+            break;
+        }
 
-            case V4L2_PIX_FMT_RGB565:
-                data = (uint8_t*)heap_caps_malloc(w * h * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-                if (data == nullptr) {
-                    ESP_LOGE(TAG, "Failed to allocate memory for preview image");
-                    return false;
-                }
-                memcpy(data, frame_.data, frame_.len);
-                lvgl_image_size = frame_.len;  // fallthrough 时兼顾 YUYV 与 RGB565
-                break;
+        case V4L2_PIX_FMT_RGB565:
+            // 直接从帧缓冲区缩放拷贝
+            CameraPreview::Show(frame_.data, w, h, stride, false);
+            return;
 
 #ifdef CONFIG_XIAOZHI_CAMERA_ALLOW_JPEG_INPUT
-            case V4L2_PIX_FMT_JPEG: {
-                uint8_t* out_data = nullptr;  // out data is allocated by jpeg_to_image
-                size_t out_len = 0;
-                size_t out_width = 0;
-                size_t out_height = 0;
-                size_t out_stride = 0;
-
-                esp_err_t ret =
-                    jpeg_to_image(frame_.data, frame_.len, &out_data, &out_len, &out_width, &out_height, &out_stride);
-                if (ret != ESP_OK) {
-                    ESP_LOGE(TAG, "Failed to decode JPEG image: %d (%s)", (int)ret, esp_err_to_name(ret));
-                    if (out_data) {
-                        heap_caps_free(out_data);
-                        out_data = nullptr;
-                    }
-                    return false;
+        case V4L2_PIX_FMT_JPEG: {
+            size_t out_len = 0;
+            size_t out_width = 0;
+            size_t out_height = 0;
+            size_t out_stride = 0;
+
+            // out data is allocated by jpeg_to_image
+            esp_err_t ret =
+                jpeg_to_image(frame_.data, frame_.len, &data, &out_len, &out_width, &out_height, &out_stride);
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to decode JPEG image: %d (%s)", (int)ret, esp_err_to_name(ret));
+                if (data) {
+                    heap_caps_free(data);
                 }
-
-                data = out_data;
-                w = out_width;
-                h = out_height;
-                lvgl_image_size = out_len;
-                stride = out_stride;
-                break;
+                return;
             }
-#endif
-            default:
-                ESP_LOGE(TAG, "unsupported frame format: 0x%08lx", frame_.format);
-                return false;
+            w = out_width;
+            h = out_height;
+            stride = out_stride;
+            break;
         }
-
-        auto image = std::make_unique<LvglAllocatedImage>(data, lvgl_image_size, w, h, stride, color_format);
-        display->SetPreviewImage(std::move(image));
+#endif
+        default:
+            ESP_LOGE(TAG, "unsupported frame format: 0x%08lx", frame_.format);
+            return;
     }
-    return true;
+
+    CameraPreview::Show(data, w, h, stride, false);
+    heap_caps_free(data);
 }
 
 bool EspVideo::SetHMirror(bool enabled) {
@@ -882,7 +877,7 @@ bool EspVideo::SetVFlip(bool enabled) {
  * 问题对图像进行AI分析并返回结果。
  *
  * 实现特点：
- * - 使用独立线程编码JPEG，与主线程分离
+ * - 使用独立线程编码JPEG，与建立连接、上传重叠执行（见 CameraExplainUploader）
  * - 采用分块传输编码(chunked transfer encoding)优化内存使用
  * - 通过队列机制实现编码线程和发送线程的数据同步
  * - 支持设备ID、客户端ID和认证令牌的HTTP头部配置
@@ -894,7 +889,7 @@ bool EspVideo::SetVFlip(bool enabled) {
  *                  {"success": false, "message": "错误信息"}
  *
  * @note 调用此函数前必须先调用SetExplainUrl()设置服务器URL
- * @note 函数会等待之前的编码线程完成后再开始新的处理
+ * @note 预览图在 Capture 启动的独立线程中生成，不阻塞本函数
  * @warning 如果摄像头缓冲区为空或网络连接失败，将返回错误信息
  */
 std::string EspVideo::Explain(const std::string& question) {
@@ -902,140 +897,12 @@ std::string EspVideo::Explain(const std::string& question) {
         throw std::runtime_error("Image explain URL or token is not set");
     }
 
-    // 创建局部的 JPEG 队列, 40 entries is about to store 512 * 40 = 20480 bytes of JPEG data
-    QueueHandle_t jpeg_queue = xQueueCreate(40, sizeof(JpegChunk));
-    if (jpeg_queue == nullptr) {
-        ESP_LOGE(TAG, "Failed to create JPEG queue");
-        throw std::runtime_error("Failed to create JPEG queue");
-    }
-
-    // We spawn a thread to encode the image to JPEG using optimized encoder (cost about 500ms and 8KB SRAM)
-    encoder_thread_ = std::thread([this, jpeg_queue]() {
+    // 编码、连接和上传并行进行，JPEG 数据边编码边以分块传输编码上传
+    ESP_LOGI(TAG, "Explain image size=%d bytes", (int)frame_.len);
+    CameraExplainUploader uploader(explain_url_, explain_token_);
+    return uploader.Upload(question, [this](jpg_out_cb cb, void* arg) {
         uint16_t w = frame_.width ? frame_.width : 320;
         uint16_t h = frame_.height ? frame_.height : 240;
-        v4l2_pix_fmt_t enc_fmt = frame_.format;
-        bool ok = image_to_jpeg_cb(
-            frame_.data, frame_.len, w, h, enc_fmt, 80,
-            [](void* arg, size_t index, const void* data, size_t len) -> size_t {
-                auto jpeg_queue = static_cast<QueueHandle_t>(arg);
-                JpegChunk chunk = {.data = nullptr, .len = len};
-                if (index == 0 && data != nullptr && len > 0) {
-                    chunk.data = (uint8_t*)heap_caps_aligned_alloc(16, len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-                    if (chunk.data == nullptr) {
-                        ESP_LOGE(TAG, "Failed to allocate %zu bytes for JPEG chunk", len);
-                        chunk.len = 0;
-                    } else {
-                        memcpy(chunk.data, data, len);
-                    }
-                } else {
-                    chunk.len = 0;  // Sentinel or error
-                }
-                xQueueSend(jpeg_queue, &chunk, portMAX_DELAY);
-                return len;
-            },
-            jpeg_queue);
-
-        if (!ok) {
-            JpegChunk chunk = {.data = nullptr, .len = 0};
-            xQueueSend(jpeg_queue, &chunk, portMAX_DELAY);
-        }
-    });
-
-    auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(3);
-    // 构造multipart/form-data请求体
-    std::string boundary = "----ESP32_CAMERA_BOUNDARY";
-
-    // 配置HTTP客户端，使用分块传输编码
-    http->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
-    http->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
-    if (!explain_token_.empty()) {
-        http->SetHeader("Authorization", "Bearer " + explain_token_);
-    }
-    http->SetHeader("Content-Type", "multipart/form-data; boundary=" + boundary);
-    http->SetHeader("Transfer-Encoding", "chunked");
-    if (!http->Open("POST", explain_url_)) {
-        ESP_LOGE(TAG, "Failed to connect to explain URL");
-        // Clear the queue
-        encoder_thread_.join();
-        JpegChunk chunk;
-        while (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) == pdPASS) {
-            if (chunk.data != nullptr) {
-                heap_caps_free(chunk.data);
-            } else {
-                break;
-            }
-        }
-        vQueueDelete(jpeg_queue);
-        throw std::runtime_error("Failed to connect to explain URL");
-    }
-
-    {
-        // 第一块：question字段
-        std::string question_field;
-        question_field += "--" + boundary + "\r\n";
-        question_field += "Content-Disposition: form-data; name=\"question\"\r\n";
-        question_field += "\r\n";
-        question_field += question + "\r\n";
-        http->Write(question_field.c_str(), question_field.size());
-    }
-    {
-        // 第二块：文件字段头部
-        std::string file_header;
-        file_header += "--" + boundary + "\r\n";
-        file_header += "Content-Disposition: form-data; name=\"file\"; filename=\"camera.jpg\"\r\n";
-        file_header += "Content-Type: image/jpeg\r\n";
-        file_header += "\r\n";
-        http->Write(file_header.c_str(), file_header.size());
-    }
-
-    // 第三块：JPEG数据
-    size_t total_sent = 0;
-    bool saw_terminator = false;
-    while (true) {
-        JpegChunk chunk;
-        if (xQueueReceive(jpeg_queue, &chunk, portMAX_DELAY) != pdPASS) {
-            ESP_LOGE(TAG, "Failed to receive JPEG chunk");
-            break;
-        }
-        if (chunk.data == nullptr) {
-            saw_terminator = true;
-            break;  // The last chunk
-        }
-        http->Write((const char*)chunk.data, chunk.len);
-        total_sent += chunk.len;
-        heap_caps_free(chunk.data);
-    }
-    // Wait for the encoder thread to finish
-    encoder_thread_.join();
-    // 清理队列
-    vQueueDelete(jpeg_queue);
-
-    if (!saw_terminator || total_sent == 0) {
-        ESP_LOGE(TAG, "JPEG encoder failed or produced empty output");
-        throw std::runtime_error("Failed to encode image to JPEG");
-    }
-
-    {
-        // 第四块：multipart尾部
-        std::string multipart_footer;
-        multipart_footer += "\r\n--" + boundary + "--\r\n";
-        http->Write(multipart_footer.c_str(), multipart_footer.size());
-    }
-    // 结束块
-    http->Write("", 0);
-
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to upload photo, status code: %d", http->GetStatusCode());
-        throw std::runtime_error("Failed to upload photo");
-    }
-
-    std::string result = http->ReadAll();
-    http->Close();
-
-    // Get remain task stack size
-    size_t remain_stack_size = uxTaskGetStackHighWaterMark(nullptr);
-    ESP_LOGI(TAG, "Explain image size=%d bytes, compressed size=%d, remain stack size=%d, question=%s\n%s",
-             (int)frame_.len, (int)total_sent, (int)remain_stack_size, question.c_str(), result.c_str());
-    return result;
+        return image_to_jpeg_cb(frame_.data, frame_.len, w, h, frame_.format, 80, cb, arg);
+    }, capture_timing_);
 }
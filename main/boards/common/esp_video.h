@@ -10,14 +10,10 @@
 #include <freertos/queue.h>
 
 #include "camera.h"
+#include "camera_pipeline.h"
 #include "jpg/image_to_jpeg.h"
 #include "esp_video_init.h"
 
-struct JpegChunk {
-    uint8_t* data;
-    size_t len;
-};
-
 class EspVideo : public Camera {
 private:
     struct FrameBuffer {
@@ -38,7 +34,10 @@ private:
     std::vector<MmapBuffer> mmap_buffers_;
     std::string explain_url_;
     std::string explain_token_;
-    std::thread encoder_thread_;
+    std::thread preview_thread_;  // Renders the preview while the photo is encoded and uploaded
+    CameraExplainUploader::Timing capture_timing_;
+
+    void ShowPreview();
 
 public:
     EspVideo(const esp_video_init_config_t& config);
@@ -0,0 +1,171 @@
+#include "boot_graph.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <cJSON.h>
+
+#define TAG "BootGraph"
+
+void BootTimeline::Record(const std::string& name, int64_t start_us, int64_t end_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    spans_.push_back({name, start_us, end_us});
+}
+
+void BootTimeline::Print() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& span : spans_) {
+        ESP_LOGI(TAG, "%-16s %8lld - %8lld us (%lld ms)", span.name.c_str(), (long long)span.start_us,
+            (long long)span.end_us, (long long)(span.end_us - span.start_us) / 1000);
+    }
+}
+
+std::string BootTimeline::ToJson() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cJSON* root = cJSON_CreateArray();
+    for (const auto& span : spans_) {
+        cJSON* item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "name", span.name.c_str());
+        cJSON_AddNumberToObject(item, "start_us", span.start_us);
+        cJSON_AddNumberToObject(item, "end_us", span.end_us);
+        cJSON_AddItemToArray(root, item);
+    }
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
+
+void BootGraph::AddStep(const std::string& name, std::initializer_list<const char*> after, StepFunction function,
+    int core, uint32_t stack_size) {
+    Step step;
+    step.name = name;
+    step.after_names.assign(after.begin(), after.end());
+    step.function = function;
+    step.core = core;
+    step.stack_size = stack_size;
+    step.owner = this;
+    steps_.push_back(std::move(step));
+}
+
+bool BootGraph::ResolveDependencies() {
+    for (auto& step : steps_) {
+        step.after.clear();
+        for (const auto& name : step.after_names) {
+            size_t i = 0;
+            while (i < steps_.size() && steps_[i].name != name) {
+                i++;
+            }
+            if (i == steps_.size()) {
+                ESP_LOGE(TAG, "Step %s depends on unknown step %s", step.name.c_str(), name.c_str());
+                return false;
+            }
+            step.after.push_back(i);
+        }
+    }
+
+    // Every step has to become ready at some point, or Run() would wait forever
+    std::vector<bool> ordered(steps_.size(), false);
+    for (size_t count = 0; count < steps_.size(); count++) {
+        size_t next = 0;
+        for (; next < steps_.size(); next++) {
+            if (ordered[next]) {
+                continue;
+            }
+            bool ready = true;
+            for (size_t i : steps_[next].after) {
+                ready = ready && ordered[i];
+            }
+            if (ready) {
+                break;
+            }
+        }
+        if (next == steps_.size()) {
+            ESP_LOGE(TAG, "Boot steps have circular dependencies");
+            return false;
+        }
+        ordered[next] = true;
+    }
+    return true;
+}
+
+bool BootGraph::IsReady(const Step& step) const {
+    if (step.started) {
+        return false;
+    }
+    for (size_t i : step.after) {
+        if (!steps_[i].done) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BootGraph::Finish(Step& step) {
+    BootTimeline::GetInstance().Record(step.name, step.start_us, esp_timer_get_time());
+    std::lock_guard<std::mutex> lock(mutex_);
+    step.done = true;
+    done_cv_.notify_all();
+}
+
+bool BootGraph::Run() {
+    if (!ResolveDependencies()) {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        // Start everything that can run elsewhere before taking a step on this task
+        Step* local = nullptr;
+        bool all_done = true;
+        for (auto& step : steps_) {
+            all_done = all_done && step.done;
+            if (!IsReady(step)) {
+                continue;
+            }
+            if (step.core == kCallingTask) {
+                if (local == nullptr) {
+                    local = &step;
+                }
+                continue;
+            }
+            step.started = true;
+            step.start_us = esp_timer_get_time();
+            auto result = xTaskCreatePinnedToCore([](void* arg) {
+                auto step = static_cast<Step*>(arg);
+                step->function();
+                // The graph outlives its tasks, Run() does not return before every step is done
+                step->owner->Finish(*step);
+                vTaskDelete(NULL);
+            }, step.name.c_str(), step.stack_size, &step, 2, nullptr,
+                portNUM_PROCESSORS > 1 ? step.core : tskNO_AFFINITY);
+            if (result != pdPASS) {
+                // Nothing would ever finish the step, run it here instead of waiting for it forever
+                ESP_LOGW(TAG, "Failed to create the task of step %s, running it on the calling task", step.name.c_str());
+                step.started = false;
+                step.core = kCallingTask;
+                if (local == nullptr) {
+                    local = &step;
+                }
+            }
+        }
+        if (all_done) {
+            break;
+        }
+        if (local == nullptr) {
+            done_cv_.wait(lock);
+            continue;
+        }
+
+        local->started = true;
+        local->start_us = esp_timer_get_time();
+        lock.unlock();
+        local->function();
+        Finish(*local);
+        lock.lock();
+    }
+    return true;
+}
@@ -0,0 +1,86 @@
+#ifndef _BOOT_GRAPH_H
+#define _BOOT_GRAPH_H
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Start and end times (µs since boot) of the steps of the boot, kept for the log and the
+ * self.get_boot_timeline tool.
+ */
+class BootTimeline {
+public:
+    static BootTimeline& GetInstance() {
+        static BootTimeline instance;
+        return instance;
+    }
+
+    void Record(const std::string& name, int64_t start_us, int64_t end_us);
+    void Print() const;
+    // [{"name": "assets", "start_us": 181000, "end_us": 243000}, ...]
+    std::string ToJson() const;
+
+private:
+    struct Span {
+        std::string name;
+        int64_t start_us;
+        int64_t end_us;
+    };
+
+    BootTimeline() = default;
+    BootTimeline(const BootTimeline&) = delete;
+    BootTimeline& operator=(const BootTimeline&) = delete;
+
+    mutable std::mutex mutex_;
+    std::vector<Span> spans_;
+};
+
+/**
+ * Runs boot steps as soon as the steps they depend on have finished.
+ *
+ * Steps without a core run on the task calling Run(), in the order they were added, so they may
+ * use the large main task stack. Steps with a core run on their own task pinned to that core (any
+ * core on single core chips) and overlap with everything else that is ready. A step whose task
+ * cannot be created runs on the calling task instead.
+ */
+class BootGraph {
+public:
+    using StepFunction = std::function<void()>;
+
+    static constexpr int kCallingTask = -1;
+
+    void AddStep(const std::string& name, std::initializer_list<const char*> after, StepFunction function,
+        int core = kCallingTask, uint32_t stack_size = 4096);
+
+    // Returns false without running anything if a dependency is unknown or circular
+    bool Run();
+
+private:
+    struct Step {
+        std::string name;
+        std::vector<size_t> after;
+        std::vector<std::string> after_names;
+        StepFunction function;
+        int core;
+        uint32_t stack_size;
+        bool started = false;
+        bool done = false;
+        int64_t start_us = 0;
+        BootGraph* owner = nullptr;
+    };
+
+    std::vector<Step> steps_;
+    std::mutex mutex_;
+    std::condition_variable done_cv_;
+
+    bool ResolveDependencies();
+    bool IsReady(const Step& step) const;
+    void Finish(Step& step);
+};
+
+#endif // _BOOT_GRAPH_H
@@ -1,24 +1,294 @@
 #include "event_system.h"
 #include <stdlib.h>
 #include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <sched.h>
+#endif
+
+#define EVENT_QUEUE_MASK (EVENT_QUEUE_SIZE - 1)
+
+_Static_assert((EVENT_QUEUE_SIZE & EVENT_QUEUE_MASK) == 0,
+    "EVENT_QUEUE_SIZE must be a power of two");
+_Static_assert(EVENT_MAX < 32, "event_mask only has 32 bits");
+
+// 单个事件类型的监听器快照（只读，发布后不再修改）
+// listeners[0, sync_count) 为同步监听器，其后为延迟监听器
+typedef struct listener_snapshot {
+    size_t sync_count;
+    size_t deferred_count;
+    struct listener_snapshot* retired_next;
+    event_listener_t* listeners[];
+} listener_snapshot_t;
+
+// 有界多生产者队列（每个槽位带序号）
+typedef struct {
+    atomic_size_t sequence;
+    event_t event;
+} queue_cell_t;
+
+static _Atomic(listener_snapshot_t*) g_snapshots[EVENT_MAX];
+
+// 读端按纪元计数：取消订阅翻转纪元后只需等待旧纪元的读端退出，
+// 新进入的读端只会看到新快照，持续发布不会让等待饿死
+static atomic_uint g_reader_epoch = 0;
+static atomic_uint g_readers[2];
+
+// 当前线程嵌套在发布/分发中的层数，回调内不能等待宽限期
+static _Thread_local unsigned t_reader_depth = 0;
+
+// 写端（订阅/取消订阅）状态，受 g_writer_lock 保护
+static pthread_mutex_t g_writer_lock = PTHREAD_MUTEX_INITIALIZER;
+// 串行化宽限期等待，不与 g_writer_lock 同时等待读端
+static pthread_mutex_t g_grace_lock = PTHREAD_MUTEX_INITIALIZER;
 static event_listener_t* g_listeners = NULL;
-static bool g_initialized = false;
-static uint64_t g_event_id = 0;
+static listener_snapshot_t* g_retired = NULL;
+
+static queue_cell_t g_queue[EVENT_QUEUE_SIZE];
+static atomic_size_t g_queue_head = 0;
+static atomic_size_t g_queue_tail = 0;
+
+static atomic_bool g_initialized = false;
+static atomic_uint_least64_t g_event_id = 0;
+
+static atomic_uint g_stat_published = 0;
+static atomic_uint g_stat_delivered = 0;
+static atomic_uint g_stat_queued = 0;
+static atomic_uint g_stat_dropped = 0;
+static atomic_uint g_stat_high_water = 0;
+
+#ifdef ESP_PLATFORM
+static TaskHandle_t g_dispatcher = NULL;
+static TaskHandle_t g_dispatcher_joiner = NULL;
+static atomic_bool g_dispatcher_stop = false;
+#endif
+
+static void queue_reset(void) {
+    for (size_t i = 0; i < EVENT_QUEUE_SIZE; i++) {
+        atomic_store_explicit(&g_queue[i].sequence, i, memory_order_relaxed);
+    }
+    atomic_store(&g_queue_head, 0);
+    atomic_store(&g_queue_tail, 0);
+}
+
+static bool queue_push(const event_t* event) {
+    size_t pos = atomic_load_explicit(&g_queue_tail, memory_order_relaxed);
+    queue_cell_t* cell;
+
+    for (;;) {
+        cell = &g_queue[pos & EVENT_QUEUE_MASK];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&g_queue_tail, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            return false;   // 队列已满
+        } else {
+            pos = atomic_load_explicit(&g_queue_tail, memory_order_relaxed);
+        }
+    }
+
+    cell->event = *event;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+
+    unsigned depth = (unsigned)(pos + 1 - atomic_load_explicit(&g_queue_head, memory_order_relaxed));
+    unsigned high = atomic_load_explicit(&g_stat_high_water, memory_order_relaxed);
+    while (depth > high &&
+           !atomic_compare_exchange_weak_explicit(&g_stat_high_water, &high, depth,
+               memory_order_relaxed, memory_order_relaxed)) {
+    }
+    return true;
+}
+
+static bool queue_pop(event_t* event) {
+    size_t pos = atomic_load_explicit(&g_queue_head, memory_order_relaxed);
+    queue_cell_t* cell;
+
+    for (;;) {
+        cell = &g_queue[pos & EVENT_QUEUE_MASK];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&g_queue_head, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            return false;   // 队列为空
+        } else {
+            pos = atomic_load_explicit(&g_queue_head, memory_order_relaxed);
+        }
+    }
+
+    *event = cell->event;
+    atomic_store_explicit(&cell->sequence, pos + EVENT_QUEUE_SIZE, memory_order_release);
+    return true;
+}
+
+// 读端进入/退出；读端持有期间快照及其中的监听器不会被释放
+// 计数后重新检查纪元：若期间发生翻转则改记到新纪元，保证写端等待时不会漏掉
+static listener_snapshot_t* snapshot_acquire(event_type_t type, unsigned* epoch) {
+    unsigned current = atomic_load(&g_reader_epoch);
+    for (;;) {
+        atomic_fetch_add(&g_readers[current & 1], 1);
+        unsigned check = atomic_load(&g_reader_epoch);
+        if (check == current) {
+            break;
+        }
+        atomic_fetch_sub(&g_readers[current & 1], 1);
+        current = check;
+    }
+    *epoch = current & 1;
+    t_reader_depth++;
+    return atomic_load(&g_snapshots[type]);
+}
+
+static void snapshot_release(unsigned epoch) {
+    t_reader_depth--;
+    atomic_fetch_sub(&g_readers[epoch], 1);
+}
+
+static void free_snapshots(listener_snapshot_t* list) {
+    while (list != NULL) {
+        listener_snapshot_t* next = list->retired_next;
+        free(list);
+        list = next;
+    }
+}
+
+// 释放已退休的快照：无读端时所有退休快照都不可能再被访问
+// 调用时必须持有 g_writer_lock
+static void reclaim_retired_locked(void) {
+    if (g_retired == NULL ||
+        atomic_load(&g_readers[0]) != 0 || atomic_load(&g_readers[1]) != 0) {
+        return;
+    }
+    free_snapshots(g_retired);
+    g_retired = NULL;
+}
+
+// 宽限期：返回时，调用前进入发布/分发的读端都已退出，
+// 此前退休的快照和已移除的监听器不会再被访问
+// 不能在回调内调用，也不能持有 g_writer_lock
+static void synchronize_readers(void) {
+    pthread_mutex_lock(&g_grace_lock);
+
+    pthread_mutex_lock(&g_writer_lock);
+    listener_snapshot_t* retired = g_retired;
+    g_retired = NULL;
+    pthread_mutex_unlock(&g_writer_lock);
+
+    unsigned old_epoch = atomic_fetch_add(&g_reader_epoch, 1) & 1;
+    while (atomic_load(&g_readers[old_epoch]) != 0) {
+#ifdef ESP_PLATFORM
+        vTaskDelay(1);
+#else
+        sched_yield();
+#endif
+    }
+    pthread_mutex_unlock(&g_grace_lock);
+
+    free_snapshots(retired);
+}
+
+// 为单个事件类型重建快照，调用时必须持有 g_writer_lock
+static int rebuild_snapshot_locked(event_type_t type) {
+    uint32_t bit = EVENT_MASK(type);
+    size_t sync_count = 0;
+    size_t deferred_count = 0;
+
+    for (event_listener_t* l = g_listeners; l != NULL; l = l->next) {
+        if (l->event_mask & bit) {
+            if (l->delivery == EVENT_DELIVERY_DEFERRED) {
+                deferred_count++;
+            } else {
+                sync_count++;
+            }
+        }
+    }
+
+    listener_snapshot_t* snapshot = NULL;
+    if (sync_count + deferred_count > 0) {
+        snapshot = malloc(sizeof(listener_snapshot_t) +
+                          (sync_count + deferred_count) * sizeof(event_listener_t*));
+        if (snapshot == NULL) {
+            return -1;
+        }
+        snapshot->sync_count = sync_count;
+        snapshot->deferred_count = deferred_count;
+        snapshot->retired_next = NULL;
+
+        size_t s = 0;
+        size_t d = sync_count;
+        for (event_listener_t* l = g_listeners; l != NULL; l = l->next) {
+            if (l->event_mask & bit) {
+                if (l->delivery == EVENT_DELIVERY_DEFERRED) {
+                    snapshot->listeners[d++] = l;
+                } else {
+                    snapshot->listeners[s++] = l;
+                }
+            }
+        }
+    }
+
+    listener_snapshot_t* old = atomic_exchange(&g_snapshots[type], snapshot);
+    if (old != NULL) {
+        old->retired_next = g_retired;
+        g_retired = old;
+    }
+    return 0;
+}
+
+static int rebuild_snapshots_locked(uint32_t mask) {
+    int ret = 0;
+    for (int type = 0; type < EVENT_MAX; type++) {
+        if ((mask & EVENT_MASK(type)) && rebuild_snapshot_locked((event_type_t)type) != 0) {
+            ret = -1;
+        }
+    }
+    reclaim_retired_locked();
+    return ret;
+}
 
 int event_system_init(void) {
-    if (g_initialized) {
+    if (atomic_load(&g_initialized)) {
         return 0;
     }
-    g_listeners = NULL;
-    g_event_id = 0;
-    g_initialized = true;
+    queue_reset();
+    atomic_store(&g_event_id, 0);
+    event_system_reset_stats();
+    atomic_store(&g_initialized, true);
     return 0;
 }
 
+#ifdef ESP_PLATFORM
+static void stop_dispatcher(void);
+#endif
+
 void event_system_deinit(void) {
+    atomic_store(&g_initialized, false);
+
+#ifdef ESP_PLATFORM
+    stop_dispatcher();
+#endif
+
+    pthread_mutex_lock(&g_writer_lock);
     g_listeners = NULL;
-    g_initialized = false;
+    rebuild_snapshots_locked(EVENT_MASK(EVENT_MAX) - 1);
+    pthread_mutex_unlock(&g_writer_lock);
+
+    // 回调内反初始化时无法等待，退休快照留待之后回收
+    if (t_reader_depth == 0) {
+        synchronize_readers();
+    }
 }
 
 int event_subscribe(event_listener_t* listener) {
@@ -26,49 +296,96 @@ int event_subscribe(event_listener_t* listener) {
         return -1;
     }
 
+    pthread_mutex_lock(&g_writer_lock);
     listener->next = g_listeners;
     g_listeners = listener;
-    return 0;
+    int ret = rebuild_snapshots_locked(listener->event_mask);
+    pthread_mutex_unlock(&g_writer_lock);
+    return ret;
 }
 
 int event_unsubscribe(event_listener_t* listener) {
     if (listener == NULL) {
         return -1;
     }
+    // 回调内等待宽限期会等到自己，直接拒绝
+    if (t_reader_depth > 0) {
+        return -2;
+    }
+
+    pthread_mutex_lock(&g_writer_lock);
 
     event_listener_t* prev = NULL;
     event_listener_t* current = g_listeners;
-
-    while (current != NULL) {
-        if (current == listener) {
-            if (prev == NULL) {
-                g_listeners = current->next;
-            } else {
-                prev->next = current->next;
-            }
-            return 0;
-        }
+    while (current != NULL && current != listener) {
         prev = current;
         current = current->next;
     }
 
-    return -1;
+    if (current == NULL) {
+        pthread_mutex_unlock(&g_writer_lock);
+        return -1;
+    }
+
+    if (prev == NULL) {
+        g_listeners = current->next;
+    } else {
+        prev->next = current->next;
+    }
+    if (rebuild_snapshots_locked(listener->event_mask) != 0) {
+        // 旧快照可能仍引用该监听器，恢复订阅，调用方不得释放
+        listener->next = g_listeners;
+        g_listeners = listener;
+        rebuild_snapshots_locked(listener->event_mask);
+        pthread_mutex_unlock(&g_writer_lock);
+        return -1;
+    }
+    pthread_mutex_unlock(&g_writer_lock);
+
+    synchronize_readers();
+    return 0;
 }
 
 void event_publish(const event_t* event) {
-    if (event == NULL || !g_initialized) {
+    if (event == NULL || event->type >= EVENT_MAX || !atomic_load(&g_initialized)) {
         return;
     }
 
-    event_listener_t* current = g_listeners;
-    while (current != NULL) {
-        if (current->event_mask & (1U << event->type)) {
-            event_t evt = *event;
-            evt.timestamp = ++g_event_id;
-            current->callback(&evt, current->user_data);
-        }
-        current = current->next;
+    event_t evt = *event;
+    evt.timestamp = atomic_fetch_add(&g_event_id, 1) + 1;
+    atomic_fetch_add_explicit(&g_stat_published, 1, memory_order_relaxed);
+
+    unsigned epoch;
+    listener_snapshot_t* snapshot = snapshot_acquire(evt.type, &epoch);
+    if (snapshot == NULL) {
+        snapshot_release(epoch);
+        return;
+    }
+
+    for (size_t i = 0; i < snapshot->sync_count; i++) {
+        event_listener_t* l = snapshot->listeners[i];
+        l->callback(&evt, l->user_data);
+    }
+    atomic_fetch_add_explicit(&g_stat_delivered, (unsigned)snapshot->sync_count,
+                              memory_order_relaxed);
+    bool has_deferred = snapshot->deferred_count > 0;
+    snapshot_release(epoch);
+
+    if (!has_deferred) {
+        return;
+    }
+
+    if (!queue_push(&evt)) {
+        atomic_fetch_add_explicit(&g_stat_dropped, 1, memory_order_relaxed);
+        return;
+    }
+    atomic_fetch_add_explicit(&g_stat_queued, 1, memory_order_relaxed);
+
+#ifdef ESP_PLATFORM
+    if (g_dispatcher != NULL) {
+        xTaskNotifyGive(g_dispatcher);
     }
+#endif
 }
 
 void event_publish_type(event_type_t type) {
@@ -79,3 +396,95 @@ void event_publish_type(event_type_t type) {
     };
     event_publish(&event);
 }
+
+size_t event_system_dispatch_pending(size_t max_events) {
+    size_t processed = 0;
+    event_t evt;
+
+    while (processed < max_events && queue_pop(&evt)) {
+        // 使用分发时的快照：期间取消订阅的监听器不会再收到事件
+        unsigned epoch;
+        listener_snapshot_t* snapshot = snapshot_acquire(evt.type, &epoch);
+        if (snapshot != NULL) {
+            size_t end = snapshot->sync_count + snapshot->deferred_count;
+            for (size_t i = snapshot->sync_count; i < end; i++) {
+                event_listener_t* l = snapshot->listeners[i];
+                l->callback(&evt, l->user_data);
+            }
+            atomic_fetch_add_explicit(&g_stat_delivered, (unsigned)snapshot->deferred_count,
+                                      memory_order_relaxed);
+        }
+        snapshot_release(epoch);
+        processed++;
+    }
+    return processed;
+}
+
+size_t event_system_pending(void) {
+    return atomic_load(&g_queue_tail) - atomic_load(&g_queue_head);
+}
+
+#ifdef ESP_PLATFORM
+static void event_dispatcher_task(void* arg) {
+    (void)arg;
+    while (!atomic_load(&g_dispatcher_stop)) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (!atomic_load(&g_dispatcher_stop) &&
+               event_system_dispatch_pending(EVENT_QUEUE_SIZE) > 0) {
+        }
+    }
+    // 通知 stop_dispatcher() 本任务已不再访问监听器
+    if (g_dispatcher_joiner != NULL) {
+        xTaskNotifyGive(g_dispatcher_joiner);
+    }
+    vTaskDelete(NULL);
+}
+
+// 请求分发任务退出并等待它完成当前分发
+static void stop_dispatcher(void) {
+    if (g_dispatcher == NULL) {
+        return;
+    }
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    // 在分发任务的回调内调用时无法等待自己，退出后由任务自行删除
+    g_dispatcher_joiner = g_dispatcher == self ? NULL : self;
+    atomic_store(&g_dispatcher_stop, true);
+    xTaskNotifyGive(g_dispatcher);
+    if (g_dispatcher_joiner != NULL) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    g_dispatcher = NULL;
+}
+
+int event_system_start_dispatcher(uint32_t stack_size, int priority) {
+    if (g_dispatcher != NULL) {
+        return 0;
+    }
+    atomic_store(&g_dispatcher_stop, false);
+    if (xTaskCreate(event_dispatcher_task, "event_dispatch", stack_size, NULL,
+                    priority, &g_dispatcher) != pdPASS) {
+        g_dispatcher = NULL;
+        return -1;
+    }
+    return 0;
+}
+#endif
+
+void event_system_get_stats(event_system_stats_t* stats) {
+    if (stats == NULL) {
+        return;
+    }
+    stats->published = atomic_load_explicit(&g_stat_published, memory_order_relaxed);
+    stats->delivered = atomic_load_explicit(&g_stat_delivered, memory_order_relaxed);
+    stats->queued = atomic_load_explicit(&g_stat_queued, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&g_stat_dropped, memory_order_relaxed);
+    stats->queue_high_water = atomic_load_explicit(&g_stat_high_water, memory_order_relaxed);
+}
+
+void event_system_reset_stats(void) {
+    atomic_store(&g_stat_published, 0);
+    atomic_store(&g_stat_delivered, 0);
+    atomic_store(&g_stat_queued, 0);
+    atomic_store(&g_stat_dropped, 0);
+    atomic_store(&g_stat_high_water, 0);
+}
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -30,6 +31,7 @@ typedef enum {
 } event_type_t;
 
 // 事件数据联合体
+// 只按值复制：延迟投递时字符串和指针所指的数据必须在回调前一直有效（例如静态字符串）
 typedef union {
     int int_value;
     bool bool_value;
@@ -61,22 +63,54 @@ typedef struct {
 // 事件回调函数类型
 typedef void (*event_callback_t)(const event_t* event, void* user_data);
 
+// 投递方式
+typedef enum {
+    EVENT_DELIVERY_SYNC = 0,    // 在发布者线程同步回调
+    EVENT_DELIVERY_DEFERRED     // 经无锁队列由分发任务回调，字符串负载须为静态
+} event_delivery_t;
+
 // 事件监听器
 typedef struct event_listener {
     event_callback_t callback;
     void* user_data;
     uint32_t event_mask;  // 位掩码，监听哪些事件
+    event_delivery_t delivery;
     struct event_listener* next;
 } event_listener_t;
 
+// 延迟投递队列容量（必须为 2 的幂）
+#define EVENT_QUEUE_SIZE 64
+
+// 统计信息
+typedef struct {
+    uint32_t published;         // event_publish 调用次数
+    uint32_t delivered;         // 回调次数（同步 + 延迟）
+    uint32_t queued;            // 进入延迟队列的事件数
+    uint32_t dropped;           // 队列满而丢弃的事件数
+    uint32_t queue_high_water;  // 队列最高占用
+} event_system_stats_t;
+
 // 事件系统 API
 int event_system_init(void);
 void event_system_deinit(void);
 int event_subscribe(event_listener_t* listener);
+// 返回 0 后该监听器不会再被回调，可以释放
+// 会等待正在进行的发布/分发结束，不能在回调内调用（返回 -2）
 int event_unsubscribe(event_listener_t* listener);
 void event_publish(const event_t* event);
 void event_publish_type(event_type_t type);
 
+// 延迟投递：处理队列中最多 max_events 个事件，返回处理数量
+// 启动分发任务后由任务调用，也可在主循环中手动调用
+size_t event_system_dispatch_pending(size_t max_events);
+size_t event_system_pending(void);
+#ifdef ESP_PLATFORM
+int event_system_start_dispatcher(uint32_t stack_size, int priority);
+#endif
+
+void event_system_get_stats(event_system_stats_t* stats);
+void event_system_reset_stats(void);
+
 // 便捷订阅宏
 #define EVENT_MASK(event_type) (1U << (event_type))
 
@@ -2,14 +2,33 @@
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef ESP_PLATFORM
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+#define LOG_BUFFER_SIZE 512
+#define LOG_QUEUE_MASK (LOG_DEFERRED_QUEUE_SIZE - 1)
+
+_Static_assert((LOG_DEFERRED_QUEUE_SIZE & LOG_QUEUE_MASK) == 0,
+    "LOG_DEFERRED_QUEUE_SIZE must be a power of two");
+_Static_assert(LOG_DEFERRED_STRING_SIZE <= 255, "string offsets are stored in uint8_t");
 
 static log_config_t g_log_config = {
     .level = LOG_LEVEL_INFO,
     .output_fn = NULL,
     .use_colors = true,
-    .print_timestamp = false
+    .print_timestamp = false,
+    .deferred = false
 };
 
+static FILE* g_output_file = NULL;
+
 static const char* g_level_strings[] = {
     "NONE",
     "E",
@@ -30,11 +49,95 @@ static const char* g_level_colors[] = {
 
 static const char* g_level_color_reset = "\033[0m";
 
+// 延迟日志记录：只保存格式串指针和原始参数，格式化由后台完成
+typedef union {
+    long long i;
+    double d;
+    const void* p;
+} log_arg_t;
+
+typedef struct {
+    uint64_t timestamp_us;
+    const char* tag;
+    const char* fmt;
+    uint8_t level;
+    uint8_t arg_count;
+    uint8_t string_used;
+    bool truncated;
+    log_arg_t args[LOG_DEFERRED_MAX_ARGS];
+    char strings[LOG_DEFERRED_STRING_SIZE];
+} log_record_t;
+
+typedef struct {
+    atomic_size_t sequence;
+    log_record_t record;
+} log_cell_t;
+
+static log_cell_t g_queue[LOG_DEFERRED_QUEUE_SIZE];
+static atomic_size_t g_queue_head = 0;
+static atomic_size_t g_queue_tail = 0;
+static atomic_bool g_queue_ready = false;
+
+static atomic_uint g_stat_written = 0;
+static atomic_uint g_stat_dropped = 0;
+static atomic_uint g_stat_truncated = 0;
+static atomic_uint g_stat_emitted = 0;
+
+#ifdef ESP_PLATFORM
+static TaskHandle_t g_log_task = NULL;
+#endif
+
+// 格式说明符解析结果
+typedef enum {
+    LEN_NONE,
+    LEN_HH,
+    LEN_H,
+    LEN_L,
+    LEN_LL,
+    LEN_Z,
+    LEN_J,
+    LEN_T,
+    LEN_BIG_L
+} length_mod_t;
+
+typedef struct {
+    const char* flags;
+    size_t flags_len;
+    const char* width;      // 数字宽度，'*' 时为 NULL 且 star_width 为 true
+    size_t width_len;
+    const char* precision;
+    size_t precision_len;
+    bool has_precision;
+    bool star_width;
+    bool star_precision;
+    length_mod_t length;
+    char conversion;        // 0 表示格式串非法
+} format_spec_t;
+
+static uint64_t log_now_us(void) {
+#ifdef ESP_PLATFORM
+    return (uint64_t)esp_timer_get_time();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+#endif
+}
+
 void log_init(const log_config_t* config) {
     if (config == NULL) {
         return;
     }
     memcpy(&g_log_config, config, sizeof(log_config_t));
+
+    if (config->deferred && !atomic_load(&g_queue_ready)) {
+        for (size_t i = 0; i < LOG_DEFERRED_QUEUE_SIZE; i++) {
+            atomic_store_explicit(&g_queue[i].sequence, i, memory_order_relaxed);
+        }
+        atomic_store(&g_queue_head, 0);
+        atomic_store(&g_queue_tail, 0);
+        atomic_store(&g_queue_ready, true);
+    }
 }
 
 void log_set_level(log_level_t level) {
@@ -45,33 +148,469 @@ log_level_t log_get_level(void) {
     return g_log_config.level;
 }
 
-static void log_print(log_level_t level, const char* tag, const char* fmt, va_list args) {
-    if (level > g_log_config.level) {
+void log_set_output_file(FILE* fp) {
+    g_output_file = fp;
+}
+
+static void log_emit(log_level_t level, const char* tag, uint64_t timestamp_us, const char* msg) {
+    atomic_fetch_add_explicit(&g_stat_emitted, 1, memory_order_relaxed);
+
+    if (g_log_config.output_fn != NULL) {
+        g_log_config.output_fn(level, tag, msg);
         return;
     }
 
-    char buffer[512];
-    vsnprintf(buffer, sizeof(buffer), fmt, args);
+    FILE* out = g_output_file != NULL ? g_output_file : stdout;
+    char timestamp[24] = "";
+    if (g_log_config.print_timestamp) {
+        snprintf(timestamp, sizeof(timestamp), "(%llu) ",
+                 (unsigned long long)(timestamp_us / 1000));
+    }
 
-    if (g_log_config.output_fn != NULL) {
-        g_log_config.output_fn(level, tag, buffer);
+    if (g_log_config.use_colors) {
+        fprintf(out, "%s[%s]%s[%s] %s%s\n",
+                g_level_colors[level],
+                g_level_strings[level],
+                timestamp,
+                tag,
+                msg,
+                g_level_color_reset);
     } else {
-        if (g_log_config.use_colors) {
-            printf("%s[%s][%s] %s%s\n",
-                   g_level_colors[level],
-                   g_level_strings[level],
-                   tag,
-                   buffer,
-                   g_level_color_reset);
+        fprintf(out, "[%s]%s[%s] %s\n",
+                g_level_strings[level],
+                timestamp,
+                tag,
+                msg);
+    }
+}
+
+// 解析 '%' 开始的格式说明符，返回说明符之后的位置
+static const char* parse_spec(const char* p, format_spec_t* spec) {
+    memset(spec, 0, sizeof(*spec));
+    const char* q = p + 1;
+
+    if (*q == '%') {
+        spec->conversion = '%';
+        return q + 1;
+    }
+
+    spec->flags = q;
+    while (*q != '\0' && strchr("-+ #0", *q) != NULL) {
+        q++;
+    }
+    spec->flags_len = (size_t)(q - spec->flags);
+
+    if (*q == '*') {
+        spec->star_width = true;
+        q++;
+    } else {
+        spec->width = q;
+        while (*q >= '0' && *q <= '9') {
+            q++;
+        }
+        spec->width_len = (size_t)(q - spec->width);
+    }
+
+    if (*q == '.') {
+        spec->has_precision = true;
+        q++;
+        if (*q == '*') {
+            spec->star_precision = true;
+            q++;
         } else {
-            printf("[%s][%s] %s\n",
-                   g_level_strings[level],
-                   tag,
-                   buffer);
+            spec->precision = q;
+            while (*q >= '0' && *q <= '9') {
+                q++;
+            }
+            spec->precision_len = (size_t)(q - spec->precision);
+        }
+    }
+
+    switch (*q) {
+        case 'h':
+            q++;
+            if (*q == 'h') {
+                spec->length = LEN_HH;
+                q++;
+            } else {
+                spec->length = LEN_H;
+            }
+            break;
+        case 'l':
+            q++;
+            if (*q == 'l') {
+                spec->length = LEN_LL;
+                q++;
+            } else {
+                spec->length = LEN_L;
+            }
+            break;
+        case 'z': spec->length = LEN_Z; q++; break;
+        case 'j': spec->length = LEN_J; q++; break;
+        case 't': spec->length = LEN_T; q++; break;
+        case 'L': spec->length = LEN_BIG_L; q++; break;
+        default: break;
+    }
+
+    if (*q == '\0' || strchr("diuoxXcspfFeEgGaAn", *q) == NULL) {
+        spec->conversion = 0;
+        return q;
+    }
+    spec->conversion = *q;
+    return q + 1;
+}
+
+static long long read_signed(va_list* args, length_mod_t length) {
+    switch (length) {
+        case LEN_HH: return (signed char)va_arg(*args, int);
+        case LEN_H:  return (short)va_arg(*args, int);
+        case LEN_L:  return va_arg(*args, long);
+        case LEN_LL: return va_arg(*args, long long);
+        case LEN_Z:  return (long long)va_arg(*args, size_t);
+        case LEN_J:  return (long long)va_arg(*args, intmax_t);
+        case LEN_T:  return (long long)va_arg(*args, ptrdiff_t);
+        default:     return va_arg(*args, int);
+    }
+}
+
+static long long read_unsigned(va_list* args, length_mod_t length) {
+    switch (length) {
+        case LEN_HH: return (unsigned char)va_arg(*args, unsigned int);
+        case LEN_H:  return (unsigned short)va_arg(*args, unsigned int);
+        case LEN_L:  return (long long)va_arg(*args, unsigned long);
+        case LEN_LL: return (long long)va_arg(*args, unsigned long long);
+        case LEN_Z:  return (long long)va_arg(*args, size_t);
+        case LEN_J:  return (long long)va_arg(*args, uintmax_t);
+        case LEN_T:  return (long long)va_arg(*args, ptrdiff_t);
+        default:     return (long long)va_arg(*args, unsigned int);
+    }
+}
+
+// 按格式串把参数拷贝进记录；遇到无法识别的说明符时停止并标记截断
+static void capture_args(log_record_t* record, const char* fmt, va_list* args) {
+    record->arg_count = 0;
+    record->string_used = 0;
+    record->truncated = false;
+
+    for (const char* p = fmt; *p != '\0';) {
+        if (*p != '%') {
+            p++;
+            continue;
+        }
+
+        format_spec_t spec;
+        p = parse_spec(p, &spec);
+        if (spec.conversion == '%') {
+            continue;
+        }
+        if (spec.conversion == 0) {
+            record->truncated = true;
+            return;
+        }
+
+        size_t needed = (spec.star_width ? 1 : 0) + (spec.star_precision ? 1 : 0) +
+                        (spec.conversion == 'n' ? 0 : 1);
+        if (record->arg_count + needed > LOG_DEFERRED_MAX_ARGS) {
+            record->truncated = true;
+            return;
+        }
+
+        if (spec.star_width) {
+            record->args[record->arg_count++].i = va_arg(*args, int);
+        }
+        if (spec.star_precision) {
+            record->args[record->arg_count++].i = va_arg(*args, int);
         }
+
+        log_arg_t* arg = &record->args[record->arg_count];
+        switch (spec.conversion) {
+            case 'd':
+            case 'i':
+                arg->i = read_signed(args, spec.length);
+                break;
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                arg->i = read_unsigned(args, spec.length);
+                break;
+            case 'c':
+                arg->i = va_arg(*args, int);
+                break;
+            case 'p':
+                arg->p = va_arg(*args, void*);
+                break;
+            case 's': {
+                const char* str = va_arg(*args, const char*);
+                if (str == NULL) {
+                    arg->i = -1;
+                    break;
+                }
+                // 字符串拷贝到记录内，空间不足时截断
+                size_t space = LOG_DEFERRED_STRING_SIZE - record->string_used;
+                size_t len = strnlen(str, space > 0 ? space - 1 : 0);
+                if (space == 0 || str[len] != '\0') {
+                    record->truncated = true;
+                }
+                if (space == 0) {
+                    arg->i = -1;
+                    break;
+                }
+                memcpy(record->strings + record->string_used, str, len);
+                record->strings[record->string_used + len] = '\0';
+                arg->i = record->string_used;
+                record->string_used += (uint8_t)(len + 1);
+                break;
+            }
+            case 'n':
+                (void)va_arg(*args, void*);
+                continue;
+            default:
+                if (spec.length == LEN_BIG_L) {
+                    arg->d = (double)va_arg(*args, long double);
+                } else {
+                    arg->d = va_arg(*args, double);
+                }
+                break;
+        }
+        record->arg_count++;
     }
 }
 
+// 在后台任务中按记录重建输出
+static void format_record(const log_record_t* record, char* out, size_t size) {
+    size_t pos = 0;
+    size_t arg_index = 0;
+
+#define OUT_REMAINING (pos < size ? size - pos : 0)
+#define OUT_ADVANCE(n) do { if ((n) > 0) pos += (size_t)(n); } while (0)
+
+    for (const char* p = record->fmt; *p != '\0' && pos + 1 < size;) {
+        if (*p != '%') {
+            out[pos++] = *p++;
+            continue;
+        }
+
+        format_spec_t spec;
+        p = parse_spec(p, &spec);
+        if (spec.conversion == '%') {
+            out[pos++] = '%';
+            continue;
+        }
+        if (spec.conversion == 0 || spec.conversion == 'n') {
+            if (spec.conversion == 0) {
+                break;
+            }
+            continue;
+        }
+
+        size_t needed = (spec.star_width ? 1 : 0) + (spec.star_precision ? 1 : 0) + 1;
+        if (arg_index + needed > record->arg_count) {
+            break;
+        }
+
+        // 重建说明符：展开 '*'，整数统一使用 ll 长度
+        char spec_buf[48];
+        size_t n = 0;
+        spec_buf[n++] = '%';
+        memcpy(spec_buf + n, spec.flags, spec.flags_len);
+        n += spec.flags_len;
+        if (spec.star_width) {
+            n += (size_t)snprintf(spec_buf + n, sizeof(spec_buf) - n, "%d",
+                                  (int)record->args[arg_index++].i);
+        } else if (spec.width_len > 0 && spec.width_len < 8) {
+            memcpy(spec_buf + n, spec.width, spec.width_len);
+            n += spec.width_len;
+        }
+        if (spec.has_precision) {
+            spec_buf[n++] = '.';
+            if (spec.star_precision) {
+                n += (size_t)snprintf(spec_buf + n, sizeof(spec_buf) - n, "%d",
+                                      (int)record->args[arg_index++].i);
+            } else if (spec.precision_len < 8) {
+                memcpy(spec_buf + n, spec.precision, spec.precision_len);
+                n += spec.precision_len;
+            }
+        }
+
+        const log_arg_t* arg = &record->args[arg_index++];
+        int written = 0;
+        switch (spec.conversion) {
+            case 'd':
+            case 'i':
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                spec_buf[n++] = 'l';
+                spec_buf[n++] = 'l';
+                spec_buf[n++] = spec.conversion;
+                spec_buf[n] = '\0';
+                written = snprintf(out + pos, OUT_REMAINING, spec_buf, arg->i);
+                break;
+            case 'c':
+                spec_buf[n++] = 'c';
+                spec_buf[n] = '\0';
+                written = snprintf(out + pos, OUT_REMAINING, spec_buf, (int)arg->i);
+                break;
+            case 'p':
+                spec_buf[n++] = 'p';
+                spec_buf[n] = '\0';
+                written = snprintf(out + pos, OUT_REMAINING, spec_buf, arg->p);
+                break;
+            case 's':
+                spec_buf[n++] = 's';
+                spec_buf[n] = '\0';
+                written = snprintf(out + pos, OUT_REMAINING, spec_buf,
+                                   arg->i < 0 ? "(null)" : record->strings + arg->i);
+                break;
+            default:
+                spec_buf[n++] = spec.conversion;
+                spec_buf[n] = '\0';
+                written = snprintf(out + pos, OUT_REMAINING, spec_buf, arg->d);
+                break;
+        }
+        OUT_ADVANCE(written);
+    }
+
+    if (record->truncated && pos + 4 < size) {
+        memcpy(out + pos, "...", 3);
+        pos += 3;
+    }
+    if (pos >= size) {
+        pos = size - 1;
+    }
+    out[pos] = '\0';
+
+#undef OUT_REMAINING
+#undef OUT_ADVANCE
+}
+
+static void log_defer(log_level_t level, const char* tag, const char* fmt, va_list args) {
+    size_t pos = atomic_load_explicit(&g_queue_tail, memory_order_relaxed);
+    log_cell_t* cell;
+
+    for (;;) {
+        cell = &g_queue[pos & LOG_QUEUE_MASK];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&g_queue_tail, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            atomic_fetch_add_explicit(&g_stat_dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&g_queue_tail, memory_order_relaxed);
+        }
+    }
+
+    // 槽位已被占有，直接在队列中填写记录
+    log_record_t* record = &cell->record;
+    record->timestamp_us = log_now_us();
+    record->tag = tag;
+    record->fmt = fmt;
+    record->level = (uint8_t)level;
+
+    va_list args_copy;
+    va_copy(args_copy, args);
+    capture_args(record, fmt, &args_copy);
+    va_end(args_copy);
+
+    if (record->truncated) {
+        atomic_fetch_add_explicit(&g_stat_truncated, 1, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    atomic_fetch_add_explicit(&g_stat_written, 1, memory_order_relaxed);
+
+#ifdef ESP_PLATFORM
+    if (g_log_task != NULL) {
+        xTaskNotifyGive(g_log_task);
+    }
+#endif
+}
+
+size_t log_flush(size_t max_records) {
+    if (!atomic_load(&g_queue_ready)) {
+        return 0;
+    }
+
+    size_t processed = 0;
+    char buffer[LOG_BUFFER_SIZE];
+
+    while (processed < max_records) {
+        size_t pos = atomic_load_explicit(&g_queue_head, memory_order_relaxed);
+        log_cell_t* cell = &g_queue[pos & LOG_QUEUE_MASK];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        if ((intptr_t)seq - (intptr_t)(pos + 1) < 0) {
+            break;  // 队列为空
+        }
+        if (!atomic_compare_exchange_strong_explicit(&g_queue_head, &pos, pos + 1,
+                memory_order_relaxed, memory_order_relaxed)) {
+            continue;
+        }
+
+        const log_record_t* record = &cell->record;
+        format_record(record, buffer, sizeof(buffer));
+        log_emit((log_level_t)record->level, record->tag, record->timestamp_us, buffer);
+
+        atomic_store_explicit(&cell->sequence, pos + LOG_DEFERRED_QUEUE_SIZE, memory_order_release);
+        processed++;
+    }
+    return processed;
+}
+
+#ifdef ESP_PLATFORM
+static void log_deferred_task(void* arg) {
+    (void)arg;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (log_flush(LOG_DEFERRED_QUEUE_SIZE) > 0) {
+        }
+    }
+}
+
+int log_start_deferred_task(uint32_t stack_size, int priority) {
+    if (g_log_task != NULL) {
+        return 0;
+    }
+    if (xTaskCreate(log_deferred_task, "log_deferred", stack_size, NULL,
+                    priority, &g_log_task) != pdPASS) {
+        g_log_task = NULL;
+        return -1;
+    }
+    return 0;
+}
+#endif
+
+void log_get_stats(log_stats_t* stats) {
+    if (stats == NULL) {
+        return;
+    }
+    stats->deferred_written = atomic_load_explicit(&g_stat_written, memory_order_relaxed);
+    stats->deferred_dropped = atomic_load_explicit(&g_stat_dropped, memory_order_relaxed);
+    stats->deferred_truncated = atomic_load_explicit(&g_stat_truncated, memory_order_relaxed);
+    stats->emitted = atomic_load_explicit(&g_stat_emitted, memory_order_relaxed);
+}
+
+static void log_print(log_level_t level, const char* tag, const char* fmt, va_list args) {
+    if (level > g_log_config.level) {
+        return;
+    }
+
+    if (g_log_config.deferred && atomic_load_explicit(&g_queue_ready, memory_order_relaxed)) {
+        log_defer(level, tag, fmt, args);
+        return;
+    }
+
+    char buffer[LOG_BUFFER_SIZE];
+    vsnprintf(buffer, sizeof(buffer), fmt, args);
+    log_emit(level, tag, log_now_us(), buffer);
+}
+
 void log_error(const char* tag, const char* fmt, ...) {
     va_list args;
     va_start(args, fmt);
@@ -3,6 +3,9 @@
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,7 +21,12 @@ typedef enum {
     LOG_LEVEL_VERBOSE
 } log_level_t;
 
-// 日志输出函数类型
+// 编译期日志级别：高于此级别的 LOGx 调用在编译时被移除
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_VERBOSE
+#endif
+
+// 日志输出函数类型（UART、文件、UDP 调试通道等）
 typedef void (*log_output_fn)(log_level_t level, const char* tag, const char* msg);
 
 // 日志配置
@@ -27,12 +35,30 @@ typedef struct {
     log_output_fn output_fn;
     bool use_colors;
     bool print_timestamp;
+    // 延迟模式：调用方只记录格式串指针和原始参数，由后台任务格式化输出
+    // tag 和 fmt 必须是静态字符串；%s 参数会被拷贝
+    bool deferred;
 } log_config_t;
 
+// 延迟日志队列容量（记录条数，必须为 2 的幂）
+#define LOG_DEFERRED_QUEUE_SIZE 64
+// 单条记录最多参数个数与字符串参数总长度
+#define LOG_DEFERRED_MAX_ARGS 8
+#define LOG_DEFERRED_STRING_SIZE 64
+
+// 日志统计
+typedef struct {
+    uint32_t deferred_written;  // 进入队列的记录数
+    uint32_t deferred_dropped;  // 队列满而丢弃的记录数
+    uint32_t deferred_truncated; // 参数或字符串被截断的记录数
+    uint32_t emitted;           // 实际输出的记录数
+} log_stats_t;
+
 // 日志 API
 void log_init(const log_config_t* config);
 void log_set_level(log_level_t level);
 log_level_t log_get_level(void);
+void log_set_output_file(FILE* fp);     // output_fn 为 NULL 时的输出目标，默认 stdout
 
 void log_error(const char* tag, const char* fmt, ...);
 void log_warn(const char* tag, const char* fmt, ...);
@@ -40,12 +66,22 @@ void log_info(const char* tag, const char* fmt, ...);
 void log_debug(const char* tag, const char* fmt, ...);
 void log_verbose(const char* tag, const char* fmt, ...);
 
+// 延迟模式：格式化并输出最多 max_records 条记录，返回处理数量
+size_t log_flush(size_t max_records);
+#ifdef ESP_PLATFORM
+int log_start_deferred_task(uint32_t stack_size, int priority);
+#endif
+void log_get_stats(log_stats_t* stats);
+
 // 简写宏
-#define LOGE(tag, ...) log_error(tag, __VA_ARGS__)
-#define LOGW(tag, ...) log_warn(tag, __VA_ARGS__)
-#define LOGI(tag, ...) log_info(tag, __VA_ARGS__)
-#define LOGD(tag, ...) log_debug(tag, __VA_ARGS__)
-#define LOGV(tag, ...) log_verbose(tag, __VA_ARGS__)
+#define LOG_AT_LEVEL(level, fn, tag, ...) \
+    do { if ((level) <= LOG_COMPILE_LEVEL) fn(tag, __VA_ARGS__); } while (0)
+
+#define LOGE(tag, ...) LOG_AT_LEVEL(LOG_LEVEL_ERROR, log_error, tag, __VA_ARGS__)
+#define LOGW(tag, ...) LOG_AT_LEVEL(LOG_LEVEL_WARN, log_warn, tag, __VA_ARGS__)
+#define LOGI(tag, ...) LOG_AT_LEVEL(LOG_LEVEL_INFO, log_info, tag, __VA_ARGS__)
+#define LOGD(tag, ...) LOG_AT_LEVEL(LOG_LEVEL_DEBUG, log_debug, tag, __VA_ARGS__)
+#define LOGV(tag, ...) LOG_AT_LEVEL(LOG_LEVEL_VERBOSE, log_verbose, tag, __VA_ARGS__)
 
 #ifdef __cplusplus
 }
@@ -1,65 +1,133 @@
 #include "memory_pool.h"
 #include <stdlib.h>
 #include <string.h>
+#include <stdatomic.h>
 
-// 内存块头部
-typedef struct memory_block_header {
-    memory_pool_t* pool;
-    bool in_use;
-} memory_block_header_t;
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#endif
 
+// 空闲链表头：高 48 位为版本号（防 ABA），低 16 位为块索引
+// 16 位版本号在一次 CAS 窗口内被其他任务的 65536 次分配/释放绕回后会出现 ABA，
+// 低优先级任务被抢占时并非不可能；48 位版本号按每微秒一次操作也要约 9 年才会绕回。
+// 没有 64 位 CAS 指令的芯片上，ESP-IDF 以短临界区实现 64 位原子操作
+#define FREE_INDEX_NONE 0xFFFFu
+#define HEAD_INDEX(h) ((uint32_t)((h) & 0xFFFFu))
+#define HEAD_TAG(h) ((uint64_t)(h) >> 16)
+#define MAKE_HEAD(tag, index) (((uint64_t)(tag) << 16) | ((uint64_t)(index) & 0xFFFFu))
+
+// 块元数据独立存放在默认堆中，块本身不带头部
 struct memory_pool {
-    void* buffer;
+    uint8_t* buffer;
     size_t block_size;
     size_t block_count;
-    size_t free_count;
-    void* free_list;
+    memory_pool_placement_t placement;
+
+    atomic_uint_least64_t free_head;
+    _Atomic uint16_t* next;             // 空闲链表中的下一个块索引
+    atomic_uint_least32_t* in_use_bits; // 每块 1 位，用于检测重复释放
+
+    atomic_size_t free_count;
+    atomic_size_t high_water;
+    atomic_uint alloc_count;
+    atomic_uint fail_count;
+};
+
+struct memory_pool_set {
+    memory_pool_t* pools[MEMORY_POOL_SET_MAX_CLASSES];
+    _Atomic uint32_t* requested[MEMORY_POOL_SET_MAX_CLASSES];   // 每块的请求大小，释放时扣除
+    size_t class_count;
+    memory_pool_placement_t placement;
+    bool fallback_to_heap;
+
+    atomic_uint heap_fallback_count;
+    atomic_uint_least64_t bytes_requested;
+    atomic_uint_least64_t bytes_reserved;
 };
 
 // 对齐到 8 字节
-#define ALIGN_8(x) (((x) + 7) & ~7)
+#define ALIGN_8(x) (((x) + 7) & ~(size_t)7)
+
+// 退回堆分配的块前面保存请求大小，长度保持 MEMORY_POOL_ALIGNMENT 对齐
+#define HEAP_HEADER_SIZE ALIGN_8(sizeof(size_t))
+
+// 默认级别：64 B - 8 KB，共约 74 KB
+static const memory_pool_config_t g_default_classes[] = {
+    { 64,   32, MEMORY_POOL_PLACEMENT_DEFAULT },
+    { 128,  32, MEMORY_POOL_PLACEMENT_DEFAULT },
+    { 256,  16, MEMORY_POOL_PLACEMENT_DEFAULT },
+    { 512,  16, MEMORY_POOL_PLACEMENT_DEFAULT },
+    { 1024, 8,  MEMORY_POOL_PLACEMENT_DEFAULT },
+    { 2048, 8,  MEMORY_POOL_PLACEMENT_DEFAULT },
+    { 4096, 4,  MEMORY_POOL_PLACEMENT_DEFAULT },
+    { 8192, 2,  MEMORY_POOL_PLACEMENT_DEFAULT },
+};
+
+static void* placement_alloc(size_t size, memory_pool_placement_t placement) {
+#ifdef ESP_PLATFORM
+    switch (placement) {
+        case MEMORY_POOL_PLACEMENT_INTERNAL:
+            return heap_caps_aligned_alloc(MEMORY_POOL_ALIGNMENT, size,
+                                           MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        case MEMORY_POOL_PLACEMENT_PSRAM:
+            return heap_caps_aligned_alloc(MEMORY_POOL_ALIGNMENT, size,
+                                           MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        default:
+            return heap_caps_aligned_alloc(MEMORY_POOL_ALIGNMENT, size, MALLOC_CAP_8BIT);
+    }
+#else
+    (void)placement;
+    return malloc(size);
+#endif
+}
+
+static void placement_free(void* ptr) {
+#ifdef ESP_PLATFORM
+    heap_caps_free(ptr);
+#else
+    free(ptr);
+#endif
+}
 
 memory_pool_t* memory_pool_create(const memory_pool_config_t* config) {
-    if (config == NULL || config->block_size == 0 || config->block_count == 0) {
+    if (config == NULL || config->block_size == 0 || config->block_count == 0 ||
+        config->block_count > MEMORY_POOL_MAX_BLOCKS) {
         return NULL;
     }
 
-    memory_pool_t* pool = malloc(sizeof(memory_pool_t));
+    memory_pool_t* pool = calloc(1, sizeof(memory_pool_t));
     if (pool == NULL) {
         return NULL;
     }
 
-    size_t aligned_block_size = ALIGN_8(config->block_size + sizeof(memory_block_header_t));
-    size_t total_size = aligned_block_size * config->block_count;
+    size_t aligned_block_size = ALIGN_8(config->block_size);
+    size_t bitmap_words = (config->block_count + 31) / 32;
 
-    pool->buffer = malloc(total_size);
-    if (pool->buffer == NULL) {
-        free(pool);
+    pool->buffer = placement_alloc(aligned_block_size * config->block_count, config->placement);
+    pool->next = calloc(config->block_count, sizeof(*pool->next));
+    pool->in_use_bits = calloc(bitmap_words, sizeof(*pool->in_use_bits));
+    if (pool->buffer == NULL || pool->next == NULL || pool->in_use_bits == NULL) {
+        memory_pool_destroy(pool);
         return NULL;
     }
 
     pool->block_size = aligned_block_size;
     pool->block_count = config->block_count;
-    pool->free_count = config->block_count;
-    pool->free_list = pool->buffer;
+    pool->placement = config->placement;
 
     // 初始化空闲链表
-    char* block = (char*)pool->buffer;
     for (size_t i = 0; i < config->block_count; i++) {
-        memory_block_header_t* header = (memory_block_header_t*)block;
-        header->pool = pool;
-        header->in_use = false;
-
-        // 将当前块指向下一个块
-        char* next = block + aligned_block_size;
-        if (i < config->block_count - 1) {
-            *(char**)block = next;
-        } else {
-            *(char**)block = NULL;
-        }
-
-        block = next;
+        uint16_t next = (i < config->block_count - 1) ? (uint16_t)(i + 1) : FREE_INDEX_NONE;
+        atomic_init(&pool->next[i], next);
+    }
+    for (size_t i = 0; i < bitmap_words; i++) {
+        atomic_init(&pool->in_use_bits[i], 0);
     }
+    atomic_init(&pool->free_head, MAKE_HEAD(0, 0));
+    atomic_init(&pool->free_count, config->block_count);
+    atomic_init(&pool->high_water, 0);
+    atomic_init(&pool->alloc_count, 0);
+    atomic_init(&pool->fail_count, 0);
 
     return pool;
 }
@@ -68,51 +136,265 @@ void memory_pool_destroy(memory_pool_t* pool) {
     if (pool == NULL) {
         return;
     }
-    free(pool->buffer);
+    if (pool->buffer != NULL) {
+        placement_free(pool->buffer);
+    }
+    free((void*)pool->next);
+    free((void*)pool->in_use_bits);
     free(pool);
 }
 
 void* memory_pool_alloc(memory_pool_t* pool) {
-    if (pool == NULL || pool->free_list == NULL) {
+    if (pool == NULL) {
         return NULL;
     }
 
-    char* block = (char*)pool->free_list;
-    memory_block_header_t* header = (memory_block_header_t*)block;
+    uint64_t head = atomic_load_explicit(&pool->free_head, memory_order_acquire);
+    uint32_t index;
+    for (;;) {
+        index = HEAD_INDEX(head);
+        if (index == FREE_INDEX_NONE) {
+            atomic_fetch_add_explicit(&pool->fail_count, 1, memory_order_relaxed);
+            return NULL;
+        }
+        uint16_t next = atomic_load_explicit(&pool->next[index], memory_order_relaxed);
+        if (atomic_compare_exchange_weak_explicit(&pool->free_head, &head,
+                MAKE_HEAD(HEAD_TAG(head) + 1, next),
+                memory_order_acq_rel, memory_order_acquire)) {
+            break;
+        }
+    }
+
+    atomic_fetch_or_explicit(&pool->in_use_bits[index / 32], 1u << (index % 32),
+                             memory_order_relaxed);
+    atomic_fetch_add_explicit(&pool->alloc_count, 1, memory_order_relaxed);
 
-    pool->free_list = *(char**)block;
-    header->in_use = true;
-    pool->free_count--;
+    size_t in_use = pool->block_count -
+        (atomic_fetch_sub_explicit(&pool->free_count, 1, memory_order_relaxed) - 1);
+    size_t high = atomic_load_explicit(&pool->high_water, memory_order_relaxed);
+    while (in_use > high &&
+           !atomic_compare_exchange_weak_explicit(&pool->high_water, &high, in_use,
+               memory_order_relaxed, memory_order_relaxed)) {
+    }
 
-    return block + sizeof(memory_block_header_t);
+    return pool->buffer + (size_t)index * pool->block_size;
 }
 
-void memory_pool_free(memory_pool_t* pool, void* ptr) {
+bool memory_pool_owns(const memory_pool_t* pool, const void* ptr) {
     if (pool == NULL || ptr == NULL) {
-        return;
+        return false;
+    }
+    const uint8_t* p = (const uint8_t*)ptr;
+    return p >= pool->buffer && p < pool->buffer + pool->block_size * pool->block_count;
+}
+
+// 归还 index 号块，重复释放时返回 false
+static bool release_block(memory_pool_t* pool, uint32_t index) {
+    uint32_t bit = 1u << (index % 32);
+    uint32_t prev = atomic_fetch_and_explicit(&pool->in_use_bits[index / 32], ~bit,
+                                              memory_order_relaxed);
+    if (!(prev & bit)) {
+        return false;
     }
 
-    char* block = (char*)ptr - sizeof(memory_block_header_t);
-    memory_block_header_t* header = (memory_block_header_t*)block;
+    uint64_t head = atomic_load_explicit(&pool->free_head, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&pool->next[index], (uint16_t)HEAD_INDEX(head), memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->free_head, &head,
+                 MAKE_HEAD(HEAD_TAG(head) + 1, index),
+                 memory_order_release, memory_order_relaxed));
 
-    if (!header->in_use || header->pool != pool) {
+    atomic_fetch_add_explicit(&pool->free_count, 1, memory_order_relaxed);
+    return true;
+}
+
+void memory_pool_free(memory_pool_t* pool, void* ptr) {
+    if (!memory_pool_owns(pool, ptr)) {
         return;
     }
 
-    header->in_use = false;
-    *(char**)block = pool->free_list;
-    pool->free_list = block;
-    pool->free_count++;
+    size_t offset = (size_t)((uint8_t*)ptr - pool->buffer);
+    if (offset % pool->block_size != 0) {
+        return;
+    }
+    release_block(pool, (uint32_t)(offset / pool->block_size));
 }
 
 size_t memory_pool_available(memory_pool_t* pool) {
-    return pool ? pool->free_count : 0;
+    return pool ? atomic_load_explicit(&pool->free_count, memory_order_relaxed) : 0;
 }
 
 size_t memory_pool_block_size(memory_pool_t* pool) {
-    return pool ? (pool->block_size - sizeof(memory_block_header_t)) : 0;
+    return pool ? pool->block_size : 0;
 }
 
 bool memory_pool_is_valid(memory_pool_t* pool) {
     return pool != NULL && pool->buffer != NULL;
 }
+
+void memory_pool_get_stats(const memory_pool_t* pool, memory_pool_stats_t* stats) {
+    if (stats == NULL) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (pool == NULL) {
+        return;
+    }
+    memory_pool_t* p = (memory_pool_t*)pool;
+    stats->block_size = p->block_size;
+    stats->block_count = p->block_count;
+    stats->in_use = p->block_count - atomic_load_explicit(&p->free_count, memory_order_relaxed);
+    stats->high_water = atomic_load_explicit(&p->high_water, memory_order_relaxed);
+    stats->alloc_count = atomic_load_explicit(&p->alloc_count, memory_order_relaxed);
+    stats->fail_count = atomic_load_explicit(&p->fail_count, memory_order_relaxed);
+}
+
+memory_pool_set_t* memory_pool_set_create(const memory_pool_set_config_t* config) {
+    const memory_pool_config_t* classes = g_default_classes;
+    size_t class_count = sizeof(g_default_classes) / sizeof(g_default_classes[0]);
+    memory_pool_placement_t placement = MEMORY_POOL_PLACEMENT_DEFAULT;
+    bool fallback_to_heap = true;
+
+    if (config != NULL) {
+        if (config->classes != NULL) {
+            classes = config->classes;
+            class_count = config->class_count;
+        }
+        placement = config->placement;
+        fallback_to_heap = config->fallback_to_heap;
+    }
+    if (class_count == 0 || class_count > MEMORY_POOL_SET_MAX_CLASSES) {
+        return NULL;
+    }
+
+    memory_pool_set_t* set = calloc(1, sizeof(memory_pool_set_t));
+    if (set == NULL) {
+        return NULL;
+    }
+    set->class_count = class_count;
+    set->placement = placement;
+    set->fallback_to_heap = fallback_to_heap;
+
+    for (size_t i = 0; i < class_count; i++) {
+        if (i > 0 && classes[i].block_size <= classes[i - 1].block_size) {
+            memory_pool_set_destroy(set);
+            return NULL;
+        }
+        memory_pool_config_t class_config = classes[i];
+        class_config.placement = placement;
+        set->pools[i] = memory_pool_create(&class_config);
+        set->requested[i] = calloc(classes[i].block_count, sizeof(*set->requested[i]));
+        if (set->pools[i] == NULL || set->requested[i] == NULL) {
+            memory_pool_set_destroy(set);
+            return NULL;
+        }
+    }
+    return set;
+}
+
+void memory_pool_set_destroy(memory_pool_set_t* set) {
+    if (set == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < set->class_count; i++) {
+        memory_pool_destroy(set->pools[i]);
+        free((void*)set->requested[i]);
+    }
+    free(set);
+}
+
+void* memory_pool_set_alloc(memory_pool_set_t* set, size_t size) {
+    if (set == NULL || size == 0) {
+        return NULL;
+    }
+
+    // 从最小满足的级别开始，耗尽时尝试更大的级别
+    for (size_t i = 0; i < set->class_count; i++) {
+        memory_pool_t* pool = set->pools[i];
+        if (pool->block_size < size) {
+            continue;
+        }
+        void* ptr = memory_pool_alloc(pool);
+        if (ptr != NULL) {
+            size_t index = (size_t)((uint8_t*)ptr - pool->buffer) / pool->block_size;
+            atomic_store_explicit(&set->requested[i][index], (uint32_t)size, memory_order_relaxed);
+            atomic_fetch_add_explicit(&set->bytes_requested, size, memory_order_relaxed);
+            atomic_fetch_add_explicit(&set->bytes_reserved, pool->block_size, memory_order_relaxed);
+            return ptr;
+        }
+    }
+
+    if (!set->fallback_to_heap) {
+        return NULL;
+    }
+    if (size > SIZE_MAX - HEAP_HEADER_SIZE) {
+        return NULL;
+    }
+    uint8_t* block = placement_alloc(HEAP_HEADER_SIZE + size, set->placement);
+    if (block == NULL) {
+        return NULL;
+    }
+    memcpy(block, &size, sizeof(size));
+    atomic_fetch_add_explicit(&set->heap_fallback_count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&set->bytes_requested, size, memory_order_relaxed);
+    atomic_fetch_add_explicit(&set->bytes_reserved, size, memory_order_relaxed);
+    return block + HEAP_HEADER_SIZE;
+}
+
+void memory_pool_set_free(memory_pool_set_t* set, void* ptr) {
+    if (set == NULL || ptr == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < set->class_count; i++) {
+        memory_pool_t* pool = set->pools[i];
+        if (memory_pool_owns(pool, ptr)) {
+            size_t offset = (size_t)((uint8_t*)ptr - pool->buffer);
+            if (offset % pool->block_size != 0) {
+                return;
+            }
+            uint32_t index = (uint32_t)(offset / pool->block_size);
+            // 归还后块可能立即被其他任务分配并改写请求大小，先读出；重复释放不扣除
+            uint32_t size = atomic_load_explicit(&set->requested[i][index], memory_order_relaxed);
+            if (release_block(pool, index)) {
+                atomic_fetch_sub_explicit(&set->bytes_requested, size, memory_order_relaxed);
+                atomic_fetch_sub_explicit(&set->bytes_reserved, pool->block_size, memory_order_relaxed);
+            }
+            return;
+        }
+    }
+    if (set->fallback_to_heap) {
+        uint8_t* block = (uint8_t*)ptr - HEAP_HEADER_SIZE;
+        size_t size;
+        memcpy(&size, block, sizeof(size));
+        atomic_fetch_sub_explicit(&set->bytes_requested, size, memory_order_relaxed);
+        atomic_fetch_sub_explicit(&set->bytes_reserved, size, memory_order_relaxed);
+        placement_free(block);
+    }
+}
+
+void memory_pool_set_get_stats(const memory_pool_set_t* set, memory_pool_set_stats_t* stats) {
+    if (stats == NULL) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (set == NULL) {
+        return;
+    }
+    memory_pool_set_t* s = (memory_pool_set_t*)set;
+    stats->class_count = s->class_count;
+    for (size_t i = 0; i < s->class_count; i++) {
+        memory_pool_get_stats(s->pools[i], &stats->classes[i]);
+    }
+    stats->heap_fallback_count = atomic_load_explicit(&s->heap_fallback_count, memory_order_relaxed);
+    stats->bytes_requested = atomic_load_explicit(&s->bytes_requested, memory_order_relaxed);
+    stats->bytes_reserved = atomic_load_explicit(&s->bytes_reserved, memory_order_relaxed);
+}
+
+int memory_pool_set_fragmentation(const memory_pool_set_t* set) {
+    memory_pool_set_stats_t stats;
+    memory_pool_set_get_stats(set, &stats);
+    if (stats.bytes_reserved == 0) {
+        return 0;
+    }
+    return (int)(100 - (stats.bytes_requested * 100) / stats.bytes_reserved);
+}
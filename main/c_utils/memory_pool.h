@@ -2,6 +2,7 @@
 #define MEMORY_POOL_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 
 #ifdef __cplusplus
@@ -9,14 +10,39 @@ extern "C" {
 #endif
 
 typedef struct memory_pool memory_pool_t;
+typedef struct memory_pool_set memory_pool_set_t;
+
+// 单个内存池最多块数（空闲链表使用 16 位索引）
+#define MEMORY_POOL_MAX_BLOCKS 0xFFFE
+
+// 内存池所有块的对齐
+#define MEMORY_POOL_ALIGNMENT 8
+
+// 内存放置位置（仅 ESP 平台有效，主机上均使用 malloc）
+typedef enum {
+    MEMORY_POOL_PLACEMENT_DEFAULT = 0,  // 默认堆
+    MEMORY_POOL_PLACEMENT_INTERNAL,     // 片内 RAM
+    MEMORY_POOL_PLACEMENT_PSRAM         // 外部 PSRAM
+} memory_pool_placement_t;
 
 // 内存池配置
 typedef struct {
     size_t block_size;
     size_t block_count;
+    memory_pool_placement_t placement;
 } memory_pool_config_t;
 
-// 内存池 API
+// 内存池统计
+typedef struct {
+    size_t block_size;
+    size_t block_count;
+    size_t in_use;
+    size_t high_water;      // 同时占用块数的最大值
+    uint32_t alloc_count;
+    uint32_t fail_count;    // 池耗尽导致的分配失败
+} memory_pool_stats_t;
+
+// 内存池 API（线程安全，分配/释放为无锁路径）
 memory_pool_t* memory_pool_create(const memory_pool_config_t* config);
 void memory_pool_destroy(memory_pool_t* pool);
 void* memory_pool_alloc(memory_pool_t* pool);
@@ -24,6 +50,34 @@ void memory_pool_free(memory_pool_t* pool, void* ptr);
 size_t memory_pool_available(memory_pool_t* pool);
 size_t memory_pool_block_size(memory_pool_t* pool);
 bool memory_pool_is_valid(memory_pool_t* pool);
+bool memory_pool_owns(const memory_pool_t* pool, const void* ptr);
+void memory_pool_get_stats(const memory_pool_t* pool, memory_pool_stats_t* stats);
+
+// 分级内存池：按请求大小选择最小的可用级别
+#define MEMORY_POOL_SET_MAX_CLASSES 12
+
+typedef struct {
+    const memory_pool_config_t* classes;    // 按 block_size 升序；NULL 使用默认 64 B - 8 KB 级别
+    size_t class_count;
+    memory_pool_placement_t placement;      // 覆盖各级别的 placement
+    bool fallback_to_heap;                  // 级别耗尽或超出最大级别时退回堆分配
+} memory_pool_set_config_t;
+
+typedef struct {
+    size_t class_count;
+    memory_pool_stats_t classes[MEMORY_POOL_SET_MAX_CLASSES];
+    uint32_t heap_fallback_count;
+    uint64_t bytes_requested;   // 当前在用分配的请求字节数
+    uint64_t bytes_reserved;    // 当前在用分配占用的块字节数
+} memory_pool_set_stats_t;
+
+memory_pool_set_t* memory_pool_set_create(const memory_pool_set_config_t* config);
+void memory_pool_set_destroy(memory_pool_set_t* set);
+void* memory_pool_set_alloc(memory_pool_set_t* set, size_t size);
+void memory_pool_set_free(memory_pool_set_t* set, void* ptr);
+void memory_pool_set_get_stats(const memory_pool_set_t* set, memory_pool_set_stats_t* stats);
+// 内部碎片率（0-100）：当前在用的块中未被请求使用的字节比例
+int memory_pool_set_fragmentation(const memory_pool_set_t* set);
 
 #ifdef __cplusplus
 }
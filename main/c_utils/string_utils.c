@@ -3,10 +3,266 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <math.h>
 
-#define STRING_DEFAULT_CAPACITY 64
+#define STRING_DEFAULT_CAPACITY STRING_SSO_CAPACITY
 #define STRING_GROWTH_FACTOR 2
 
+// 数字格式化缓冲区大小
+#define INT_BUF_SIZE 24
+#define FLOAT_BUF_SIZE 48
+#define FLOAT_MAX_DECIMALS 9
+
+// 竞技场分配按 8 字节对齐（分段结构体也从竞技场分配）
+#define ARENA_ALIGN(x) (((x) + 7) & ~(size_t)7)
+
+struct string_arena {
+    char* buffer;
+    size_t capacity;
+    size_t used;
+};
+
+struct string_rope_segment {
+    struct string_rope_segment* next;
+    size_t len;
+    size_t capacity;
+    bool heap;
+    char data[];
+};
+
+// 两位数查表，避免逐位除法
+static const char g_digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const uint64_t g_pow10[FLOAT_MAX_DECIMALS + 1] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL,
+    1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL
+};
+
+// ---------------------------------------------------------------------------
+// 竞技场
+// ---------------------------------------------------------------------------
+
+static void* arena_alloc(string_arena_t* arena, size_t size) {
+    size_t offset = ARENA_ALIGN(arena->used);
+    if (offset > arena->capacity || size > arena->capacity - offset) {
+        return NULL;
+    }
+    arena->used = offset + size;
+    return arena->buffer + offset;
+}
+
+// 若 ptr 是竞技场中最后一次分配，则原地扩展
+static bool arena_try_extend(string_arena_t* arena, char* ptr, size_t old_size, size_t new_size) {
+    if (ptr + old_size != arena->buffer + arena->used) {
+        return false;
+    }
+    size_t extra = new_size - old_size;
+    if (extra > arena->capacity - arena->used) {
+        return false;
+    }
+    arena->used += extra;
+    return true;
+}
+
+string_arena_t* string_arena_create(size_t capacity) {
+    string_arena_t* arena = malloc(sizeof(string_arena_t));
+    if (arena == NULL) {
+        return NULL;
+    }
+    arena->buffer = malloc(capacity);
+    if (arena->buffer == NULL) {
+        free(arena);
+        return NULL;
+    }
+    arena->capacity = capacity;
+    arena->used = 0;
+    return arena;
+}
+
+void string_arena_destroy(string_arena_t* arena) {
+    if (arena == NULL) {
+        return;
+    }
+    free(arena->buffer);
+    free(arena);
+}
+
+void string_arena_reset(string_arena_t* arena) {
+    if (arena != NULL) {
+        arena->used = 0;
+    }
+}
+
+size_t string_arena_used(const string_arena_t* arena) {
+    return arena ? arena->used : 0;
+}
+
+size_t string_arena_capacity(const string_arena_t* arena) {
+    return arena ? arena->capacity : 0;
+}
+
+// ---------------------------------------------------------------------------
+// 数字格式化
+// ---------------------------------------------------------------------------
+
+// 从缓冲区末尾向前写入，返回长度；结果位于 buf + INT_BUF_SIZE - 返回值
+static size_t format_uint64_reverse(char* end, uint64_t value) {
+    char* p = end;
+    while (value >= 100) {
+        unsigned idx = (unsigned)(value % 100) * 2;
+        value /= 100;
+        *--p = g_digit_pairs[idx + 1];
+        *--p = g_digit_pairs[idx];
+    }
+    if (value >= 10) {
+        unsigned idx = (unsigned)value * 2;
+        *--p = g_digit_pairs[idx + 1];
+        *--p = g_digit_pairs[idx];
+    } else {
+        *--p = (char)('0' + value);
+    }
+    return (size_t)(end - p);
+}
+
+static size_t format_uint64(char* buf, uint64_t value) {
+    char tmp[INT_BUF_SIZE];
+    size_t len = format_uint64_reverse(tmp + sizeof(tmp), value);
+    memcpy(buf, tmp + sizeof(tmp) - len, len);
+    return len;
+}
+
+static size_t format_int64(char* buf, int64_t value) {
+    if (value < 0) {
+        buf[0] = '-';
+        return 1 + format_uint64(buf + 1, (uint64_t)0 - (uint64_t)value);
+    }
+    return format_uint64(buf, (uint64_t)value);
+}
+
+static int clamp_decimals(int decimals) {
+    if (decimals < 0) {
+        return 0;
+    }
+    return decimals > FLOAT_MAX_DECIMALS ? FLOAT_MAX_DECIMALS : decimals;
+}
+
+// 定点快速路径，结果与 "%.*f" 一致；返回 0 表示需要调用方改用 printf：
+// 放大后超出 2^52（小数部分不再精确）或恰好落在 .5 上（需按 printf 的精确值舍入）
+static size_t format_double(char* buf, double value, int decimals) {
+    if (isnan(value)) {
+        memcpy(buf, "nan", 3);
+        return 3;
+    }
+    if (isinf(value)) {
+        if (value < 0) {
+            memcpy(buf, "-inf", 4);
+            return 4;
+        }
+        memcpy(buf, "inf", 3);
+        return 3;
+    }
+
+    bool negative = signbit(value);
+    double magnitude = negative ? -value : value;
+    uint64_t scale = g_pow10[decimals];
+
+    double product = magnitude * (double)scale;
+    if (product >= 4503599627370496.0) {    // 2^52
+        return 0;
+    }
+    // 乘法只可能把真值舍入到相邻的可表示数，小数部分不等于 .5 时舍入方向不受影响
+    double whole = floor(product);
+    double fraction = product - whole;
+    if (fraction == 0.5) {
+        return 0;
+    }
+    uint64_t scaled = (uint64_t)whole + (fraction > 0.5 ? 1 : 0);
+    uint64_t int_part = scaled / scale;
+    uint64_t frac_part = scaled % scale;
+
+    size_t len = 0;
+    if (negative) {
+        buf[len++] = '-';
+    }
+    len += format_uint64(buf + len, int_part);
+    if (decimals > 0) {
+        buf[len++] = '.';
+        for (int i = decimals - 1; i >= 0; i--) {
+            buf[len + i] = (char)('0' + frac_part % 10);
+            frac_part /= 10;
+        }
+        len += decimals;
+    }
+    return len;
+}
+
+// JSON 转义，通过 append 回调写入字符串或分段字符串
+typedef int (*append_fn)(void* target, const char* str, size_t len);
+
+static int append_json_escaped(void* target, append_fn append, const char* str) {
+    static const char hex[] = "0123456789abcdef";
+
+    if (append(target, "\"", 1) != 0) {
+        return -1;
+    }
+
+    const char* run = str;
+    for (const char* p = str; *p != '\0'; p++) {
+        unsigned char c = (unsigned char)*p;
+        char esc[6];
+        size_t esc_len = 0;
+
+        switch (c) {
+            case '"':  esc[0] = '\\'; esc[1] = '"';  esc_len = 2; break;
+            case '\\': esc[0] = '\\'; esc[1] = '\\'; esc_len = 2; break;
+            case '\n': esc[0] = '\\'; esc[1] = 'n';  esc_len = 2; break;
+            case '\r': esc[0] = '\\'; esc[1] = 'r';  esc_len = 2; break;
+            case '\t': esc[0] = '\\'; esc[1] = 't';  esc_len = 2; break;
+            case '\b': esc[0] = '\\'; esc[1] = 'b';  esc_len = 2; break;
+            case '\f': esc[0] = '\\'; esc[1] = 'f';  esc_len = 2; break;
+            default:
+                if (c < 0x20) {
+                    memcpy(esc, "\\u00", 4);
+                    esc[4] = hex[c >> 4];
+                    esc[5] = hex[c & 0xF];
+                    esc_len = 6;
+                }
+                break;
+        }
+
+        if (esc_len > 0) {
+            if (p > run && append(target, run, (size_t)(p - run)) != 0) {
+                return -1;
+            }
+            if (append(target, esc, esc_len) != 0) {
+                return -1;
+            }
+            run = p + 1;
+        }
+    }
+
+    size_t tail = strlen(run);
+    if (tail > 0 && append(target, run, tail) != 0) {
+        return -1;
+    }
+    return append(target, "\"", 1);
+}
+
+// ---------------------------------------------------------------------------
+// 动态字符串
+// ---------------------------------------------------------------------------
+
 static int string_ensure_capacity(string_t* s, size_t needed) {
     if (s == NULL || needed <= s->capacity) {
         return 0;
@@ -21,6 +277,42 @@ static int string_ensure_capacity(string_t* s, size_t needed) {
         new_capacity *= STRING_GROWTH_FACTOR;
     }
 
+    if (s->arena != NULL) {
+        if (s->data != s->sso &&
+            arena_try_extend(s->arena, s->data, s->capacity, new_capacity)) {
+            s->capacity = new_capacity;
+            return 0;
+        }
+        char* new_data = arena_alloc(s->arena, new_capacity);
+        if (new_data != NULL) {
+            memcpy(new_data, s->data, s->len + 1);
+            s->data = new_data;
+            s->capacity = new_capacity;
+            return 0;
+        }
+        // 竞技场已满，转为堆内存（旧数据随竞技场 reset 回收）
+        new_data = malloc(new_capacity);
+        if (new_data == NULL) {
+            return -1;
+        }
+        memcpy(new_data, s->data, s->len + 1);
+        s->arena = NULL;
+        s->data = new_data;
+        s->capacity = new_capacity;
+        return 0;
+    }
+
+    if (s->data == s->sso) {
+        char* new_data = malloc(new_capacity);
+        if (new_data == NULL) {
+            return -1;
+        }
+        memcpy(new_data, s->sso, s->len + 1);
+        s->data = new_data;
+        s->capacity = new_capacity;
+        return 0;
+    }
+
     char* new_data = realloc(s->data, new_capacity);
     if (new_data == NULL) {
         return -1;
@@ -31,6 +323,34 @@ static int string_ensure_capacity(string_t* s, size_t needed) {
     return 0;
 }
 
+void string_init(string_t* s) {
+    if (s == NULL) {
+        return;
+    }
+    s->data = s->sso;
+    s->data[0] = '\0';
+    s->len = 0;
+    s->capacity = STRING_SSO_CAPACITY;
+    s->arena = NULL;
+}
+
+void string_init_arena(string_t* s, string_arena_t* arena) {
+    string_init(s);
+    if (s != NULL) {
+        s->arena = arena;
+    }
+}
+
+void string_deinit(string_t* s) {
+    if (s == NULL) {
+        return;
+    }
+    if (s->arena == NULL && s->data != s->sso) {
+        free(s->data);
+    }
+    string_init(s);
+}
+
 string_t* string_create(void) {
     return string_create_capacity(STRING_DEFAULT_CAPACITY);
 }
@@ -41,15 +361,16 @@ string_t* string_create_capacity(size_t capacity) {
         return NULL;
     }
 
-    s->data = malloc(capacity);
-    if (s->data == NULL) {
-        free(s);
-        return NULL;
+    string_init(s);
+    if (capacity > STRING_SSO_CAPACITY) {
+        s->data = malloc(capacity);
+        if (s->data == NULL) {
+            free(s);
+            return NULL;
+        }
+        s->data[0] = '\0';
+        s->capacity = capacity;
     }
-
-    s->data[0] = '\0';
-    s->len = 0;
-    s->capacity = capacity;
     return s;
 }
 
@@ -85,7 +406,7 @@ void string_destroy(string_t* s) {
     if (s == NULL) {
         return;
     }
-    free(s->data);
+    string_deinit(s);
     free(s);
 }
 
@@ -118,45 +439,75 @@ int string_append_len(string_t* s, const char* str, size_t len) {
     return 0;
 }
 
-int string_printf(string_t* s, const char* fmt, ...) {
-    if (s == NULL || fmt == NULL) {
+static int string_append_target(void* target, const char* str, size_t len) {
+    return string_append_len((string_t*)target, str, len);
+}
+
+int string_append_char(string_t* s, char c) {
+    if (s == NULL) {
+        return -1;
+    }
+    if (string_ensure_capacity(s, s->len + 2) != 0) {
         return -1;
     }
+    s->data[s->len++] = c;
+    s->data[s->len] = '\0';
+    return 0;
+}
 
-    va_list args;
-    va_start(args, fmt);
+int string_append_vprintf(string_t* s, const char* fmt, va_list args) {
+    if (s == NULL || fmt == NULL) {
+        return -1;
+    }
 
-    // 首先尝试获取需要的缓冲区大小
+    // 先直接写入剩余空间，只有放不下时才扩容并重写一次
+    size_t available = s->capacity - s->len;
     va_list args_copy;
     va_copy(args_copy, args);
-    int needed = vsnprintf(NULL, 0, fmt, args_copy);
+    int needed = vsnprintf(s->data + s->len, available, fmt, args_copy);
     va_end(args_copy);
 
     if (needed < 0) {
-        va_end(args);
+        s->data[s->len] = '\0';
         return -1;
     }
 
-    // 溢出检查：确保 needed + 1 不会溢出
-    if (needed > (int)(SIZE_MAX - 1)) {
-        va_end(args);
-        return -1;
+    if ((size_t)needed >= available) {
+        // 溢出检查：确保 len + needed + 1 不会溢出
+        if ((size_t)needed > SIZE_MAX - s->len - 1 ||
+            string_ensure_capacity(s, s->len + (size_t)needed + 1) != 0) {
+            s->data[s->len] = '\0';
+            return -1;
+        }
+        va_copy(args_copy, args);
+        vsnprintf(s->data + s->len, (size_t)needed + 1, fmt, args_copy);
+        va_end(args_copy);
     }
 
-    // 确保有足够的空间
-    if (string_ensure_capacity(s, needed + 1) != 0) {
-        va_end(args);
-        return -1;
-    }
+    s->len += (size_t)needed;
+    return needed;
+}
 
-    // 实际写入
-    int written = vsnprintf(s->data, s->capacity, fmt, args);
+int string_append_printf(string_t* s, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int written = string_append_vprintf(s, fmt, args);
     va_end(args);
+    return written;
+}
 
-    if (written >= 0) {
-        s->len = written;
+int string_printf(string_t* s, const char* fmt, ...) {
+    if (s == NULL || fmt == NULL) {
+        return -1;
     }
 
+    string_clear(s);
+
+    va_list args;
+    va_start(args, fmt);
+    int written = string_append_vprintf(s, fmt, args);
+    va_end(args);
+
     return written;
 }
 
@@ -168,6 +519,33 @@ void string_clear(string_t* s) {
     s->len = 0;
 }
 
+int string_append_int(string_t* s, int64_t value) {
+    char buf[INT_BUF_SIZE];
+    return string_append_len(s, buf, format_int64(buf, value));
+}
+
+int string_append_uint(string_t* s, uint64_t value) {
+    char buf[INT_BUF_SIZE];
+    return string_append_len(s, buf, format_uint64(buf, value));
+}
+
+int string_append_float(string_t* s, double value, int decimals) {
+    char buf[FLOAT_BUF_SIZE];
+    decimals = clamp_decimals(decimals);
+    size_t len = format_double(buf, value, decimals);
+    if (len == 0) {
+        return string_append_printf(s, "%.*f", decimals, value) < 0 ? -1 : 0;
+    }
+    return string_append_len(s, buf, len);
+}
+
+int string_append_json_string(string_t* s, const char* str) {
+    if (s == NULL || str == NULL) {
+        return -1;
+    }
+    return append_json_escaped(s, string_append_target, str);
+}
+
 const char* string_cstr(const string_t* s) {
     return s && s->data ? s->data : "";
 }
@@ -183,3 +561,237 @@ size_t string_capacity(const string_t* s) {
 bool string_empty(const string_t* s) {
     return s == NULL || s->len == 0;
 }
+
+// ---------------------------------------------------------------------------
+// 分段字符串
+// ---------------------------------------------------------------------------
+
+static string_rope_segment_t* rope_new_segment(string_rope_t* rope, size_t min_capacity) {
+    size_t capacity = min_capacity > STRING_ROPE_SEGMENT_SIZE ?
+        min_capacity : STRING_ROPE_SEGMENT_SIZE;
+    if (capacity > SIZE_MAX - sizeof(string_rope_segment_t)) {
+        return NULL;
+    }
+
+    string_rope_segment_t* segment = NULL;
+    bool heap = false;
+    if (rope->arena != NULL) {
+        segment = arena_alloc(rope->arena, sizeof(string_rope_segment_t) + capacity);
+    }
+    if (segment == NULL) {
+        segment = malloc(sizeof(string_rope_segment_t) + capacity);
+        heap = true;
+    }
+    if (segment == NULL) {
+        return NULL;
+    }
+
+    segment->next = NULL;
+    segment->len = 0;
+    segment->capacity = capacity;
+    segment->heap = heap;
+
+    if (rope->tail != NULL) {
+        rope->tail->next = segment;
+    } else {
+        rope->head = segment;
+    }
+    rope->tail = segment;
+    rope->segment_count++;
+    return segment;
+}
+
+void string_rope_init(string_rope_t* rope, string_arena_t* arena) {
+    if (rope == NULL) {
+        return;
+    }
+    rope->head = NULL;
+    rope->tail = NULL;
+    rope->len = 0;
+    rope->segment_count = 0;
+    rope->arena = arena;
+}
+
+void string_rope_clear(string_rope_t* rope) {
+    if (rope == NULL) {
+        return;
+    }
+    string_rope_segment_t* segment = rope->head;
+    while (segment != NULL) {
+        string_rope_segment_t* next = segment->next;
+        if (segment->heap) {
+            free(segment);
+        }
+        segment = next;
+    }
+    rope->head = NULL;
+    rope->tail = NULL;
+    rope->len = 0;
+    rope->segment_count = 0;
+}
+
+void string_rope_deinit(string_rope_t* rope) {
+    string_rope_clear(rope);
+}
+
+int string_rope_append_len(string_rope_t* rope, const char* str, size_t len) {
+    if (rope == NULL || str == NULL) {
+        return -1;
+    }
+
+    size_t remaining = len;
+    string_rope_segment_t* segment = rope->tail;
+    if (segment != NULL && segment->len < segment->capacity) {
+        size_t n = segment->capacity - segment->len;
+        if (n > remaining) {
+            n = remaining;
+        }
+        memcpy(segment->data + segment->len, str, n);
+        segment->len += n;
+        str += n;
+        remaining -= n;
+    }
+
+    if (remaining > 0) {
+        segment = rope_new_segment(rope, remaining);
+        if (segment == NULL) {
+            rope->len += len - remaining;
+            return -1;
+        }
+        memcpy(segment->data, str, remaining);
+        segment->len = remaining;
+    }
+
+    rope->len += len;
+    return 0;
+}
+
+int string_rope_append(string_rope_t* rope, const char* str) {
+    if (rope == NULL || str == NULL) {
+        return -1;
+    }
+    return string_rope_append_len(rope, str, strlen(str));
+}
+
+static int string_rope_append_target(void* target, const char* str, size_t len) {
+    return string_rope_append_len((string_rope_t*)target, str, len);
+}
+
+int string_rope_append_printf(string_rope_t* rope, const char* fmt, ...) {
+    if (rope == NULL || fmt == NULL) {
+        return -1;
+    }
+
+    // 先尝试写入当前分段剩余空间（vsnprintf 需要为 '\0' 预留一字节）
+    string_rope_segment_t* segment = rope->tail;
+    size_t available = segment != NULL ? segment->capacity - segment->len : 0;
+    char scratch[1];
+    char* dst = available > 0 ? segment->data + segment->len : scratch;
+    size_t dst_size = available > 0 ? available : sizeof(scratch);
+
+    va_list args;
+    va_start(args, fmt);
+    va_list args_copy;
+    va_copy(args_copy, args);
+    int needed = vsnprintf(dst, dst_size, fmt, args_copy);
+    va_end(args_copy);
+
+    if (needed < 0) {
+        va_end(args);
+        return -1;
+    }
+
+    if ((size_t)needed < available) {
+        segment->len += (size_t)needed;
+    } else {
+        // 放不下时新开一个足够大的分段，保证格式化结果连续
+        segment = rope_new_segment(rope, (size_t)needed + 1);
+        if (segment == NULL) {
+            va_end(args);
+            return -1;
+        }
+        vsnprintf(segment->data, (size_t)needed + 1, fmt, args);
+        segment->len = (size_t)needed;
+    }
+    va_end(args);
+
+    rope->len += (size_t)needed;
+    return needed;
+}
+
+int string_rope_append_int(string_rope_t* rope, int64_t value) {
+    char buf[INT_BUF_SIZE];
+    return string_rope_append_len(rope, buf, format_int64(buf, value));
+}
+
+int string_rope_append_float(string_rope_t* rope, double value, int decimals) {
+    char buf[FLOAT_BUF_SIZE];
+    decimals = clamp_decimals(decimals);
+    size_t len = format_double(buf, value, decimals);
+    if (len == 0) {
+        return string_rope_append_printf(rope, "%.*f", decimals, value) < 0 ? -1 : 0;
+    }
+    return string_rope_append_len(rope, buf, len);
+}
+
+int string_rope_append_json_string(string_rope_t* rope, const char* str) {
+    if (rope == NULL || str == NULL) {
+        return -1;
+    }
+    return append_json_escaped(rope, string_rope_append_target, str);
+}
+
+size_t string_rope_len(const string_rope_t* rope) {
+    return rope ? rope->len : 0;
+}
+
+int string_rope_foreach(const string_rope_t* rope, string_rope_visit_fn fn, void* user_data) {
+    if (rope == NULL || fn == NULL) {
+        return -1;
+    }
+    for (const string_rope_segment_t* segment = rope->head; segment != NULL; segment = segment->next) {
+        if (segment->len == 0) {
+            continue;
+        }
+        int ret = fn(segment->data, segment->len, user_data);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+size_t string_rope_copy_to(const string_rope_t* rope, char* buf, size_t size) {
+    if (rope == NULL || buf == NULL || size == 0) {
+        return 0;
+    }
+
+    size_t copied = 0;
+    for (const string_rope_segment_t* segment = rope->head;
+         segment != NULL && copied < size - 1; segment = segment->next) {
+        size_t n = segment->len;
+        if (n > size - 1 - copied) {
+            n = size - 1 - copied;
+        }
+        memcpy(buf + copied, segment->data, n);
+        copied += n;
+    }
+    buf[copied] = '\0';
+    return copied;
+}
+
+int string_rope_flatten(const string_rope_t* rope, string_t* out) {
+    if (rope == NULL || out == NULL) {
+        return -1;
+    }
+    if (rope->len > SIZE_MAX - out->len - 1 ||
+        string_ensure_capacity(out, out->len + rope->len + 1) != 0) {
+        return -1;
+    }
+    for (const string_rope_segment_t* segment = rope->head; segment != NULL; segment = segment->next) {
+        memcpy(out->data + out->len, segment->data, segment->len);
+        out->len += segment->len;
+    }
+    out->data[out->len] = '\0';
+    return 0;
+}
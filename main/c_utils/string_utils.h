@@ -2,17 +2,27 @@
 #define STRING_UTILS_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
+#include <stdarg.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// 内联小字符串容量（含结尾 '\0'），不超过此长度时不申请堆内存
+#define STRING_SSO_CAPACITY 32
+
+// 字符串竞技场：一次申请整块内存，按消息整体 reset
+typedef struct string_arena string_arena_t;
+
 // 动态字符串结构
 typedef struct {
     char* data;
     size_t len;
     size_t capacity;
+    string_arena_t* arena;              // 非 NULL 时缓冲区来自竞技场
+    char sso[STRING_SSO_CAPACITY];
 } string_t;
 
 // 字符串创建/销毁
@@ -22,18 +32,70 @@ string_t* string_create_from(const char* str);
 string_t* string_create_from_len(const char* str, size_t len);
 void string_destroy(string_t* s);
 
+// 嵌入式使用（栈上或结构体成员），无需 string_create
+void string_init(string_t* s);
+void string_init_arena(string_t* s, string_arena_t* arena);
+void string_deinit(string_t* s);
+
 // 字符串操作
 int string_append(string_t* s, const char* str);
 int string_append_len(string_t* s, const char* str, size_t len);
+int string_append_char(string_t* s, char c);
 int string_printf(string_t* s, const char* fmt, ...);
+int string_append_printf(string_t* s, const char* fmt, ...);
+int string_append_vprintf(string_t* s, const char* fmt, va_list args);
 void string_clear(string_t* s);
 
+// 快速数字格式化（不经过 vsnprintf）
+int string_append_int(string_t* s, int64_t value);
+int string_append_uint(string_t* s, uint64_t value);
+int string_append_float(string_t* s, double value, int decimals);
+// 追加带引号并转义的 JSON 字符串
+int string_append_json_string(string_t* s, const char* str);
+
 // 属性访问
 const char* string_cstr(const string_t* s);
 size_t string_len(const string_t* s);
 size_t string_capacity(const string_t* s);
 bool string_empty(const string_t* s);
 
+// 竞技场 API
+string_arena_t* string_arena_create(size_t capacity);
+void string_arena_destroy(string_arena_t* arena);
+void string_arena_reset(string_arena_t* arena);   // 使所有基于该竞技场的字符串失效
+size_t string_arena_used(const string_arena_t* arena);
+size_t string_arena_capacity(const string_arena_t* arena);
+
+// 分段字符串（rope）：追加时只新增分段，已写入内容不搬移
+#define STRING_ROPE_SEGMENT_SIZE 256
+
+typedef struct string_rope_segment string_rope_segment_t;
+
+typedef struct {
+    string_rope_segment_t* head;
+    string_rope_segment_t* tail;
+    size_t len;
+    size_t segment_count;
+    string_arena_t* arena;              // 非 NULL 时分段来自竞技场
+} string_rope_t;
+
+// 分段遍历回调，返回非 0 时停止
+typedef int (*string_rope_visit_fn)(const char* data, size_t len, void* user_data);
+
+void string_rope_init(string_rope_t* rope, string_arena_t* arena);
+void string_rope_deinit(string_rope_t* rope);
+void string_rope_clear(string_rope_t* rope);
+int string_rope_append(string_rope_t* rope, const char* str);
+int string_rope_append_len(string_rope_t* rope, const char* str, size_t len);
+int string_rope_append_printf(string_rope_t* rope, const char* fmt, ...);
+int string_rope_append_int(string_rope_t* rope, int64_t value);
+int string_rope_append_float(string_rope_t* rope, double value, int decimals);
+int string_rope_append_json_string(string_rope_t* rope, const char* str);
+size_t string_rope_len(const string_rope_t* rope);
+int string_rope_foreach(const string_rope_t* rope, string_rope_visit_fn fn, void* user_data);
+size_t string_rope_copy_to(const string_rope_t* rope, char* buf, size_t size);
+int string_rope_flatten(const string_rope_t* rope, string_t* out);
+
 // 便捷宏
 #define string_free(s) do { string_destroy(s); s = NULL; } while(0)
 
@@ -0,0 +1,257 @@
+#include "delta_patch.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "DeltaPatch"
+
+static const uint8_t kMagic[4] = {'X', 'Z', 'D', '1'};
+
+static uint32_t ReadLe32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+DeltaPatch::DeltaPatch(ReadFunction read_patch, BaseReadFunction read_base)
+    : read_patch_(read_patch), read_base_(read_base) {
+    mbedtls_sha256_init(&sha256_);
+}
+
+DeltaPatch::~DeltaPatch() {
+    mbedtls_sha256_free(&sha256_);
+}
+
+bool DeltaPatch::Fill() {
+    int ret = read_patch_(input_, sizeof(input_));
+    if (ret <= 0) {
+        ESP_LOGE(TAG, "Failed to read patch at target offset %u: %d", (unsigned)target_pos_, ret);
+        return false;
+    }
+    input_pos_ = 0;
+    input_len_ = ret;
+    return true;
+}
+
+bool DeltaPatch::ReadByte(uint8_t& value) {
+    if (input_pos_ == input_len_ && !Fill()) {
+        return false;
+    }
+    value = input_[input_pos_++];
+    return true;
+}
+
+bool DeltaPatch::ReadBytes(uint8_t* buffer, size_t size) {
+    while (size > 0) {
+        if (input_pos_ == input_len_) {
+            // Large literals go straight to the caller's buffer
+            if (size >= sizeof(input_)) {
+                int ret = read_patch_(buffer, size);
+                if (ret <= 0) {
+                    ESP_LOGE(TAG, "Failed to read patch at target offset %u: %d", (unsigned)target_pos_, ret);
+                    return false;
+                }
+                buffer += ret;
+                size -= ret;
+                continue;
+            }
+            if (!Fill()) {
+                return false;
+            }
+        }
+        size_t n = std::min(size, input_len_ - input_pos_);
+        memcpy(buffer, input_ + input_pos_, n);
+        input_pos_ += n;
+        buffer += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool DeltaPatch::ReadVarint(uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t byte;
+        if (!ReadByte(byte)) {
+            return false;
+        }
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    ESP_LOGE(TAG, "Malformed varint");
+    return false;
+}
+
+bool DeltaPatch::Begin() {
+    uint8_t header[kHeaderSize];
+    if (!ReadBytes(header, sizeof(header))) {
+        return false;
+    }
+    if (memcmp(header, kMagic, sizeof(kMagic)) != 0) {
+        ESP_LOGE(TAG, "Invalid patch magic");
+        return false;
+    }
+    base_size_ = ReadLe32(header + 4);
+    target_size_ = ReadLe32(header + 8);
+    memcpy(base_sha256_, header + 12, sizeof(base_sha256_));
+    memcpy(target_sha256_, header + 44, sizeof(target_sha256_));
+    ESP_LOGI(TAG, "Patch from %u to %u bytes", (unsigned)base_size_, (unsigned)target_size_);
+
+    // The patch only applies to the exact image it was made from
+    const size_t block_size = 4096;
+    auto block = static_cast<uint8_t*>(heap_caps_malloc(block_size, MALLOC_CAP_8BIT));
+    if (block == nullptr) {
+        return false;
+    }
+    mbedtls_sha256_starts(&sha256_, 0);
+    bool success = true;
+    for (size_t offset = 0; offset < base_size_; offset += block_size) {
+        size_t size = std::min(block_size, base_size_ - offset);
+        if (!read_base_(offset, block, size)) {
+            ESP_LOGE(TAG, "Failed to read base at 0x%x", (unsigned)offset);
+            success = false;
+            break;
+        }
+        mbedtls_sha256_update(&sha256_, block, size);
+    }
+    heap_caps_free(block);
+    if (!success) {
+        return false;
+    }
+
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&sha256_, digest);
+    if (memcmp(digest, base_sha256_, sizeof(digest)) != 0) {
+        ESP_LOGW(TAG, "Patch was made for a different base image");
+        return false;
+    }
+
+    mbedtls_sha256_starts(&sha256_, 0);
+    state_ = kStateControl;
+    base_pos_ = 0;
+    target_pos_ = 0;
+    return true;
+}
+
+int DeltaPatch::Read(uint8_t* buffer, size_t size) {
+    size_t produced = 0;
+    while (produced < size && target_pos_ < target_size_) {
+        switch (state_) {
+        case kStateControl: {
+            uint64_t add, copy, seek;
+            if (!ReadVarint(add) || !ReadVarint(copy) || !ReadVarint(seek)) {
+                return -1;
+            }
+            size_t target_left = target_size_ - target_pos_;
+            if (add > target_left || copy > target_left - add || add > base_size_ - base_pos_) {
+                ESP_LOGE(TAG, "Record out of range at target offset %u", (unsigned)target_pos_);
+                return -1;
+            }
+            add_left_ = add;
+            copy_left_ = copy;
+            seek_ = (int64_t)(seek >> 1) ^ -(int64_t)(seek & 1);
+            zero_left_ = 0;
+            literal_left_ = 0;
+            state_ = kStateAdd;
+            break;
+        }
+
+        case kStateAdd: {
+            if (add_left_ == 0) {
+                state_ = kStateCopy;
+                break;
+            }
+            // Read the base once for the whole span, then add the differences in place
+            size_t n = std::min(add_left_, size - produced);
+            uint8_t* out = buffer + produced;
+            if (!read_base_(base_pos_, out, n)) {
+                ESP_LOGE(TAG, "Failed to read base at 0x%x", (unsigned)base_pos_);
+                return -1;
+            }
+            for (size_t i = 0; i < n;) {
+                if (zero_left_ == 0 && literal_left_ == 0) {
+                    uint64_t zero, literal;
+                    if (!ReadVarint(zero) || !ReadVarint(literal)) {
+                        return -1;
+                    }
+                    if (zero + literal == 0 || zero + literal > add_left_ - i) {
+                        ESP_LOGE(TAG, "Add run out of range at target offset %u", (unsigned)(target_pos_ + i));
+                        return -1;
+                    }
+                    zero_left_ = zero;
+                    literal_left_ = literal;
+                }
+                if (zero_left_ > 0) {
+                    size_t skip = std::min(zero_left_, n - i);
+                    zero_left_ -= skip;
+                    i += skip;
+                    continue;
+                }
+                size_t count = std::min(literal_left_, n - i);
+                literal_left_ -= count;
+                while (count > 0) {
+                    if (input_pos_ == input_len_ && !Fill()) {
+                        return -1;
+                    }
+                    size_t k = std::min(count, input_len_ - input_pos_);
+                    const uint8_t* diff = input_ + input_pos_;
+                    for (size_t j = 0; j < k; j++) {
+                        out[i + j] += diff[j];
+                    }
+                    input_pos_ += k;
+                    i += k;
+                    count -= k;
+                }
+            }
+            base_pos_ += n;
+            add_left_ -= n;
+            target_pos_ += n;
+            produced += n;
+            break;
+        }
+
+        case kStateCopy: {
+            if (copy_left_ == 0) {
+                int64_t position = (int64_t)base_pos_ + seek_;
+                if (position < 0 || position > (int64_t)base_size_) {
+                    ESP_LOGE(TAG, "Seek out of range at target offset %u", (unsigned)target_pos_);
+                    return -1;
+                }
+                base_pos_ = position;
+                state_ = kStateControl;
+                break;
+            }
+            size_t n = std::min(copy_left_, size - produced);
+            if (!ReadBytes(buffer + produced, n)) {
+                return -1;
+            }
+            copy_left_ -= n;
+            target_pos_ += n;
+            produced += n;
+            break;
+        }
+        }
+    }
+
+    if (produced > 0) {
+        mbedtls_sha256_update(&sha256_, buffer, produced);
+    }
+    return produced;
+}
+
+bool DeltaPatch::Verify() {
+    if (target_pos_ != target_size_) {
+        ESP_LOGE(TAG, "Patch ended at %u of %u bytes", (unsigned)target_pos_, (unsigned)target_size_);
+        return false;
+    }
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&sha256_, digest);
+    if (memcmp(digest, target_sha256_, sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "Target SHA-256 mismatch");
+        return false;
+    }
+    return true;
+}
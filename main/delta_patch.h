@@ -0,0 +1,87 @@
+#ifndef _DELTA_PATCH_H
+#define _DELTA_PATCH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+#include <mbedtls/sha256.h>
+
+/**
+ * Streaming decoder for firmware delta patches made by scripts/firmware_delta.py.
+ *
+ * The target image is rebuilt from the running image (the base) and a patch read in order, so
+ * neither the patch nor the target needs to be buffered. All integers are little endian.
+ *
+ *   header:  "XZD1", u32 base_size, u32 target_size, u8 base_sha256[32], u8 target_sha256[32]
+ *   records: varint add_len, varint copy_len, zigzag varint seek, add data, copy data
+ *
+ * A record adds add_len bytes of difference to the base at the base cursor, then copies copy_len
+ * literal bytes, then moves the base cursor by seek. The add data is a list of
+ * (varint zero_run, varint literal_len, literal_len difference bytes) pairs, since the
+ * difference is mostly zeros and there is no decompressor to spare on the device.
+ */
+class DeltaPatch {
+public:
+    // Same contract as Http::Read: bytes read, 0 at the end, negative on error
+    using ReadFunction = std::function<int(uint8_t* buffer, size_t size)>;
+    using BaseReadFunction = std::function<bool(size_t offset, uint8_t* buffer, size_t size)>;
+
+    static constexpr size_t kHeaderSize = 76;
+
+    DeltaPatch(ReadFunction read_patch, BaseReadFunction read_base);
+    ~DeltaPatch();
+
+    /**
+     * Read the header and check that the base has the expected SHA-256, reading all of it.
+     */
+    bool Begin();
+
+    /**
+     * Produce up to `size` bytes of the target image.
+     * @return bytes produced, 0 once the whole target has been produced, -1 on a malformed patch
+     */
+    int Read(uint8_t* buffer, size_t size);
+
+    // True once the whole target has been produced and its SHA-256 matches the header
+    bool Verify();
+
+    size_t base_size() const { return base_size_; }
+    size_t target_size() const { return target_size_; }
+
+private:
+    enum State {
+        kStateControl,
+        kStateAdd,
+        kStateCopy,
+    };
+
+    ReadFunction read_patch_;
+    BaseReadFunction read_base_;
+    uint8_t input_[512];
+    size_t input_pos_ = 0;
+    size_t input_len_ = 0;
+
+    size_t base_size_ = 0;
+    size_t target_size_ = 0;
+    uint8_t base_sha256_[32];
+    uint8_t target_sha256_[32];
+
+    State state_ = kStateControl;
+    size_t base_pos_ = 0;
+    size_t target_pos_ = 0;
+    size_t add_left_ = 0;
+    size_t copy_left_ = 0;
+    int64_t seek_ = 0;
+    size_t zero_left_ = 0;
+    size_t literal_left_ = 0;
+
+    mbedtls_sha256_context sha256_;
+
+    bool Fill();
+    bool ReadByte(uint8_t& value);
+    bool ReadBytes(uint8_t* buffer, size_t size);
+    bool ReadVarint(uint64_t& value);
+};
+
+#endif // _DELTA_PATCH_H
@@ -1,11 +1,80 @@
 #include "device_state_machine.h"
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef ESP_PLATFORM
+#include <esp_timer.h>
+#else
+#include <time.h>
+#endif
+
 // 最大监听器数量
 #define MAX_LISTENERS 16
 
+#define TRACE_MASK (DEVICE_STATE_TRACE_SIZE - 1)
+
+_Static_assert((DEVICE_STATE_TRACE_SIZE & TRACE_MASK) == 0,
+    "DEVICE_STATE_TRACE_SIZE must be a power of two");
+
+// 状态 × 事件 转换表：X(当前状态, 事件, 下一状态, 动作)
+// 未列出的组合表示该状态忽略此事件
+#define DEVICE_TRANSITIONS(X) \
+    X(STARTING,         WIFI_CONFIG,       WIFI_CONFIGURING, NONE)            \
+    X(IDLE,             WIFI_CONFIG,       WIFI_CONFIGURING, NONE)            \
+    X(ERROR,            WIFI_CONFIG,       WIFI_CONFIGURING, NONE)            \
+    X(WIFI_CONFIGURING, NETWORK_CONNECTED, IDLE,             NONE)            \
+    X(IDLE,             WAKE_WORD,         LISTENING,        START_LISTENING) \
+    X(SPEAKING,         WAKE_WORD,         LISTENING,        ABORT_SPEAKING)  \
+    X(IDLE,             START_LISTENING,   LISTENING,        START_LISTENING) \
+    X(SPEAKING,         START_LISTENING,   LISTENING,        ABORT_SPEAKING)  \
+    X(LISTENING,        STOP_LISTENING,    IDLE,             STOP_LISTENING)  \
+    X(IDLE,             TTS_START,         SPEAKING,         START_SPEAKING)  \
+    X(LISTENING,        TTS_START,         SPEAKING,         START_SPEAKING)  \
+    X(SPEAKING,         TTS_STOP,          LISTENING,        START_LISTENING) \
+    X(LISTENING,        CHANNEL_CLOSED,    IDLE,             CLOSE_CHANNEL)   \
+    X(SPEAKING,         CHANNEL_CLOSED,    IDLE,             CLOSE_CHANNEL)   \
+    X(LISTENING,        UPLINK_PACKET,     LISTENING,        MARK_UPLINK)     \
+    X(IDLE,             ERROR,             ERROR,            NONE)
+
+typedef struct {
+    uint8_t next_state;     // device_state_t
+    uint8_t action;         // device_action_t
+    bool valid;
+} transition_entry_t;
+
+#define TRANSITION_ENTRY(from, event, to, action) \
+    [DEVICE_STATE_##from][DEVICE_EVENT_##event] = { \
+        DEVICE_STATE_##to, DEVICE_ACTION_##action, true },
+
+// 编译期生成，分发时直接索引
+static const transition_entry_t s_transitions[DEVICE_STATE_MAX][DEVICE_EVENT_MAX] = {
+    DEVICE_TRANSITIONS(TRANSITION_ENTRY)
+};
+
+static const char* const s_state_names[DEVICE_STATE_MAX] = {
+    "starting",
+    "wifi_configuring",
+    "idle",
+    "listening",
+    "speaking",
+    "error",
+};
+
+static const char* const s_event_names[DEVICE_EVENT_MAX] = {
+    "wifi_config",
+    "network_connected",
+    "wake_word",
+    "start_listening",
+    "stop_listening",
+    "tts_start",
+    "tts_stop",
+    "channel_closed",
+    "uplink_packet",
+    "error",
+};
+
 // 监听器结构
 typedef struct {
     state_change_callback_t callback;
@@ -15,11 +84,44 @@ typedef struct {
 
 // 状态机结构
 struct device_state_machine {
+    // 保护状态、监听器与追踪；主任务、唤醒词与协议回调都会分发事件
+    pthread_mutex_t lock;
+
     device_state_t current_state;
     listener_t listeners[MAX_LISTENERS];
     int listener_count;
+
+    state_action_callback_t action_callback;
+    void* action_user_data;
+
+    // 进入 LISTENING 后是否已记录首个上行包
+    bool uplink_marked;
+
+    device_state_trace_entry_t trace[DEVICE_STATE_TRACE_SIZE];
+    uint32_t trace_head;    // 下一写入位置（单调递增）
 };
 
+static uint64_t trace_now_us(void) {
+#ifdef ESP_PLATFORM
+    return (uint64_t)esp_timer_get_time();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+#endif
+}
+
+static void trace_record(device_state_machine_t* sm, device_event_t event,
+                         device_state_t from, device_state_t to, device_action_t action) {
+    device_state_trace_entry_t* entry = &sm->trace[sm->trace_head & TRACE_MASK];
+    entry->timestamp_us = trace_now_us();
+    entry->event = (uint8_t)event;
+    entry->from = (uint8_t)from;
+    entry->to = (uint8_t)to;
+    entry->action = (uint8_t)action;
+    sm->trace_head++;
+}
+
 // 创建状态机
 device_state_machine_t* device_state_machine_create(void) {
     device_state_machine_t* sm = (device_state_machine_t*)malloc(sizeof(device_state_machine_t));
@@ -28,6 +130,10 @@ device_state_machine_t* device_state_machine_create(void) {
     }
 
     memset(sm, 0, sizeof(device_state_machine_t));
+    if (pthread_mutex_init(&sm->lock, NULL) != 0) {
+        free(sm);
+        return NULL;
+    }
     sm->current_state = DEVICE_STATE_STARTING;
 
     return sm;
@@ -36,6 +142,7 @@ device_state_machine_t* device_state_machine_create(void) {
 // 销毁状态机
 void device_state_machine_destroy(device_state_machine_t* sm) {
     if (sm != NULL) {
+        pthread_mutex_destroy(&sm->lock);
         free(sm);
     }
 }
@@ -78,11 +185,29 @@ static bool is_valid_transition(device_state_t from, device_state_t to) {
     }
 }
 
-// 通知监听器状态变化
-static void notify_listeners(device_state_machine_t* sm, device_state_t old_state, device_state_t new_state) {
+// 只读接口也要加锁，锁本身不属于状态机的逻辑状态
+static pthread_mutex_t* sm_lock(const device_state_machine_t* sm) {
+    return (pthread_mutex_t*)&sm->lock;
+}
+
+// 回调在锁外调用，回调中可以再次分发事件或读取追踪
+typedef struct {
+    listener_t listeners[MAX_LISTENERS];
+    state_action_callback_t action_callback;
+    void* action_user_data;
+} callbacks_t;
+
+// 必须持有 sm->lock
+static void snapshot_callbacks(const device_state_machine_t* sm, callbacks_t* out) {
+    memcpy(out->listeners, sm->listeners, sizeof(out->listeners));
+    out->action_callback = sm->action_callback;
+    out->action_user_data = sm->action_user_data;
+}
+
+static void notify_listeners(const callbacks_t* callbacks, device_state_t old_state, device_state_t new_state) {
     for (int i = 0; i < MAX_LISTENERS; i++) {
-        if (sm->listeners[i].valid && sm->listeners[i].callback != NULL) {
-            sm->listeners[i].callback(old_state, new_state, sm->listeners[i].user_data);
+        if (callbacks->listeners[i].valid && callbacks->listeners[i].callback != NULL) {
+            callbacks->listeners[i].callback(old_state, new_state, callbacks->listeners[i].user_data);
         }
     }
 }
@@ -93,33 +218,94 @@ int device_state_machine_transition(device_state_machine_t* sm, device_state_t n
         return -1;
     }
 
+    pthread_mutex_lock(&sm->lock);
     device_state_t old_state = sm->current_state;
 
     // 如果已经是目标状态，返回成功
     if (old_state == new_state) {
+        pthread_mutex_unlock(&sm->lock);
         return 0;
     }
 
     // 验证转换
     if (!is_valid_transition(old_state, new_state)) {
+        pthread_mutex_unlock(&sm->lock);
         return -2;
     }
 
-    // 执行转换
+    // 执行转换（直接转换在追踪中以 DEVICE_EVENT_MAX 标记）
     sm->current_state = new_state;
+    sm->uplink_marked = false;
+    trace_record(sm, DEVICE_EVENT_MAX, old_state, new_state, DEVICE_ACTION_NONE);
+    callbacks_t callbacks;
+    snapshot_callbacks(sm, &callbacks);
+    pthread_mutex_unlock(&sm->lock);
 
     // 通知监听器
-    notify_listeners(sm, old_state, new_state);
+    notify_listeners(&callbacks, old_state, new_state);
 
     return 0;
 }
 
+bool device_state_machine_accepts(const device_state_machine_t* sm, device_event_t event) {
+    if (sm == NULL || event >= DEVICE_EVENT_MAX) {
+        return false;
+    }
+    return s_transitions[device_state_machine_get_state(sm)][event].valid;
+}
+
+// 事件分发
+int device_state_machine_dispatch(device_state_machine_t* sm, device_event_t event) {
+    if (sm == NULL || event >= DEVICE_EVENT_MAX) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&sm->lock);
+    device_state_t old_state = sm->current_state;
+    const transition_entry_t* entry = &s_transitions[old_state][event];
+    if (!entry->valid) {
+        pthread_mutex_unlock(&sm->lock);
+        return -2;
+    }
+
+    device_state_t new_state = (device_state_t)entry->next_state;
+    device_action_t action = (device_action_t)entry->action;
+
+    // 自环只执行动作；上行包只追踪进入聆听后的第一个
+    if (new_state == old_state && action == DEVICE_ACTION_MARK_UPLINK) {
+        if (sm->uplink_marked) {
+            pthread_mutex_unlock(&sm->lock);
+            return 0;
+        }
+        sm->uplink_marked = true;
+    }
+    if (new_state != old_state) {
+        sm->current_state = new_state;
+        sm->uplink_marked = false;
+    }
+    trace_record(sm, event, old_state, new_state, action);
+    callbacks_t callbacks;
+    snapshot_callbacks(sm, &callbacks);
+    pthread_mutex_unlock(&sm->lock);
+
+    if (action != DEVICE_ACTION_NONE && callbacks.action_callback != NULL) {
+        callbacks.action_callback(action, event, callbacks.action_user_data);
+    }
+    if (new_state != old_state) {
+        notify_listeners(&callbacks, old_state, new_state);
+    }
+    return 0;
+}
+
 // 获取当前状态
 device_state_t device_state_machine_get_state(const device_state_machine_t* sm) {
     if (sm == NULL) {
         return DEVICE_STATE_MAX;
     }
-    return sm->current_state;
+    pthread_mutex_lock(sm_lock(sm));
+    device_state_t state = sm->current_state;
+    pthread_mutex_unlock(sm_lock(sm));
+    return state;
 }
 
 // 添加监听器
@@ -128,18 +314,103 @@ int device_state_machine_add_listener(device_state_machine_t* sm, state_change_c
         return -1;
     }
 
-    // 查找空闲槽位
+    // 查找空闲槽位，监听器已满返回 -2
+    int slot = -2;
+    pthread_mutex_lock(&sm->lock);
     for (int i = 0; i < MAX_LISTENERS; i++) {
         if (!sm->listeners[i].valid) {
             sm->listeners[i].callback = callback;
             sm->listeners[i].user_data = user_data;
             sm->listeners[i].valid = true;
-            return i;
+            slot = i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sm->lock);
+    return slot;
+}
+
+// 设置转换动作回调
+void device_state_machine_set_action_callback(device_state_machine_t* sm,
+                                              state_action_callback_t callback, void* user_data) {
+    if (sm == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&sm->lock);
+    sm->action_callback = callback;
+    sm->action_user_data = user_data;
+    pthread_mutex_unlock(&sm->lock);
+}
+
+// 拷贝转换追踪
+size_t device_state_machine_get_trace(const device_state_machine_t* sm,
+                                      device_state_trace_entry_t* out, size_t max_entries) {
+    if (sm == NULL || out == NULL || max_entries == 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(sm_lock(sm));
+    size_t available = sm->trace_head < DEVICE_STATE_TRACE_SIZE ?
+        sm->trace_head : DEVICE_STATE_TRACE_SIZE;
+    size_t count = available < max_entries ? available : max_entries;
+    uint32_t start = sm->trace_head - (uint32_t)count;
+    for (size_t i = 0; i < count; i++) {
+        out[i] = sm->trace[(start + i) & TRACE_MASK];
+    }
+    pthread_mutex_unlock(sm_lock(sm));
+    return count;
+}
+
+void device_state_machine_clear_trace(device_state_machine_t* sm) {
+    if (sm == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&sm->lock);
+    sm->trace_head = 0;
+    pthread_mutex_unlock(&sm->lock);
+}
+
+// 计算追踪中两个事件之间的延迟
+int64_t device_state_machine_trace_latency_us(const device_state_machine_t* sm,
+                                              device_event_t from_event, device_event_t to_event) {
+    if (sm == NULL) {
+        return -1;
+    }
+
+    pthread_mutex_lock(sm_lock(sm));
+    size_t available = sm->trace_head < DEVICE_STATE_TRACE_SIZE ?
+        sm->trace_head : DEVICE_STATE_TRACE_SIZE;
+    const device_state_trace_entry_t* end_entry = NULL;
+    int64_t latency = -1;
+
+    // 从新到旧查找：先找到 to_event，再找到它之前最近的 from_event
+    for (size_t i = 1; i <= available; i++) {
+        const device_state_trace_entry_t* entry = &sm->trace[(sm->trace_head - i) & TRACE_MASK];
+        if (end_entry == NULL) {
+            if (entry->event == to_event) {
+                end_entry = entry;
+            }
+        } else if (entry->event == from_event) {
+            latency = (int64_t)(end_entry->timestamp_us - entry->timestamp_us);
+            break;
         }
     }
+    pthread_mutex_unlock(sm_lock(sm));
+    return latency;
+}
 
-    // 监听器已满
-    return -2;
+const char* device_state_machine_state_name(device_state_t state) {
+    if (state >= DEVICE_STATE_MAX) {
+        return "invalid_state";
+    }
+    return s_state_names[state];
+}
+
+const char* device_state_machine_event_name(device_event_t event) {
+    if (event >= DEVICE_EVENT_MAX) {
+        return "direct";
+    }
+    return s_event_names[event];
 }
 
 // 判断是否处于空闲状态
@@ -147,7 +418,7 @@ bool device_state_machine_is_idle(const device_state_machine_t* sm) {
     if (sm == NULL) {
         return false;
     }
-    return sm->current_state == DEVICE_STATE_IDLE;
+    return device_state_machine_get_state(sm) == DEVICE_STATE_IDLE;
 }
 
 // 判断是否处于活跃状态
@@ -155,6 +426,6 @@ bool device_state_machine_is_active(const device_state_machine_t* sm) {
     if (sm == NULL) {
         return false;
     }
-    return sm->current_state == DEVICE_STATE_LISTENING ||
-           sm->current_state == DEVICE_STATE_SPEAKING;
+    device_state_t state = device_state_machine_get_state(sm);
+    return state == DEVICE_STATE_LISTENING || state == DEVICE_STATE_SPEAKING;
 }
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -19,10 +20,52 @@ typedef enum {
     DEVICE_STATE_MAX
 } device_state_t;
 
+// 状态机事件
+typedef enum {
+    DEVICE_EVENT_WIFI_CONFIG = 0,       // 进入配网
+    DEVICE_EVENT_NETWORK_CONNECTED,     // 网络就绪
+    DEVICE_EVENT_WAKE_WORD,             // 检测到唤醒词
+    DEVICE_EVENT_START_LISTENING,       // 手动开始聆听
+    DEVICE_EVENT_STOP_LISTENING,        // 手动停止聆听
+    DEVICE_EVENT_TTS_START,             // 服务端开始播报
+    DEVICE_EVENT_TTS_STOP,              // 服务端播报结束
+    DEVICE_EVENT_CHANNEL_CLOSED,        // 音频通道关闭
+    DEVICE_EVENT_UPLINK_PACKET,         // 上行音频包已发送
+    DEVICE_EVENT_ERROR,                 // 不可恢复错误
+    DEVICE_EVENT_MAX
+} device_event_t;
+
+// 转换动作（由应用层在 action 回调中执行）
+typedef enum {
+    DEVICE_ACTION_NONE = 0,
+    DEVICE_ACTION_START_LISTENING,      // 必要时打开音频通道，开始上行
+    DEVICE_ACTION_ABORT_SPEAKING,       // 打断播报后进入聆听
+    DEVICE_ACTION_STOP_LISTENING,       // 停止上行
+    DEVICE_ACTION_START_SPEAKING,       // 停止上行、重置解码器准备播放
+    DEVICE_ACTION_CLOSE_CHANNEL,        // 音频通道已关闭，清理会话
+    DEVICE_ACTION_MARK_UPLINK,          // 记录首个上行包（仅追踪）
+    DEVICE_ACTION_MAX
+} device_action_t;
+
+// 转换追踪记录
+#define DEVICE_STATE_TRACE_SIZE 32      // 必须为 2 的幂
+
+typedef struct {
+    uint64_t timestamp_us;
+    uint8_t event;                      // device_event_t
+    uint8_t from;                       // device_state_t
+    uint8_t to;                         // device_state_t
+    uint8_t action;                     // device_action_t
+} device_state_trace_entry_t;
+
 // 状态变更回调
 typedef void (*state_change_callback_t)(device_state_t old_state,
     device_state_t new_state, void* user_data);
 
+// 转换动作回调，在状态提交之后、通知监听器之前调用
+typedef void (*state_action_callback_t)(device_action_t action,
+    device_event_t event, void* user_data);
+
 // 状态机结构
 typedef struct device_state_machine device_state_machine_t;
 
@@ -35,9 +78,28 @@ int device_state_machine_transition(device_state_machine_t* sm,
     device_state_t new_state);
 device_state_t device_state_machine_get_state(const device_state_machine_t* sm);
 
+// 事件分发：查表 O(1) 得到下一状态与动作
+// 返回 0 成功，-1 参数错误，-2 当前状态不接受该事件
+int device_state_machine_dispatch(device_state_machine_t* sm, device_event_t event);
+bool device_state_machine_accepts(const device_state_machine_t* sm, device_event_t event);
+
 // 状态监听
 int device_state_machine_add_listener(device_state_machine_t* sm,
     state_change_callback_t callback, void* user_data);
+void device_state_machine_set_action_callback(device_state_machine_t* sm,
+    state_action_callback_t callback, void* user_data);
+
+// 转换追踪（环形缓冲，按时间从旧到新拷贝，返回拷贝条数）
+size_t device_state_machine_get_trace(const device_state_machine_t* sm,
+    device_state_trace_entry_t* out, size_t max_entries);
+void device_state_machine_clear_trace(device_state_machine_t* sm);
+// 最近一次 from_event 到其后首个 to_event 的间隔，未找到返回 -1
+int64_t device_state_machine_trace_latency_us(const device_state_machine_t* sm,
+    device_event_t from_event, device_event_t to_event);
+
+// 名称（用于日志）
+const char* device_state_machine_state_name(device_state_t state);
+const char* device_state_machine_event_name(device_event_t event);
 
 // 便捷函数
 bool device_state_machine_is_idle(const device_state_machine_t* sm);
@@ -49,6 +49,10 @@ void Display::ClearChatMessages() {
     // Default empty implementation, override in subclasses if needed
 }
 
+void Display::EndChatTurn() {
+    // Default empty implementation, override in subclasses that merge streamed sentences
+}
+
 void Display::SetTheme(Theme* theme) {
     current_theme_ = theme;
     Settings settings("display", true);
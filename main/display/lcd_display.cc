@@ -2,15 +2,21 @@
 #include "gif/lvgl_gif.h"
 #include "settings.h"
 #include "lvgl_theme.h"
+#include "chat_message_list.h"
 #include "assets/lang_config.h"
 
 #include <vector>
+#include <memory>
 #include <algorithm>
 #include <font_awesome.h>
 #include <esp_log.h>
 #include <esp_err.h>
 #include <esp_lvgl_port.h>
 #include <esp_psram.h>
+#include <esp_heap_caps.h>
+#include <esp_lcd_panel_io.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <cstring>
 #include <src/misc/cache/lv_cache.h>
 
@@ -89,15 +95,102 @@ LcdDisplay::LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_
     esp_timer_create(&preview_timer_args, &preview_timer_);
 }
 
+// Pick the LVGL stripe height from the internal DMA-capable RAM that is free right now,
+// spending at most a quarter of it on draw buffers.
+static int CalculateFlushLines(int width, int height, int buffer_count) {
+#if CONFIG_LCD_FLUSH_PSRAM_FULL_FRAME
+    return height;
+#else
+    // std::clamp is undefined when the bounds are swapped
+    static_assert(CONFIG_LCD_FLUSH_MIN_LINES <= CONFIG_LCD_FLUSH_MAX_LINES,
+                  "CONFIG_LCD_FLUSH_MAX_LINES must not be below CONFIG_LCD_FLUSH_MIN_LINES");
+    const size_t line_bytes = width * sizeof(uint16_t);
+    size_t free_dma = heap_caps_get_free_size(MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    size_t largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    size_t budget = std::min(free_dma / 4 / buffer_count, largest_block);
+    int lines = static_cast<int>(budget / line_bytes);
+    lines = std::clamp(lines, CONFIG_LCD_FLUSH_MIN_LINES, CONFIG_LCD_FLUSH_MAX_LINES);
+    return std::min(lines, height);
+#endif
+}
+
+using DmaBuffer = std::unique_ptr<uint16_t, decltype(&heap_caps_free)>;
+
+static bool OnClearTransferDone(esp_lcd_panel_io_handle_t panel_io,
+    esp_lcd_panel_io_event_data_t* edata, void* user_ctx) {
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(static_cast<SemaphoreHandle_t>(user_ctx), &woken);
+    return woken == pdTRUE;
+}
+
+// Clear the panel to white using as few DMA transfers as memory allows.
+// draw_bitmap only queues the transfers, so the buffer is freed only after every
+// transfer-done event has arrived; if some never do, it is leaked instead.
+static void ClearPanel(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
+                       int width, int height, int lines) {
+    DmaBuffer buffer(nullptr, heap_caps_free);
+    for (; lines >= 1; lines /= 2) {
+        buffer.reset(static_cast<uint16_t*>(
+            heap_caps_malloc(static_cast<size_t>(width) * lines * sizeof(uint16_t), MALLOC_CAP_DMA)));
+        if (buffer) {
+            break;
+        }
+    }
+    if (!buffer) {
+        ESP_LOGW(TAG, "No DMA memory to clear the panel");
+        return;
+    }
+
+    const int transfers = (height + lines - 1) / lines;
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(transfers, 0);
+    if (done == nullptr) {
+        ESP_LOGW(TAG, "No memory to track the panel clear");
+        return;
+    }
+    const esp_lcd_panel_io_callbacks_t callbacks = {
+        .on_color_trans_done = OnClearTransferDone,
+    };
+    if (esp_lcd_panel_io_register_event_callbacks(panel_io, &callbacks, done) != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot track the panel clear, skipping it");
+        vSemaphoreDelete(done);
+        return;
+    }
+
+    std::fill_n(buffer.get(), static_cast<size_t>(width) * lines, 0xFFFF);
+    int queued = 0;
+    for (int y = 0; y < height; y += lines) {
+        if (esp_lcd_panel_draw_bitmap(panel, 0, y, width, std::min(y + lines, height), buffer.get()) == ESP_OK) {
+            queued++;
+        }
+    }
+
+    int completed = 0;
+    while (completed < queued && xSemaphoreTake(done, pdMS_TO_TICKS(500)) == pdTRUE) {
+        completed++;
+    }
+    const esp_lcd_panel_io_callbacks_t no_callbacks = {};
+    esp_lcd_panel_io_register_event_callbacks(panel_io, &no_callbacks, nullptr);
+    vSemaphoreDelete(done);
+
+    if (completed < queued) {
+        ESP_LOGW(TAG, "Panel clear finished %d of %d transfers, leaking its buffer", completed, queued);
+        buffer.release();
+    }
+}
+
 SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                            int width, int height, int offset_x, int offset_y, bool mirror_x, bool mirror_y, bool swap_xy)
     : LcdDisplay(panel_io, panel, width, height) {
 
+#if CONFIG_LCD_FLUSH_SINGLE_BUFFER
+    const int buffer_count = 1;
+#else
+    const int buffer_count = 2;
+#endif
+    const int flush_lines = CalculateFlushLines(width_, height_, buffer_count);
+
     // draw white
-    std::vector<uint16_t> buffer(width_, 0xFFFF);
-    for (int y = 0; y < height_; y++) {
-        esp_lcd_panel_draw_bitmap(panel_, 0, y, width_, y + 1, buffer.data());
-    }
+    ClearPanel(panel_io_, panel_, width_, height_, flush_lines);
 
     // Set the display to on
     ESP_LOGI(TAG, "Turning display on");
@@ -133,14 +226,24 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
 #endif
     lvgl_port_init(&port_cfg);
 
-    ESP_LOGI(TAG, "Adding LCD display");
+#if CONFIG_LCD_FLUSH_PSRAM_FULL_FRAME
+    ESP_LOGI(TAG, "Adding LCD display, full-frame PSRAM buffers, %d-line DMA bounce buffer",
+        CONFIG_LCD_FLUSH_TRANS_LINES);
+#else
+    ESP_LOGI(TAG, "Adding LCD display, %d x %d-line draw buffer(s)", buffer_count, flush_lines);
+#endif
     const lvgl_port_display_cfg_t display_cfg = {
         .io_handle = panel_io_,
         .panel_handle = panel_,
         .control_handle = nullptr,
-        .buffer_size = static_cast<uint32_t>(width_ * 20),
-        .double_buffer = false,
+        .buffer_size = static_cast<uint32_t>(width_ * flush_lines),
+        // With two buffers LVGL renders the next stripe while the previous one is on the SPI DMA
+        .double_buffer = buffer_count > 1,
+#if CONFIG_LCD_FLUSH_PSRAM_FULL_FRAME
+        .trans_size = static_cast<uint32_t>(width_ * CONFIG_LCD_FLUSH_TRANS_LINES),
+#else
         .trans_size = 0,
+#endif
         .hres = static_cast<uint32_t>(width_),
         .vres = static_cast<uint32_t>(height_),
         .monochrome = false,
@@ -151,8 +254,13 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         },
         .color_format = LV_COLOR_FORMAT_RGB565,
         .flags = {
+#if CONFIG_LCD_FLUSH_PSRAM_FULL_FRAME
+            .buff_dma = 0,
+            .buff_spiram = 1,
+#else
             .buff_dma = 1,
             .buff_spiram = 0,
+#endif
             .sw_rotate = 0,
             .swap_bytes = 1,
             .full_refresh = 0,
@@ -496,10 +604,16 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_style_text_color(emoji_label_, lvgl_theme->text_color(), 0);
     lv_label_set_text(emoji_label_, FONT_AWESOME_MICROCHIP_AI);
 }
+// History kept as text, and rows of LVGL objects that show a window of it
+#if CONFIG_SPIRAM
+#define  MAX_MESSAGES 500
+#else
+#define  MAX_MESSAGES 100
+#endif
 #if CONFIG_IDF_TARGET_ESP32P4
-#define  MAX_MESSAGES 40
+#define  MAX_MESSAGE_ROWS 40
 #else
-#define  MAX_MESSAGES 20
+#define  MAX_MESSAGE_ROWS 20
 #endif
 void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     if (!setup_ui_called_) {
@@ -513,45 +627,12 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
         return;
     }
     
-    // Check if message count exceeds limit
-    uint32_t child_count = lv_obj_get_child_cnt(content_);
-    if (child_count >= MAX_MESSAGES) {
-        // Delete the oldest message (first child object)
-        lv_obj_t* first_child = lv_obj_get_child(content_, 0);
-        if (first_child != nullptr) {
-            lv_obj_del(first_child);
-            // Refresh child count after deletion
-            child_count = lv_obj_get_child_cnt(content_);
-        }
-        // Scroll to the last message immediately (get last_child after deletion)
-        if (child_count > 0) {
-            lv_obj_t* last_child = lv_obj_get_child(content_, child_count - 1);
-            if (last_child != nullptr && lv_obj_is_valid(last_child)) {
-                lv_obj_scroll_to_view_recursive(last_child, LV_ANIM_OFF);
-            }
-        }
-    }
-    
-    // Collapse system messages (if it's a system message, check if the last message is also a system message)
+    // Bubbles are recycled from a fixed pool of MAX_MESSAGE_ROWS rows
+    auto messages = ChatMessageList::Attach(content_, MAX_MESSAGES, MAX_MESSAGE_ROWS);
+
+    // Collapse system messages (a new system message replaces the previous one if it is the last message)
     if (strcmp(role, "system") == 0) {
-        // Refresh child count to get accurate count after potential deletion above
-        child_count = lv_obj_get_child_cnt(content_);
-        if (child_count > 0) {
-            // Get the last message container
-            lv_obj_t* last_container = lv_obj_get_child(content_, child_count - 1);
-            if (last_container != nullptr && lv_obj_is_valid(last_container) && lv_obj_get_child_cnt(last_container) > 0) {
-                // Get the bubble inside the container
-                lv_obj_t* last_bubble = lv_obj_get_child(last_container, 0);
-                if (last_bubble != nullptr && lv_obj_is_valid(last_bubble)) {
-                    // Check if bubble type is system message
-                    void* bubble_type_ptr = lv_obj_get_user_data(last_bubble);
-                    if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "system") == 0) {
-                        // If the last message is also a system message, delete it
-                        lv_obj_del(last_container);
-                    }
-                }
-            }
-        }
+        messages->RemoveLastIfRole("system");
     } else {
         // Hide the centered AI logo
         lv_obj_add_flag(emoji_label_, LV_OBJ_FLAG_HIDDEN);
@@ -562,148 +643,35 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
         return;
     }
 
-    auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
-
-    // Create a message bubble
-    lv_obj_t* msg_bubble = lv_obj_create(content_);
-    lv_obj_set_style_radius(msg_bubble, 8, 0);
-    lv_obj_set_scrollbar_mode(msg_bubble, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_border_width(msg_bubble, 0, 0);
-    lv_obj_set_style_pad_all(msg_bubble, lvgl_theme->spacing(4), 0);
+    // Rasterize new glyphs now, so the first redraws of the bubble are served from the atlas
+    LvglGlyphAtlas::GetInstance().Warm(lv_obj_get_style_text_font(content_, LV_PART_MAIN), content);
 
-    // Create the message text
-    lv_obj_t* msg_text = lv_label_create(msg_bubble);
-    lv_label_set_text(msg_text, content);
-    
-    // Calculate bubble width constraints
-    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;  // 85% of screen width
-    lv_coord_t min_width = 20;  
-    
-    // Let LVGL calculate the natural text width first
-    lv_obj_set_width(msg_text, LV_SIZE_CONTENT);
-    lv_obj_update_layout(msg_text);
-    lv_coord_t text_width = lv_obj_get_width(msg_text);
-    
-    // Ensure text width is not less than minimum width
-    if (text_width < min_width) {
-        text_width = min_width;
+    // Streaming TTS sends the reply one sentence at a time, extend the current assistant bubble
+    lv_obj_t* msg_text = nullptr;
+    if (strcmp(role, "assistant") == 0) {
+        msg_text = messages->AppendToLast(role, content);
     }
-
-    // Constrain to max width
-    lv_coord_t bubble_width = (text_width < max_width) ? text_width : max_width;
-    
-    // Set message text width
-    lv_obj_set_width(msg_text, bubble_width);
-    lv_label_set_long_mode(msg_text, LV_LABEL_LONG_WRAP);
-
-    // Set bubble width
-    lv_obj_set_width(msg_bubble, bubble_width);
-    lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-
-    // Set alignment and style based on message role
-    if (strcmp(role, "user") == 0) {
-        // User messages are right-aligned with green background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->user_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->text_color(), 0);
-        
-        // Set custom attribute to mark bubble type
-        lv_obj_set_user_data(msg_bubble, (void*)"user");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "assistant") == 0) {
-        // Assistant messages are left-aligned with white background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->assistant_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->text_color(), 0);
-        
-        // Set custom attribute to mark bubble type
-        lv_obj_set_user_data(msg_bubble, (void*)"assistant");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "system") == 0) {
-        // System messages are center-aligned with light gray background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->system_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->system_text_color(), 0);
-        
-        // Set custom attribute to mark bubble type
-        lv_obj_set_user_data(msg_bubble, (void*)"system");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
+    if (msg_text == nullptr) {
+        msg_text = messages->AddMessage(role, content, static_cast<LvglTheme*>(current_theme_));
     }
-    
-    // Create a full-width container for user messages to ensure right alignment
-    if (strcmp(role, "user") == 0) {
-        // Create a full-width container
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // Make container transparent and borderless
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // Move the message bubble into this container
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // Right align the bubble in the container
-        lv_obj_align(msg_bubble, LV_ALIGN_RIGHT_MID, -25, 0);
-        
-        // Auto-scroll to this container
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else if (strcmp(role, "system") == 0) {
-        // Create full-width container for system messages to ensure center alignment
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        lv_obj_set_parent(msg_bubble, container);
-        lv_obj_align(msg_bubble, LV_ALIGN_CENTER, 0, 0);
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else {
-        // For assistant messages
-        // Left align assistant messages
-        lv_obj_align(msg_bubble, LV_ALIGN_LEFT_MID, 0, 0);
 
-        // Auto-scroll to the message bubble
-        lv_obj_scroll_to_view_recursive(msg_bubble, LV_ANIM_ON);
-    }
-    
     // Store reference to the latest message label
     chat_message_label_ = msg_text;
 }
 
 void LcdDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
-    DisplayLockGuard lock(this);
-    if (content_ == nullptr) {
+    if (image == nullptr) {
         return;
     }
 
-    if (image == nullptr) {
+    // Scale once to the bubble size outside the lock, so LVGL does not zoom on every redraw
+    auto scaled = LvglAllocatedImage::ScaleToFit(*image, width_ * 70 / 100, height_ * 50 / 100);
+    if (scaled != nullptr) {
+        image = std::move(scaled);
+    }
+
+    DisplayLockGuard lock(this);
+    if (content_ == nullptr) {
         return;
     }
     
@@ -787,10 +755,10 @@ void LcdDisplay::ClearChatMessages() {
         return;
     }
     
-    // Use lv_obj_clean to delete all children of content_ (chat message bubbles)
-    lv_obj_clean(content_);
+    // Release all message rows back to the pool and delete image bubbles
+    ChatMessageList::Attach(content_, MAX_MESSAGES, MAX_MESSAGE_ROWS)->Clear();
     
-    // Reset chat_message_label_ as it has been deleted
+    // Reset chat_message_label_ as its row is no longer shown
     chat_message_label_ = nullptr;
     
     // Show the centered AI logo (emoji_label_) again
@@ -995,6 +963,16 @@ void LcdDisplay::SetupUI() {
 }
 
 void LcdDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
+    // Half the screen width; the scaled copy is kept in preview_image_cached_ until the image changes
+    bool scaled = false;
+    if (image != nullptr) {
+        auto fitted = LvglAllocatedImage::ScaleToFit(*image, width_ / 2, height_);
+        if (fitted != nullptr) {
+            image = std::move(fitted);
+            scaled = true;
+        }
+    }
+
     DisplayLockGuard lock(this);
     if (preview_image_ == nullptr) {
         ESP_LOGE(TAG, "Preview image is not initialized");
@@ -1015,7 +993,9 @@ void LcdDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
     preview_image_cached_ = std::move(image);
     auto img_dsc = preview_image_cached_->image_dsc();
     lv_image_set_src(preview_image_, img_dsc);
-    if (img_dsc->header.w > 0 && img_dsc->header.h > 0) {
+    if (scaled) {
+        lv_image_set_scale(preview_image_, LV_SCALE_NONE);
+    } else if (img_dsc->header.w > 0 && img_dsc->header.h > 0) {
         // zoom factor 0.5
         lv_image_set_scale(preview_image_, 128 * width_ / img_dsc->header.w);
     }
@@ -1041,6 +1021,7 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
         }
         return;
     }
+    LvglGlyphAtlas::GetInstance().Warm(lv_obj_get_style_text_font(chat_message_label_, LV_PART_MAIN), content);
     lv_label_set_text(chat_message_label_, content);
     // Show bottom_bar_ only when there is content (and subtitle is not globally hidden)
     if (bottom_bar_ != nullptr) {
@@ -1071,6 +1052,16 @@ void LcdDisplay::ClearChatMessages() {
 }
 #endif
 
+void LcdDisplay::EndChatTurn() {
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    DisplayLockGuard lock(this);
+    if (content_ != nullptr) {
+        // The next assistant sentence starts a new bubble
+        ChatMessageList::Attach(content_, MAX_MESSAGES, MAX_MESSAGE_ROWS)->EndTurn();
+    }
+#endif
+}
+
 void LcdDisplay::SetEmotion(const char* emotion) {
     if (!setup_ui_called_) {
         ESP_LOGW(TAG, "SetEmotion('%s') called before SetupUI() - emotion will not be displayed!", emotion);
@@ -1102,11 +1093,17 @@ void LcdDisplay::SetEmotion(const char* emotion) {
         return;
     }
 
-    DisplayLockGuard lock(this);
+    // Decoding (or filling the frame cache) does not touch LVGL objects, so it runs before
+    // the display lock is taken and the UI keeps refreshing meanwhile
+    std::unique_ptr<LvglGif> gif;
     if (image->IsGif()) {
-        // Create new GIF controller
-        gif_controller_ = std::make_unique<LvglGif>(image->image_dsc());
-        
+        gif = std::make_unique<LvglGif>(image->image_dsc(), emotion);
+    }
+
+    DisplayLockGuard lock(this);
+    if (gif) {
+        gif_controller_ = std::move(gif);
+
         if (gif_controller_->IsLoaded()) {
             // Set up frame update callback
             gif_controller_->SetFrameCallback([this]() {
@@ -1132,7 +1129,7 @@ void LcdDisplay::SetEmotion(const char* emotion) {
 
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
     // In WeChat message style, if emotion is neutral, don't display it
-    uint32_t child_count = lv_obj_get_child_cnt(content_);
+    size_t child_count = ChatMessageList::Attach(content_, MAX_MESSAGES, MAX_MESSAGE_ROWS)->size();
     if (strcmp(emotion, "neutral") == 0 && child_count > 0) {
         // Stop GIF animation if running
         if (gif_controller_) {
@@ -1264,6 +1261,9 @@ void LcdDisplay::SetTheme(Theme* theme) {
             ESP_LOGW(TAG, "child[%lu] Bubble type is not found", i);
         }
     }
+
+    // Message widths were measured with the previous font
+    ChatMessageList::Attach(content_, MAX_MESSAGES, MAX_MESSAGE_ROWS)->SetTheme(lvgl_theme);
 #else
     // Simple UI mode - just update the main chat message
     if (chat_message_label_ != nullptr) {
@@ -0,0 +1,451 @@
+#include "chat_message_list.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <sdkconfig.h>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+#define TAG "ChatMessageList"
+
+// Bubble user data is read back by LcdDisplay::SetTheme, so it must be one of these literals
+static const char* CanonicalRole(const char* role) {
+    if (strcmp(role, "user") == 0) {
+        return "user";
+    }
+    if (strcmp(role, "system") == 0) {
+        return "system";
+    }
+    return "assistant";
+}
+
+// The history can hold hundreds of messages, keep their text out of internal RAM
+static char* AllocText(size_t size) {
+#if CONFIG_SPIRAM
+    void* ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (ptr != nullptr) {
+        return static_cast<char*>(ptr);
+    }
+#endif
+    return static_cast<char*>(heap_caps_malloc(size, MALLOC_CAP_8BIT));
+}
+
+ChatMessageList* ChatMessageList::Attach(lv_obj_t* content, size_t max_messages, size_t max_rows) {
+    auto list = static_cast<ChatMessageList*>(lv_obj_get_user_data(content));
+    if (list != nullptr) {
+        return list;
+    }
+
+    list = new ChatMessageList(content, max_messages, max_rows);
+    lv_obj_set_user_data(content, list);
+    lv_obj_add_event_cb(content, [](lv_event_t* e) {
+        delete static_cast<ChatMessageList*>(lv_event_get_user_data(e));
+    }, LV_EVENT_DELETE, list);
+    lv_obj_add_event_cb(content, [](lv_event_t* e) {
+        static_cast<ChatMessageList*>(lv_event_get_user_data(e))->OnScroll();
+    }, LV_EVENT_SCROLL, list);
+    return list;
+}
+
+ChatMessageList::ChatMessageList(lv_obj_t* content, size_t max_messages, size_t max_rows)
+    : content_(content), max_messages_(std::max<size_t>(max_messages, 1)), max_rows_(std::max<size_t>(max_rows, 1)) {
+    rows_.reserve(max_rows_);
+    free_rows_.reserve(max_rows_);
+}
+
+ChatMessageList::~ChatMessageList() {
+    // LVGL objects are deleted together with the content object
+    if (scroll_pending_) {
+        lv_async_call_cancel(ScrollToLast, this);
+    }
+}
+
+size_t ChatMessageList::size() const {
+    return lv_obj_get_child_cnt(content_) - free_rows_.size();
+}
+
+ChatMessageList::Row* ChatMessageList::FindRow(lv_obj_t* container) const {
+    for (auto& row : rows_) {
+        if (row->container == container) {
+            return row.get();
+        }
+    }
+    return nullptr;
+}
+
+// Free rows are kept hidden at the front, bound rows follow in history order
+ChatMessageList::Row* ChatMessageList::FirstBoundRow() const {
+    uint32_t count = lv_obj_get_child_cnt(content_);
+    for (uint32_t i = free_rows_.size(); i < count; i++) {
+        Row* row = FindRow(lv_obj_get_child(content_, i));
+        if (row != nullptr) {
+            return row;
+        }
+    }
+    return nullptr;
+}
+
+ChatMessageList::Row* ChatMessageList::LastBoundRow() const {
+    for (int32_t i = (int32_t)lv_obj_get_child_cnt(content_) - 1; i >= (int32_t)free_rows_.size(); i--) {
+        Row* row = FindRow(lv_obj_get_child(content_, i));
+        if (row != nullptr) {
+            return row;
+        }
+    }
+    return nullptr;
+}
+
+// A free row, or a new one while fewer than max_rows_ exist. The caller moves it into place.
+ChatMessageList::Row* ChatMessageList::AcquireRow() {
+    if (!free_rows_.empty()) {
+        Row* row = free_rows_.back();
+        free_rows_.pop_back();
+        lv_obj_remove_flag(row->container, LV_OBJ_FLAG_HIDDEN);
+        return row;
+    }
+    if (rows_.size() >= max_rows_ || theme_ == nullptr) {
+        return nullptr;
+    }
+
+    auto new_row = std::make_unique<Row>();
+    Row* row = new_row.get();
+
+    // Full-width transparent row, so bubbles can be aligned left, right or center
+    row->container = lv_obj_create(content_);
+    lv_obj_set_width(row->container, LV_HOR_RES);
+    lv_obj_set_height(row->container, LV_SIZE_CONTENT);
+    lv_obj_set_style_bg_opa(row->container, LV_OPA_TRANSP, 0);
+    lv_obj_set_style_border_width(row->container, 0, 0);
+    lv_obj_set_style_pad_all(row->container, 0, 0);
+    lv_obj_set_scrollbar_mode(row->container, LV_SCROLLBAR_MODE_OFF);
+    lv_obj_remove_flag(row->container, LV_OBJ_FLAG_SCROLLABLE);
+
+    row->bubble = lv_obj_create(row->container);
+    lv_obj_set_style_radius(row->bubble, 8, 0);
+    lv_obj_set_scrollbar_mode(row->bubble, LV_SCROLLBAR_MODE_OFF);
+    lv_obj_set_style_border_width(row->bubble, 0, 0);
+    lv_obj_set_style_pad_all(row->bubble, theme_->spacing(4), 0);
+    lv_obj_set_style_bg_opa(row->bubble, LV_OPA_70, 0);
+    lv_obj_set_size(row->bubble, LV_SIZE_CONTENT, LV_SIZE_CONTENT);
+
+    row->label = lv_label_create(row->bubble);
+    lv_label_set_long_mode(row->label, LV_LABEL_LONG_WRAP);
+
+    rows_.push_back(std::move(new_row));
+    ESP_LOGD(TAG, "Created row %u/%u", (unsigned)rows_.size(), (unsigned)max_rows_);
+    return row;
+}
+
+void ChatMessageList::ReleaseRow(Row* row) {
+    lv_obj_add_flag(row->container, LV_OBJ_FLAG_HIDDEN);
+    lv_label_set_text_static(row->label, "");
+    lv_obj_move_to_index(row->container, 0);
+    free_rows_.push_back(row);
+}
+
+void ChatMessageList::ApplyRole(Row* row, const char* role) {
+    // Colors are applied every time, the theme may have changed since the row was last used
+    lv_obj_set_user_data(row->bubble, (void*)role);
+    if (strcmp(role, "user") == 0) {
+        lv_obj_set_style_bg_color(row->bubble, theme_->user_bubble_color(), 0);
+        lv_obj_set_style_text_color(row->label, theme_->text_color(), 0);
+        lv_obj_align(row->bubble, LV_ALIGN_RIGHT_MID, -25, 0);
+    } else if (strcmp(role, "system") == 0) {
+        lv_obj_set_style_bg_color(row->bubble, theme_->system_bubble_color(), 0);
+        lv_obj_set_style_text_color(row->label, theme_->system_text_color(), 0);
+        lv_obj_align(row->bubble, LV_ALIGN_CENTER, 0, 0);
+    } else {
+        lv_obj_set_style_bg_color(row->bubble, theme_->assistant_bubble_color(), 0);
+        lv_obj_set_style_text_color(row->label, theme_->text_color(), 0);
+        lv_obj_align(row->bubble, LV_ALIGN_LEFT_MID, 0, 0);
+    }
+}
+
+// Width of the widest line of the whole text, kerning included, measured once per text and font
+int32_t ChatMessageList::MeasureWidth(Message& message) {
+    if (message.width < 0) {
+        lv_point_t size;
+        lv_text_get_size(&size, message.text.get(), lv_obj_get_style_text_font(content_, LV_PART_MAIN),
+            lv_obj_get_style_text_letter_space(content_, LV_PART_MAIN), 0, LV_COORD_MAX, LV_TEXT_FLAG_NONE);
+        message.width = size.x;
+    }
+    return message.width;
+}
+
+// The label shows the history text in place, it is rebound whenever that text moves
+void ChatMessageList::BindRow(Row* row, Message& message) {
+    ApplyRole(row, message.role);
+    lv_label_set_text_static(row->label, message.text.get());
+
+    const int32_t min_width = 20;
+    const int32_t max_width = LV_HOR_RES * 85 / 100 - 16;  // 85% of screen width
+    int32_t width = std::min(std::max(MeasureWidth(message), min_width), max_width);
+    if (lv_obj_get_style_width(row->label, LV_PART_MAIN) != width) {
+        lv_obj_set_width(row->label, width);
+    }
+}
+
+void ChatMessageList::DropOldest() {
+    if (first_ > 0) {
+        first_--;
+    } else if (bound_ > 0) {
+        // The oldest message is on screen, its row goes first
+        ReleaseRow(FirstBoundRow());
+        bound_--;
+    }
+    messages_.pop_front();
+}
+
+// Rebind the rows to the newest messages if older ones were scrolled into view
+void ChatMessageList::ShowLatest() {
+    if (first_ + bound_ == messages_.size()) {
+        return;
+    }
+    while (bound_ > 0) {
+        ReleaseRow(LastBoundRow());
+        bound_--;
+    }
+    size_t count = std::min(messages_.size(), max_rows_);
+    first_ = messages_.size() - count;
+    for (size_t i = first_; i < messages_.size(); i++) {
+        Row* row = AcquireRow();
+        if (row == nullptr) {
+            break;
+        }
+        lv_obj_move_to_index(row->container, -1);
+        BindRow(row, messages_[i]);
+        bound_++;
+    }
+    first_ = messages_.size() - bound_;
+}
+
+// Keep `anchor` where it was on screen after rows above it were added or removed
+static void KeepInPlace(lv_obj_t* content, lv_obj_t* anchor, int32_t anchor_y) {
+    lv_obj_update_layout(content);
+    int32_t moved = lv_obj_get_y(anchor) - anchor_y;
+    if (moved != 0) {
+        lv_obj_scroll_to_y(content, lv_obj_get_scroll_y(content) + moved, LV_ANIM_OFF);
+    }
+}
+
+// Show up to `count` older messages above the window, taking rows from its bottom once all are in use
+void ChatMessageList::ShiftBack(size_t count) {
+    Row* anchor = FirstBoundRow();
+    lv_obj_update_layout(content_);
+    int32_t anchor_y = lv_obj_get_y(anchor->container);
+
+    for (size_t i = 0; i < count && first_ > 0; i++) {
+        // Goes right above the current first row, image bubbles above the window stay at the top
+        uint32_t top = lv_obj_get_index(FirstBoundRow()->container);
+        Row* row = bound_ < max_rows_ ? AcquireRow() : nullptr;
+        if (row == nullptr) {
+            row = LastBoundRow();
+            if (row == anchor) {
+                break;
+            }
+            bound_--;
+        }
+        uint32_t from = lv_obj_get_index(row->container);
+        lv_obj_move_to_index(row->container, from < top ? top - 1 : top);
+        first_--;
+        bound_++;
+        BindRow(row, messages_[first_]);
+    }
+    KeepInPlace(content_, anchor->container, anchor_y);
+}
+
+// Show up to `count` newer messages below the window, taking rows from its top once all are in use
+void ChatMessageList::ShiftForward(size_t count) {
+    Row* anchor = LastBoundRow();
+    lv_obj_update_layout(content_);
+    int32_t anchor_y = lv_obj_get_y(anchor->container);
+
+    for (size_t i = 0; i < count && first_ + bound_ < messages_.size(); i++) {
+        Row* row = bound_ < max_rows_ ? AcquireRow() : nullptr;
+        if (row == nullptr) {
+            row = FirstBoundRow();
+            if (row == anchor) {
+                break;
+            }
+            first_++;
+            bound_--;
+        }
+        lv_obj_move_to_index(row->container, -1);
+        BindRow(row, messages_[first_ + bound_]);
+        bound_++;
+    }
+    KeepInPlace(content_, anchor->container, anchor_y);
+}
+
+// Rebind a quarter of the rows whenever one end of the window comes within half a screen
+void ChatMessageList::OnScroll() {
+    if (shifting_ || bound_ == 0) {
+        return;
+    }
+    size_t step = std::max<size_t>(max_rows_ / 4, 1);
+    int32_t edge = lv_obj_get_height(content_) / 2;
+    // Moving the rows and correcting the scroll position sends scroll events of its own
+    shifting_ = true;
+    if (first_ > 0 && lv_obj_get_scroll_top(content_) < edge) {
+        ShiftBack(step);
+    } else if (first_ + bound_ < messages_.size() && lv_obj_get_scroll_bottom(content_) < edge) {
+        ShiftForward(step);
+    }
+    shifting_ = false;
+}
+
+lv_obj_t* ChatMessageList::AddMessage(const char* role, const char* text, LvglTheme* theme) {
+    theme_ = theme;
+    role = CanonicalRole(role);
+    // Streaming TTS sentences are merged until the turn ends or someone else speaks
+    turn_open_ = strcmp(role, "assistant") == 0;
+
+    size_t length = strlen(text);
+    Text copy(AllocText(length + 1), heap_caps_free);
+    if (copy == nullptr) {
+        ESP_LOGE(TAG, "No memory for a message of %u bytes", (unsigned)length);
+        return nullptr;
+    }
+    memcpy(copy.get(), text, length + 1);
+
+    ShowLatest();
+    messages_.push_back({ role, std::move(copy), length, -1 });
+    if (messages_.size() > max_messages_) {
+        DropOldest();
+    }
+
+    Row* row = AcquireRow();
+    if (row == nullptr) {
+        // Every row is in use: recycle the oldest, with the image bubbles above it
+        row = FirstBoundRow();
+        while (lv_obj_get_child(content_, free_rows_.size()) != row->container) {
+            lv_obj_delete(lv_obj_get_child(content_, free_rows_.size()));
+        }
+        first_++;
+        bound_--;
+    }
+    lv_obj_move_to_index(row->container, -1);
+    BindRow(row, messages_.back());
+    bound_++;
+    first_ = messages_.size() - bound_;
+
+    ScheduleScroll();
+    return row->label;
+}
+
+lv_obj_t* ChatMessageList::AppendToLast(const char* role, const char* text) {
+    if (!turn_open_ || messages_.empty() || strcmp(messages_.back().role, CanonicalRole(role)) != 0) {
+        return nullptr;
+    }
+    ShowLatest();
+    Row* row = LastBoundRow();
+    if (row == nullptr) {
+        return nullptr;
+    }
+    Message& message = messages_.back();
+
+    // Separate sentences with a space when both sides are ASCII (CJK text needs none)
+    unsigned char last = message.length > 0 ? message.text.get()[message.length - 1] : ' ';
+    unsigned char next = text[0];
+    bool space = last < 0x80 && !isspace(last) && next < 0x80 && next != '\0' && !isspace(next);
+
+    size_t added = strlen(text);
+    size_t length = message.length + (space ? 1 : 0) + added;
+    Text joined(AllocText(length + 1), heap_caps_free);
+    if (joined == nullptr) {
+        ESP_LOGE(TAG, "No memory to extend a message to %u bytes", (unsigned)length);
+        return nullptr;
+    }
+    memcpy(joined.get(), message.text.get(), message.length);
+    if (space) {
+        joined.get()[message.length] = ' ';
+    }
+    memcpy(joined.get() + length - added, text, added + 1);
+
+    // The label still points at the old text until it is rebound
+    std::swap(message.text, joined);
+    message.length = length;
+    message.width = -1;
+    BindRow(row, message);
+
+    ScheduleScroll();
+    return row->label;
+}
+
+void ChatMessageList::EndTurn() {
+    turn_open_ = false;
+}
+
+bool ChatMessageList::RemoveLastIfRole(const char* role) {
+    if (messages_.empty() || strcmp(messages_.back().role, CanonicalRole(role)) != 0) {
+        return false;
+    }
+    if (bound_ > 0 && first_ + bound_ == messages_.size()) {
+        ReleaseRow(LastBoundRow());
+        bound_--;
+    }
+    messages_.pop_back();
+    first_ = std::min(first_, messages_.size() - bound_);
+    return true;
+}
+
+void ChatMessageList::Clear() {
+    std::vector<lv_obj_t*> children;
+    uint32_t child_count = lv_obj_get_child_cnt(content_);
+    children.reserve(child_count);
+    for (uint32_t i = 0; i < child_count; i++) {
+        children.push_back(lv_obj_get_child(content_, i));
+    }
+
+    for (auto child : children) {
+        Row* row = FindRow(child);
+        if (row == nullptr) {
+            lv_obj_delete(child);
+        } else if (!lv_obj_has_flag(child, LV_OBJ_FLAG_HIDDEN)) {
+            ReleaseRow(row);
+        }
+    }
+    // Rows no longer point at any text
+    messages_.clear();
+    first_ = 0;
+    bound_ = 0;
+    turn_open_ = false;
+}
+
+void ChatMessageList::SetTheme(LvglTheme* theme) {
+    theme_ = theme;
+    for (auto& message : messages_) {
+        message.width = -1;
+    }
+    // Bound rows are in history order, measure them with the new font
+    uint32_t count = lv_obj_get_child_cnt(content_);
+    size_t index = first_;
+    for (uint32_t i = free_rows_.size(); i < count && index < first_ + bound_; i++) {
+        Row* row = FindRow(lv_obj_get_child(content_, i));
+        if (row != nullptr) {
+            BindRow(row, messages_[index++]);
+        }
+    }
+}
+
+void ChatMessageList::ScheduleScroll() {
+    // Several messages in one LVGL cycle only need one layout pass and one scroll
+    if (scroll_pending_) {
+        return;
+    }
+    scroll_pending_ = true;
+    lv_async_call(ScrollToLast, this);
+}
+
+void ChatMessageList::ScrollToLast(void* user_data) {
+    auto list = static_cast<ChatMessageList*>(user_data);
+    list->scroll_pending_ = false;
+    if (list->size() == 0) {
+        return;
+    }
+    lv_obj_t* last = lv_obj_get_child(list->content_, -1);
+    if (last != nullptr) {
+        lv_obj_scroll_to_view_recursive(last, LV_ANIM_ON);
+    }
+}
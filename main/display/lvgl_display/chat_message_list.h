@@ -0,0 +1,116 @@
+#pragma once
+
+#include "lvgl_theme.h"
+
+#include <lvgl.h>
+#include <esp_heap_caps.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+/**
+ * Chat history for the WeChat message style, shown through a fixed pool of rows.
+ *
+ * Up to `max_messages` messages are kept as text (in PSRAM when available), while at
+ * most `max_rows` of them have LVGL objects: a full-width transparent row holding a
+ * bubble and a label. The rows show a contiguous window of the history. New messages
+ * recycle the oldest row instead of deleting and creating objects, and scrolling to
+ * either end of the content rebinds rows from the other end to older or newer
+ * messages, keeping the visible bubbles in place.
+ *
+ * Each message is measured once with lv_text_get_size, so binding a row needs no
+ * layout pass, and scrolling to the newest message is coalesced into one async call
+ * per refresh.
+ *
+ * The list is owned by the content object and freed with it. Must be used with the
+ * LVGL lock held.
+ */
+class ChatMessageList {
+public:
+    // Return the list attached to `content`, creating it on first use
+    static ChatMessageList* Attach(lv_obj_t* content, size_t max_messages, size_t max_rows);
+
+    ~ChatMessageList();
+
+    /**
+     * Add a message at the end, dropping the oldest one when the history is full.
+     * Shows the newest messages if older ones were scrolled into view.
+     * @return the message label
+     */
+    lv_obj_t* AddMessage(const char* role, const char* text, LvglTheme* theme);
+
+    /**
+     * Append text to the last message if it is from `role` and its turn is still open.
+     * @return the message label, or nullptr if the text must go into a new message
+     */
+    lv_obj_t* AppendToLast(const char* role, const char* text);
+
+    // Start a new bubble for the next message even if it is from the same role
+    void EndTurn();
+
+    // Drop the last message if it is from `role`
+    bool RemoveLastIfRole(const char* role);
+
+    // Drop all messages and delete other objects added to the content (image bubbles)
+    void Clear();
+
+    // Colors and font for rows bound from now on, cached widths are measured again
+    void SetTheme(LvglTheme* theme);
+
+    // Number of visible children, messages and image bubbles
+    size_t size() const;
+
+    size_t message_count() const { return messages_.size(); }
+    size_t row_count() const { return rows_.size(); }
+    // History index of the message in the first visible row
+    size_t first_shown() const { return first_; }
+
+private:
+    using Text = std::unique_ptr<char, decltype(&heap_caps_free)>;
+
+    struct Message {
+        const char* role;
+        Text text;
+        size_t length;
+        int32_t width;      // Widest line, -1 until measured with the current font
+    };
+
+    struct Row {
+        lv_obj_t* container;
+        lv_obj_t* bubble;
+        lv_obj_t* label;
+    };
+
+    lv_obj_t* content_;
+    size_t max_messages_;
+    size_t max_rows_;
+    LvglTheme* theme_ = nullptr;
+    std::deque<Message> messages_;
+    std::vector<std::unique_ptr<Row>> rows_;
+    std::vector<Row*> free_rows_;
+    size_t first_ = 0;      // History index shown by the first bound row
+    size_t bound_ = 0;      // Rows showing messages first_ .. first_ + bound_ - 1
+    bool turn_open_ = false;
+    bool scroll_pending_ = false;
+    bool shifting_ = false;
+
+    ChatMessageList(lv_obj_t* content, size_t max_messages, size_t max_rows);
+
+    Row* FindRow(lv_obj_t* container) const;
+    Row* FirstBoundRow() const;
+    Row* LastBoundRow() const;
+    Row* AcquireRow();
+    void ReleaseRow(Row* row);
+    void BindRow(Row* row, Message& message);
+    void ApplyRole(Row* row, const char* role);
+    int32_t MeasureWidth(Message& message);
+    void DropOldest();
+    void ShowLatest();
+    void ShiftBack(size_t count);
+    void ShiftForward(size_t count);
+    void OnScroll();
+    void ScheduleScroll();
+    static void ScrollToLast(void* user_data);
+};
@@ -0,0 +1,313 @@
+#include "gif_frame_cache.h"
+#include "gifdec.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <sdkconfig.h>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "GifFrameCache"
+
+#ifndef CONFIG_EMOJI_GIF_FRAME_CACHE_SIZE_KB
+#define CONFIG_EMOJI_GIF_FRAME_CACHE_SIZE_KB 0
+#endif
+
+static void* AllocFrameMemory(size_t size) {
+#if CONFIG_SPIRAM
+    void* ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (ptr != nullptr) {
+        return ptr;
+    }
+#endif
+    return heap_caps_malloc(size, MALLOC_CAP_8BIT);
+}
+
+// Upper bound on remembered over-budget clips, roughly one per emotion
+#define MAX_REJECTED_CLIPS 32
+
+// gifdec canvas pixels are stored as B, G, R, A
+static inline uint16_t ToRgb565(const uint8_t* bgra) {
+    return ((bgra[2] & 0xF8) << 8) | ((bgra[1] & 0xFC) << 3) | (bgra[0] >> 3);
+}
+
+GifClip::GifClip(const void* source, uint16_t width, uint16_t height)
+    : source_(source), width_(width), height_(height) {
+}
+
+GifClip::~GifClip() {
+    for (auto& frame : frames_) {
+        heap_caps_free(frame.pixels);
+    }
+}
+
+bool GifClip::AddFrame(const uint8_t* argb, const uint8_t* prev_argb, uint32_t delay_ms) {
+    const uint32_t* cur = reinterpret_cast<const uint32_t*>(argb);
+    const uint32_t* prev = reinterpret_cast<const uint32_t*>(prev_argb);
+    int min_x = width_, min_y = height_, max_x = -1, max_y = -1;
+
+    if (prev == nullptr) {
+        min_x = 0;
+        min_y = 0;
+        max_x = width_ - 1;
+        max_y = height_ - 1;
+    } else {
+        for (int y = 0; y < height_; y++) {
+            const uint32_t* cur_row = cur + y * width_;
+            const uint32_t* prev_row = prev + y * width_;
+            int x = 0;
+            while (x < width_ && cur_row[x] == prev_row[x]) {
+                x++;
+            }
+            if (x == width_) {
+                continue;
+            }
+            int right = width_ - 1;
+            while (cur_row[right] == prev_row[right]) {
+                right--;
+            }
+            min_x = std::min(min_x, x);
+            max_x = std::max(max_x, right);
+            min_y = std::min(min_y, y);
+            max_y = y;
+        }
+    }
+
+    Frame frame = {};
+    frame.delay_ms = delay_ms;
+    if (max_x < 0) {
+        // Identical to the previous frame, only the delay matters
+        frames_.push_back(frame);
+        memory_size_ += sizeof(Frame);
+        return true;
+    }
+
+    frame.x = min_x;
+    frame.y = min_y;
+    frame.w = max_x - min_x + 1;
+    frame.h = max_y - min_y + 1;
+    size_t area = (size_t)frame.w * frame.h;
+    frame.pixels = static_cast<uint8_t*>(AllocFrameMemory(area * 3));
+    if (frame.pixels == nullptr) {
+        return false;
+    }
+
+    uint16_t* rgb = reinterpret_cast<uint16_t*>(frame.pixels);
+    uint8_t* alpha = frame.pixels + area * 2;
+    for (int y = 0; y < frame.h; y++) {
+        const uint8_t* src = argb + ((size_t)(frame.y + y) * width_ + frame.x) * 4;
+        for (int x = 0; x < frame.w; x++, src += 4) {
+            *rgb++ = ToRgb565(src);
+            *alpha++ = src[3];
+            if (src[3] != 0xFF) {
+                has_alpha_ = true;
+            }
+        }
+    }
+
+    frames_.push_back(frame);
+    memory_size_ += sizeof(Frame) + area * 3;
+    return true;
+}
+
+void GifClip::DropAlpha() {
+    for (auto& frame : frames_) {
+        if (frame.pixels == nullptr) {
+            continue;
+        }
+        size_t area = (size_t)frame.w * frame.h;
+        void* shrunk = heap_caps_realloc(frame.pixels, area * 2, MALLOC_CAP_8BIT);
+        if (shrunk != nullptr) {
+            frame.pixels = static_cast<uint8_t*>(shrunk);
+        }
+        memory_size_ -= area;
+    }
+}
+
+void GifClip::ApplyFrame(size_t index, uint8_t* canvas) const {
+    const Frame& frame = frames_[index];
+    if (frame.pixels == nullptr) {
+        return;
+    }
+
+    size_t area = (size_t)frame.w * frame.h;
+    for (int y = 0; y < frame.h; y++) {
+        size_t offset = (size_t)(frame.y + y) * width_ + frame.x;
+        memcpy(canvas + offset * 2, frame.pixels + (size_t)y * frame.w * 2, frame.w * 2);
+    }
+    if (has_alpha_) {
+        uint8_t* alpha_plane = canvas + (size_t)width_ * height_ * 2;
+        const uint8_t* alpha = frame.pixels + area * 2;
+        for (int y = 0; y < frame.h; y++) {
+            size_t offset = (size_t)(frame.y + y) * width_ + frame.x;
+            memcpy(alpha_plane + offset, alpha + (size_t)y * frame.w, frame.w);
+        }
+    }
+}
+
+std::shared_ptr<GifClip> GifClip::Decode(const lv_img_dsc_t* img_dsc, size_t max_bytes) {
+    gd_GIF* gif = gd_open_gif_data(img_dsc->data);
+    if (gif == nullptr) {
+        return nullptr;
+    }
+
+    size_t canvas_bytes = (size_t)gif->width * gif->height * 4;
+    uint8_t* prev = static_cast<uint8_t*>(AllocFrameMemory(canvas_bytes));
+    if (prev == nullptr) {
+        gd_close_gif(gif);
+        return nullptr;
+    }
+
+    auto clip = std::make_shared<GifClip>(img_dsc->data, gif->width, gif->height);
+    bool ok = true;
+    while (true) {
+        // Same sequence as LvglGif::NextFrame, so replayed frames match live decoding
+        uint32_t pos_before = gif->f_rw_p;
+        int has_next = gd_get_frame(gif);
+        if (has_next < 0) {
+            ok = false;
+            break;
+        }
+        // A rewind ends where frame 0 ends, which for a one-frame GIF is where it began
+        if (has_next == 0 || (!clip->frames_.empty() && gif->f_rw_p <= pos_before)) {
+            break;
+        }
+        if (clip->frames_.empty()) {
+            // The NETSCAPE extension precedes the first image and is decremented on every loop
+            clip->loop_count_ = gif->loop_count;
+        }
+
+        gd_render_frame(gif, gif->canvas);
+        if (!clip->AddFrame(gif->canvas, clip->frames_.empty() ? nullptr : prev, gif->gce.delay * 10)) {
+            ESP_LOGW(TAG, "Out of memory while decoding frame %u", (unsigned)clip->frames_.size());
+            ok = false;
+            break;
+        }
+        if (clip->memory_size_ > max_bytes) {
+            ESP_LOGW(TAG, "GIF exceeds cache budget (%u bytes)", (unsigned)max_bytes);
+            ok = false;
+            break;
+        }
+        memcpy(prev, gif->canvas, canvas_bytes);
+    }
+
+    heap_caps_free(prev);
+    gd_close_gif(gif);
+    if (!ok || clip->frames_.empty()) {
+        return nullptr;
+    }
+    if (!clip->has_alpha_) {
+        clip->DropAlpha();
+    }
+    return clip;
+}
+
+GifFrameCache::GifFrameCache() : capacity_(CONFIG_EMOJI_GIF_FRAME_CACHE_SIZE_KB * 1024) {
+}
+
+bool GifFrameCache::IsRejected(const std::string& key, const void* source) const {
+    for (const auto& rejected : rejected_) {
+        if (rejected.key == key && rejected.source == source) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<const GifClip> GifFrameCache::Acquire(const std::string& key, const lv_img_dsc_t* img_dsc) {
+    if (capacity_ == 0 || img_dsc == nullptr || img_dsc->data == nullptr) {
+        return nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            if (it->key != key) {
+                continue;
+            }
+            if (it->clip->source() == img_dsc->data) {
+                entries_.splice(entries_.begin(), entries_, it);
+                hits_++;
+                return entries_.front().clip;
+            }
+            // Same emotion from another emoji collection, the old clip is stale
+            used_ -= it->clip->memory_size();
+            entries_.erase(it);
+            break;
+        }
+        if (IsRejected(key, img_dsc->data)) {
+            return nullptr;
+        }
+        misses_++;
+    }
+
+    // The first frame alone is stored as a full RGB565 image, so the logical screen size
+    // in the GIF header is enough to reject clips that can never fit
+    bool fits = true;
+    const uint8_t* header = static_cast<const uint8_t*>(img_dsc->data);
+    if (img_dsc->data_size >= 10 && memcmp(header, "GIF", 3) == 0) {
+        size_t width = header[6] | (header[7] << 8);
+        size_t height = header[8] | (header[9] << 8);
+        fits = width * height * 2 <= capacity_;
+    }
+
+    // Decode without holding the mutex, so other lookups are not blocked meanwhile
+    int64_t start_time = esp_timer_get_time();
+    auto clip = fits ? GifClip::Decode(img_dsc, capacity_) : nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (clip == nullptr) {
+        ESP_LOGW(TAG, "Not caching %s: over the %u byte budget or undecodable", key.c_str(), (unsigned)capacity_);
+        if (rejected_.size() >= MAX_REJECTED_CLIPS) {
+            rejected_.erase(rejected_.begin());
+        }
+        rejected_.push_back({key, img_dsc->data});
+        return nullptr;
+    }
+    for (const auto& entry : entries_) {
+        if (entry.key == key && entry.clip->source() == img_dsc->data) {
+            // Another task decoded the same clip meanwhile
+            return entry.clip;
+        }
+    }
+
+    EvictUntilFits(clip->memory_size());
+    entries_.push_front({key, clip});
+    used_ += clip->memory_size();
+    ESP_LOGI(TAG, "Decoded %s: %ux%u, %u frames, %u bytes in %d ms (cache %u/%u)",
+        key.c_str(), clip->width(), clip->height(), (unsigned)clip->frames().size(),
+        (unsigned)clip->memory_size(), (int)((esp_timer_get_time() - start_time) / 1000),
+        (unsigned)used_, (unsigned)capacity_);
+    return clip;
+}
+
+void GifFrameCache::EvictUntilFits(size_t bytes) {
+    while (!entries_.empty() && used_ + bytes > capacity_) {
+        ESP_LOGD(TAG, "Evict %s", entries_.back().key.c_str());
+        used_ -= entries_.back().clip->memory_size();
+        entries_.pop_back();
+    }
+}
+
+void GifFrameCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    rejected_.clear();
+    used_ = 0;
+}
+
+size_t GifFrameCache::used() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return used_;
+}
+
+uint32_t GifFrameCache::hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+uint32_t GifFrameCache::misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
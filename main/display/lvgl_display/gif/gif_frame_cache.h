@@ -0,0 +1,121 @@
+#pragma once
+
+#include <lvgl.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * A GIF decoded once into RGB565 / RGB565A8 frames.
+ *
+ * Every frame is stored as a patch: the bounding box of the pixels that differ
+ * from the previous composited frame (the first frame covers the whole image).
+ * Replaying a clip copies the patches into a canvas in order, without LZW decoding.
+ */
+class GifClip {
+public:
+    struct Frame {
+        uint16_t x, y, w, h;    // Dirty rectangle relative to the image
+        uint32_t delay_ms;      // How long this frame stays on screen
+        uint8_t* pixels;        // RGB565 plane (w*h*2), then alpha plane (w*h) if has_alpha
+    };
+
+    GifClip(const void* source, uint16_t width, uint16_t height);
+    ~GifClip();
+
+    GifClip(const GifClip&) = delete;
+    GifClip& operator=(const GifClip&) = delete;
+
+    const void* source() const { return source_; }
+    uint16_t width() const { return width_; }
+    uint16_t height() const { return height_; }
+    bool has_alpha() const { return has_alpha_; }
+    int32_t loop_count() const { return loop_count_; }
+    const std::vector<Frame>& frames() const { return frames_; }
+    size_t memory_size() const { return memory_size_; }
+
+    lv_color_format_t color_format() const {
+        return has_alpha_ ? LV_COLOR_FORMAT_RGB565A8 : LV_COLOR_FORMAT_RGB565;
+    }
+    size_t canvas_size() const { return (size_t)width_ * height_ * (has_alpha_ ? 3 : 2); }
+
+    /**
+     * Copy frame `index` into a canvas of canvas_size() bytes laid out as color_format()
+     */
+    void ApplyFrame(size_t index, uint8_t* canvas) const;
+
+    /**
+     * Decode all frames of a GIF (one loop). Returns nullptr if the data is not a
+     * valid GIF, decoding fails, or the decoded clip would exceed max_bytes.
+     */
+    static std::shared_ptr<GifClip> Decode(const lv_img_dsc_t* img_dsc, size_t max_bytes);
+
+private:
+    const void* source_;
+    uint16_t width_;
+    uint16_t height_;
+    bool has_alpha_ = false;
+    int32_t loop_count_ = -1;
+    std::vector<Frame> frames_;
+    size_t memory_size_ = 0;
+
+    bool AddFrame(const uint8_t* argb, const uint8_t* prev_argb, uint32_t delay_ms);
+    void DropAlpha();
+};
+
+/**
+ * LRU cache of decoded emoji GIFs, bounded by CONFIG_EMOJI_GIF_FRAME_CACHE_SIZE_KB.
+ * Frames are placed in PSRAM when available. Clips are shared, so evicting one that
+ * is still playing only frees it once the player releases it.
+ */
+class GifFrameCache {
+public:
+    static GifFrameCache& GetInstance() {
+        static GifFrameCache instance;
+        return instance;
+    }
+
+    /**
+     * Return the decoded clip for `key`, decoding and inserting it on a miss.
+     * Returns nullptr when caching is disabled or the clip does not fit the budget;
+     * callers should then fall back to live decoding. Clips that did not fit are
+     * remembered, so they are not decoded again on every request.
+     */
+    std::shared_ptr<const GifClip> Acquire(const std::string& key, const lv_img_dsc_t* img_dsc);
+
+    void Clear();
+    size_t capacity() const { return capacity_; }
+    size_t used() const;
+    uint32_t hits() const;
+    uint32_t misses() const;
+
+private:
+    GifFrameCache();
+
+    struct Entry {
+        std::string key;
+        std::shared_ptr<const GifClip> clip;
+    };
+
+    // A key/source pair that failed to decode or exceeded the budget
+    struct Rejected {
+        std::string key;
+        const void* source;
+    };
+
+    mutable std::mutex mutex_;
+    std::list<Entry> entries_;  // Most recently used first
+    std::vector<Rejected> rejected_;
+    size_t capacity_;
+    size_t used_ = 0;
+    uint32_t hits_ = 0;
+    uint32_t misses_ = 0;
+
+    void EvictUntilFits(size_t bytes);
+    bool IsRejected(const std::string& key, const void* source) const;
+};
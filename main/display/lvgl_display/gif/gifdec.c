@@ -10,22 +10,22 @@
 #define MIN(A, B) ((A) < (B) ? (A) : (B))
 #define MAX(A, B) ((A) > (B) ? (A) : (B))
 
-typedef struct Entry {
-    uint16_t length;
-    uint16_t prefix;
-    uint8_t  suffix;
-} Entry;
-
-typedef struct Table {
-    int bulk;
-    int nentries;
-    Entry * entries;
-} Table;
-
-#if LV_GIF_CACHE_DECODE_DATA
 #define LZW_MAXBITS                 12
 #define LZW_TABLE_SIZE              (1 << LZW_MAXBITS)
-#define LZW_CACHE_SIZE              (LZW_TABLE_SIZE * 4)
+
+/* LZW string table. Every code stores its full string length, so a string can be
+ * written back to front straight into the frame row without an intermediate stack.
+ * The stack is only used for strings that wrap onto the next row. */
+typedef struct LzwTable {
+    uint16_t prefix[LZW_TABLE_SIZE];
+    uint16_t length[LZW_TABLE_SIZE];
+    uint8_t  suffix[LZW_TABLE_SIZE];
+    uint8_t  stack[LZW_TABLE_SIZE];
+} LzwTable;
+
+#if LV_GIF_CACHE_DECODE_DATA
+/* Reserve room to align the table after the frame buffer. */
+#define LZW_CACHE_SIZE              (sizeof(LzwTable) + 3)
 #endif
 
 static gd_GIF  * gif_open(gd_GIF * gif);
@@ -38,6 +38,43 @@ static void f_gif_close(gd_GIF * gif);
     #include "gifdec_mve.h"
 #endif
 
+/* Pack one canvas pixel. The canvas is stored as B, G, R, A bytes. */
+static inline uint32_t
+make_pixel(const uint8_t * rgb, uint8_t alpha)
+{
+    uint8_t px[4] = {rgb[2], rgb[1], rgb[0], alpha};
+    uint32_t value;
+    memcpy(&value, px, sizeof(value));
+    return value;
+}
+
+/* Convert the active palette to canvas pixels once per frame instead of once per pixel.
+ * The global color table is only converted again after a local table replaced it. */
+static void
+convert_palette(gd_GIF * gif)
+{
+    int i;
+
+    if(gif->palette == gif->converted_palette) return;
+    for(i = 0; i < 0x100; i++) {
+        gif->palette_argb[i] = make_pixel(&gif->palette->colors[i * 3], 0xFF);
+    }
+    gif->converted_palette = gif->palette == &gif->gct ? gif->palette : NULL;
+}
+
+static inline void
+fill_pixels(uint32_t * dst, int w, int h, int stride, uint32_t color)
+{
+    int j, k;
+
+    for(j = 0; j < h; j++) {
+        for(k = 0; k < w; k++) {
+            dst[k] = color;
+        }
+        dst += stride;
+    }
+}
+
 static uint16_t
 read_num(gd_GIF * gif)
 {
@@ -145,19 +182,17 @@ static gd_GIF * gif_open(gd_GIF * gif_base)
         memset(gif->frame, gif->bgindex, gif->width * gif->height);
     }
     bgcolor = &gif->palette->colors[gif->bgindex * 3];
+    gif->converted_palette = NULL;
+    convert_palette(gif);
     #if LV_GIF_CACHE_DECODE_DATA
-    gif->lzw_cache = gif->frame + width * height;
+    gif->lzw_cache = (uint8_t *) (((uintptr_t) (gif->frame + width * height) + 3) & ~(uintptr_t) 3);
     #endif
 
 #ifdef GIFDEC_FILL_BG
     GIFDEC_FILL_BG(gif->canvas, gif->width * gif->height, 1, gif->width * gif->height, bgcolor, 0x00);
 #else
-    for(int i = 0; i < gif->width * gif->height; i++) {
-        gif->canvas[i * 4 + 0] = *(bgcolor + 2);
-        gif->canvas[i * 4 + 1] = *(bgcolor + 1);
-        gif->canvas[i * 4 + 2] = *(bgcolor + 0);
-        gif->canvas[i * 4 + 3] = 0x00;  // 初始化为透明，让第一帧根据自己的透明度设置来渲染
-    }
+    // 初始化为透明，让第一帧根据自己的透明度设置来渲染
+    fill_pixels((uint32_t *) gif->canvas, gif->width * gif->height, 1, 0, make_pixel(bgcolor, 0x00));
 #endif
     gif->anim_start = f_gif_seek(gif, 0, LV_FS_SEEK_CUR);
     gif->loop_count = -1;
@@ -299,247 +334,111 @@ read_ext(gd_GIF * gif)
     }
 }
 
-static uint16_t
-get_key(gd_GIF *gif, int key_size, uint8_t *sub_len, uint8_t *shift, uint8_t *byte)
+/* LZW code reader. Sub-blocks are read whole and codes are taken from a bit buffer. */
+typedef struct LzwReader {
+    gd_GIF * gif;
+    uint32_t bits;
+    int nbits;
+    int block_len;
+    int block_pos;
+    uint8_t block[0xFF];
+} LzwReader;
+
+/* Return the next code, or -1 at the end of the image data. */
+static inline int
+lzw_read_code(LzwReader * r, int code_size)
 {
-    int bits_read;
-    int rpad;
-    int frag_size;
-    uint16_t key;
-
-    key = 0;
-    for (bits_read = 0; bits_read < key_size; bits_read += frag_size) {
-        rpad = (*shift + bits_read) % 8;
-        if (rpad == 0) {
-            /* Update byte. */
-            if (*sub_len == 0) {
-                f_gif_read(gif, sub_len, 1); /* Must be nonzero! */
-                if (*sub_len == 0) return 0x1000;
-            }
-            f_gif_read(gif, byte, 1);
-            (*sub_len)--;
+    int code;
+
+    while(r->nbits < code_size) {
+        if(r->block_pos == r->block_len) {
+            uint8_t len;
+            f_gif_read(r->gif, &len, 1);
+            if(len == 0) return -1;
+            f_gif_read(r->gif, r->block, len);
+            r->block_len = len;
+            r->block_pos = 0;
         }
-        frag_size = MIN(key_size - bits_read, 8 - rpad);
-        key |= ((uint16_t) ((*byte) >> rpad)) << bits_read;
+        r->bits |= (uint32_t) r->block[r->block_pos++] << r->nbits;
+        r->nbits += 8;
     }
-    /* Clear extra bits to the left. */
-    key &= (1 << key_size) - 1;
-    *shift = (*shift + key_size) % 8;
-    return key;
+    code = r->bits & ((1U << code_size) - 1);
+    r->bits >>= code_size;
+    r->nbits -= code_size;
+    return code;
 }
 
-#if LV_GIF_CACHE_DECODE_DATA
-/* Decompress image pixels.
- * Return 0 on success or -1 on out-of-memory (w.r.t. LZW code table) or parse error. */
-static int
-read_image_data(gd_GIF *gif, int interlace)
-{
-    uint8_t sub_len, shift, byte;
-    int ret = 0;
-    int key_size;
-    int y, pass, linesize;
-    uint8_t *ptr = NULL;
-    uint8_t *ptr_row_start = NULL;
-    uint8_t *ptr_base = NULL;
-    size_t start, end;
-    uint16_t key, clear_code, stop_code, curr_code;
-    int frm_off, frm_size,curr_size,top_slot,new_codes,slot;
-    /* The first value of the value sequence corresponding to key */
-    int first_value;
-    int last_key;
-    uint8_t *sp = NULL;
-    uint8_t *p_stack = NULL;
-    uint8_t *p_suffix = NULL;
-    uint16_t *p_prefix = NULL;
-
-    /* get initial key size and clear code, stop code */
-    f_gif_read(gif, &byte, 1);
-    key_size = (int) byte;
-    clear_code = 1 << key_size;
-    stop_code = clear_code + 1;
-    key = 0;
-
-    start = f_gif_seek(gif, 0, LV_FS_SEEK_CUR);
-    discard_sub_blocks(gif);
-    end = f_gif_seek(gif, 0, LV_FS_SEEK_CUR);
-    f_gif_seek(gif, start, LV_FS_SEEK_SET);
+/* Output position inside the frame rectangle, following the interlace passes. */
+typedef struct LzwCursor {
+    uint8_t * base;
+    uint8_t * row;
+    int x, y;
+    int pass;
+    int fw, fh;
+    int linesize;
+    int interlace;
+} LzwCursor;
 
-    linesize = gif->width;
-    ptr_base = &gif->frame[gif->fy * linesize + gif->fx];
-    ptr_row_start = ptr_base;
-    ptr = ptr_row_start;
-    sub_len = shift = 0;
-    /* decoder */
-    pass = 0;
-    y = 0;
-    p_stack = gif->lzw_cache;
-    p_suffix = gif->lzw_cache + LZW_TABLE_SIZE;
-    p_prefix = (uint16_t*)(gif->lzw_cache + LZW_TABLE_SIZE * 2);
-    frm_off = 0;
-    frm_size = gif->fw * gif->fh;
-    curr_size = key_size + 1;
-    top_slot = 1 << curr_size;
-    new_codes = clear_code + 2;
-    slot = new_codes;
-    first_value = -1;
-    last_key = -1;
-    sp = p_stack;
-
-    while (frm_off < frm_size) {
-        /* copy data to frame buffer */
-        while (sp > p_stack) {
-            if(frm_off >= frm_size){
-                ESP_LOGW(TAG, "LZW table token overflows the frame buffer");
-                return -1;
-            }
-            *ptr++ = *(--sp);
-            frm_off += 1;
-            /* read one line */
-            if ((ptr - ptr_row_start) == gif->fw) {
-                if (interlace) {
-                    switch(pass) {
-                    case 0:
-                    case 1:
-                        y += 8;
-                        ptr_row_start += linesize * 8;
-                        break;
-                    case 2:
-                        y += 4;
-                        ptr_row_start += linesize * 4;
-                        break;
-                    case 3:
-                        y += 2;
-                        ptr_row_start += linesize * 2;
-                        break;
-                    default:
-                        break;
-                    }
-                    while (y >= gif->fh) {
-                        y  = 4 >> pass;
-                        ptr_row_start = ptr_base + linesize * y;
-                        pass++;
-                    }
-                } else {
-                    ptr_row_start += linesize;
-                }
-                ptr = ptr_row_start;
-            }
+static inline void
+lzw_next_row(LzwCursor * c)
+{
+    c->x = 0;
+    if(!c->interlace) {
+        c->y++;
+    }
+    else {
+        static const uint8_t step[4] = {8, 8, 4, 2};
+        static const uint8_t start[4] = {0, 4, 2, 1};
+        c->y += step[c->pass];
+        while(c->y >= c->fh && c->pass < 3) {
+            c->pass++;
+            c->y = start[c->pass];
         }
+    }
+    c->row = c->base + c->y * c->linesize;
+}
 
-        key = get_key(gif, curr_size, &sub_len, &shift, &byte);
-
-        if (key == stop_code || key >= LZW_TABLE_SIZE)
-            break;
+/* Write the string of `code` at the cursor and return its first byte. */
+static inline uint8_t
+lzw_emit(LzwTable * t, LzwCursor * c, int code)
+{
+    int len = t->length[code];
+    int i;
 
-        if (key == clear_code) {
-            curr_size = key_size + 1;
-            slot = new_codes;
-            top_slot = 1 << curr_size;
-            first_value = last_key = -1;
-            sp = p_stack;
-            continue;
+    if(len <= c->fw - c->x) {
+        /* Common case: the string fits in the current row, write it back to front. */
+        uint8_t * p = c->row + c->x + len - 1;
+        for(i = 0; i < len; i++) {
+            *p-- = t->suffix[code];
+            code = t->prefix[code];
         }
-
-        curr_code = key;
-        /*
-         * If the current code is a code that will be added to the decoding
-         * dictionary, it is composed of the data list corresponding to the
-         * previous key and its first data.
-         * */
-        if (curr_code == slot && first_value >= 0) {
-            *sp++ = first_value;
-            curr_code = last_key;
-        }else if(curr_code >= slot)
-            break;
-
-        while (curr_code >= new_codes) {
-            *sp++ = p_suffix[curr_code];
-            curr_code = p_prefix[curr_code];
+        p++;
+        c->x += len;
+        if(c->x == c->fw) {
+            uint8_t first = *p;
+            lzw_next_row(c);
+            return first;
         }
-        *sp++ = curr_code;
-
-        /* Add code to decoding dictionary */
-        if (slot < top_slot && last_key >= 0) {
-            p_suffix[slot] = curr_code;
-            p_prefix[slot++] = last_key;
+        return *p;
+    }
+    else {
+        uint8_t * sp = t->stack + len;
+        uint8_t first;
+        for(i = 0; i < len; i++) {
+            *--sp = t->suffix[code];
+            code = t->prefix[code];
         }
-        first_value = curr_code;
-        last_key = key;
-        if (slot >= top_slot) {
-            if (curr_size < LZW_MAXBITS) {
-                top_slot <<= 1;
-                curr_size += 1;
-            }
+        first = *sp;
+        while(len > 0) {
+            int n = MIN(len, c->fw - c->x);
+            memcpy(c->row + c->x, sp, n);
+            sp += n;
+            len -= n;
+            c->x += n;
+            if(c->x == c->fw) lzw_next_row(c);
         }
+        return first;
     }
-
-    if (key == stop_code) f_gif_read(gif, &sub_len, 1); /* Must be zero! */
-    f_gif_seek(gif, end, LV_FS_SEEK_SET);
-    return ret;
-}
-#else
-static Table *
-new_table(int key_size)
-{
-    int key;
-    int init_bulk = MAX(1 << (key_size + 1), 0x100);
-    Table * table = lv_malloc(sizeof(*table) + sizeof(Entry) * init_bulk);
-    if(table) {
-        table->bulk = init_bulk;
-        table->nentries = (1 << key_size) + 2;
-        table->entries = (Entry *) &table[1];
-        for(key = 0; key < (1 << key_size); key++)
-            table->entries[key] = (Entry) {
-            1, 0xFFF, key
-        };
-    }
-    return table;
-}
-
-/* Add table entry. Return value:
- *  0 on success
- *  +1 if key size must be incremented after this addition
- *  -1 if could not realloc table */
-static int
-add_entry(Table ** tablep, uint16_t length, uint16_t prefix, uint8_t suffix)
-{
-    Table * table = *tablep;
-    if(table->nentries == table->bulk) {
-        table->bulk *= 2;
-        table = lv_realloc(table, sizeof(*table) + sizeof(Entry) * table->bulk);
-        if(!table) return -1;
-        table->entries = (Entry *) &table[1];
-        *tablep = table;
-    }
-    table->entries[table->nentries] = (Entry) {
-        length, prefix, suffix
-    };
-    table->nentries++;
-    if((table->nentries & (table->nentries - 1)) == 0)
-        return 1;
-    return 0;
-}
-
-/* Compute output index of y-th input line, in frame of height h. */
-static int
-interlaced_line_index(int h, int y)
-{
-    int p; /* number of lines in current pass */
-
-    p = (h - 1) / 8 + 1;
-    if(y < p)  /* pass 1 */
-        return y * 8;
-    y -= p;
-    p = (h - 5) / 8 + 1;
-    if(y < p)  /* pass 2 */
-        return y * 8 + 4;
-    y -= p;
-    p = (h - 3) / 4 + 1;
-    if(y < p)  /* pass 3 */
-        return y * 4 + 2;
-    y -= p;
-    /* pass 4 */
-    return y * 2 + 1;
 }
 
 /* Decompress image pixels.
@@ -547,83 +446,116 @@ interlaced_line_index(int h, int y)
 static int
 read_image_data(gd_GIF * gif, int interlace)
 {
-    uint8_t sub_len, shift, byte;
-    int init_key_size, key_size, table_is_full = 0;
-    int frm_off, frm_size, str_len = 0, i, p, x, y;
-    uint16_t key, clear, stop;
-    int ret;
-    Table * table;
-    Entry entry = {0};
+    uint8_t byte;
+    int min_code_size, code_size, code, clear_code, stop_code, next_code;
+    int prev_code = -1;
+    uint8_t prev_first = 0;
+    int frm_off, frm_size;
+    int ret = 0;
     size_t start, end;
+    LzwTable * table;
+    LzwReader reader;
+    LzwCursor cursor;
 
     f_gif_read(gif, &byte, 1);
-    key_size = (int) byte;
+    min_code_size = (int) byte;
     start = f_gif_seek(gif, 0, LV_FS_SEEK_CUR);
     discard_sub_blocks(gif);
     end = f_gif_seek(gif, 0, LV_FS_SEEK_CUR);
     f_gif_seek(gif, start, LV_FS_SEEK_SET);
-    clear = 1 << key_size;
-    stop = clear + 1;
-    table = new_table(key_size);
-    key_size++;
-    init_key_size = key_size;
-    sub_len = shift = 0;
-    key = get_key(gif, key_size, &sub_len, &shift, &byte); /* clear code */
+    if(min_code_size < 1 || min_code_size > 11) {
+        ESP_LOGW(TAG, "Invalid LZW minimum code size: %d", min_code_size);
+        f_gif_seek(gif, end, LV_FS_SEEK_SET);
+        return -1;
+    }
+
+#if LV_GIF_CACHE_DECODE_DATA
+    table = (LzwTable *) gif->lzw_cache;
+#else
+    table = lv_malloc(sizeof(LzwTable));
+    if(!table) return -1;
+#endif
+
+    clear_code = 1 << min_code_size;
+    stop_code = clear_code + 1;
+    for(code = 0; code < clear_code; code++) {
+        table->prefix[code] = 0;
+        table->length[code] = 1;
+        table->suffix[code] = code;
+    }
+    code_size = min_code_size + 1;
+    next_code = clear_code + 2;
+
+    memset(&reader, 0, sizeof(reader));
+    reader.gif = gif;
+
+    cursor.linesize = gif->width;
+    cursor.base = &gif->frame[gif->fy * cursor.linesize + gif->fx];
+    cursor.row = cursor.base;
+    cursor.x = cursor.y = cursor.pass = 0;
+    cursor.fw = gif->fw;
+    cursor.fh = gif->fh;
+    cursor.interlace = interlace;
+
     frm_off = 0;
-    ret = 0;
     frm_size = gif->fw * gif->fh;
     while(frm_off < frm_size) {
-        if(key == clear) {
-            key_size = init_key_size;
-            table->nentries = (1 << (key_size - 1)) + 2;
-            table_is_full = 0;
+        code = lzw_read_code(&reader, code_size);
+        if(code < 0 || code == stop_code) break;
+        if(code == clear_code) {
+            code_size = min_code_size + 1;
+            next_code = clear_code + 2;
+            prev_code = -1;
+            continue;
         }
-        else if(!table_is_full) {
-            ret = add_entry(&table, str_len + 1, key, entry.suffix);
-            if(ret == -1) {
-                lv_free(table);
-                return -1;
-            }
-            if(table->nentries == 0x1000) {
-                ret = 0;
-                table_is_full = 1;
-            }
+        if(prev_code < 0) {
+            /* First code after a clear code must be a literal. */
+            if(code >= clear_code) break;
+            cursor.row[cursor.x++] = code;
+            if(cursor.x == cursor.fw) lzw_next_row(&cursor);
+            frm_off++;
+            prev_code = code;
+            prev_first = code;
+            continue;
+        }
+
+        if(code > next_code || (code == next_code && next_code >= LZW_TABLE_SIZE)) {
+            ESP_LOGW(TAG, "Invalid LZW code");
+            break;
         }
-        key = get_key(gif, key_size, &sub_len, &shift, &byte);
-        if(key == clear) continue;
-        if(key == stop || key == 0x1000) break;
-        if(ret == 1) key_size++;
-        entry = table->entries[key];
-        str_len = entry.length;
-	if(frm_off + str_len > frm_size){
-		ESP_LOGW(TAG, "LZW table token overflows the frame buffer");
-		lv_free(table);
-		return -1;
-	}
-        for(i = 0; i < str_len; i++) {
-            p = frm_off + entry.length - 1;
-            x = p % gif->fw;
-            y = p / gif->fw;
-            if(interlace)
-                y = interlaced_line_index((int) gif->fh, y);
-            gif->frame[(gif->fy + y) * gif->width + gif->fx + x] = entry.suffix;
-            if(entry.prefix == 0xFFF)
-                break;
-            else
-                entry = table->entries[entry.prefix];
+        if(code == next_code) {
+            /* KwKwK: the new string is the previous one plus its own first byte. */
+            table->prefix[next_code] = prev_code;
+            table->suffix[next_code] = prev_first;
+            table->length[next_code] = table->length[prev_code] + 1;
+        }
+        if(frm_off + table->length[code] > frm_size) {
+            ESP_LOGW(TAG, "LZW table token overflows the frame buffer");
+            ret = -1;
+            break;
+        }
+        frm_off += table->length[code];
+        prev_first = lzw_emit(table, &cursor, code);
+
+        if(next_code < LZW_TABLE_SIZE) {
+            if(code != next_code) {
+                table->prefix[next_code] = prev_code;
+                table->suffix[next_code] = prev_first;
+                table->length[next_code] = table->length[prev_code] + 1;
+            }
+            next_code++;
+            if(next_code == (1 << code_size) && code_size < LZW_MAXBITS) code_size++;
         }
-        frm_off += str_len;
-        if(key < table->nentries - 1 && !table_is_full)
-            table->entries[table->nentries - 1].suffix = entry.suffix;
+        prev_code = code;
     }
+
+#if !LV_GIF_CACHE_DECODE_DATA
     lv_free(table);
-    if(key == stop) f_gif_read(gif, &sub_len, 1);  /* Must be zero! */
+#endif
     f_gif_seek(gif, end, LV_FS_SEEK_SET);
-    return 0;
+    return ret;
 }
 
-#endif
-
 /* Read image.
  * Return 0 on success or -1 on out-of-memory (w.r.t. LZW code table) or parse error. */
 static int
@@ -653,10 +585,58 @@ read_image(gd_GIF * gif)
     }
     else
         gif->palette = &gif->gct;
+    convert_palette(gif);
     /* Image Data. */
     return read_image_data(gif, interlace);
 }
 
+/* Expand palette indices of one row. Four pixels per step; the Xtensa PIE has no
+ * table gather, so the same word-wide loop serves as the fast path on every target. */
+static inline void
+expand_row(uint32_t * dst, const uint8_t * src, int w, const uint32_t * palette)
+{
+    int k = 0;
+
+    for(; k + 4 <= w; k += 4) {
+        dst[k + 0] = palette[src[k + 0]];
+        dst[k + 1] = palette[src[k + 1]];
+        dst[k + 2] = palette[src[k + 2]];
+        dst[k + 3] = palette[src[k + 3]];
+    }
+    for(; k < w; k++) {
+        dst[k] = palette[src[k]];
+    }
+}
+
+/* Same as expand_row, but pixels equal to `tindex` keep the canvas value. Groups of
+ * four indices without the transparent index are detected with one word compare. */
+static inline void
+expand_row_keyed(uint32_t * dst, const uint8_t * src, int w, const uint32_t * palette, uint8_t tindex)
+{
+    const uint32_t key = tindex * 0x01010101U;
+    int k = 0;
+
+    for(; k + 4 <= w; k += 4) {
+        uint32_t word;
+        memcpy(&word, &src[k], sizeof(word));
+        word ^= key;
+        if(((word - 0x01010101U) & ~word & 0x80808080U) == 0) {
+            dst[k + 0] = palette[src[k + 0]];
+            dst[k + 1] = palette[src[k + 1]];
+            dst[k + 2] = palette[src[k + 2]];
+            dst[k + 3] = palette[src[k + 3]];
+            continue;
+        }
+        if(src[k + 0] != tindex) dst[k + 0] = palette[src[k + 0]];
+        if(src[k + 1] != tindex) dst[k + 1] = palette[src[k + 1]];
+        if(src[k + 2] != tindex) dst[k + 2] = palette[src[k + 2]];
+        if(src[k + 3] != tindex) dst[k + 3] = palette[src[k + 3]];
+    }
+    for(; k < w; k++) {
+        if(src[k] != tindex) dst[k] = palette[src[k]];
+    }
+}
+
 static void
 render_frame_rect(gd_GIF * gif, uint8_t * buffer)
 {
@@ -666,21 +646,17 @@ render_frame_rect(gd_GIF * gif, uint8_t * buffer)
                         &gif->frame[i], gif->palette->colors,
                         gif->gce.transparency ? gif->gce.tindex : 0x100);
 #else
-    int j, k;
-    uint8_t index, * color;
+    int j;
+    const uint8_t * src = &gif->frame[i];
+    uint32_t * dst = (uint32_t *) &buffer[i * 4];
 
     for(j = 0; j < gif->fh; j++) {
-        for(k = 0; k < gif->fw; k++) {
-            index = gif->frame[(gif->fy + j) * gif->width + gif->fx + k];
-            color = &gif->palette->colors[index * 3];
-            if(!gif->gce.transparency || index != gif->gce.tindex) {
-                buffer[(i + k) * 4 + 0] = *(color + 2);
-                buffer[(i + k) * 4 + 1] = *(color + 1);
-                buffer[(i + k) * 4 + 2] = *(color + 0);
-                buffer[(i + k) * 4 + 3] = 0xFF;
-            }
-        }
-        i += gif->width;
+        if(gif->gce.transparency)
+            expand_row_keyed(dst, src, gif->fw, gif->palette_argb, gif->gce.tindex);
+        else
+            expand_row(dst, src, gif->fw, gif->palette_argb);
+        src += gif->width;
+        dst += gif->width;
     }
 #endif
 }
@@ -701,16 +677,8 @@ dispose(gd_GIF * gif)
 #ifdef GIFDEC_FILL_BG
             GIFDEC_FILL_BG(&(gif->canvas[i * 4]), gif->fw, gif->fh, gif->width, bgcolor, opa);
 #else
-            int j, k;
-            for(j = 0; j < gif->fh; j++) {
-                for(k = 0; k < gif->fw; k++) {
-                    gif->canvas[(i + k) * 4 + 0] = *(bgcolor + 2);
-                    gif->canvas[(i + k) * 4 + 1] = *(bgcolor + 1);
-                    gif->canvas[(i + k) * 4 + 2] = *(bgcolor + 0);
-                    gif->canvas[(i + k) * 4 + 3] = opa;
-                }
-                i += gif->width;
-            }
+            fill_pixels((uint32_t *) &gif->canvas[i * 4], gif->fw, gif->fh, gif->width,
+                        make_pixel(bgcolor, opa));
 #endif
             break;
         case 3: /* Restore to previous, i.e., don't update canvas.*/
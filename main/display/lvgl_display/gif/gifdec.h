@@ -36,6 +36,9 @@ typedef struct _gd_GIF {
     gd_GCE gce;
     gd_Palette * palette;
     gd_Palette lct, gct;
+    /* Active palette converted to canvas pixels, see convert_palette() */
+    uint32_t palette_argb[0x100];
+    gd_Palette * converted_palette;
     void (*plain_text)(
         struct _gd_GIF * gif, uint16_t tx, uint16_t ty,
         uint16_t tw, uint16_t th, uint8_t cw, uint8_t ch,
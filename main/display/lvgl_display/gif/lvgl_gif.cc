@@ -4,14 +4,44 @@
 
 #define TAG "LvglGif"
 
-LvglGif::LvglGif(const lv_img_dsc_t* img_dsc)
-    : gif_(nullptr), timer_(nullptr), last_call_(0), playing_(false), loaded_(false),
+LvglGif::LvglGif(const lv_img_dsc_t* img_dsc, const char* cache_key)
+    : gif_(nullptr), clip_canvas_(nullptr), clip_index_(0), clip_loops_(-1), clip_finished_(false),
+      timer_(nullptr), last_call_(0), playing_(false), loaded_(false),
       loop_delay_ms_(0), loop_waiting_(false), loop_wait_start_(0) {
     if (!img_dsc || !img_dsc->data) {
         ESP_LOGE(TAG, "Invalid image descriptor");
         return;
     }
 
+    if (cache_key != nullptr) {
+        clip_ = GifFrameCache::GetInstance().Acquire(cache_key, img_dsc);
+        if (clip_) {
+            clip_canvas_ = static_cast<uint8_t*>(lv_malloc(clip_->canvas_size()));
+            if (!clip_canvas_) {
+                ESP_LOGW(TAG, "Failed to allocate canvas for cached GIF, decoding live");
+                clip_.reset();
+            }
+        }
+    }
+
+    if (clip_) {
+        memset(&img_dsc_, 0, sizeof(img_dsc_));
+        img_dsc_.header.magic = LV_IMAGE_HEADER_MAGIC;
+        img_dsc_.header.flags = LV_IMAGE_FLAGS_MODIFIABLE;
+        img_dsc_.header.cf = clip_->color_format();
+        img_dsc_.header.w = clip_->width();
+        img_dsc_.header.h = clip_->height();
+        img_dsc_.header.stride = clip_->width() * 2;
+        img_dsc_.data = clip_canvas_;
+        img_dsc_.data_size = clip_->canvas_size();
+
+        RewindClip();
+        loaded_ = true;
+        ESP_LOGD(TAG, "GIF loaded from frame cache: %dx%d, %u frames",
+            clip_->width(), clip_->height(), (unsigned)clip_->frames().size());
+        return;
+    }
+
     gif_ = gd_open_gif_data(img_dsc->data);
     if (!gif_) {
         ESP_LOGE(TAG, "Failed to open GIF from image descriptor");
@@ -53,7 +83,7 @@ const lv_img_dsc_t* LvglGif::image_dsc() const {
 
 // Animation control methods
 void LvglGif::Start() {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         ESP_LOGW(TAG, "GIF not loaded, cannot start");
         return;
     }
@@ -71,7 +101,18 @@ void LvglGif::Start() {
         last_call_ = lv_tick_get();
         lv_timer_resume(timer_);
         lv_timer_reset(timer_);
-        
+
+        if (clip_) {
+            // The current cached frame is already on the canvas
+            if (clip_finished_) {
+                RewindClip();
+            }
+            if (frame_callback_) {
+                frame_callback_();
+            }
+            return;
+        }
+
         // Render first frame
         NextFrame();
         
@@ -88,7 +129,7 @@ void LvglGif::Pause() {
 }
 
 void LvglGif::Resume() {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         ESP_LOGW(TAG, "GIF not loaded, cannot resume");
         return;
     }
@@ -109,7 +150,9 @@ void LvglGif::Stop() {
     // Reset loop waiting state
     loop_waiting_ = false;
 
-    if (gif_) {
+    if (clip_) {
+        RewindClip();
+    } else if (gif_) {
         gd_rewind(gif_);
         // Render first frame without advancing
         if (gif_->canvas) {
@@ -128,17 +171,24 @@ bool LvglGif::IsLoaded() const {
 }
 
 int32_t LvglGif::GetLoopCount() const {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         return -1;
     }
+    if (clip_) {
+        return clip_loops_;
+    }
     return gif_->loop_count;
 }
 
 void LvglGif::SetLoopCount(int32_t count) {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         ESP_LOGW(TAG, "GIF not loaded, cannot set loop count");
         return;
     }
+    if (clip_) {
+        clip_loops_ = count;
+        return;
+    }
     gif_->loop_count = count;
 }
 
@@ -152,17 +202,17 @@ void LvglGif::SetLoopDelay(uint32_t delay_ms) {
 }
 
 uint16_t LvglGif::width() const {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         return 0;
     }
-    return gif_->width;
+    return clip_ ? clip_->width() : gif_->width;
 }
 
 uint16_t LvglGif::height() const {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         return 0;
     }
-    return gif_->height;
+    return clip_ ? clip_->height() : gif_->height;
 }
 
 void LvglGif::SetFrameCallback(std::function<void()> callback) {
@@ -170,7 +220,7 @@ void LvglGif::SetFrameCallback(std::function<void()> callback) {
 }
 
 void LvglGif::NextFrame() {
-    if (!loaded_ || !gif_ || !playing_) {
+    if (!loaded_ || !playing_) {
         return;
     }
 
@@ -184,16 +234,27 @@ void LvglGif::NextFrame() {
         // Loop delay completed, continue playing
         loop_waiting_ = false;
         ESP_LOGD(TAG, "Loop delay completed, continuing GIF");
+        if (clip_) {
+            last_call_ = lv_tick_get();
+            ShowClipFrame(0);
+            return;
+        }
     }
 
     // Check if enough time has passed for the next frame
+    uint32_t delay_ms = clip_ ? clip_->frames()[clip_index_].delay_ms : gif_->gce.delay * 10;
     uint32_t elapsed = lv_tick_elaps(last_call_);
-    if (elapsed < gif_->gce.delay * 10) {
+    if (elapsed < delay_ms) {
         return;
     }
 
     last_call_ = lv_tick_get();
 
+    if (clip_) {
+        NextClipFrame();
+        return;
+    }
+
     // Save file position before getting next frame to detect loop
     uint32_t pos_before = gif_->f_rw_p;
 
@@ -231,6 +292,51 @@ void LvglGif::NextFrame() {
     }
 }
 
+void LvglGif::NextClipFrame() {
+    size_t next = clip_index_ + 1;
+    if (next < clip_->frames().size()) {
+        ShowClipFrame(next);
+        return;
+    }
+
+    // End of one cycle, same loop semantics as gd_get_frame
+    if (clip_loops_ == 1 || clip_loops_ < 0) {
+        playing_ = false;
+        clip_finished_ = true;
+        if (timer_) {
+            lv_timer_pause(timer_);
+        }
+        ESP_LOGD(TAG, "GIF animation completed");
+        return;
+    }
+    if (clip_loops_ > 1) {
+        clip_loops_--;
+    }
+
+    if (loop_delay_ms_ > 0) {
+        loop_waiting_ = true;
+        loop_wait_start_ = lv_tick_get();
+        ESP_LOGD(TAG, "GIF completed one cycle, waiting %lu ms before next loop", loop_delay_ms_);
+        return;
+    }
+    ShowClipFrame(0);
+}
+
+void LvglGif::ShowClipFrame(size_t index) {
+    clip_index_ = index;
+    clip_->ApplyFrame(index, clip_canvas_);
+    if (frame_callback_) {
+        frame_callback_();
+    }
+}
+
+void LvglGif::RewindClip() {
+    clip_index_ = 0;
+    clip_loops_ = clip_->loop_count();
+    clip_finished_ = false;
+    clip_->ApplyFrame(0, clip_canvas_);
+}
+
 void LvglGif::Cleanup() {
     // Stop and delete timer
     if (timer_) {
@@ -244,6 +350,13 @@ void LvglGif::Cleanup() {
         gif_ = nullptr;
     }
 
+    // Release cached frames
+    clip_.reset();
+    if (clip_canvas_) {
+        lv_free(clip_canvas_);
+        clip_canvas_ = nullptr;
+    }
+
     playing_ = false;
     loaded_ = false;
     
@@ -2,6 +2,7 @@
 
 #include "../lvgl_image.h"
 #include "gifdec.h"
+#include "gif_frame_cache.h"
 #include <lvgl.h>
 #include <memory>
 #include <functional>
@@ -12,7 +13,12 @@
  */
 class LvglGif {
 public:
-    explicit LvglGif(const lv_img_dsc_t* img_dsc);
+    /**
+     * @param cache_key When set, frames are taken from GifFrameCache under this key and
+     *                  replayed as RGB565/RGB565A8 without LZW decoding. Falls back to
+     *                  live decoding if the clip cannot be cached.
+     */
+    explicit LvglGif(const lv_img_dsc_t* img_dsc, const char* cache_key = nullptr);
     virtual ~LvglGif();
 
     // LvglImage interface implementation
@@ -81,8 +87,15 @@ public:
     void SetFrameCallback(std::function<void()> callback);
 
 private:
-    // GIF decoder instance
+    // GIF decoder instance (live decoding)
     gd_GIF* gif_;
+
+    // Pre-decoded frames (cached playback)
+    std::shared_ptr<const GifClip> clip_;
+    uint8_t* clip_canvas_;
+    size_t clip_index_;
+    int32_t clip_loops_;
+    bool clip_finished_;
     
     // LVGL image descriptor
     lv_img_dsc_t img_dsc_;
@@ -109,6 +122,21 @@ private:
      * Update to next frame
      */
     void NextFrame();
+
+    /**
+     * Advance cached playback by one frame
+     */
+    void NextClipFrame();
+
+    /**
+     * Copy a cached frame into the canvas and notify the frame callback
+     */
+    void ShowClipFrame(size_t index);
+
+    /**
+     * Rewind cached playback to the first frame
+     */
+    void RewindClip();
     
     /**
      * Cleanup resources
@@ -27,169 +27,57 @@ static void* malloc_psram(size_t size) {
 #endif
 }
 
-static __always_inline uint8_t expand_5_to_8(uint8_t v) {
-    return (uint8_t)((v << 3) | (v >> 2));
+static int bytes_per_pixel(v4l2_pix_fmt_t format) {
+    switch (format) {
+        case V4L2_PIX_FMT_GREY:
+            return 1;
+        case V4L2_PIX_FMT_RGB24:
+            return 3;
+        case V4L2_PIX_FMT_RGB565:
+        case V4L2_PIX_FMT_RGB565X:
+        case V4L2_PIX_FMT_YUYV:
+        case V4L2_PIX_FMT_UYVY:
+        case V4L2_PIX_FMT_YUV422P:  // 按 Y 平面计算，U/V 平面各占一半
+            return 2;
+        default:
+            return 0;
+    }
 }
 
-static __always_inline uint8_t expand_6_to_8(uint8_t v) {
-    return (uint8_t)((v << 2) | (v >> 4));
+static __always_inline uint32_t load_u32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
 }
 
-static uint8_t* convert_input_to_encoder_buf(const uint8_t* src, uint16_t width, uint16_t height, v4l2_pix_fmt_t format,
-                                             jpeg_pixel_format_t* out_fmt, int* out_size) {
-    // GRAY 直接作为 JPEG_PIXEL_FORMAT_GRAY 输入
-    if (format == V4L2_PIX_FMT_GREY) {
-        int sz = (int)width * (int)height;
-        uint8_t* buf = (uint8_t*)jpeg_calloc_align(sz, 16);
-        if (!buf)
-            return NULL;
-        memcpy(buf, src, sz);
-        if (out_fmt)
-            *out_fmt = JPEG_PIXEL_FORMAT_GRAY;
-        if (out_size)
-            *out_size = sz;
-        return buf;
-    }
-
-    // V4L2 YUYV (Y Cb Y Cr) 可直接作为 JPEG_PIXEL_FORMAT_YCbYCr 输入
-    if (format == V4L2_PIX_FMT_YUYV) {
-        int sz = (int)width * (int)height * 2;
-        uint8_t* buf = (uint8_t*)jpeg_calloc_align(sz, 16);
-        if (!buf)
-            return NULL;
-        memcpy(buf, src, sz);
-        if (out_fmt)
-            *out_fmt = JPEG_PIXEL_FORMAT_YCbYCr;
-        if (out_size)
-            *out_size = sz;
-        return buf;
-    }
+static __always_inline void store_u32(uint8_t* p, uint32_t v) {
+    memcpy(p, &v, sizeof(v));
+}
 
-    // V4L2 UYVY (Cb Y Cr Y) -> 重排为 YUYV 再作为 YCbYCr 输入
-    // 当前版本暂时不会出现 UYVY 格式
-    if (format == V4L2_PIX_FMT_UYVY) [[unlikely]] {
-        int sz = (int)width * (int)height * 2;
-        const uint8_t* s = src;
-        uint8_t* buf = (uint8_t*)jpeg_calloc_align(sz, 16);
-        if (!buf)
-            return NULL;
-        uint8_t* d = buf;
-        for (int i = 0; i < sz; i += 4) {
-            // src: Cb, Y0, Cr, Y1 -> dst: Y0, Cb, Y1, Cr
-            d[0] = s[1];
-            d[1] = s[0];
-            d[2] = s[3];
-            d[3] = s[2];
-            s += 4;
-            d += 4;
-        }
-        if (out_fmt)
-            *out_fmt = JPEG_PIXEL_FORMAT_YCbYCr;
-        if (out_size)
-            *out_size = sz;
-        return buf;
+// UYVY (Cb Y0 Cr Y1) -> YUYV (Y0 Cb Y1 Cr)，即每个 16 位字交换字节，一次处理 4 个像素
+static void uyvy_to_yuyv(const uint8_t* src, uint8_t* dst, size_t len) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint32_t a = load_u32(src + i);
+        uint32_t b = load_u32(src + i + 4);
+        store_u32(dst + i, ((a & 0x00FF00FF) << 8) | ((a >> 8) & 0x00FF00FF));
+        store_u32(dst + i + 4, ((b & 0x00FF00FF) << 8) | ((b >> 8) & 0x00FF00FF));
     }
-
-    // V4L2 YUV422P (YUV422 Planar) -> 重排为 YUYV (YCbYCr)
-    // 当前版本暂时不会出现 YUV422P 格式
-    if (format == V4L2_PIX_FMT_YUV422P) [[unlikely]] {
-        int sz = (int)width * (int)height * 2;
-        const uint8_t* y_plane = src;
-        const uint8_t* u_plane = y_plane + (int)width * (int)height;
-        const uint8_t* v_plane = u_plane + ((int)width / 2) * (int)height;
-        uint8_t* buf = (uint8_t*)jpeg_calloc_align(sz, 16);
-        if (!buf)
-            return NULL;
-        uint8_t* dst = buf;
-        for (int y = 0; y < height; y++) {
-            const uint8_t* y_row = y_plane + y * (int)width;
-            const uint8_t* u_row = u_plane + y * ((int)width / 2);
-            const uint8_t* v_row = v_plane + y * ((int)width / 2);
-            for (int x = 0; x < width; x += 2) {
-                uint8_t y0 = y_row[x + 0];
-                uint8_t y1 = y_row[x + 1];
-                uint8_t cb = u_row[x / 2];
-                uint8_t cr = v_row[x / 2];
-                dst[0] = y0;
-                dst[1] = cb;
-                dst[2] = y1;
-                dst[3] = cr;
-                dst += 4;
-            }
-        }
-        if (out_fmt)
-            *out_fmt = JPEG_PIXEL_FORMAT_YCbYCr;
-        if (out_size)
-            *out_size = sz;
-        return buf;
+    for (; i + 4 <= len; i += 4) {
+        uint32_t a = load_u32(src + i);
+        store_u32(dst + i, ((a & 0x00FF00FF) << 8) | ((a >> 8) & 0x00FF00FF));
     }
+}
 
-    // RGB 转换为 YUV422 (YCbYCr) 再输入
-    // 见 https://github.com/78/xiaozhi-esp32/issues/1380#issuecomment-3497156378
-    else if (format == V4L2_PIX_FMT_RGB24 || format == V4L2_PIX_FMT_RGB565 || format == V4L2_PIX_FMT_RGB565X) {
-        esp_imgfx_pixel_fmt_t in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB888;
-        uint32_t src_len = 0;
-        switch (format) {
-            case V4L2_PIX_FMT_RGB24:
-                in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB888;
-                src_len = static_cast<uint32_t>(width * height * 3);
-                break;
-            case V4L2_PIX_FMT_RGB565:
-                in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_LE;
-                src_len = static_cast<uint32_t>(width * height * 2);
-                break;
-            [[unlikely]] case V4L2_PIX_FMT_RGB565X: // 当前版本暂时不会出现 RGB565X
-                in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_BE;
-                src_len = static_cast<uint32_t>(width * height * 2);
-                break;
-            [[unlikely]] default:
-                ESP_LOGE(TAG, "[Unreachable Case] unsupported format: 0x%08lx", format);
-                std::unreachable();
-        }
-        int sz = (int)width * (int)height * 2;
-        uint8_t* buf = (uint8_t*)jpeg_calloc_align(sz, 16);
-        if (!buf)
-            return nullptr;
-        esp_imgfx_color_convert_cfg_t convert_cfg = {
-            .in_res = {.width = static_cast<int16_t>(width),
-                        .height = static_cast<int16_t>(height)},
-            .in_pixel_fmt = in_pixel_fmt,
-            .out_pixel_fmt = ESP_IMGFX_PIXEL_FMT_YUYV,
-            .color_space_std = ESP_IMGFX_COLOR_SPACE_STD_BT601,
-        };
-        esp_imgfx_color_convert_handle_t convert_handle = nullptr;
-        esp_imgfx_err_t err = esp_imgfx_color_convert_open(&convert_cfg, &convert_handle);
-        if (err != ESP_IMGFX_ERR_OK || convert_handle == nullptr) {
-            ESP_LOGE(TAG, "esp_imgfx_color_convert_open failed");
-            jpeg_free_align(buf);
-            return nullptr;
-        }
-        esp_imgfx_data_t convert_input_data = {
-            .data = const_cast<uint8_t*>(src),
-            .data_len = static_cast<uint32_t>(src_len),
-        };
-        esp_imgfx_data_t convert_output_data = {
-            .data = buf,
-            .data_len = static_cast<uint32_t>(sz),
-        };
-        err = esp_imgfx_color_convert_process(convert_handle, &convert_input_data, &convert_output_data);
-        if (err != ESP_IMGFX_ERR_OK) {
-            ESP_LOGE(TAG, "esp_imgfx_color_convert_process failed");
-            jpeg_free_align(buf);
-            return nullptr;
-        }
-        esp_imgfx_color_convert_close(convert_handle);
-        convert_handle = nullptr;
-        if (out_fmt)
-            *out_fmt = JPEG_PIXEL_FORMAT_YCbYCr;
-        if (out_size)
-            *out_size = sz;
-        return buf;
+// YUV422P 的一行 -> YUYV，每两个像素拼成一个 32 位字写出（小端）
+static void yuv422p_row_to_yuyv(const uint8_t* y_row, const uint8_t* u_row, const uint8_t* v_row, uint8_t* dst,
+                                int width) {
+    for (int x = 0; x + 1 < width; x += 2) {
+        uint32_t v = (uint32_t)y_row[x] | ((uint32_t)u_row[x / 2] << 8) | ((uint32_t)y_row[x + 1] << 16) |
+                     ((uint32_t)v_row[x / 2] << 24);
+        store_u32(dst, v);
+        dst += 4;
     }
-    ESP_LOGE(TAG, "unsupported format: 0x%08lx", format);
-    if (out_size)
-        *out_size = 0;
-    return nullptr;
 }
 
 #if CONFIG_XIAOZHI_ENABLE_HARDWARE_JPEG_ENCODER
@@ -255,6 +143,23 @@ static uint8_t* convert_input_to_hw_encoder_buf(const uint8_t* src, uint16_t wid
         return buf;
     }
 
+    if (format == V4L2_PIX_FMT_RGB565X) {
+        // 硬件只接受小端 RGB565，大端的 RGB565X 需要 bswap16（LVGL 截图即为此格式）
+        int sz = (int)width * (int)height * 2;
+        uint16_t* buf = (uint16_t*)malloc_psram(sz);
+        if (!buf)
+            return NULL;
+        const uint16_t* bsrc = (const uint16_t*)src;
+        for (int i = 0; i < sz / 2; i++) {
+            buf[i] = __builtin_bswap16(bsrc[i]);
+        }
+        if (out_fmt)
+            *out_fmt = JPEG_ENCODE_IN_FORMAT_RGB565;
+        if (out_size)
+            *out_size = sz;
+        return (uint8_t*)buf;
+    }
+
     if (format == V4L2_PIX_FMT_YUYV) {
         // 硬件需要 | Y1 V Y0 U | 的“大端”格式，因此需要 bswap16
         int sz = (int)width * (int)height * 2;
@@ -275,9 +180,10 @@ static uint8_t* convert_input_to_hw_encoder_buf(const uint8_t* src, uint16_t wid
     return NULL;
 }
 
+// 输出回调拒收数据时置位 *cb_rejected，此时调用方不应再回退到软件编码重复输出
 static bool encode_with_hw_jpeg(const uint8_t* src, size_t src_len, uint16_t width, uint16_t height,
                                 v4l2_pix_fmt_t format, uint8_t quality, uint8_t** jpg_out, size_t* jpg_out_len,
-                                jpg_out_cb cb, void* cb_arg) {
+                                jpg_out_cb cb, void* cb_arg, bool* cb_rejected) {
     if (quality < 1)
         quality = 1;
     if (quality > 100)
@@ -326,7 +232,12 @@ static bool encode_with_hw_jpeg(const uint8_t* src, size_t src_len, uint16_t wid
     }
 
     if (cb) {
-        cb(cb_arg, 0, outbuf, (size_t)out_len);
+        if (cb(cb_arg, 0, outbuf, (size_t)out_len) < out_len) {
+            ESP_LOGW(TAG, "hw jpeg: output callback aborted");
+            free(outbuf);
+            *cb_rejected = true;
+            return false;
+        }
         cb(cb_arg, 1, NULL, 0);
         free(outbuf);
         if (jpg_out)
@@ -347,21 +258,30 @@ static bool encode_with_hw_jpeg(const uint8_t* src, size_t src_len, uint16_t wid
 }
 #endif // CONFIG_XIAOZHI_ENABLE_HARDWARE_JPEG_ENCODER
 
-static bool encode_with_esp_new_jpeg(const uint8_t* src, size_t src_len, uint16_t width, uint16_t height,
+// 软件编码器的输入：内存中的完整图像，或按行回调提供的数据
+struct jpeg_row_source {
+    const uint8_t* src;
+    jpg_rows_cb rows_cb;
+    void* rows_arg;
+};
+
+// 按 MCU 行分块编码：每块只在需要时转换/拷贝一次，峰值内存为一个块而不是整帧
+static bool encode_with_esp_new_jpeg(const jpeg_row_source& source, uint16_t width, uint16_t height,
                                      v4l2_pix_fmt_t format, uint8_t quality, uint8_t** jpg_out, size_t* jpg_out_len,
                                      jpg_out_cb cb, void* cb_arg) {
+    int src_bpp = bytes_per_pixel(format);
+    if (src_bpp == 0 || (format == V4L2_PIX_FMT_YUV422P && source.src == nullptr)) {
+        ESP_LOGE(TAG, "unsupported format: 0x%08lx", format);
+        return false;
+    }
     if (quality < 1)
         quality = 1;
     if (quality > 100)
         quality = 100;
 
-    jpeg_pixel_format_t enc_src_type = JPEG_PIXEL_FORMAT_RGB888;
-    int enc_in_size = 0;
-    uint8_t* enc_in = convert_input_to_encoder_buf(src, width, height, format, &enc_src_type, &enc_in_size);
-    if (!enc_in) {
-        ESP_LOGE(TAG, "alloc/convert input failed");
-        return false;
-    }
+    // GRAY 与 YUYV 可直接作为编码器输入，其余格式按块转换为 YUYV (YCbYCr)
+    bool direct = (format == V4L2_PIX_FMT_GREY || format == V4L2_PIX_FMT_YUYV);
+    jpeg_pixel_format_t enc_src_type = (format == V4L2_PIX_FMT_GREY) ? JPEG_PIXEL_FORMAT_GRAY : JPEG_PIXEL_FORMAT_YCbYCr;
 
     jpeg_enc_config_t cfg = DEFAULT_JPEG_ENC_CONFIG();
     cfg.width = width;
@@ -375,36 +295,154 @@ static bool encode_with_esp_new_jpeg(const uint8_t* src, size_t src_len, uint16_
     jpeg_enc_handle_t h = NULL;
     jpeg_error_t ret = jpeg_enc_open(&cfg, &h);
     if (ret != JPEG_ERR_OK) {
-        jpeg_free_align(enc_in);
         ESP_LOGE(TAG, "jpeg_enc_open failed: %d", (int)ret);
         return false;
     }
 
-    // 估算输出缓冲区：宽高的 1.5 倍 + 64KB
-    size_t out_cap = (size_t)width * (size_t)height * 3 / 2 + 64 * 1024;
-    if (out_cap < 128 * 1024)
-        out_cap = 128 * 1024;
+    // 每块为整数个 MCU 行 (GRAY 8 行, YUV420 16 行)
+    int block_size = jpeg_enc_get_block_size(h);
+    int block_rows = block_size / ((int)width * (enc_src_type == JPEG_PIXEL_FORMAT_GRAY ? 1 : 2));
+    size_t src_stride = (size_t)width * src_bpp;
+
+    // 内存输入且 16 字节对齐时，直接格式的完整块不经拷贝送入编码器
+    bool zero_copy = direct && source.src != nullptr && ((uintptr_t)source.src & 15) == 0 &&
+                     (src_stride * block_rows) % 16 == 0;
+    bool need_band = !direct && (source.src == nullptr || height % block_rows != 0);
+    uint8_t* block = (uint8_t*)jpeg_calloc_align(block_size, 16);
+    uint8_t* band = need_band ? (uint8_t*)jpeg_calloc_align(src_stride * block_rows, 16) : nullptr;
+
+    // 回调输出只需容纳一个块的编码结果（首块还包含文件头）；否则按整图估算：宽高的 1.5 倍 + 64KB
+    size_t out_cap;
+    if (cb) {
+        out_cap = (size_t)block_size * 2 + 2048;
+    } else {
+        out_cap = (size_t)width * (size_t)height * 3 / 2 + 64 * 1024;
+        if (out_cap < 128 * 1024)
+            out_cap = 128 * 1024;
+    }
     uint8_t* outbuf = (uint8_t*)malloc_psram(out_cap);
-    if (!outbuf) {
-        jpeg_enc_close(h);
-        jpeg_free_align(enc_in);
-        ESP_LOGE(TAG, "alloc out buffer failed");
-        return false;
+
+    esp_imgfx_color_convert_handle_t convert_handle = nullptr;
+    bool ok = block != nullptr && outbuf != nullptr && (!need_band || band != nullptr);
+    if (!ok) {
+        ESP_LOGE(TAG, "alloc buffers failed");
     }
 
-    int out_len = 0;
-    ret = jpeg_enc_process(h, enc_in, enc_in_size, outbuf, (int)out_cap, &out_len);
+    // RGB 由 esp_imgfx 转换（S3/P4 上为 SIMD 实现），按块高度打开一次，逐块复用
+    // 见 https://github.com/78/xiaozhi-esp32/issues/1380#issuecomment-3497156378
+    if (ok && (format == V4L2_PIX_FMT_RGB24 || format == V4L2_PIX_FMT_RGB565 || format == V4L2_PIX_FMT_RGB565X)) {
+        esp_imgfx_color_convert_cfg_t convert_cfg = {
+            .in_res = {.width = static_cast<int16_t>(width),
+                        .height = static_cast<int16_t>(block_rows)},
+            .in_pixel_fmt = format == V4L2_PIX_FMT_RGB24    ? ESP_IMGFX_PIXEL_FMT_RGB888
+                            : format == V4L2_PIX_FMT_RGB565 ? ESP_IMGFX_PIXEL_FMT_RGB565_LE
+                                                            : ESP_IMGFX_PIXEL_FMT_RGB565_BE,
+            .out_pixel_fmt = ESP_IMGFX_PIXEL_FMT_YUYV,
+            .color_space_std = ESP_IMGFX_COLOR_SPACE_STD_BT601,
+        };
+        if (esp_imgfx_color_convert_open(&convert_cfg, &convert_handle) != ESP_IMGFX_ERR_OK || convert_handle == nullptr) {
+            ESP_LOGE(TAG, "esp_imgfx_color_convert_open failed");
+            ok = false;
+        }
+    }
+
+    size_t out_len = 0;
+    for (int y = 0; ok && y < height; y += block_rows) {
+        int rows = height - y < block_rows ? height - y : block_rows;
+        const uint8_t* enc_in = block;
+
+        if (format == V4L2_PIX_FMT_YUV422P) {
+            // 当前版本暂时不会出现 YUV422P 格式
+            const uint8_t* u_plane = source.src + (size_t)width * height;
+            const uint8_t* v_plane = u_plane + (size_t)(width / 2) * height;
+            for (int r = 0; r < block_rows; r++) {
+                int sy = y + (r < rows ? r : rows - 1);
+                yuv422p_row_to_yuyv(source.src + (size_t)sy * width, u_plane + (size_t)sy * (width / 2),
+                                    v_plane + (size_t)sy * (width / 2), block + (size_t)r * width * 2, width);
+            }
+        } else {
+            // 内存输入的完整块直接读取源图像；回调输入和不足 MCU 高度的最后一块写入条带缓冲区（直接格式写入编码块）
+            const uint8_t* rows_in;
+            if (source.src != nullptr && rows == block_rows) {
+                rows_in = source.src + (size_t)y * src_stride;
+            } else {
+                uint8_t* fill = direct ? block : band;
+                if (source.src != nullptr) {
+                    memcpy(fill, source.src + (size_t)y * src_stride, src_stride * rows);
+                } else if (!source.rows_cb(source.rows_arg, (uint16_t)y, (uint16_t)rows, fill, src_stride)) {
+                    ESP_LOGW(TAG, "rows: source aborted at row %d", y);
+                    ok = false;
+                    break;
+                }
+                // 重复最后一行补齐，编码器会按图像高度裁掉
+                for (int r = rows; r < block_rows; r++) {
+                    memcpy(fill + r * src_stride, fill + (rows - 1) * src_stride, src_stride);
+                }
+                rows_in = fill;
+            }
+
+            if (direct) {
+                if (rows_in == block || zero_copy) {
+                    enc_in = rows_in;
+                } else {
+                    memcpy(block, rows_in, block_size);
+                }
+            } else if (convert_handle != nullptr) {
+                esp_imgfx_data_t convert_input_data = {
+                    .data = const_cast<uint8_t*>(rows_in),
+                    .data_len = static_cast<uint32_t>(src_stride * block_rows),
+                };
+                esp_imgfx_data_t convert_output_data = {
+                    .data = block,
+                    .data_len = static_cast<uint32_t>(block_size),
+                };
+                if (esp_imgfx_color_convert_process(convert_handle, &convert_input_data, &convert_output_data) != ESP_IMGFX_ERR_OK) {
+                    ESP_LOGE(TAG, "esp_imgfx_color_convert_process failed");
+                    ok = false;
+                    break;
+                }
+            } else {
+                // V4L2 UYVY -> YUYV，当前版本暂时不会出现 UYVY 格式
+                uyvy_to_yuyv(rows_in, block, block_size);
+            }
+        }
+
+        int len = 0;
+        uint8_t* dst = cb ? outbuf : outbuf + out_len;
+        ret = jpeg_enc_process_with_block(h, enc_in, block_size, dst, (int)(cb ? out_cap : out_cap - out_len), &len);
+        if (ret < JPEG_ERR_OK) {
+            ESP_LOGE(TAG, "jpeg_enc_process_with_block failed: %d", (int)ret);
+            ok = false;
+            break;
+        }
+        if (cb) {
+            if (len > 0 && cb(cb_arg, 0, outbuf, (size_t)len) < (size_t)len) {
+                ESP_LOGW(TAG, "output callback aborted at row %d", y);
+                ok = false;
+                break;
+            }
+        } else {
+            out_len += len;
+        }
+    }
+
+    if (convert_handle != nullptr) {
+        esp_imgfx_color_convert_close(convert_handle);
+    }
     jpeg_enc_close(h);
-    jpeg_free_align(enc_in);
+    if (band != nullptr) {
+        jpeg_free_align(band);
+    }
+    if (block != nullptr) {
+        jpeg_free_align(block);
+    }
 
-    if (ret != JPEG_ERR_OK) {
+    if (!ok) {
         free(outbuf);
-        ESP_LOGE(TAG, "jpeg_enc_process failed: %d", (int)ret);
         return false;
     }
 
     if (cb) {
-        cb(cb_arg, 0, outbuf, (size_t)out_len);
         cb(cb_arg, 1, NULL, 0);  // 结束信号
         free(outbuf);
         if (jpg_out)
@@ -416,7 +454,7 @@ static bool encode_with_esp_new_jpeg(const uint8_t* src, size_t src_len, uint16_
 
     if (jpg_out && jpg_out_len) {
         *jpg_out = outbuf;
-        *jpg_out_len = (size_t)out_len;
+        *jpg_out_len = out_len;
         return true;
     }
 
@@ -440,28 +478,46 @@ bool image_to_jpeg(uint8_t* src, size_t src_len, uint16_t width, uint16_t height
     }
 #endif // CONFIG_XIAOZHI_CAMERA_ALLOW_JPEG_INPUT
 #if CONFIG_XIAOZHI_ENABLE_HARDWARE_JPEG_ENCODER
-    if (encode_with_hw_jpeg(src, src_len, width, height, format, quality, out, out_len, NULL, NULL)) {
+    bool cb_rejected = false;
+    if (encode_with_hw_jpeg(src, src_len, width, height, format, quality, out, out_len, NULL, NULL, &cb_rejected)) {
         return true;
     }
     // Fallback to esp_new_jpeg
 #endif
-    return encode_with_esp_new_jpeg(src, src_len, width, height, format, quality, out, out_len, NULL, NULL);
+    jpeg_row_source source = {src, nullptr, nullptr};
+    return encode_with_esp_new_jpeg(source, width, height, format, quality, out, out_len, NULL, NULL);
 }
 
 bool image_to_jpeg_cb(uint8_t* src, size_t src_len, uint16_t width, uint16_t height, v4l2_pix_fmt_t format,
                       uint8_t quality, jpg_out_cb cb, void* arg) {
 #ifdef CONFIG_XIAOZHI_CAMERA_ALLOW_JPEG_INPUT
     if (format == V4L2_PIX_FMT_JPEG) {
-        cb(arg, 0, src, src_len);
+        if (cb(arg, 0, src, src_len) < src_len) {
+            return false;
+        }
         cb(arg, 1, nullptr, 0); // end signal
         return true;
     }
 #endif // CONFIG_XIAOZHI_CAMERA_ALLOW_JPEG_INPUT
 #if CONFIG_XIAOZHI_ENABLE_HARDWARE_JPEG_ENCODER
-    if (encode_with_hw_jpeg(src, src_len, width, height, format, quality, NULL, NULL, cb, arg)) {
+    bool cb_rejected = false;
+    if (encode_with_hw_jpeg(src, src_len, width, height, format, quality, NULL, NULL, cb, arg, &cb_rejected)) {
         return true;
     }
+    if (cb_rejected) {
+        return false;
+    }
     // Fallback to esp_new_jpeg
 #endif
-    return encode_with_esp_new_jpeg(src, src_len, width, height, format, quality, NULL, NULL, cb, arg);
+    jpeg_row_source source = {src, nullptr, nullptr};
+    return encode_with_esp_new_jpeg(source, width, height, format, quality, NULL, NULL, cb, arg);
+}
+
+bool image_to_jpeg_rows_cb(uint16_t width, uint16_t height, v4l2_pix_fmt_t format, uint8_t quality,
+                           jpg_rows_cb rows_cb, void* rows_arg, jpg_out_cb cb, void* arg) {
+    if (rows_cb == nullptr || cb == nullptr) {
+        return false;
+    }
+    jpeg_row_source source = {nullptr, rows_cb, rows_arg};
+    return encode_with_esp_new_jpeg(source, width, height, format, quality, NULL, NULL, cb, arg);
 }
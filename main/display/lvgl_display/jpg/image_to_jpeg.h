@@ -32,7 +32,7 @@ extern "C"
 
     // JPEG输出回调函数类型
     // arg: 用户自定义参数, index: 当前数据索引, data: JPEG数据块, len: 数据块长度
-    // 返回: 实际处理的字节数
+    // 返回: 实际处理的字节数，小于 len 时编码中止并返回 false
     typedef size_t (*jpg_out_cb)(void *arg, size_t index, const void *data, size_t len);
 
     /**
@@ -79,6 +79,35 @@ extern "C"
     bool image_to_jpeg_cb(uint8_t *src, size_t src_len, uint16_t width, uint16_t height,
                           v4l2_pix_fmt_t format, uint8_t quality, jpg_out_cb cb, void *arg);
 
+    // JPEG输入行回调函数类型
+    // arg: 用户自定义参数, y: 起始行, rows: 行数, dst: 目标缓冲区, stride: 每行字节数
+    // 返回: true 继续编码, false 中止编码
+    typedef bool (*jpg_rows_cb)(void *arg, uint16_t y, uint16_t rows, uint8_t *dst, size_t stride);
+
+    /**
+     * @brief 按条带流式编码JPEG（行回调版本）
+     *
+     * 不需要完整的源图像缓冲区，编码器按 MCU 行高度分块向 rows_cb 请求源数据：
+     * - 只分配一个条带大小的输入缓冲区，峰值内存与图像高度无关
+     * - 颜色转换按条带进行，与编码交替执行
+     * - 每个条带编码完成后立即通过 cb 输出（index 为 0），结束时调用 cb(arg, 1, NULL, 0)
+     *
+     * 仅使用软件编码器；不支持 YUV422P 和 JPEG 输入。
+     *
+     * @param width     图像宽度
+     * @param height    图像高度
+     * @param format    rows_cb 写入的数据格式 (RGB565 / RGB565X / RGB24 / YUYV / UYVY / GREY)
+     * @param quality   JPEG质量 (1-100)
+     * @param rows_cb   源数据回调函数
+     * @param rows_arg  传递给 rows_cb 的用户参数
+     * @param cb        输出回调函数
+     * @param arg       传递给输出回调函数的用户参数
+     *
+     * @return true 成功, false 失败
+     */
+    bool image_to_jpeg_rows_cb(uint16_t width, uint16_t height, v4l2_pix_fmt_t format, uint8_t quality,
+                               jpg_rows_cb rows_cb, void *rows_arg, jpg_out_cb cb, void *arg);
+
 #ifdef __cplusplus
 }
 #endif
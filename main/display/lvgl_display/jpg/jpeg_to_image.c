@@ -20,8 +20,57 @@
 
 #define TAG "jpeg_to_image"
 
-static esp_err_t decode_with_new_jpeg(const uint8_t* src, size_t src_len, uint8_t** out, size_t* out_len, size_t* width,
-                                      size_t* height, size_t* stride) {
+// 选择最小的 IDCT 缩放比例 (1/2, 1/4, 1/8)，使解码结果仍不小于等比缩放到 fit_width x fit_height 内的尺寸
+// 解码器要求缩放后的宽高为 8 的倍数，不满足时退回更大的比例
+static int select_scale_shift(const uint8_t* src, size_t src_len, size_t fit_width, size_t fit_height,
+                              jpeg_resolution_t* scale) {
+    if (fit_width == 0 || fit_height == 0) {
+        return 0;
+    }
+
+    jpeg_dec_config_t config = DEFAULT_JPEG_DEC_CONFIG();
+    config.output_type = JPEG_PIXEL_FORMAT_RGB565_LE;
+    jpeg_dec_handle_t jpeg_dec = NULL;
+    if (jpeg_dec_open(&config, &jpeg_dec) != JPEG_ERR_OK) {
+        return 0;
+    }
+    jpeg_dec_io_t jpeg_io = {0};
+    jpeg_dec_header_info_t info = {0};
+    jpeg_io.inbuf = (uint8_t*)src;
+    jpeg_io.inbuf_len = (int)src_len;
+    jpeg_error_t jpeg_ret = jpeg_dec_parse_header(jpeg_dec, &jpeg_io, &info);
+    jpeg_dec_close(jpeg_dec);
+    if (jpeg_ret != JPEG_ERR_OK || info.width == 0 || info.height == 0) {
+        return 0;
+    }
+
+    // 等比缩放后的目标尺寸（不放大）
+    size_t target_w = info.width;
+    size_t target_h = info.height;
+    if (fit_width * info.height < fit_height * info.width) {
+        if (fit_width < target_w) {
+            target_w = fit_width;
+            target_h = (size_t)info.height * fit_width / info.width;
+        }
+    } else if (fit_height < target_h) {
+        target_h = fit_height;
+        target_w = (size_t)info.width * fit_height / info.height;
+    }
+
+    for (int shift = 3; shift > 0; shift--) {
+        int w = info.width >> shift;
+        int h = info.height >> shift;
+        if (w >= (int)target_w && h >= (int)target_h && (w % 8) == 0 && (h % 8) == 0) {
+            scale->width = w;
+            scale->height = h;
+            return shift;
+        }
+    }
+    return 0;
+}
+
+static esp_err_t decode_with_new_jpeg(const uint8_t* src, size_t src_len, size_t fit_width, size_t fit_height,
+                                      uint8_t** out, size_t* out_len, size_t* width, size_t* height, size_t* stride) {
     ESP_LOGD(TAG, "Decoding JPEG with software decoder");
     esp_err_t ret = ESP_OK;
     jpeg_error_t jpeg_ret = JPEG_ERR_OK;
@@ -32,6 +81,10 @@ static esp_err_t decode_with_new_jpeg(const uint8_t* src, size_t src_len, uint8_
     jpeg_dec_config_t config = DEFAULT_JPEG_DEC_CONFIG();
     config.output_type = JPEG_PIXEL_FORMAT_RGB565_LE;
     config.rotate = JPEG_ROTATE_0D;
+    int scale_shift = select_scale_shift(src, src_len, fit_width, fit_height, &config.scale);
+    if (scale_shift > 0) {
+        ESP_LOGD(TAG, "Decoding at 1/%d scale: %dx%d", 1 << scale_shift, config.scale.width, config.scale.height);
+    }
 
     jpeg_dec_handle_t jpeg_dec = NULL;
     jpeg_ret = jpeg_dec_open(&config, &jpeg_dec);
@@ -52,6 +105,10 @@ static esp_err_t decode_with_new_jpeg(const uint8_t* src, size_t src_len, uint8_
     }
 
     ESP_LOGD(TAG, "JPEG header info: width=%d, height=%d", out_info.width, out_info.height);
+    if (scale_shift > 0) {
+        out_info.width = config.scale.width;
+        out_info.height = config.scale.height;
+    }
 
     out_buf = jpeg_calloc_align(out_info.width * out_info.height * 2, 16);
     if (out_buf == NULL) {
@@ -260,5 +317,23 @@ esp_err_t jpeg_to_image(const uint8_t* src, size_t src_len, uint8_t** out, size_
     ESP_LOGW(TAG, "Failed to decode with hardware JPEG, fallback to software decoder");
     // Fallback to esp_new_jpeg
 #endif
-    return decode_with_new_jpeg(src, src_len, out, out_len, width, height, stride);
+    return decode_with_new_jpeg(src, src_len, 0, 0, out, out_len, width, height, stride);
+}
+
+esp_err_t jpeg_to_image_scaled(const uint8_t* src, size_t src_len, size_t fit_width, size_t fit_height, uint8_t** out,
+                               size_t* out_len, size_t* width, size_t* height, size_t* stride) {
+    if (src == NULL || src_len == 0 || out == NULL || out_len == NULL || width == NULL || height == NULL ||
+        stride == NULL) {
+        ESP_LOGE(TAG, "Invalid parameters");
+        return ESP_ERR_INVALID_ARG;
+    }
+#ifdef CONFIG_XIAOZHI_ENABLE_HARDWARE_JPEG_DECODER
+    // 硬件解码器不支持缩放，但整图解码仍比软件缩放解码快，由调用者 (PPA) 完成缩放
+    esp_err_t ret = decode_with_hardware_jpeg(src, src_len, out, out_len, width, height, stride);
+    if (ret == ESP_OK) {
+        return ret;
+    }
+    ESP_LOGW(TAG, "Failed to decode with hardware JPEG, fallback to software decoder");
+#endif
+    return decode_with_new_jpeg(src, src_len, fit_width, fit_height, out, out_len, width, height, stride);
 }
@@ -55,6 +55,23 @@ extern "C" {
 esp_err_t jpeg_to_image(const uint8_t* src, size_t src_len, uint8_t** out, size_t* out_len, size_t* width,
                         size_t* height, size_t* stride);
 
+/**
+ * @brief Decodes a JPEG image to RGB565 at a reduced scale
+ *
+ * Same as jpeg_to_image(), but the software decoder uses IDCT scaling: the image is decoded at the
+ * smallest of 1/1, 1/2, 1/4 and 1/8 of its size that still covers the image scaled (keeping the
+ * aspect ratio, never enlarged) to fit within fit_width x fit_height. The caller resizes the rest of
+ * the way, which is much cheaper than decoding at full size. The hardware decoder cannot scale, so
+ * its output is always full size.
+ *
+ * @param[in] fit_width Width of the box the image will be fitted into, 0 to decode at full size
+ * @param[in] fit_height Height of the box the image will be fitted into, 0 to decode at full size
+ *
+ * Other parameters and the return value are the same as jpeg_to_image().
+ */
+esp_err_t jpeg_to_image_scaled(const uint8_t* src, size_t src_len, size_t fit_width, size_t fit_height, uint8_t** out,
+                               size_t* out_len, size_t* width, size_t* height, size_t* stride);
+
 #ifdef __cplusplus
 }
 #endif
@@ -4,6 +4,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <font_awesome.h>
+#include <lvgl_private.h>
 
 #include "lvgl_display.h"
 #include "board.h"
@@ -80,11 +81,19 @@ void LvglDisplay::SetStatus(const char* status) {
         }
         return;
     }
-    lv_label_set_text(status_label_, status);
-    lv_obj_remove_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
-    lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
-
     last_status_update_time_ = std::chrono::system_clock::now();
+
+    // Setting the same text would still invalidate the label and flush it to the panel
+    if (strcmp(lv_label_get_text(status_label_), status) != 0) {
+        lv_label_set_text(status_label_, status);
+        status_bar_updates_++;
+    }
+    if (lv_obj_has_flag(status_label_, LV_OBJ_FLAG_HIDDEN)) {
+        lv_obj_remove_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
+    }
+    if (!lv_obj_has_flag(notification_label_, LV_OBJ_FLAG_HIDDEN)) {
+        lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
+    }
 }
 
 void LvglDisplay::ShowNotification(const std::string &notification, int duration_ms) {
@@ -115,24 +124,11 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
     auto& board = Board::GetInstance();
     auto codec = board.GetAudioCodec();
 
-    // Update mute icon
-    {
-        DisplayLockGuard lock(this);
-        if (mute_label_ == nullptr) {
-            return;
-        }
+    // Collect the new values without the display lock, then touch only the objects whose
+    // value differs from what is on screen, all in one lock so LVGL merges them into one refresh
+    bool muted = codec->output_volume() == 0;
 
-        // Update icon if mute state changes
-        if (codec->output_volume() == 0 && !muted_) {
-            muted_ = true;
-            lv_label_set_text(mute_label_, FONT_AWESOME_VOLUME_XMARK);
-        } else if (codec->output_volume() > 0 && muted_) {
-            muted_ = false;
-            lv_label_set_text(mute_label_, "");
-        }
-    }
-
-    // Update time
+    char time_str[16] = "";
     if (app.GetDeviceState() == kDeviceStateIdle) {
         if (last_status_update_time_ + std::chrono::seconds(10) < std::chrono::system_clock::now()) {
             // Set status to clock "HH:MM"
@@ -140,9 +136,7 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
             struct tm* tm = localtime(&now);
             // Check if the we have already set the time
             if (tm->tm_year >= 2025 - 1900) {
-                char time_str[16];
                 strftime(time_str, sizeof(time_str), "%H:%M", tm);
-                SetStatus(time_str);
             } else {
                 ESP_LOGW(TAG, "System time is not set, tm_year: %d", tm->tm_year);
             }
@@ -153,10 +147,11 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
     // Update battery icon
     int battery_level;
     bool charging, discharging;
-    const char* icon = nullptr;
-    if (board.GetBatteryLevel(battery_level, charging, discharging)) {
+    const char* battery_icon = nullptr;
+    bool has_battery = board.GetBatteryLevel(battery_level, charging, discharging);
+    if (has_battery) {
         if (charging) {
-            icon = FONT_AWESOME_BATTERY_BOLT;
+            battery_icon = FONT_AWESOME_BATTERY_BOLT;
         } else {
             const char* levels[] = {
                 FONT_AWESOME_BATTERY_EMPTY, // 0-19%
@@ -166,38 +161,16 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
                 FONT_AWESOME_BATTERY_FULL, // 80-99%
                 FONT_AWESOME_BATTERY_FULL, // 100%
             };
-            icon = levels[battery_level / 20];
-        }
-        DisplayLockGuard lock(this);
-        if (battery_label_ != nullptr && battery_icon_ != icon) {
-            battery_icon_ = icon;
-            lv_label_set_text(battery_label_, battery_icon_);
-        }
-
-        // Check low battery popup only when clock tick event is triggered
-        // Because when initializing, the battery level is not ready yet.
-        if (low_battery_popup_ != nullptr && !update_all) {
-            if (strcmp(icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging) {
-                if (lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // Show if low battery popup is hidden
-                    lv_obj_remove_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
-                    app.Schedule([&app]() {
-                        app.PlaySound(Lang::Sounds::OGG_LOW_BATTERY);
-                    });
-                }
-            } else {
-                // Hide the low battery popup when the battery is not empty
-                if (!lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // Hide if low battery popup is shown
-                    lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
-                }
-            }
+            battery_icon = levels[battery_level / 20];
         }
     }
 
     // Update network icon every 10 seconds
+    const char* network_icon = nullptr;
     static int seconds_counter = 0;
     if (update_all || seconds_counter++ % 10 == 0) {
         // Don't read 4G network status during firmware upgrade to avoid occupying UART resources
-        auto device_state = Application::GetInstance().GetDeviceState();
+        auto device_state = app.GetDeviceState();
         static const std::vector<DeviceState> allowed_states = {
             kDeviceStateIdle,
             kDeviceStateStarting,
@@ -206,16 +179,77 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
             kDeviceStateActivating,
         };
         if (std::find(allowed_states.begin(), allowed_states.end(), device_state) != allowed_states.end()) {
-            icon = board.GetNetworkStateIcon();
-            if (network_label_ != nullptr && icon != nullptr && network_icon_ != icon) {
-                DisplayLockGuard lock(this);
-                network_icon_ = icon;
-                lv_label_set_text(network_label_, network_icon_);
-            }
+            network_icon = board.GetNetworkStateIcon();
         }
     }
-
     esp_pm_lock_release(pm_lock_);
+
+    DisplayLockGuard lock(this);
+    if (mute_label_ == nullptr) {
+        return;
+    }
+
+    if (muted != muted_) {
+        muted_ = muted;
+        lv_label_set_text(mute_label_, muted_ ? FONT_AWESOME_VOLUME_XMARK : "");
+        status_bar_updates_++;
+    }
+
+    if (battery_icon != nullptr && battery_label_ != nullptr && battery_icon_ != battery_icon) {
+        battery_icon_ = battery_icon;
+        lv_label_set_text(battery_label_, battery_icon_);
+        status_bar_updates_++;
+    }
+
+    // Check low battery popup only when clock tick event is triggered
+    // Because when initializing, the battery level is not ready yet.
+    if (has_battery && low_battery_popup_ != nullptr && !update_all) {
+        bool low_battery = strcmp(battery_icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging;
+        bool popup_hidden = lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+        if (low_battery && popup_hidden) {
+            lv_obj_remove_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+            app.Schedule([&app]() {
+                app.PlaySound(Lang::Sounds::OGG_LOW_BATTERY);
+            });
+        } else if (!low_battery && !popup_hidden) {
+            // Hide the low battery popup when the battery is not empty
+            lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+        }
+    }
+
+    if (network_icon != nullptr && network_label_ != nullptr && network_icon_ != network_icon) {
+        network_icon_ = network_icon;
+        lv_label_set_text(network_label_, network_icon_);
+        status_bar_updates_++;
+    }
+
+    if (time_str[0] != '\0') {
+        SetStatus(time_str);
+    }
+
+    CountFlushes();
+}
+
+void LvglDisplay::CountFlushes() {
+    if (display_ == nullptr) {
+        return;
+    }
+    if (flush_window_start_us_ == 0) {
+        lv_display_add_event_cb(display_, [](lv_event_t* e) {
+            static_cast<LvglDisplay*>(lv_event_get_user_data(e))->flush_count_++;
+        }, LV_EVENT_FLUSH_START, this);
+        flush_window_start_us_ = esp_timer_get_time();
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (now - flush_window_start_us_ >= 60 * 1000 * 1000) {
+        ESP_LOGD(TAG, "Last minute: %u flushes, %u status bar updates", (unsigned)flush_count_,
+            (unsigned)status_bar_updates_);
+        flush_count_ = 0;
+        status_bar_updates_ = 0;
+        flush_window_start_us_ = now;
+    }
 }
 
 void LvglDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
@@ -231,44 +265,94 @@ void LvglDisplay::SetPowerSaveMode(bool on) {
     }
 }
 
-bool LvglDisplay::SnapshotToJpeg(std::string& jpeg_data, int quality) {
 #if CONFIG_LV_USE_SNAPSHOT
-    DisplayLockGuard lock(this);
+// Same as lv_snapshot_take_to_draw_buf, but only renders `area` of the object into `draw_buf`.
+// LVGL has no public API to render part of an object, hence lvgl_private.h.
+static void RenderSnapshotBand(lv_obj_t* obj, lv_draw_buf_t* draw_buf, const lv_area_t& area) {
+    lv_layer_t layer;
+    lv_layer_init(&layer);
+    layer.draw_buf = draw_buf;
+    layer.buf_area = area;
+    layer.color_format = draw_buf->header.cf;
+    layer._clip_area = area;
+    layer.phy_clip_area = area;
 
-    lv_obj_t* screen = lv_screen_active();
-    lv_draw_buf_t* draw_buffer = lv_snapshot_take(screen, LV_COLOR_FORMAT_RGB565);
-    if (draw_buffer == nullptr) {
-        ESP_LOGE(TAG, "Failed to take snapshot, draw_buffer is nullptr");
-        return false;
-    }
+    lv_display_t* disp_old = lv_refr_get_disp_refreshing();
+    lv_display_t* disp_new = lv_obj_get_display(obj);
+    lv_layer_t* layer_old = disp_new->layer_head;
+    disp_new->layer_head = &layer;
 
-    // swap bytes
-    uint16_t* data = (uint16_t*)draw_buffer->data;
-    size_t pixel_count = draw_buffer->data_size / 2;
-    for (size_t i = 0; i < pixel_count; i++) {
-        data[i] = __builtin_bswap16(data[i]);
+    lv_refr_set_disp_refreshing(disp_new);
+    lv_obj_redraw(&layer, obj);
+    while (layer.draw_task_head) {
+        lv_draw_dispatch_wait_for_request();
+        lv_draw_dispatch();
     }
 
-    // Clear output string and use callback version to avoid pre-allocating large memory blocks
+    disp_new->layer_head = layer_old;
+    lv_refr_set_disp_refreshing(disp_old);
+}
+#endif
+
+bool LvglDisplay::SnapshotToJpeg(std::string& jpeg_data, int quality) {
     jpeg_data.clear();
+#if CONFIG_LV_USE_SNAPSHOT
+    // The encoder asks for one MCU row at a time, which is rendered straight into its input buffer,
+    // so no full-screen RGB565 copy is made. The lock is held for the whole encode, so the image never
+    // mixes two UI states. LVGL renders RGB565 byte swapped (RGB565X), the converter reads that order.
+    struct SnapshotContext {
+        lv_obj_t* screen;
+        lv_area_t coords;
+        std::string* jpeg_data;
+    } context = { nullptr, {}, &jpeg_data };
 
-    // Use callback-based JPEG encoder to further save memory
-    bool ret = image_to_jpeg_cb((uint8_t*)draw_buffer->data, draw_buffer->data_size, draw_buffer->header.w, draw_buffer->header.h, V4L2_PIX_FMT_RGB565, quality,
-        [](void *arg, size_t index, const void *data, size_t len) -> size_t {
-        std::string* output = static_cast<std::string*>(arg);
-        if (data && len > 0) {
-            output->append(static_cast<const char*>(data), len);
-        }
-        return len;
-    }, &jpeg_data);
+    DisplayLockGuard lock(this);
+    context.screen = lv_screen_active();
+    lv_obj_get_coords(context.screen, &context.coords);
+    bool ret = image_to_jpeg_rows_cb(lv_area_get_width(&context.coords), lv_area_get_height(&context.coords),
+        V4L2_PIX_FMT_RGB565X, quality,
+        [](void* arg, uint16_t y, uint16_t rows, uint8_t* dst, size_t stride) -> bool {
+            auto context = static_cast<SnapshotContext*>(arg);
+            lv_draw_buf_t draw_buf;
+            if (lv_draw_buf_init(&draw_buf, lv_area_get_width(&context->coords), rows, LV_COLOR_FORMAT_RGB565,
+                    stride, dst, stride * rows) != LV_RESULT_OK) {
+                return false;
+            }
+            lv_area_t band = context->coords;
+            band.y1 += y;
+            band.y2 = band.y1 + rows - 1;
+            lv_draw_buf_clear(&draw_buf, nullptr);
+            RenderSnapshotBand(context->screen, &draw_buf, band);
+            return true;
+        }, &context,
+        [](void* arg, size_t index, const void* data, size_t len) -> size_t {
+            auto context = static_cast<SnapshotContext*>(arg);
+            if (data && len > 0) {
+                context->jpeg_data->append(static_cast<const char*>(data), len);
+            }
+            return len;
+        }, &context);
     if (!ret) {
         ESP_LOGE(TAG, "Failed to convert image to JPEG");
+        jpeg_data.clear();
     }
-
-    lv_draw_buf_destroy(draw_buffer);
     return ret;
 #else
     ESP_LOGE(TAG, "LV_USE_SNAPSHOT is not enabled");
     return false;
 #endif
 }
+
+bool LvglDisplay::SnapshotToJpeg(std::function<bool(const void* data, size_t len)> writer, int quality) {
+    // The JPEG is a fraction of the frame, it is kept until the lock is released so a slow upload
+    // does not block the UI
+    std::string jpeg_data;
+    if (!SnapshotToJpeg(jpeg_data, quality)) {
+        return false;
+    }
+    if (!writer(jpeg_data.data(), jpeg_data.size())) {
+        ESP_LOGE(TAG, "Failed to write JPEG data");
+        return false;
+    }
+    return true;
+}
@@ -11,6 +11,7 @@
 
 #include <string>
 #include <chrono>
+#include <functional>
 
 class LvglDisplay : public Display {
 public:
@@ -24,6 +25,9 @@ public:
     virtual void UpdateStatusBar(bool update_all = false);
     virtual void SetPowerSaveMode(bool on);
     virtual bool SnapshotToJpeg(std::string& jpeg_data, int quality = 80);
+    // Snapshot the screen and encode it, then pass the JPEG data to `writer` once the display lock
+    // is released. Returns false if encoding fails or `writer` returns false.
+    virtual bool SnapshotToJpeg(std::function<bool(const void* data, size_t len)> writer, int quality = 80);
 
 protected:
     esp_pm_lock_handle_t pm_lock_ = nullptr;
@@ -44,6 +48,13 @@ protected:
     std::chrono::system_clock::time_point last_status_update_time_;
     esp_timer_handle_t notification_timer_ = nullptr;
 
+    // Panel flushes and status bar label changes, logged once a minute
+    uint32_t flush_count_ = 0;
+    uint32_t status_bar_updates_ = 0;
+    int64_t flush_window_start_us_ = 0;
+
+    void CountFlushes();
+
     friend class DisplayLockGuard;
     virtual bool Lock(int timeout_ms = 0) = 0;
     virtual void Unlock() = 0;
@@ -1,13 +1,243 @@
 #include "lvgl_font.h"
 #include <cbin_font.h>
 
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <sdkconfig.h>
+#include <cstring>
+#include <iterator>
+
+#define TAG "LvglFont"
+
+#ifndef CONFIG_LVGL_GLYPH_ATLAS_SIZE_KB
+#define CONFIG_LVGL_GLYPH_ATLAS_SIZE_KB 0
+#endif
 
 LvglCBinFont::LvglCBinFont(void* data) {
     font_ = cbin_font_create(static_cast<uint8_t*>(data));
+    LvglGlyphAtlas::GetInstance().Attach(font_);
 }
 
 LvglCBinFont::~LvglCBinFont() {
     if (font_ != nullptr) {
+        LvglGlyphAtlas::GetInstance().Detach(font_);
         cbin_font_delete(font_);
     }
-}
\ No newline at end of file
+}
+
+LvglGlyphAtlas::LvglGlyphAtlas() : capacity_(CONFIG_LVGL_GLYPH_ATLAS_SIZE_KB * 1024) {
+}
+
+void LvglGlyphAtlas::Attach(lv_font_t* font) {
+    if (capacity_ == 0 || font == nullptr || font->get_glyph_bitmap == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fonts_.find(font) != fonts_.end()) {
+        return;
+    }
+    fonts_.emplace(font, font->get_glyph_bitmap);
+    font->get_glyph_bitmap = CachedGlyphBitmap;
+}
+
+void LvglGlyphAtlas::Detach(lv_font_t* font) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto font_it = fonts_.find(font);
+    if (font_it == fonts_.end()) {
+        return;
+    }
+    font->get_glyph_bitmap = font_it->second;
+    fonts_.erase(font_it);
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        auto next = std::next(it);
+        if (it->key.font == font) {
+            Erase(it);
+        }
+        it = next;
+    }
+}
+
+const void* LvglGlyphAtlas::CachedGlyphBitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf) {
+    return GetInstance().Lookup(g_dsc, draw_buf);
+}
+
+const void* LvglGlyphAtlas::Lookup(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf) {
+    Key key = {g_dsc->resolved_font, g_dsc->gid.index};
+    GetGlyphBitmap original;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto font_it = fonts_.find(key.font);
+        if (font_it == fonts_.end()) {
+            return nullptr;
+        }
+        original = font_it->second;
+
+        auto it = index_.find(key);
+        if (it != index_.end() && draw_buf != nullptr && it->second->width == g_dsc->box_w &&
+            it->second->height == g_dsc->box_h && CopyOut(*it->second, draw_buf)) {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            hits_++;
+            return draw_buf;
+        }
+        misses_++;
+    }
+
+    // Rasterize outside the lock, other fonts can still be served meanwhile
+    const void* bitmap = original(g_dsc, draw_buf);
+    if (bitmap != nullptr && bitmap == draw_buf && draw_buf->header.cf == LV_COLOR_FORMAT_A8) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (index_.find(key) == index_.end()) {
+            Insert(key, draw_buf, g_dsc->box_w, g_dsc->box_h);
+        }
+    }
+    return bitmap;
+}
+
+bool LvglGlyphAtlas::CopyOut(const Entry& entry, lv_draw_buf_t* draw_buf) const {
+    if (lv_draw_buf_reshape(draw_buf, LV_COLOR_FORMAT_A8, entry.width, entry.height, LV_STRIDE_AUTO) == nullptr) {
+        return false;
+    }
+    uint32_t stride = draw_buf->header.stride;
+    uint8_t* dst = draw_buf->data;
+    const uint8_t* src = entry.pixels;
+    for (uint16_t y = 0; y < entry.height; y++, dst += stride) {
+        if (!entry.a4) {
+            memcpy(dst, src, entry.width);
+            src += entry.width;
+            continue;
+        }
+        for (uint16_t x = 0; x < entry.width; x += 2, src++) {
+            dst[x] = (*src >> 4) * 17;
+            if (x + 1 < entry.width) {
+                dst[x + 1] = (*src & 0x0F) * 17;
+            }
+        }
+    }
+    return true;
+}
+
+void LvglGlyphAtlas::Insert(const Key& key, const lv_draw_buf_t* draw_buf, uint16_t width, uint16_t height) {
+    uint32_t stride = draw_buf->header.stride;
+    const uint8_t* src = draw_buf->data;
+
+    // Fonts with up to 4 bits per pixel expand to multiples of 17, so they can be packed back losslessly
+    bool a4 = true;
+    for (uint16_t y = 0; y < height && a4; y++) {
+        const uint8_t* row = src + (size_t)y * stride;
+        for (uint16_t x = 0; x < width; x++) {
+            if (row[x] % 17 != 0) {
+                a4 = false;
+                break;
+            }
+        }
+    }
+
+    size_t row_bytes = a4 ? (width + 1) / 2 : width;
+    size_t size = row_bytes * height;
+    if (size + sizeof(Entry) > capacity_) {
+        return;
+    }
+    while (!entries_.empty() && used_ + size + sizeof(Entry) > capacity_) {
+        Erase(std::prev(entries_.end()));
+    }
+
+    uint8_t* pixels = nullptr;
+    if (size > 0) {
+#if CONFIG_SPIRAM
+        pixels = static_cast<uint8_t*>(heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+#else
+        pixels = static_cast<uint8_t*>(heap_caps_malloc(size, MALLOC_CAP_8BIT));
+#endif
+        if (pixels == nullptr) {
+            return;
+        }
+    }
+
+    uint8_t* dst = pixels;
+    for (uint16_t y = 0; y < height; y++) {
+        const uint8_t* row = src + (size_t)y * stride;
+        if (!a4) {
+            memcpy(dst, row, width);
+            dst += width;
+            continue;
+        }
+        for (uint16_t x = 0; x < width; x += 2) {
+            uint8_t high = row[x] / 17;
+            uint8_t low = x + 1 < width ? row[x + 1] / 17 : 0;
+            *dst++ = (high << 4) | low;
+        }
+    }
+
+    entries_.push_front({key, width, height, a4, pixels, size});
+    index_[key] = entries_.begin();
+    used_ += size + sizeof(Entry);
+}
+
+void LvglGlyphAtlas::Erase(std::list<Entry>::iterator it) {
+    heap_caps_free(it->pixels);
+    used_ -= it->size + sizeof(Entry);
+    index_.erase(it->key);
+    entries_.erase(it);
+}
+
+void LvglGlyphAtlas::Warm(const lv_font_t* font, const char* text) {
+    if (capacity_ == 0 || font == nullptr || text == nullptr) {
+        return;
+    }
+
+    uint32_t warmed = 0;
+    uint32_t i = 0;
+    while (text[i] != '\0') {
+        uint32_t letter = lv_text_encoded_next(text, &i);
+        lv_font_glyph_dsc_t g_dsc = {};
+        if (!lv_font_get_glyph_dsc(font, &g_dsc, letter, 0) || g_dsc.resolved_font == nullptr ||
+            g_dsc.box_w == 0 || g_dsc.box_h == 0) {
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (fonts_.find(g_dsc.resolved_font) == fonts_.end() ||
+                index_.find({g_dsc.resolved_font, g_dsc.gid.index}) != index_.end()) {
+                continue;
+            }
+        }
+
+        lv_draw_buf_t* draw_buf = lv_draw_buf_create(g_dsc.box_w, g_dsc.box_h, LV_COLOR_FORMAT_A8, LV_STRIDE_AUTO);
+        if (draw_buf == nullptr) {
+            break;
+        }
+        Lookup(&g_dsc, draw_buf);
+        lv_draw_buf_destroy(draw_buf);
+        warmed++;
+    }
+
+    if (warmed > 0) {
+        // Other tasks update the counters through CachedGlyphBitmap, so take a consistent copy
+        uint32_t hits, total;
+        size_t used;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            hits = hits_;
+            total = hits_ + misses_;
+            used = used_;
+        }
+        ESP_LOGD(TAG, "Glyph atlas: warmed %u, hit rate %u%% (%u/%u), %u/%u bytes", (unsigned)warmed,
+            total > 0 ? (unsigned)(hits * 100ULL / total) : 0, (unsigned)hits, (unsigned)total,
+            (unsigned)used, (unsigned)capacity_);
+    }
+}
+
+size_t LvglGlyphAtlas::used() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return used_;
+}
+
+uint32_t LvglGlyphAtlas::hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+uint32_t LvglGlyphAtlas::misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
@@ -2,6 +2,11 @@
 
 #include <lvgl.h>
 
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
 
 class LvglFont {
 public:
@@ -29,3 +34,66 @@ public:
 private:
     lv_font_t* font_;
 };
+
+
+// LRU cache of rasterized glyphs for LvglCBinFont, bounded by CONFIG_LVGL_GLYPH_ATLAS_SIZE_KB.
+// The font's get_glyph_bitmap is wrapped, so a cached glyph is copied into LVGL's glyph
+// buffer instead of being decompressed from the assets partition on every redraw. Bitmaps
+// are kept as A4 when the font has at most 4 bits per pixel, otherwise A8, in PSRAM.
+class LvglGlyphAtlas {
+public:
+    static LvglGlyphAtlas& GetInstance() {
+        static LvglGlyphAtlas instance;
+        return instance;
+    }
+
+    void Attach(lv_font_t* font);
+    void Detach(lv_font_t* font);
+
+    // Rasterize the glyphs of `text` ahead of drawing. Must be called with the LVGL lock held.
+    void Warm(const lv_font_t* font, const char* text);
+
+    size_t capacity() const { return capacity_; }
+    size_t used() const;
+    uint32_t hits() const;
+    uint32_t misses() const;
+
+private:
+    using GetGlyphBitmap = const void* (*)(lv_font_glyph_dsc_t*, lv_draw_buf_t*);
+
+    struct Key {
+        const lv_font_t* font;
+        uint32_t index;
+        bool operator==(const Key& other) const { return font == other.font && index == other.index; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return std::hash<const void*>()(key.font) ^ (key.index * 2654435761u);
+        }
+    };
+    struct Entry {
+        Key key;
+        uint16_t width;
+        uint16_t height;
+        bool a4;            // Two pixels per byte, rows padded to a whole byte
+        uint8_t* pixels;
+        size_t size;
+    };
+
+    mutable std::mutex mutex_;
+    std::unordered_map<const lv_font_t*, GetGlyphBitmap> fonts_;
+    std::list<Entry> entries_;  // Most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+    size_t capacity_;
+    size_t used_ = 0;
+    uint32_t hits_ = 0;
+    uint32_t misses_ = 0;
+
+    LvglGlyphAtlas();
+
+    static const void* CachedGlyphBitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf);
+    const void* Lookup(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf);
+    bool CopyOut(const Entry& entry, lv_draw_buf_t* draw_buf) const;
+    void Insert(const Key& key, const lv_draw_buf_t* draw_buf, uint16_t width, uint16_t height);
+    void Erase(std::list<Entry>::iterator it);
+};
@@ -4,7 +4,16 @@
 #include <esp_log.h>
 #include <stdexcept>
 #include <cstring>
+#include <algorithm>
 #include <esp_heap_caps.h>
+#include <sdkconfig.h>
+
+#ifndef CONFIG_IDF_TARGET_ESP32
+#include "jpg/jpeg_to_image.h"
+#endif
+#if CONFIG_SOC_PPA_SUPPORTED
+#include <driver/ppa.h>
+#endif
 
 #define TAG "LvglImage"
 
@@ -61,4 +70,211 @@ LvglAllocatedImage::~LvglAllocatedImage() {
         heap_caps_free((void*)image_dsc_.data);
         image_dsc_.data = nullptr;
     }
-}
\ No newline at end of file
+}
+
+#if CONFIG_SOC_PPA_SUPPORTED
+// Scale with the PPA. Its scale factors have 1/16 precision, so the output can be slightly
+// smaller than requested; the actual size is returned in dst_width and dst_height.
+static bool PpaResizeRgb565(const uint8_t* src, int src_width, int src_height, int src_stride,
+                            int& dst_width, int& dst_height, uint8_t*& dst, size_t& dst_size) {
+    static ppa_client_handle_t ppa_client = nullptr;
+    if (ppa_client == nullptr) {
+        ppa_client_config_t client_cfg = {
+            .oper_type = PPA_OPERATION_SRM,
+            .max_pending_trans_num = 1,
+        };
+        if (ppa_register_client(&client_cfg, &ppa_client) != ESP_OK) {
+            ppa_client = nullptr;
+            return false;
+        }
+    }
+
+    float scale = std::min((float)dst_width / src_width, (float)dst_height / src_height);
+    scale = (int)(scale * 16) / 16.0f;
+    if (scale <= 0) {
+        return false;
+    }
+    int out_width = (int)(src_width * scale);
+    int out_height = (int)(src_height * scale);
+    // The output buffer is written by DMA, keep it cache line aligned
+    size_t out_size = ((size_t)out_width * out_height * 2 + 63) & ~(size_t)63;
+    uint8_t* out = (uint8_t*)heap_caps_aligned_alloc(64, out_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (out == nullptr) {
+        return false;
+    }
+
+    ppa_srm_oper_config_t srm_cfg = {};
+    srm_cfg.in.buffer = src;
+    srm_cfg.in.pic_w = src_stride / 2;
+    srm_cfg.in.pic_h = src_height;
+    srm_cfg.in.block_w = src_width;
+    srm_cfg.in.block_h = src_height;
+    srm_cfg.in.srm_cm = PPA_SRM_COLOR_MODE_RGB565;
+    srm_cfg.out.buffer = out;
+    srm_cfg.out.buffer_size = out_size;
+    srm_cfg.out.pic_w = out_width;
+    srm_cfg.out.pic_h = out_height;
+    srm_cfg.out.srm_cm = PPA_SRM_COLOR_MODE_RGB565;
+    srm_cfg.rotation_angle = PPA_SRM_ROTATION_ANGLE_0;
+    srm_cfg.scale_x = scale;
+    srm_cfg.scale_y = scale;
+    srm_cfg.mode = PPA_TRANS_MODE_BLOCKING;
+    if (ppa_do_scale_rotate_mirror(ppa_client, &srm_cfg) != ESP_OK) {
+        heap_caps_free(out);
+        return false;
+    }
+
+    dst = out;
+    dst_size = out_size;
+    dst_width = out_width;
+    dst_height = out_height;
+    return true;
+}
+#endif
+
+// Halve both dimensions, averaging each 2x2 block so that no source pixel is skipped
+static uint8_t* HalveRgb565(const uint8_t* src, int src_width, int src_height, int src_stride) {
+    int dst_width = src_width / 2;
+    int dst_height = src_height / 2;
+    uint8_t* dst = (uint8_t*)heap_caps_malloc((size_t)dst_width * dst_height * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (dst == nullptr) {
+        return nullptr;
+    }
+
+    auto out = reinterpret_cast<uint16_t*>(dst);
+    for (int y = 0; y < dst_height; y++) {
+        auto row0 = reinterpret_cast<const uint16_t*>(src + (size_t)(2 * y) * src_stride);
+        auto row1 = reinterpret_cast<const uint16_t*>(src + (size_t)(2 * y + 1) * src_stride);
+        for (int x = 0; x < dst_width; x++) {
+            uint32_t a = row0[2 * x], b = row0[2 * x + 1], c = row1[2 * x], d = row1[2 * x + 1];
+            uint32_t r = ((a >> 11) + (b >> 11) + (c >> 11) + (d >> 11) + 2) >> 2;
+            uint32_t g = (((a >> 5) & 0x3F) + ((b >> 5) & 0x3F) + ((c >> 5) & 0x3F) + ((d >> 5) & 0x3F) + 2) >> 2;
+            uint32_t bl = ((a & 0x1F) + (b & 0x1F) + (c & 0x1F) + (d & 0x1F) + 2) >> 2;
+            out[x] = (uint16_t)((r << 11) | (g << 5) | bl);
+        }
+        out += dst_width;
+    }
+    return dst;
+}
+
+// Nearest-neighbour resize, only used for factors of at least 1/2 (see ScaleToFit)
+static uint8_t* ResizeRgb565(const uint8_t* src, int src_width, int src_height, int src_stride,
+                             int dst_width, int dst_height) {
+    uint8_t* dst = (uint8_t*)heap_caps_malloc((size_t)dst_width * dst_height * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (dst == nullptr) {
+        return nullptr;
+    }
+
+    uint32_t step_x = ((uint32_t)src_width << 16) / dst_width;
+    uint32_t step_y = ((uint32_t)src_height << 16) / dst_height;
+    auto out = reinterpret_cast<uint16_t*>(dst);
+    const uint16_t* prev_row = nullptr;
+    for (int y = 0; y < dst_height; y++) {
+        auto row = reinterpret_cast<const uint16_t*>(src + (size_t)((y * step_y) >> 16) * src_stride);
+        if (row == prev_row) {
+            // Same source row as the previous output row
+            memcpy(out, out - dst_width, dst_width * 2);
+        } else {
+            uint32_t fx = step_x / 2;
+            for (int x = 0; x < dst_width; x++, fx += step_x) {
+                out[x] = row[fx >> 16];
+            }
+        }
+        prev_row = row;
+        out += dst_width;
+    }
+    return dst;
+}
+
+std::unique_ptr<LvglAllocatedImage> LvglAllocatedImage::ScaleToFit(const LvglImage& image, int max_width, int max_height) {
+    auto img_dsc = image.image_dsc();
+    if (img_dsc == nullptr || img_dsc->data == nullptr || max_width <= 0 || max_height <= 0) {
+        return nullptr;
+    }
+
+    const uint8_t* pixels = nullptr;
+    int width = img_dsc->header.w;
+    int height = img_dsc->header.h;
+    int stride = img_dsc->header.stride;
+    uint8_t* decoded = nullptr;
+    size_t decoded_size = 0;
+
+    if (img_dsc->header.cf == LV_COLOR_FORMAT_RGB565 && width > 0 && height > 0) {
+        pixels = img_dsc->data;
+        if (stride == 0) {
+            stride = width * 2;
+        }
+    }
+#ifndef CONFIG_IDF_TARGET_ESP32
+    else if (img_dsc->data_size > 2 && img_dsc->data[0] == 0xFF && img_dsc->data[1] == 0xD8) {
+        size_t out_width = 0, out_height = 0, out_stride = 0;
+        if (jpeg_to_image_scaled(img_dsc->data, img_dsc->data_size, max_width, max_height, &decoded, &decoded_size,
+                &out_width, &out_height, &out_stride) != ESP_OK) {
+            return nullptr;
+        }
+        pixels = decoded;
+        width = out_width;
+        height = out_height;
+        stride = out_stride;
+    }
+#endif
+    else {
+        return nullptr;
+    }
+
+    // Fit within the box, keeping the aspect ratio
+    float scale = std::min({1.0f, (float)max_width / width, (float)max_height / height});
+    int dst_width = std::max(1, (int)(width * scale));
+    int dst_height = std::max(1, (int)(height * scale));
+    if (dst_width == width && dst_height == height) {
+        if (decoded == nullptr) {
+            return nullptr;  // Already fits
+        }
+        // The decoder already produced the right size
+        return std::make_unique<LvglAllocatedImage>(decoded, decoded_size, width, height, stride, LV_COLOR_FORMAT_RGB565);
+    }
+
+    uint8_t* out = nullptr;
+    size_t out_size = 0;
+#if CONFIG_SOC_PPA_SUPPORTED
+    if (!PpaResizeRgb565(pixels, width, height, stride, dst_width, dst_height, out, out_size)) {
+        ESP_LOGW(TAG, "PPA resize failed, fallback to software");
+    }
+#endif
+    if (out == nullptr) {
+        // The remaining factor can be anything: the hardware decoder cannot scale, IDCT scaling stops
+        // early on sizes that are not multiples of 8 and RGB565 input is not scaled at all. Halve
+        // first, so that nearest-neighbour never has to drop more than every other pixel.
+        while (width / 2 >= dst_width && height / 2 >= dst_height) {
+            uint8_t* half = HalveRgb565(pixels, width, height, stride);
+            if (half == nullptr) {
+                break;
+            }
+            if (decoded != nullptr) {
+                heap_caps_free(decoded);
+            }
+            decoded = half;
+            pixels = half;
+            width /= 2;
+            height /= 2;
+            stride = width * 2;
+        }
+        if (decoded != nullptr && width == dst_width && height == dst_height) {
+            // Halving landed on the exact size
+            out = decoded;
+            decoded = nullptr;
+        } else {
+            out = ResizeRgb565(pixels, width, height, stride, dst_width, dst_height);
+        }
+        out_size = (size_t)dst_width * dst_height * 2;
+    }
+    if (decoded != nullptr) {
+        heap_caps_free(decoded);
+    }
+    if (out == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %dx%d scaled image", dst_width, dst_height);
+        return nullptr;
+    }
+    ESP_LOGD(TAG, "Scaled image %dx%d to %dx%d", img_dsc->header.w, img_dsc->header.h, dst_width, dst_height);
+    return std::make_unique<LvglAllocatedImage>(out, out_size, dst_width, dst_height, dst_width * 2, LV_COLOR_FORMAT_RGB565);
+}
@@ -2,6 +2,8 @@
 
 #include <lvgl.h>
 
+#include <memory>
+
 
 // Wrap around lv_img_dsc_t
 class LvglImage {
@@ -46,6 +48,15 @@ public:
     LvglAllocatedImage(void* data, size_t size);
     LvglAllocatedImage(void* data, size_t size, int width, int height, int stride, int color_format);
     virtual ~LvglAllocatedImage();
+
+    /**
+     * Create an RGB565 copy of `image` scaled down to fit within max_width x max_height, so LVGL
+     * can draw it without zooming. JPEG data is decoded at a reduced IDCT scale first, RGB565 is
+     * resized with the PPA when available. Returns nullptr if the image already fits or is
+     * neither JPEG nor RGB565.
+     */
+    static std::unique_ptr<LvglAllocatedImage> ScaleToFit(const LvglImage& image, int max_width, int max_height);
+
     virtual const lv_img_dsc_t* image_dsc() const override { return &image_dsc_; }
 
 private:
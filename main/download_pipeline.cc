@@ -0,0 +1,459 @@
+#include "download_pipeline.h"
+#include "board.h"
+#include "settings.h"
+
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <freertos/task.h>
+#include <sdkconfig.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "DownloadPipeline"
+
+#ifndef CONFIG_DOWNLOAD_CHUNK_SIZE_KB
+#define CONFIG_DOWNLOAD_CHUNK_SIZE_KB 4
+#endif
+#ifndef CONFIG_DOWNLOAD_CHUNK_COUNT
+#define CONFIG_DOWNLOAD_CHUNK_COUNT 2
+#endif
+
+// Erasing a 64 KB block is much faster than erasing its 16 sectors one by one
+static constexpr size_t kEraseBlockSize = 64 * 1024;
+// Resume state is saved at most this often while downloading, and always when an attempt ends
+static constexpr size_t kJournalInterval = 256 * 1024;
+static constexpr int kMaxAttempts = 6;
+static constexpr int kMaxBackoffMs = 30000;
+
+DownloadPipeline::DownloadPipeline(const esp_partition_t* partition)
+    : partition_(partition),
+      sector_size_(esp_partition_get_main_flash_sector_size()),
+      chunk_size_(CONFIG_DOWNLOAD_CHUNK_SIZE_KB * 1024),
+      chunk_count_(CONFIG_DOWNLOAD_CHUNK_COUNT) {
+}
+
+DownloadPipeline::~DownloadPipeline() {
+    FreeBuffers();
+}
+
+bool DownloadPipeline::AllocateBuffers() {
+    // Halve the chunk size until at least two chunks fit, one being filled while the other is written
+    while (true) {
+        for (size_t i = 0; i < chunk_count_; i++) {
+            void* buffer = heap_caps_malloc(chunk_size_, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+            if (buffer == nullptr) {
+                buffer = heap_caps_malloc(chunk_size_, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+            }
+            if (buffer == nullptr) {
+                break;
+            }
+            buffers_.push_back(static_cast<uint8_t*>(buffer));
+        }
+        if (buffers_.size() >= 2 || chunk_size_ <= sector_size_) {
+            break;
+        }
+        FreeBuffers();
+        chunk_size_ /= 2;
+    }
+    if (buffers_.empty()) {
+        return false;
+    }
+
+    free_queue_ = xQueueCreate(buffers_.size(), sizeof(Chunk));
+    full_queue_ = xQueueCreate(buffers_.size() + 1, sizeof(Chunk));
+    writer_done_ = xSemaphoreCreateBinary();
+    if (free_queue_ == nullptr || full_queue_ == nullptr || writer_done_ == nullptr) {
+        return false;
+    }
+    for (auto buffer : buffers_) {
+        Chunk chunk = {buffer, 0, 0};
+        xQueueSend(free_queue_, &chunk, 0);
+    }
+    ESP_LOGI(TAG, "Using %u chunks of %u bytes", (unsigned)buffers_.size(), (unsigned)chunk_size_);
+    return true;
+}
+
+void DownloadPipeline::FreeBuffers() {
+    for (auto buffer : buffers_) {
+        heap_caps_free(buffer);
+    }
+    buffers_.clear();
+    if (free_queue_ != nullptr) {
+        vQueueDelete(free_queue_);
+        free_queue_ = nullptr;
+    }
+    if (full_queue_ != nullptr) {
+        vQueueDelete(full_queue_);
+        full_queue_ = nullptr;
+    }
+    if (writer_done_ != nullptr) {
+        vSemaphoreDelete(writer_done_);
+        writer_done_ = nullptr;
+    }
+}
+
+esp_err_t DownloadPipeline::EraseNext() {
+    size_t size = sector_size_;
+    if (erase_cursor_ % kEraseBlockSize == 0 && erase_end_ - erase_cursor_ >= kEraseBlockSize) {
+        size = kEraseBlockSize;
+    }
+    int64_t start_time = esp_timer_get_time();
+    esp_err_t err = esp_partition_erase_range(partition_, erase_cursor_, size);
+    stats_.erase_us += esp_timer_get_time() - start_time;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to erase 0x%x bytes at 0x%x: %s", (unsigned)size, (unsigned)erase_cursor_, esp_err_to_name(err));
+        return err;
+    }
+    erase_cursor_ += size;
+    return ESP_OK;
+}
+
+esp_err_t DownloadPipeline::WriteChunk(Chunk& chunk) {
+    while (erase_cursor_ < chunk.offset + chunk.size) {
+        esp_err_t err = EraseNext();
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    // Encrypted writes must be 16 bytes aligned, pad the last chunk with erased bytes
+    size_t size = chunk.size;
+    if (partition_->encrypted && size % 16 != 0) {
+        size_t padded = (size + 15) & ~(size_t)15;
+        memset(chunk.data + size, 0xFF, padded - size);
+        size = padded;
+    }
+
+    int64_t start_time = esp_timer_get_time();
+    esp_err_t err = esp_partition_write(partition_, chunk.offset, chunk.data, size);
+    stats_.write_us += esp_timer_get_time() - start_time;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write %u bytes at 0x%x: %s", (unsigned)size, (unsigned)chunk.offset, esp_err_to_name(err));
+    }
+    return err;
+}
+
+void DownloadPipeline::WriterTask() {
+    while (true) {
+        // Erase ahead while there is nothing to write
+        bool can_erase = write_error_ == ESP_OK && erase_cursor_ < erase_end_;
+        Chunk chunk;
+        int64_t start_time = esp_timer_get_time();
+        if (xQueueReceive(full_queue_, &chunk, can_erase ? 0 : portMAX_DELAY) != pdTRUE) {
+            esp_err_t err = EraseNext();
+            if (err != ESP_OK) {
+                write_error_ = err;
+            }
+            continue;
+        }
+        if (!can_erase) {
+            stats_.writer_idle_us += esp_timer_get_time() - start_time;
+        }
+        if (chunk.data == nullptr) {
+            break;
+        }
+
+        // After an error keep draining, so the reader never blocks on a full queue
+        if (write_error_ == ESP_OK) {
+            esp_err_t err = WriteChunk(chunk);
+            if (err != ESP_OK) {
+                write_error_ = err;
+            } else if (on_written_) {
+                on_written_(chunk);
+            }
+        }
+        chunk.size = 0;
+        xQueueSend(free_queue_, &chunk, portMAX_DELAY);
+    }
+    xSemaphoreGive(writer_done_);
+}
+
+bool DownloadPipeline::Run(Http* http, size_t offset, size_t length, ProgressCallback callback) {
+    return Run([http](uint8_t* buffer, size_t size) {
+        return http->Read(reinterpret_cast<char*>(buffer), size);
+    }, offset, length, callback);
+}
+
+bool DownloadPipeline::Run(ReadFunction read, size_t offset, size_t length, ProgressCallback callback) {
+    if (offset % sector_size_ != 0 || offset + length > partition_->size) {
+        ESP_LOGE(TAG, "Invalid range 0x%x+0x%x for partition %s (0x%lx)", (unsigned)offset, (unsigned)length,
+            partition_->label, partition_->size);
+        return false;
+    }
+    if (!AllocateBuffers()) {
+        ESP_LOGE(TAG, "Failed to allocate download buffers");
+        FreeBuffers();
+        return false;
+    }
+
+    stats_ = Stats();
+    write_error_ = ESP_OK;
+    header_rejected_ = false;
+    erase_cursor_ = offset;
+    erase_end_ = std::min((offset + length + sector_size_ - 1) / sector_size_ * sector_size_, (size_t)partition_->size);
+
+    // Without the writer nobody would return the chunks, and the reader would wait forever
+    if (xTaskCreate([](void* arg) {
+            static_cast<DownloadPipeline*>(arg)->WriterTask();
+            vTaskDelete(NULL);
+        }, "download_writer", 4096, this, uxTaskPriorityGet(NULL), nullptr) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create download writer task");
+        FreeBuffers();
+        return false;
+    }
+
+    bool success = true;
+    size_t end = offset + length;
+    size_t position = offset;
+    size_t recent_read = 0;
+    int64_t start_time = esp_timer_get_time();
+    auto last_calc_time = start_time;
+    while (position < end) {
+        Chunk chunk;
+        int64_t wait_start = esp_timer_get_time();
+        xQueueReceive(free_queue_, &chunk, portMAX_DELAY);
+        stats_.reader_wait_us += esp_timer_get_time() - wait_start;
+        if (write_error_ != ESP_OK) {
+            success = false;
+            break;
+        }
+
+        // Fill the whole chunk, flash is programmed most efficiently in large writes
+        chunk.offset = position;
+        chunk.size = 0;
+        size_t capacity = std::min(chunk_size_, end - position);
+        int64_t read_start = esp_timer_get_time();
+        while (chunk.size < capacity) {
+            int ret = read(chunk.data + chunk.size, capacity - chunk.size);
+            if (ret < 0) {
+                ESP_LOGE(TAG, "Failed to read data: %d", ret);
+                success = false;
+                break;
+            }
+            if (ret == 0) {
+                break;
+            }
+            chunk.size += ret;
+        }
+        stats_.read_us += esp_timer_get_time() - read_start;
+        if (success && chunk.size > 0 && chunk.offset == 0 && header_check_ && !header_check_(chunk.data, chunk.size)) {
+            ESP_LOGE(TAG, "Rejected the data for partition %s, nothing was written", partition_->label);
+            header_rejected_ = true;
+            success = false;
+        }
+        if (!success || chunk.size == 0) {
+            xQueueSend(free_queue_, &chunk, portMAX_DELAY);
+            break;
+        }
+
+        position += chunk.size;
+        recent_read += chunk.size;
+        xQueueSend(full_queue_, &chunk, portMAX_DELAY);
+
+        // Report speed and progress every second, a resumed download counts what was written before
+        if (esp_timer_get_time() - last_calc_time >= 1000000 || position == end) {
+            size_t progress = (uint64_t)position * 100 / end;
+            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", (unsigned)progress, (unsigned)position,
+                (unsigned)end, (unsigned)recent_read);
+            if (callback) {
+                callback(progress, recent_read);
+            }
+            last_calc_time = esp_timer_get_time();
+            recent_read = 0;
+        }
+    }
+
+    // Stop the writer once everything queued has been written
+    Chunk stop = {nullptr, 0, 0};
+    xQueueSend(full_queue_, &stop, portMAX_DELAY);
+    xSemaphoreTake(writer_done_, portMAX_DELAY);
+    FreeBuffers();
+
+    stats_.bytes = position - offset;
+    stats_.total_us = esp_timer_get_time() - start_time;
+    LogStats();
+
+    if (write_error_ != ESP_OK) {
+        return false;
+    }
+    if (success && position != end) {
+        ESP_LOGE(TAG, "Downloaded size (%u) does not match expected size (%u)", (unsigned)(position - offset), (unsigned)length);
+        return false;
+    }
+    return success;
+}
+
+void DownloadPipeline::LogStats() const {
+    auto rate = [this](int64_t us) -> unsigned {
+        return us > 0 ? (unsigned)(stats_.bytes * 1000000ULL / 1024 / us) : 0;
+    };
+    ESP_LOGI(TAG, "Downloaded %u bytes in %d ms (%u KB/s)", (unsigned)stats_.bytes, (int)(stats_.total_us / 1000),
+        rate(stats_.total_us));
+    ESP_LOGI(TAG, "Network: %d ms (%u KB/s), waiting for flash: %d ms", (int)(stats_.read_us / 1000),
+        rate(stats_.read_us), (int)(stats_.reader_wait_us / 1000));
+    ESP_LOGI(TAG, "Flash: write %d ms (%u KB/s), erase %d ms, waiting for network: %d ms", (int)(stats_.write_us / 1000),
+        rate(stats_.write_us), (int)(stats_.erase_us / 1000), (int)(stats_.writer_idle_us / 1000));
+}
+
+bool DownloadPipeline::VerifyWritten(size_t length, uint32_t crc) {
+    void* buffer = heap_caps_malloc(sector_size_, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (buffer == nullptr) {
+        return false;
+    }
+    uint32_t actual = 0;
+    for (size_t offset = 0; offset < length; offset += sector_size_) {
+        size_t size = std::min(sector_size_, length - offset);
+        if (esp_partition_read(partition_, offset, buffer, size) != ESP_OK) {
+            heap_caps_free(buffer);
+            return false;
+        }
+        actual = esp_rom_crc32_le(actual, static_cast<uint8_t*>(buffer), size);
+    }
+    heap_caps_free(buffer);
+    return actual == crc;
+}
+
+bool DownloadPipeline::Download(const std::string& url, const char* journal, ProgressCallback callback, size_t& length) {
+    // Only sector aligned progress is journaled, so a resumed download starts on a sector boundary
+    size_t committed = 0;
+    uint32_t crc = 0;
+    std::string validator;  // ETag or Last-Modified of the journaled file
+    length = 0;
+    {
+        Settings settings(journal, false);
+        if (settings.GetString("url") == url && settings.GetString("partition") == partition_->label) {
+            committed = (uint32_t)settings.GetInt("offset");
+            crc = (uint32_t)settings.GetInt("crc");
+            length = (uint32_t)settings.GetInt("length");
+            validator = settings.GetString("validator");
+        }
+    }
+    if (committed > 0) {
+        if (committed % sector_size_ == 0 && committed < length && VerifyWritten(committed, crc)) {
+            ESP_LOGI(TAG, "Resuming download at %u/%u", (unsigned)committed, (unsigned)length);
+        } else {
+            ESP_LOGW(TAG, "Journaled data does not match the partition, restarting download");
+            committed = 0;
+            crc = 0;
+        }
+    }
+
+    size_t saved = committed;
+    auto save_journal = [&]() {
+        Settings settings(journal, true);
+        settings.SetString("url", url);
+        settings.SetString("partition", partition_->label);
+        settings.SetInt("length", length);
+        settings.SetInt("offset", committed);
+        settings.SetInt("crc", crc);
+        settings.SetString("validator", validator);
+        // Commit now instead of after the settings delay, the journal is there for power loss
+        Settings::Flush();
+        saved = committed;
+    };
+    auto restart = [&]() {
+        committed = 0;
+        crc = 0;
+        length = 0;
+        validator.clear();
+        Settings settings(journal, true);
+        settings.EraseAll();
+    };
+
+    on_written_ = [&](const Chunk& chunk) {
+        size_t end = chunk.offset + chunk.size;
+        if (chunk.offset != committed || (end % sector_size_ != 0 && end != length)) {
+            return;
+        }
+        crc = esp_rom_crc32_le(crc, chunk.data, chunk.size);
+        committed = end;
+        if (committed - saved >= kJournalInterval) {
+            save_journal();
+        }
+    };
+
+    bool success = false;
+    bool retry_now = false;
+    auto network = Board::GetInstance().GetNetwork();
+    for (int attempt = 0; attempt < kMaxAttempts && !success; attempt++) {
+        if (attempt > 0 && !retry_now) {
+            int backoff_ms = std::min(1000 << (attempt - 1), kMaxBackoffMs);
+            ESP_LOGW(TAG, "Download attempt %d failed, retrying in %d ms", attempt, backoff_ms);
+            vTaskDelay(pdMS_TO_TICKS(backoff_ms));
+        }
+        retry_now = false;
+
+        auto http = network->CreateHttp(0);
+        if (committed > 0) {
+            http->SetHeader("Range", "bytes=" + std::to_string(committed) + "-");
+            // The server sends the whole file instead if it has changed since the journal was written
+            if (!validator.empty()) {
+                http->SetHeader("If-Range", validator);
+            }
+        }
+        if (!http->Open("GET", url)) {
+            ESP_LOGE(TAG, "Failed to open HTTP connection");
+            continue;
+        }
+
+        int status = http->GetStatusCode();
+        size_t body_length = http->GetBodyLength();
+        if (committed > 0 && (status == 416 || (status == 206 && committed + body_length != length))) {
+            // The file is not the one in the journal anymore, start over without waiting
+            ESP_LOGW(TAG, "Server cannot resume at %u (status %d), restarting from the beginning",
+                (unsigned)committed, status);
+            http->Close();
+            restart();
+            retry_now = true;
+            continue;
+        }
+        if (status == 206 && committed > 0 && body_length > 0) {
+            // Continue after the journaled data
+        } else if (status == 200 && body_length > 0) {
+            if (body_length > partition_->size) {
+                ESP_LOGE(TAG, "Firmware size %u is larger than partition %s (0x%lx)", (unsigned)body_length,
+                    partition_->label, partition_->size);
+                http->Close();
+                break;  // Retrying will not help
+            }
+            if (committed > 0) {
+                ESP_LOGW(TAG, "Server did not resume the download, restarting from the beginning");
+            }
+            committed = 0;
+            crc = 0;
+            length = body_length;
+            // If-Range needs a strong validator, a weak ETag falls back to the modification time
+            validator = http->GetResponseHeader("ETag");
+            if (validator.empty() || validator.rfind("W/", 0) == 0) {
+                validator = http->GetResponseHeader("Last-Modified");
+            }
+        } else {
+            ESP_LOGE(TAG, "Failed to download, status code: %d, content length: %u", status, (unsigned)body_length);
+            http->Close();
+            if (status >= 400 && status < 500 && status != 408 && status != 429) {
+                break;  // Retrying will not help
+            }
+            continue;
+        }
+
+        save_journal();
+        success = Run(http.get(), committed, length - committed, callback) && committed == length;
+        http->Close();
+        if (!success) {
+            save_journal();
+        }
+        if (header_rejected_) {
+            break;  // The server sends something else, retrying will not help
+        }
+    }
+    on_written_ = nullptr;
+
+    if (success) {
+        Settings settings(journal, true);
+        settings.EraseAll();
+    }
+    return success;
+}
@@ -0,0 +1,109 @@
+#ifndef _DOWNLOAD_PIPELINE_H
+#define _DOWNLOAD_PIPELINE_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <esp_err.h>
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <http.h>
+
+/**
+ * Streams an HTTP response body into a flash partition with network and flash work overlapped.
+ *
+ * The calling task reads the body into a ring of chunk buffers (in PSRAM when available) while a
+ * writer task programs them into the partition. Whenever the writer has nothing to program it
+ * erases the sectors ahead of the write cursor, so most erasing happens while waiting for the
+ * network. Chunk size and count come from CONFIG_DOWNLOAD_CHUNK_SIZE_KB and
+ * CONFIG_DOWNLOAD_CHUNK_COUNT.
+ *
+ * Download() adds resuming on top: progress is journaled in NVS (offset and CRC32 of the data
+ * written so far, and the ETag or Last-Modified of the file), so an interrupted download
+ * continues with an HTTP Range request once the data already in flash has been verified against
+ * the journal. If-Range makes the server send the whole file instead when it has changed.
+ */
+class DownloadPipeline {
+public:
+    using ProgressCallback = std::function<void(int progress, size_t speed)>;
+    // Same contract as Http::Read: bytes read, 0 at the end, negative on error
+    using ReadFunction = std::function<int(uint8_t* buffer, size_t size)>;
+    // Inspects the data that goes to offset 0 before anything is written, false rejects it
+    using HeaderCheck = std::function<bool(const uint8_t* data, size_t size)>;
+
+    struct Stats {
+        size_t bytes = 0;
+        int64_t total_us = 0;
+        int64_t read_us = 0;         // Reader blocked reading the source
+        int64_t reader_wait_us = 0;  // Reader waiting for a free chunk, flash bound
+        int64_t write_us = 0;        // Writer programming flash
+        int64_t erase_us = 0;        // Writer erasing flash
+        int64_t writer_idle_us = 0;  // Writer waiting with nothing left to erase, network bound
+    };
+
+    explicit DownloadPipeline(const esp_partition_t* partition);
+    ~DownloadPipeline();
+
+    /**
+     * Write `length` bytes of the response body to the partition at `offset`, which must be
+     * sector aligned. The sectors covering the data are erased as needed.
+     */
+    bool Run(Http* http, size_t offset, size_t length, ProgressCallback callback);
+
+    // Same as above with the data produced by `read`, such as a patch being applied
+    bool Run(ReadFunction read, size_t offset, size_t length, ProgressCallback callback);
+
+    /**
+     * Download `url` into the partition from offset 0, resuming from the journal in the NVS
+     * namespace `journal` and retrying failed attempts with exponential backoff. The journal
+     * is cleared on success. Returns the body length in `length`.
+     */
+    bool Download(const std::string& url, const char* journal, ProgressCallback callback, size_t& length);
+
+    /**
+     * Check the start of the data before the first chunk is written, such as an image magic.
+     * A rejected download fails without retrying.
+     */
+    void SetHeaderCheck(HeaderCheck check) { header_check_ = std::move(check); }
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    struct Chunk {
+        uint8_t* data;
+        size_t size;
+        size_t offset;
+    };
+
+    const esp_partition_t* partition_;
+    size_t sector_size_;
+    size_t chunk_size_;
+    size_t chunk_count_;
+    std::vector<uint8_t*> buffers_;
+    QueueHandle_t free_queue_ = nullptr;
+    QueueHandle_t full_queue_ = nullptr;
+    SemaphoreHandle_t writer_done_ = nullptr;
+    std::atomic<esp_err_t> write_error_{ESP_OK};
+    HeaderCheck header_check_;
+    bool header_rejected_ = false;
+    size_t erase_cursor_ = 0;
+    size_t erase_end_ = 0;
+    Stats stats_;
+
+    // Called by the writer task after each chunk has been programmed
+    std::function<void(const Chunk& chunk)> on_written_;
+
+    bool AllocateBuffers();
+    void FreeBuffers();
+    void WriterTask();
+    esp_err_t EraseNext();
+    esp_err_t WriteChunk(Chunk& chunk);
+    void LogStats() const;
+    bool VerifyWritten(size_t length, uint32_t crc);
+};
+
+#endif // _DOWNLOAD_PIPELINE_H
@@ -15,6 +15,7 @@
 #include "oled_display.h"
 #include "board.h"
 #include "settings.h"
+#include "boot_graph.h"
 #include "lvgl_theme.h"
 #include "lvgl_display.h"
 
@@ -135,6 +136,13 @@ void McpServer::AddUserOnlyTools() {
             return board.GetSystemInfoJson();
         });
 
+    AddUserOnlyTool("self.get_boot_timeline",
+        "Get the start and end time in microseconds since power on of each boot step",
+        PropertyList(),
+        [this](const PropertyList& properties) -> ReturnValue {
+            return BootTimeline::GetInstance().ToJson();
+        });
+
     AddUserOnlyTool("self.reboot", "Reboot the system",
         PropertyList(),
         [this](const PropertyList& properties) -> ReturnValue {
@@ -196,13 +204,6 @@ void McpServer::AddUserOnlyTools() {
                 auto url = properties["url"].value<std::string>();
                 auto quality = properties["quality"].value<int>();
 
-                std::string jpeg_data;
-                if (!display->SnapshotToJpeg(jpeg_data, quality)) {
-                    throw std::runtime_error("Failed to snapshot screen");
-                }
-
-                ESP_LOGI(TAG, "Upload snapshot %u bytes to %s", jpeg_data.size(), url.c_str());
-                
                 // 构造multipart/form-data请求体
                 std::string boundary = "----ESP32_SCREEN_SNAPSHOT_BOUNDARY";
                 
@@ -221,8 +222,25 @@ void McpServer::AddUserOnlyTools() {
                     http->Write(file_header.c_str(), file_header.size());
                 }
 
-                // JPEG数据
-                http->Write((const char*)jpeg_data.data(), jpeg_data.size());
+                // JPEG数据：编码完成、释放显示锁后再上传，只缓存压缩后的数据
+                size_t jpeg_size = 0;
+                bool write_failed = false;
+                bool ok = display->SnapshotToJpeg([&http, &jpeg_size, &write_failed](const void* data, size_t len) {
+                    if (http->Write(static_cast<const char*>(data), len) < 0) {
+                        write_failed = true;
+                        return false;
+                    }
+                    jpeg_size += len;
+                    return true;
+                }, quality);
+                if (!ok) {
+                    http->Close();
+                    if (write_failed) {
+                        throw std::runtime_error("Failed to upload snapshot to URL: " + url);
+                    }
+                    throw std::runtime_error("Failed to snapshot screen");
+                }
+                ESP_LOGI(TAG, "Uploaded snapshot %u bytes to %s", jpeg_size, url.c_str());
 
                 {
                     // multipart尾部
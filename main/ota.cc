@@ -2,6 +2,9 @@
 #include "system_info.h"
 #include "settings.h"
 #include "assets/lang_config.h"
+#include "download_pipeline.h"
+#include "delta_patch.h"
+#include "application.h"
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -10,20 +13,26 @@
 #include <esp_partition.h>
 #include <esp_ota_ops.h>
 #include <esp_app_format.h>
+#include <esp_image_format.h>
 #include <esp_efuse.h>
 #include <esp_efuse_table.h>
 #include <esp_heap_caps.h>
+#include <esp_timer.h>
 #ifdef SOC_HMAC_SUPPORTED
 #include <esp_hmac.h>
 #endif
 
 #include <cstring>
+#include <ctime>
 #include <vector>
 #include <sstream>
 #include <algorithm>
 
 #define TAG "Ota"
 
+// Earlier times mean the clock has not been set since power on
+static constexpr time_t kMinValidTime = 1735689600;  // 2025-01-01
+
 
 Ota::Ota() {
 #ifdef ESP_EFUSE_BLOCK_USR_DATA
@@ -75,7 +84,6 @@ std::unique_ptr<Http> Ota::SetupHttp() {
  * Specification: https://ccnphfhqs21z.feishu.cn/wiki/FjW6wZmisimNBBkov6OcmfvknVd
  */
 esp_err_t Ota::CheckVersion() {
-    auto& board = Board::GetInstance();
     auto app_desc = esp_app_get_description();
 
     // Check if there is a new firmware version available
@@ -88,7 +96,30 @@ esp_err_t Ota::CheckVersion() {
         return ESP_ERR_INVALID_ARG;
     }
 
+    // A recent response that asked for nothing is applied at once and revalidated in the background
+    std::string cached;
+    std::string etag;
+    int age;
+    bool has_cache = LoadCachedCheckVersion(url, cached, etag, age);
+    if (has_cache && age >= 0 && age <= CONFIG_OTA_CHECK_CACHE_TTL_SECONDS &&
+        ParseCheckVersionResponse(cached, true) == ESP_OK) {
+        ESP_LOGI(TAG, "Using the check version response from %d seconds ago", age);
+        check_version_source_ = "cache";
+        RevalidateInBackground(url, cached, etag);
+        return ESP_OK;
+    }
+
+    // A 304 carries no server time, so only ask for one while the clock is set
+    check_version_source_ = "network";
+    return FetchCheckVersion(url, cached, has_cache && age >= 0 ? etag : "");
+}
+
+esp_err_t Ota::FetchCheckVersion(const std::string& url, const std::string& cached, const std::string& etag) {
+    auto& board = Board::GetInstance();
     auto http = SetupHttp();
+    if (!etag.empty()) {
+        http->SetHeader("If-None-Match", etag);
+    }
 
     std::string data = board.GetSystemInfoJson();
     std::string method = data.length() > 0 ? "POST" : "GET";
@@ -101,15 +132,69 @@ esp_err_t Ota::CheckVersion() {
     }
 
     auto status_code = http->GetStatusCode();
+    if (status_code == 304 && !etag.empty()) {
+        http->Close();
+        ESP_LOGI(TAG, "Check version response not modified");
+        esp_err_t err = ParseCheckVersionResponse(cached, true);
+        if (err == ESP_OK) {
+            check_version_source_ = "revalidated";
+            TouchCachedCheckVersion();
+        }
+        return err;
+    }
     if (status_code != 200) {
         ESP_LOGE(TAG, "Failed to check version, status code: %d", status_code);
         return status_code;
     }
 
+    std::string response_etag = http->GetResponseHeader("ETag");
     data = http->ReadAll();
     http->Close();
 
-    // Response: { "firmware": { "version": "1.0.0", "url": "http://" } }
+    esp_err_t err = ParseCheckVersionResponse(data, false);
+    if (err == ESP_OK) {
+        SaveCachedCheckVersion(url, data, response_etag);
+    }
+    return err;
+}
+
+void Ota::RevalidateInBackground(const std::string& url, const std::string& cached, const std::string& etag) {
+    struct Revalidation {
+        Ota ota;
+        std::string url;
+        std::string cached;
+        std::string etag;
+    };
+    auto revalidation = new Revalidation();
+    revalidation->ota.current_version_ = current_version_;
+    revalidation->url = url;
+    revalidation->cached = cached;
+    revalidation->etag = etag;
+    xTaskCreate([](void* arg) {
+        auto revalidation = static_cast<Revalidation*>(arg);
+        auto& ota = revalidation->ota;
+        int64_t start_time = esp_timer_get_time();
+        esp_err_t err = ota.FetchCheckVersion(revalidation->url, revalidation->cached, revalidation->etag);
+        ESP_LOGI(TAG, "Revalidated the cached check version response in %d ms, err=%d",
+            (int)((esp_timer_get_time() - start_time) / 1000), err);
+        if (err == ESP_OK && ota.has_new_version_) {
+            // Upgrade like a check at boot would have, once nobody is talking to the device
+            auto& app = Application::GetInstance();
+            app.Schedule([&app, url = ota.firmware_url_, version = ota.firmware_version_]() {
+                if (app.GetDeviceState() == kDeviceStateIdle) {
+                    app.UpgradeFirmware(url, version);
+                }
+            });
+        } else if (err == ESP_OK && (ota.has_activation_code_ || ota.has_activation_challenge_)) {
+            ESP_LOGW(TAG, "Server asks for activation, it will be done at the next boot");
+        }
+        delete revalidation;
+        vTaskDelete(NULL);
+    }, "ota_revalidate", 4096 * 2, revalidation, 1, nullptr);
+}
+
+esp_err_t Ota::ParseCheckVersionResponse(const std::string& data, bool from_cache) {
+    // Response: { "firmware": { "version": "1.0.0", "url": "http://", "delta_url": "http://" } }
     // Parse the JSON response and check if the version is newer
     // If it is, set has_new_version_ to true and store the new version and URL
     
@@ -187,7 +272,10 @@ esp_err_t Ota::CheckVersion() {
 
     has_server_time_ = false;
     cJSON *server_time = cJSON_GetObjectItem(root, "server_time");
-    if (cJSON_IsObject(server_time)) {
+    if (from_cache) {
+        // The cached time is stale, but a cached response is only used while the clock is set
+        has_server_time_ = true;
+    } else if (cJSON_IsObject(server_time)) {
         cJSON *timestamp = cJSON_GetObjectItem(server_time, "timestamp");
         cJSON *timezone_offset = cJSON_GetObjectItem(server_time, "timezone_offset");
         
@@ -221,6 +309,9 @@ esp_err_t Ota::CheckVersion() {
         if (cJSON_IsString(url)) {
             firmware_url_ = url->valuestring;
         }
+        // Optional patch from the running version to this one, made by scripts/firmware_delta.py
+        cJSON *delta_url = cJSON_GetObjectItem(firmware, "delta_url");
+        firmware_delta_url_ = cJSON_IsString(delta_url) ? delta_url->valuestring : "";
 
         if (cJSON_IsString(version) && cJSON_IsString(url)) {
             // Check if the version is newer, for example, 0.1.0 is newer than 0.0.1
@@ -244,6 +335,48 @@ esp_err_t Ota::CheckVersion() {
     return ESP_OK;
 }
 
+bool Ota::LoadCachedCheckVersion(const std::string& url, std::string& data, std::string& etag, int& age) {
+    if (CONFIG_OTA_CHECK_CACHE_TTL_SECONDS == 0) {
+        return false;
+    }
+    Settings settings("ota_cache", false);
+    if (settings.GetString("url") != url || settings.GetString("version") != current_version_) {
+        return false;
+    }
+    data = settings.GetString("response");
+    etag = settings.GetString("etag");
+
+    // The clock survives a software reset but not a power cycle
+    time_t now = time(nullptr);
+    int32_t saved_time = settings.GetInt("time");
+    age = now >= kMinValidTime && now >= saved_time ? now - saved_time : -1;
+    return !data.empty();
+}
+
+void Ota::SaveCachedCheckVersion(const std::string& url, const std::string& data, const std::string& etag) {
+    Settings settings("ota_cache", true);
+    time_t now = time(nullptr);
+    // Anything that needs the server again, and responses too long for an NVS string, is not kept
+    if (CONFIG_OTA_CHECK_CACHE_TTL_SECONDS == 0 || has_new_version_ || has_activation_code_ ||
+        has_activation_challenge_ || now < kMinValidTime || data.size() >= 4000) {
+        settings.EraseAll();
+        return;
+    }
+    settings.SetString("url", url);
+    settings.SetString("version", current_version_);
+    settings.SetString("response", data);
+    settings.SetString("etag", etag);
+    settings.SetInt("time", now);
+}
+
+void Ota::TouchCachedCheckVersion() {
+    time_t now = time(nullptr);
+    if (now >= kMinValidTime) {
+        Settings settings("ota_cache", true);
+        settings.SetInt("time", now);
+    }
+}
+
 void Ota::MarkCurrentVersionValid() {
     auto partition = esp_ota_get_running_partition();
     if (strcmp(partition->label, "factory") == 0) {
@@ -264,130 +397,110 @@ void Ota::MarkCurrentVersionValid() {
     }
 }
 
-bool Ota::Upgrade(const std::string& firmware_url, std::function<void(int progress, size_t speed)> callback) {
-    ESP_LOGI(TAG, "Upgrading firmware from %s", firmware_url.c_str());
-    esp_ota_handle_t update_handle = 0;
-    auto update_partition = esp_ota_get_next_update_partition(NULL);
-    if (update_partition == NULL) {
-        ESP_LOGE(TAG, "Failed to get update partition");
-        return false;
-    }
-
-    ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", update_partition->label, update_partition->address);
-    bool image_header_checked = false;
-    std::string image_header;
-
+bool Ota::ApplyDelta(const std::string& delta_url, const esp_partition_t* partition,
+    std::function<void(int progress, size_t speed)> callback) {
+    ESP_LOGI(TAG, "Applying firmware patch from %s", delta_url.c_str());
+    auto running_partition = esp_ota_get_running_partition();
     auto network = Board::GetInstance().GetNetwork();
     auto http = network->CreateHttp(0);
-    if (!http->Open("GET", firmware_url)) {
+    if (!http->Open("GET", delta_url)) {
         ESP_LOGE(TAG, "Failed to open HTTP connection");
         return false;
     }
-
     if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get firmware, status code: %d", http->GetStatusCode());
+        ESP_LOGE(TAG, "Failed to get firmware patch, status code: %d", http->GetStatusCode());
+        http->Close();
         return false;
     }
 
-    size_t content_length = http->GetBodyLength();
-    if (content_length == 0) {
-        ESP_LOGE(TAG, "Failed to get content length");
+    // The running image is the base, the rebuilt image goes through the same writer as a download
+    DeltaPatch patch([&http](uint8_t* buffer, size_t size) {
+        return http->Read(reinterpret_cast<char*>(buffer), size);
+    }, [running_partition](size_t offset, uint8_t* buffer, size_t size) {
+        return esp_partition_read(running_partition, offset, buffer, size) == ESP_OK;
+    });
+    if (!patch.Begin() || patch.base_size() > running_partition->size) {
+        http->Close();
         return false;
     }
 
-    constexpr size_t PAGE_SIZE = 4096;
-    char* buffer = (char*)heap_caps_malloc(PAGE_SIZE, MALLOC_CAP_INTERNAL);
-    if (buffer == nullptr) {
-        ESP_LOGE(TAG, "Failed to allocate buffer");
-        return false;
+    DownloadPipeline pipeline(partition);
+    bool success = pipeline.Run([&patch](uint8_t* buffer, size_t size) {
+        return patch.Read(buffer, size);
+    }, 0, patch.target_size(), callback) && patch.Verify();
+    http->Close();
+    if (success) {
+        ESP_LOGI(TAG, "Rebuilt %u bytes of firmware from a patch", (unsigned)patch.target_size());
     }
+    return success;
+}
 
-    size_t buffer_offset = 0;  // Current data size in buffer
-    size_t total_read = 0, recent_read = 0;
-    auto last_calc_time = esp_timer_get_time();
-    while (true) {
-        int ret = http->Read(buffer + buffer_offset, PAGE_SIZE - buffer_offset);
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
-            heap_caps_free(buffer);
-            return false;
-        }
+bool Ota::Upgrade(const std::string& firmware_url, std::function<void(int progress, size_t speed)> callback,
+    const std::string& delta_url) {
+    ESP_LOGI(TAG, "Upgrading firmware from %s", firmware_url.c_str());
+    auto update_partition = esp_ota_get_next_update_partition(NULL);
+    if (update_partition == NULL) {
+        ESP_LOGE(TAG, "Failed to get update partition");
+        return false;
+    }
 
-        // Calculate speed and progress every second
-        recent_read += ret;
-        total_read += ret;
-        buffer_offset += ret;
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || ret == 0) {
-            size_t progress = total_read * 100 / content_length;
-            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", progress, total_read, content_length, recent_read);
-            if (callback) {
-                callback(progress, recent_read);
-            }
-            last_calc_time = esp_timer_get_time();
-            recent_read = 0;
-        }
+    ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", update_partition->label, update_partition->address);
 
-        if (!image_header_checked) {
-            image_header.append(buffer, buffer_offset);
-            if (image_header.size() >= sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
-                esp_app_desc_t new_app_info;
-                memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
-
-                if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
-                    esp_ota_abort(update_handle);
-                    ESP_LOGE(TAG, "Failed to begin OTA");
-                    heap_caps_free(buffer);
-                    return false;
-                }
+    // The partition is written directly below, but esp_ota_begin() still performs the checks that
+    // must pass before anything is erased: the target is not the running partition, and with
+    // rollback enabled the running image is not waiting to be marked valid (its rollback image
+    // would be erased). Sequential writes mode erases nothing, so the handle is simply aborted.
+    esp_ota_handle_t update_handle = 0;
+    esp_err_t err = esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to begin OTA: %s", esp_err_to_name(err));
+        return false;
+    }
+    esp_ota_abort(update_handle);
 
-                image_header_checked = true;
-                std::string().swap(image_header);
-            }
+    // A patch is much smaller than the image; if it does not apply, download the full image instead
+    bool patched = !delta_url.empty() && ApplyDelta(delta_url, update_partition, callback);
+    if (!patched) {
+        if (!delta_url.empty()) {
+            ESP_LOGW(TAG, "Firmware patch failed, downloading the full image");
         }
 
-        // Write to flash when buffer is full (4KB) or it's the last chunk
-        bool is_last_chunk = (ret == 0);
-        if (buffer_offset == PAGE_SIZE || (is_last_chunk && buffer_offset > 0)) {
-            auto err = esp_ota_write(update_handle, buffer, buffer_offset);
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
-                esp_ota_abort(update_handle);
-                heap_caps_free(buffer);
+        // The pipeline erases and programs the partition directly, so that erasing can run ahead of
+        // the write cursor while waiting for the network. An interrupted download resumes from the
+        // journal. Like esp_ota_write(), data that does not start with the image magic is rejected.
+        DownloadPipeline pipeline(update_partition);
+        pipeline.SetHeaderCheck([](const uint8_t* data, size_t size) {
+            if (data[0] != ESP_IMAGE_HEADER_MAGIC) {
+                ESP_LOGE(TAG, "Invalid image magic 0x%02x", data[0]);
                 return false;
             }
-
-            buffer_offset = 0;
-        }
-
-        if (is_last_chunk) {
-            break;
+            return true;
+        });
+        size_t firmware_size = 0;
+        if (!pipeline.Download(firmware_url, "ota_journal", callback, firmware_size)) {
+            return false;
         }
+        ESP_LOGI(TAG, "Downloaded %u bytes of firmware", (unsigned)firmware_size);
     }
-    http->Close();
-    heap_caps_free(buffer);
 
-    esp_err_t err = esp_ota_end(update_handle);
+    // esp_ota_set_boot_partition() verifies the image the same way esp_ota_end() would (segments,
+    // checksum, hash and signature when enabled) before it touches otadata
+    err = esp_ota_set_boot_partition(update_partition);
     if (err != ESP_OK) {
         if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
             ESP_LOGE(TAG, "Image validation failed, image is corrupted");
         } else {
-            ESP_LOGE(TAG, "Failed to end OTA: %s", esp_err_to_name(err));
+            ESP_LOGE(TAG, "Failed to set boot partition: %s", esp_err_to_name(err));
         }
         return false;
     }
 
-    err = esp_ota_set_boot_partition(update_partition);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set boot partition: %s", esp_err_to_name(err));
-        return false;
-    }
-
     ESP_LOGI(TAG, "Firmware upgrade successful");
     return true;
 }
 
 bool Ota::StartUpgrade(std::function<void(int progress, size_t speed)> callback) {
-    return Upgrade(firmware_url_, callback);
+    return Upgrade(firmware_url_, callback, firmware_delta_url_);
 }
 
 
@@ -5,6 +5,7 @@
 #include <string>
 
 #include <esp_err.h>
+#include <esp_partition.h>
 #include "board.h"
 
 class Ota {
@@ -21,15 +22,19 @@ public:
     bool HasActivationCode() { return has_activation_code_; }
     bool HasServerTime() { return has_server_time_; }
     bool StartUpgrade(std::function<void(int progress, size_t speed)> callback);
-    static bool Upgrade(const std::string& firmware_url, std::function<void(int progress, size_t speed)> callback);
+    static bool Upgrade(const std::string& firmware_url, std::function<void(int progress, size_t speed)> callback,
+        const std::string& delta_url = "");
     void MarkCurrentVersionValid();
 
     const std::string& GetFirmwareVersion() const { return firmware_version_; }
     const std::string& GetCurrentVersion() const { return current_version_; }
     const std::string& GetFirmwareUrl() const { return firmware_url_; }
+    const std::string& GetFirmwareDeltaUrl() const { return firmware_delta_url_; }
     const std::string& GetActivationMessage() const { return activation_message_; }
     const std::string& GetActivationCode() const { return activation_code_; }
     std::string GetCheckVersionUrl();
+    // "network", "cache" (revalidated in the background) or "revalidated" (304 from the server)
+    const char* GetCheckVersionSource() const { return check_version_source_; }
 
 private:
     std::string activation_message_;
@@ -44,15 +49,25 @@ private:
     std::string current_version_;
     std::string firmware_version_;
     std::string firmware_url_;
+    std::string firmware_delta_url_;
     std::string activation_challenge_;
     std::string serial_number_;
     int activation_timeout_ms_ = 30000;
+    const char* check_version_source_ = "network";
 
     std::function<void(int progress, size_t speed)> upgrade_callback_;
     std::vector<int> ParseVersion(const std::string& version);
     bool IsNewVersionAvailable(const std::string& currentVersion, const std::string& newVersion);
     std::string GetActivationPayload();
     std::unique_ptr<Http> SetupHttp();
+    esp_err_t FetchCheckVersion(const std::string& url, const std::string& cached, const std::string& etag);
+    void RevalidateInBackground(const std::string& url, const std::string& cached, const std::string& etag);
+    esp_err_t ParseCheckVersionResponse(const std::string& data, bool from_cache);
+    bool LoadCachedCheckVersion(const std::string& url, std::string& data, std::string& etag, int& age);
+    void SaveCachedCheckVersion(const std::string& url, const std::string& data, const std::string& etag);
+    void TouchCachedCheckVersion();
+    static bool ApplyDelta(const std::string& delta_url, const esp_partition_t* partition,
+        std::function<void(int progress, size_t speed)> callback);
 };
 
 #endif // _OTA_H
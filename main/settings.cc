@@ -1,88 +1,367 @@
 #include "settings.h"
 
 #include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
 #include <nvs_flash.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
 
 #define TAG "Settings"
 
+namespace {
+
+struct Entry {
+    nvs_type_t type = NVS_TYPE_ANY;
+    int32_t number = 0;
+    std::string text;
+    std::shared_ptr<const std::string> shared;  // Copy of `text` handed out by GetStringView()
+    bool dirty = false;
+};
+
+struct Namespace {
+    std::map<std::string, Entry, std::less<>> entries;
+    std::set<std::string> erased;
+    bool erase_all = false;
+    bool dirty = false;
+};
+
+class SettingsCache {
+public:
+    static SettingsCache& GetInstance() {
+        static SettingsCache instance;
+        return instance;
+    }
+
+    std::mutex mutex_;
+
+    // Must be called with mutex_ held
+    Namespace& Get(const std::string& ns) {
+        auto it = namespaces_.find(ns);
+        if (it == namespaces_.end()) {
+            it = namespaces_.emplace(ns, Load(ns)).first;
+        }
+        return it->second;
+    }
+
+    // Must be called with mutex_ held
+    Entry* Find(const std::string& ns, const std::string& key, nvs_type_t type) {
+        auto& space = Get(ns);
+        auto it = space.entries.find(key);
+        if (it == space.entries.end() || it->second.type != type) {
+            return nullptr;
+        }
+        return &it->second;
+    }
+
+    void Set(const std::string& ns, const std::string& key, nvs_type_t type, int32_t number, const std::string& text) {
+        std::vector<Settings::ChangeCallback> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& space = Get(ns);
+            auto [it, inserted] = space.entries.try_emplace(key);
+            auto& entry = it->second;
+            if (!inserted && entry.type == type && entry.number == number && entry.text == text) {
+                return;
+            }
+            entry.type = type;
+            entry.number = number;
+            entry.text = text;
+            entry.shared.reset();
+            entry.dirty = true;
+            space.erased.erase(key);
+            space.dirty = true;
+            callbacks = CallbacksFor(ns);
+        }
+        ScheduleCommit();
+        Notify(callbacks, key);
+    }
+
+    void Erase(const std::string& ns, const std::string& key) {
+        std::vector<Settings::ChangeCallback> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& space = Get(ns);
+            if (space.entries.erase(key) == 0) {
+                return;
+            }
+            if (!space.erase_all) {
+                space.erased.insert(key);
+            }
+            space.dirty = true;
+            callbacks = CallbacksFor(ns);
+        }
+        ScheduleCommit();
+        Notify(callbacks, key);
+    }
+
+    void EraseAll(const std::string& ns) {
+        std::vector<Settings::ChangeCallback> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& space = Get(ns);
+            space.entries.clear();
+            space.erased.clear();
+            space.erase_all = true;
+            space.dirty = true;
+            callbacks = CallbacksFor(ns);
+        }
+        ScheduleCommit();
+        Notify(callbacks, "");
+    }
+
+    void AddCallback(const std::string& ns, Settings::ChangeCallback callback) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        callbacks_.emplace_back(ns, std::move(callback));
+    }
+
+    void Flush() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        esp_timer_stop(commit_timer_);
+        int64_t start_time = esp_timer_get_time();
+        int count = 0;
+        bool failed = false;
+        for (auto& [ns, space] : namespaces_) {
+            if (!space.dirty) {
+                continue;
+            }
+            esp_err_t err = Commit(ns, space);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to commit namespace %s: %s", ns.c_str(), esp_err_to_name(err));
+                failed = true;
+                continue;
+            }
+            count++;
+        }
+        if (failed) {
+            // The namespaces that failed are still dirty, try again later
+            esp_timer_start_once(commit_timer_, CONFIG_SETTINGS_COMMIT_DELAY_MS * 1000);
+        }
+        if (count > 0) {
+            ESP_LOGI(TAG, "Committed %d namespaces in %d ms", count, (int)((esp_timer_get_time() - start_time) / 1000));
+        }
+    }
+
+private:
+    std::map<std::string, Namespace> namespaces_;
+    std::vector<std::pair<std::string, Settings::ChangeCallback>> callbacks_;
+    esp_timer_handle_t commit_timer_ = nullptr;
+    SemaphoreHandle_t commit_request_ = nullptr;
+
+    SettingsCache() {
+        // nvs_commit() can wait for a flash erase, which must not hold up the other esp_timer callbacks
+        commit_request_ = xSemaphoreCreateBinary();
+        if (xTaskCreate([](void* arg) {
+                auto cache = static_cast<SettingsCache*>(arg);
+                while (true) {
+                    xSemaphoreTake(cache->commit_request_, portMAX_DELAY);
+                    cache->Flush();
+                }
+            }, "settings_commit", 4096, this, 1, nullptr) != pdPASS) {
+            ESP_LOGW(TAG, "Failed to create the commit task, committing on the timer task");
+            vSemaphoreDelete(commit_request_);
+            commit_request_ = nullptr;
+        }
+
+        esp_timer_create_args_t timer_args = {
+            .callback = [](void* arg) {
+                auto cache = static_cast<SettingsCache*>(arg);
+                if (cache->commit_request_ != nullptr) {
+                    xSemaphoreGive(cache->commit_request_);
+                } else {
+                    cache->Flush();
+                }
+            },
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "settings_commit",
+            .skip_unhandled_events = true,
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&timer_args, &commit_timer_));
+        // Pending writes are not lost to a software reset
+        esp_register_shutdown_handler([]() {
+            SettingsCache::GetInstance().Flush();
+        });
+    }
+
+    static Namespace Load(const std::string& ns) {
+        Namespace space;
+        nvs_handle_t handle;
+        if (nvs_open(ns.c_str(), NVS_READONLY, &handle) != ESP_OK) {
+            return space;
+        }
+        nvs_iterator_t it = nullptr;
+        esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, ns.c_str(), NVS_TYPE_ANY, &it);
+        while (err == ESP_OK) {
+            nvs_entry_info_t info;
+            nvs_entry_info(it, &info);
+            Entry entry;
+            entry.type = info.type;
+            if (info.type == NVS_TYPE_STR) {
+                size_t length = 0;
+                if (nvs_get_str(handle, info.key, nullptr, &length) == ESP_OK && length > 0) {
+                    entry.text.resize(length);
+                    nvs_get_str(handle, info.key, entry.text.data(), &length);
+                    while (!entry.text.empty() && entry.text.back() == '\0') {
+                        entry.text.pop_back();
+                    }
+                }
+                space.entries.emplace(info.key, std::move(entry));
+            } else if (info.type == NVS_TYPE_I32) {
+                nvs_get_i32(handle, info.key, &entry.number);
+                space.entries.emplace(info.key, std::move(entry));
+            } else if (info.type == NVS_TYPE_U8) {
+                uint8_t value = 0;
+                nvs_get_u8(handle, info.key, &value);
+                entry.number = value;
+                space.entries.emplace(info.key, std::move(entry));
+            }
+            err = nvs_entry_next(&it);
+        }
+        nvs_release_iterator(it);
+        nvs_close(handle);
+        return space;
+    }
+
+    // Must be called with mutex_ held. Everything is written again if any step fails, so the
+    // namespace is only marked clean once it has been committed completely
+    static esp_err_t Commit(const std::string& ns, Namespace& space) {
+        nvs_handle_t handle;
+        esp_err_t err = nvs_open(ns.c_str(), NVS_READWRITE, &handle);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (space.erase_all) {
+            err = nvs_erase_all(handle);
+        }
+        for (auto it = space.erased.begin(); err == ESP_OK && it != space.erased.end(); ++it) {
+            err = nvs_erase_key(handle, it->c_str());
+            if (err == ESP_ERR_NVS_NOT_FOUND) {
+                err = ESP_OK;
+            }
+        }
+        for (auto it = space.entries.begin(); err == ESP_OK && it != space.entries.end(); ++it) {
+            auto& [key, entry] = *it;
+            if (!entry.dirty) {
+                continue;
+            }
+            if (entry.type == NVS_TYPE_STR) {
+                err = nvs_set_str(handle, key.c_str(), entry.text.c_str());
+            } else if (entry.type == NVS_TYPE_I32) {
+                err = nvs_set_i32(handle, key.c_str(), entry.number);
+            } else {
+                err = nvs_set_u8(handle, key.c_str(), entry.number);
+            }
+        }
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+        if (err != ESP_OK) {
+            return err;
+        }
+        for (auto& [key, entry] : space.entries) {
+            entry.dirty = false;
+        }
+        space.erased.clear();
+        space.erase_all = false;
+        space.dirty = false;
+        return ESP_OK;
+    }
+
+    // Must be called with mutex_ held
+    std::vector<Settings::ChangeCallback> CallbacksFor(const std::string& ns) {
+        std::vector<Settings::ChangeCallback> callbacks;
+        for (auto& [callback_ns, callback] : callbacks_) {
+            if (callback_ns == ns) {
+                callbacks.push_back(callback);
+            }
+        }
+        return callbacks;
+    }
+
+    static void Notify(const std::vector<Settings::ChangeCallback>& callbacks, const std::string& key) {
+        for (auto& callback : callbacks) {
+            callback(key);
+        }
+    }
+
+    void ScheduleCommit() {
+        // Writes close together are committed together. A pending commit is not pushed back, or
+        // writes arriving more often than the delay would never be committed
+        if (!esp_timer_is_active(commit_timer_)) {
+            esp_timer_start_once(commit_timer_, CONFIG_SETTINGS_COMMIT_DELAY_MS * 1000);
+        }
+    }
+};
+
+} // namespace
+
 Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
-    nvs_open(ns.c_str(), read_write_ ? NVS_READWRITE : NVS_READONLY, &nvs_handle_);
 }
 
 Settings::~Settings() {
-    if (nvs_handle_ != 0) {
-        if (read_write_ && dirty_) {
-            ESP_ERROR_CHECK(nvs_commit(nvs_handle_));
-        }
-        nvs_close(nvs_handle_);
-    }
 }
 
 std::string Settings::GetString(const std::string& key, const std::string& default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
+    auto& cache = SettingsCache::GetInstance();
+    std::lock_guard<std::mutex> lock(cache.mutex_);
+    auto entry = cache.Find(ns_, key, NVS_TYPE_STR);
+    return entry != nullptr ? entry->text : default_value;
+}
 
-    size_t length = 0;
-    if (nvs_get_str(nvs_handle_, key.c_str(), nullptr, &length) != ESP_OK) {
-        return default_value;
+std::shared_ptr<const std::string> Settings::GetStringView(const std::string& key, const std::string& default_value) {
+    auto& cache = SettingsCache::GetInstance();
+    std::lock_guard<std::mutex> lock(cache.mutex_);
+    auto entry = cache.Find(ns_, key, NVS_TYPE_STR);
+    if (entry == nullptr) {
+        return std::make_shared<const std::string>(default_value);
     }
-
-    std::string value;
-    value.resize(length);
-    ESP_ERROR_CHECK(nvs_get_str(nvs_handle_, key.c_str(), value.data(), &length));
-    while (!value.empty() && value.back() == '\0') {
-        value.pop_back();
+    if (entry->shared == nullptr) {
+        entry->shared = std::make_shared<const std::string>(entry->text);
     }
-    return value;
+    return entry->shared;
 }
 
 void Settings::SetString(const std::string& key, const std::string& value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_str(nvs_handle_, key.c_str(), value.c_str()));
-        dirty_ = true;
+        SettingsCache::GetInstance().Set(ns_, key, NVS_TYPE_STR, 0, value);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
-
-    int32_t value;
-    if (nvs_get_i32(nvs_handle_, key.c_str(), &value) != ESP_OK) {
-        return default_value;
-    }
-    return value;
+    auto& cache = SettingsCache::GetInstance();
+    std::lock_guard<std::mutex> lock(cache.mutex_);
+    auto entry = cache.Find(ns_, key, NVS_TYPE_I32);
+    return entry != nullptr ? entry->number : default_value;
 }
 
 void Settings::SetInt(const std::string& key, int32_t value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_i32(nvs_handle_, key.c_str(), value));
-        dirty_ = true;
+        SettingsCache::GetInstance().Set(ns_, key, NVS_TYPE_I32, value, "");
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 bool Settings::GetBool(const std::string& key, bool default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
-
-    uint8_t value;
-    if (nvs_get_u8(nvs_handle_, key.c_str(), &value) != ESP_OK) {
-        return default_value;
-    }
-    return value != 0;
+    auto& cache = SettingsCache::GetInstance();
+    std::lock_guard<std::mutex> lock(cache.mutex_);
+    auto entry = cache.Find(ns_, key, NVS_TYPE_U8);
+    return entry != nullptr ? entry->number != 0 : default_value;
 }
 
 void Settings::SetBool(const std::string& key, bool value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_u8(nvs_handle_, key.c_str(), value ? 1 : 0));
-        dirty_ = true;
+        SettingsCache::GetInstance().Set(ns_, key, NVS_TYPE_U8, value ? 1 : 0, "");
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -90,10 +369,7 @@ void Settings::SetBool(const std::string& key, bool value) {
 
 void Settings::EraseKey(const std::string& key) {
     if (read_write_) {
-        auto ret = nvs_erase_key(nvs_handle_, key.c_str());
-        if (ret != ESP_ERR_NVS_NOT_FOUND) {
-            ESP_ERROR_CHECK(ret);
-        }
+        SettingsCache::GetInstance().Erase(ns_, key);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -101,8 +377,16 @@ void Settings::EraseKey(const std::string& key) {
 
 void Settings::EraseAll() {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_erase_all(nvs_handle_));
+        SettingsCache::GetInstance().EraseAll(ns_);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
+
+void Settings::Flush() {
+    SettingsCache::GetInstance().Flush();
+}
+
+void Settings::OnChange(const std::string& ns, ChangeCallback callback) {
+    SettingsCache::GetInstance().AddCallback(ns, std::move(callback));
+}
@@ -1,15 +1,34 @@
 #ifndef SETTINGS_H
 #define SETTINGS_H
 
+#include <functional>
+#include <memory>
 #include <string>
 #include <nvs_flash.h>
 
+/*
+ * Settings are served from a process-wide RAM cache. A namespace is read from NVS once, the first
+ * time it is opened. Writes are kept in RAM: the first write after a commit arms a one shot timer
+ * of CONFIG_SETTINGS_COMMIT_DELAY_MS, later writes do not extend it, and when it expires every
+ * pending namespace is committed by a low priority task, so the esp_timer task never waits for
+ * flash. Flush() commits on the calling task and runs before esp_restart(). A namespace that
+ * fails to commit stays pending and the timer is armed again. Constructing a Settings object is
+ * cheap and does not touch flash.
+ *
+ * Code that writes NVS directly, bypassing this class, is not seen once a namespace is cached.
+ */
 class Settings {
 public:
+    // `key` is empty after EraseAll()
+    using ChangeCallback = std::function<void(const std::string& key)>;
+
     Settings(const std::string& ns, bool read_write = false);
     ~Settings();
 
     std::string GetString(const std::string& key, const std::string& default_value = "");
+    // The cached string itself instead of a copy. It is never modified, a later write to the key
+    // replaces it, so it stays valid and unchanged for as long as the pointer is held
+    std::shared_ptr<const std::string> GetStringView(const std::string& key, const std::string& default_value = "");
     void SetString(const std::string& key, const std::string& value);
     int32_t GetInt(const std::string& key, int32_t default_value = 0);
     void SetInt(const std::string& key, int32_t value);
@@ -18,11 +37,15 @@ public:
     void EraseKey(const std::string& key);
     void EraseAll();
 
+    // Commit all pending writes now
+    static void Flush();
+    // Called on the writing task after a key of `ns` changes, outside the cache lock, so the
+    // callback may use Settings itself
+    static void OnChange(const std::string& ns, ChangeCallback callback);
+
 private:
     std::string ns_;
-    nvs_handle_t nvs_handle_ = 0;
     bool read_write_ = false;
-    bool dirty_ = false;
 };
 
 #endif
@@ -8,9 +8,13 @@ for the current board configuration.
 Usage:
     ./build_default_assets.py --sdkconfig <path> --builtin_text_font <font_name> \
         --default_emoji_collection <collection_name> --output <output_path>
+
+With --base_assets, unchanged assets keep their offsets from the previous assets.bin, and
+--manifest writes the block hashes devices use to download only the blocks that changed.
 """
 
 import argparse
+import hashlib
 import io
 import os
 import shutil
@@ -365,12 +369,152 @@ def sort_key(filename):
     return extension, basename
 
 
-def pack_assets_simple(target_path, include_path, out_file, assets_path, max_name_len=32):
+MANIFEST_BLOCK_SIZE = 4096
+MANIFEST_BLOCK_HASH_SIZE = 16
+# Room left after the table in images built for incremental updates, so adding assets later
+# does not push the table into the first asset and move it
+TABLE_RESERVED_ENTRIES = 64
+
+
+def read_assets_table(data, max_name_len=32):
+    """Asset name -> (absolute offset of the 0x5A5A prefix, asset size) in a packed assets.bin"""
+    if len(data) < 12:
+        return {}
+    total_files = int.from_bytes(data[0:4], byteorder='little')
+    entry_size = max_name_len + 12
+    data_start = 12 + total_files * entry_size
+    assets = {}
+    for i in range(total_files):
+        entry = data[12 + i * entry_size:12 + (i + 1) * entry_size]
+        name = entry[:max_name_len].split(b'\0', 1)[0].decode('utf-8')
+        size = int.from_bytes(entry[max_name_len:max_name_len + 4], byteorder='little')
+        offset = int.from_bytes(entry[max_name_len + 4:max_name_len + 8], byteorder='little')
+        assets[name] = (data_start + offset, size)
+    return assets
+
+
+def plan_stable_layout(files, table_end, base_data, max_name_len):
+    """
+    Place each asset where it was in the previous assets.bin if it still fits there, and the
+    others in the first gap large enough, so an update only rewrites the blocks that changed
+    """
+    previous = read_assets_table(base_data, max_name_len)
+    positions = {}
+    occupied = [(0, table_end)]
+    for file_name, data in files:
+        if file_name in previous:
+            position, size = previous[file_name]
+            if position >= table_end and len(data) <= size:
+                positions[file_name] = position
+                occupied.append((position, position + 2 + len(data)))
+    occupied.sort()
+
+    for file_name, data in files:
+        if file_name in positions:
+            continue
+        need = 2 + len(data)
+        position = occupied[-1][1]
+        for (_, end), (next_start, _) in zip(occupied, occupied[1:]):
+            if next_start - end >= need:
+                position = end
+                break
+        positions[file_name] = position
+        occupied.append((position, position + need))
+        occupied.sort()
+    return positions
+
+
+def write_manifest(image, file_info_list, data_start, manifest_file):
+    """
+    Block hashes of assets.bin for incremental updates, see assets_manifest_header in main/assets.cc
+    """
+    block_count = (len(image) + MANIFEST_BLOCK_SIZE - 1) // MANIFEST_BLOCK_SIZE
+    manifest = bytearray(b'XZAM')
+    manifest += struct.pack('<IIIII', 1, len(image), MANIFEST_BLOCK_SIZE, block_count, len(file_info_list))
+    manifest += hashlib.sha256(image).digest()
+    for i in range(block_count):
+        block = image[i * MANIFEST_BLOCK_SIZE:(i + 1) * MANIFEST_BLOCK_SIZE]
+        manifest += hashlib.sha256(block).digest()[:MANIFEST_BLOCK_HASH_SIZE]
+    for file_name, offset, file_size, _, _ in file_info_list:
+        position = data_start + offset
+        data = image[position + 2:position + 2 + file_size]
+        manifest += file_name.encode('utf-8').ljust(32, b'\0')[:32]
+        manifest += struct.pack('<II', position, file_size)
+        manifest += hashlib.sha256(data).digest()[:MANIFEST_BLOCK_HASH_SIZE]
+
+    with open(manifest_file, 'wb') as f:
+        f.write(manifest)
+    return block_count
+
+
+def count_changed_blocks(old_image, new_image):
+    """Blocks of new_image a device holding old_image has to download"""
+    changed = 0
+    for offset in range(0, len(new_image), MANIFEST_BLOCK_SIZE):
+        if old_image[offset:offset + MANIFEST_BLOCK_SIZE] != new_image[offset:offset + MANIFEST_BLOCK_SIZE]:
+            changed += 1
+    return changed
+
+
+ASSET_INDEX_NAME = 'assets.phash'
+
+
+def asset_hash(name, seed):
+    """FNV-1a with a seed and a final mix, the same as AssetTable::Hash in main/asset_table.cc"""
+    h = 2166136261 ^ seed
+    for c in name:
+        h ^= c
+        h = (h * 16777619) & 0xFFFFFFFF
+    h ^= h >> 15
+    h = (h * 0x2C1B3C6D) & 0xFFFFFFFF
+    h ^= h >> 12
+    return h
+
+
+def build_asset_index(names):
+    """
+    Minimal perfect hash over the table names (hash and displace): returns the seed of each
+    bucket and the names in slot order, or None if the names are not unique
+    """
+    if len(set(names)) != len(names):
+        return None
+    key_count = len(names)
+    # Two keys per bucket keeps the index small, more buckets make seeds easier to find
+    for bucket_count in (max(1, (key_count + 1) // 2), key_count, key_count * 2):
+        buckets = [[] for _ in range(bucket_count)]
+        for name in names:
+            buckets[asset_hash(name, 0) % bucket_count].append(name)
+
+        seeds = [0] * bucket_count
+        slots = [None] * key_count
+        # Place the largest buckets first, while most slots are still free
+        for bucket in sorted(range(bucket_count), key=lambda b: -len(buckets[b])):
+            if not buckets[bucket]:
+                continue
+            for seed in range(1, 0x10000):
+                wanted = [asset_hash(name, seed) % key_count for name in buckets[bucket]]
+                if len(set(wanted)) == len(wanted) and all(slots[slot] is None for slot in wanted):
+                    for slot, name in zip(wanted, buckets[bucket]):
+                        slots[slot] = name
+                    seeds[bucket] = seed
+                    break
+            else:
+                break
+        else:
+            return seeds, slots
+    return None
+
+
+def pack_asset_index(seeds, key_count):
+    """Index asset, see asset_index_header in main/asset_table.cc"""
+    return b'XZPH' + struct.pack('<III', 1, key_count, len(seeds)) + struct.pack(f'<{len(seeds)}H', *seeds)
+
+
+def pack_assets_simple(target_path, include_path, out_file, assets_path, max_name_len=32, base_file=None, manifest_file=None):
     """
     Simplified version of pack_assets that handles basic file packing
     """
-    merged_data = bytearray()
-    file_info_list = []
+    files = []
     skip_files = ['config.json']
 
     # Ensure output directory exists
@@ -385,20 +529,56 @@ def pack_assets_simple(target_path, include_path, out_file, assets_path, max_nam
         file_path = os.path.join(target_path, filename)
         if not os.path.isfile(file_path):
             continue
-            
-        file_name = os.path.basename(file_path)
-        file_size = os.path.getsize(file_path)
-
-        file_info_list.append((file_name, len(merged_data), file_size, 0, 0))
-        # Add 0x5A5A prefix to merged_data
-        merged_data.extend(b'\x5A' * 2)
 
         with open(file_path, 'rb') as bin_file:
-            bin_data = bin_file.read()
-
-        merged_data.extend(bin_data)
+            files.append((os.path.basename(file_path), bin_file.read()))
+
+    # The perfect hash index is the first table entry and the other entries follow in slot order,
+    # so the device looks assets up in the mmapped table without building anything at boot
+    table_order = None
+    table_names = {name: name.ljust(max_name_len, '\0')[:max_name_len].encode('utf-8').split(b'\0', 1)[0] for name, _ in files}
+    index = build_asset_index([table_names[name] for name, _ in files]) if files else None
+    if index:
+        seeds, slots = index
+        names_by_key = {key: name for name, key in table_names.items()}
+        table_order = [ASSET_INDEX_NAME] + [names_by_key[key] for key in slots]
+        files.insert(0, (ASSET_INDEX_NAME, pack_asset_index(seeds, len(slots))))
+    elif files:
+        print('Warning: asset names are not unique after truncation, no index is generated')
+
+    total_files = len(files)
+    data_start = 12 + total_files * (max_name_len + 12)
+
+    base_data = b''
+    if base_file:
+        with open(base_file, 'rb') as f:
+            base_data = f.read()
+        positions = plan_stable_layout(files, data_start, base_data, max_name_len)
+    else:
+        positions = {}
+        position = data_start
+        if manifest_file:
+            reserved = data_start + TABLE_RESERVED_ENTRIES * (max_name_len + 12)
+            position = (reserved + MANIFEST_BLOCK_SIZE - 1) // MANIFEST_BLOCK_SIZE * MANIFEST_BLOCK_SIZE
+        for file_name, data in files:
+            positions[file_name] = position
+            position += 2 + len(data)
+
+    # Gaps keep the bytes of the previous assets.bin, so they do not change any block either
+    image_size = max([data_start] + [positions[name] + 2 + len(data) for name, data in files])
+    image = bytearray(base_data[:image_size])
+    image.extend(b'\0' * (image_size - len(image)))
 
-    total_files = len(file_info_list)
+    file_info_list = []
+    for file_name, data in files:
+        position = positions[file_name]
+        file_info_list.append((file_name, position - data_start, len(data), 0, 0))
+        # Add 0x5A5A prefix to merged_data
+        image[position:position + 2] = b'\x5A' * 2
+        image[position + 2:position + 2 + len(data)] = data
+    if table_order:
+        info_by_name = {info[0]: info for info in file_info_list}
+        file_info_list = [info_by_name[name] for name in table_order]
 
     mmap_table = bytearray()
     for file_name, offset, file_size, width, height in file_info_list:
@@ -410,16 +590,27 @@ def pack_assets_simple(target_path, include_path, out_file, assets_path, max_nam
         mmap_table.extend(offset.to_bytes(4, byteorder='little'))
         mmap_table.extend(width.to_bytes(2, byteorder='little'))
         mmap_table.extend(height.to_bytes(2, byteorder='little'))
+    image[12:data_start] = mmap_table
 
-    combined_data = mmap_table + merged_data
+    combined_data = image[12:]
     combined_checksum = compute_checksum(combined_data)
     combined_data_length = len(combined_data).to_bytes(4, byteorder='little')
     header_data = total_files.to_bytes(4, byteorder='little') + combined_checksum.to_bytes(4, byteorder='little')
-    final_data = header_data + combined_data_length + combined_data
+    image[0:12] = header_data + combined_data_length
+    final_data = bytes(image)
 
     with open(out_file, 'wb') as output_bin:
         output_bin.write(final_data)
 
+    if manifest_file:
+        block_count = write_manifest(final_data, file_info_list, data_start, manifest_file)
+        print(f'Manifest with {block_count} blocks written to {manifest_file}')
+    if base_file:
+        changed = count_changed_blocks(base_data, final_data)
+        total_blocks = (len(final_data) + MANIFEST_BLOCK_SIZE - 1) // MANIFEST_BLOCK_SIZE
+        print(f'Incremental update from {os.path.basename(base_file)}: {changed} of {total_blocks} blocks changed, '
+              f'{changed * MANIFEST_BLOCK_SIZE / 1024:.0f}K of {len(final_data) / 1024:.0f}K to download')
+
     # Generate header file
     current_year = datetime.now().year
     asset_name = os.path.basename(assets_path)
@@ -747,7 +938,7 @@ def get_emoji_collection_path(default_emoji_collection, xiaozhi_fonts_path, proj
     return None
 
 
-def build_assets_integrated(wakenet_model_paths, multinet_model_paths, text_font_path, emoji_collection_path, extra_files_path, output_path, multinet_model_info=None):
+def build_assets_integrated(wakenet_model_paths, multinet_model_paths, text_font_path, emoji_collection_path, extra_files_path, output_path, multinet_model_info=None, base_assets=None, manifest=None):
     """
     Build assets using integrated functions (no external dependencies)
     """
@@ -783,7 +974,7 @@ def build_assets_integrated(wakenet_model_paths, multinet_model_paths, text_font
         # Use simplified packing function
         include_path = config_data['include_path']
         image_file = config_data['image_file']
-        pack_assets_simple(assets_dir, include_path, image_file, "assets", int(config_data['name_length']))
+        pack_assets_simple(assets_dir, include_path, image_file, "assets", int(config_data['name_length']), base_assets, manifest)
         
         # Copy final assets.bin to output location
         if os.path.exists(image_file):
@@ -817,6 +1008,8 @@ def main():
     parser.add_argument('--esp_sr_model_path', help='Path to ESP-SR model directory')
     parser.add_argument('--xiaozhi_fonts_path', help='Path to xiaozhi-fonts component directory')
     parser.add_argument('--extra_files', help='Path to extra files directory to be included in assets')
+    parser.add_argument('--base_assets', help='Previous assets.bin, unchanged assets keep their offsets for incremental updates')
+    parser.add_argument('--manifest', help='Output path for the block hash manifest (upload it next to assets.bin as assets.bin.manifest)')
     
     args = parser.parse_args()
     
@@ -922,7 +1115,7 @@ def main():
     
     # Build the assets
     success = build_assets_integrated(wakenet_model_paths, multinet_model_paths, text_font_path, emoji_collection_path, 
-                                     extra_files_path, args.output, multinet_model_info)
+                                     extra_files_path, args.output, multinet_model_info, args.base_assets, args.manifest)
     
     if not success:
         sys.exit(1)
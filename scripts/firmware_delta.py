@@ -0,0 +1,308 @@
+#! /usr/bin/env python3
+"""
+Make and apply firmware delta patches for Ota::Upgrade.
+
+The device rebuilds the new image from the image it is running and a patch it streams from
+"firmware.delta_url" (see main/delta_patch.h for the format). A patch only applies to the exact
+base image it was made from, so the server has to pick the patch by the version the device reports.
+
+    firmware_delta.py diff old/xiaozhi.bin new/xiaozhi.bin xiaozhi.patch
+    firmware_delta.py apply old/xiaozhi.bin xiaozhi.patch rebuilt.bin
+
+"diff" applies the patch it made and checks the result before writing it.
+"""
+import argparse
+import hashlib
+import re
+import struct
+import sys
+
+MAGIC = b'XZD1'
+HEADER_FORMAT = '<4sII32s32s'
+
+# Exact matches are found through a hash of every INDEX_STEP-th base window of WINDOW bytes
+WINDOW = 16
+INDEX_STEP = 4
+MAX_CANDIDATES = 8
+MIN_MATCH = 32
+# Approximate extension gives up once this far past the best scoring length
+EXTEND_LIMIT = 1024
+# Shorter zero runs cost more as a separate run than as literal difference bytes
+MIN_ZERO_RUN = 4
+
+
+def write_varint(out, value):
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return
+
+
+def read_varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def zigzag(value):
+    return value * 2 if value >= 0 else -value * 2 - 1
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def match_length(base, base_pos, target, target_pos):
+    limit = min(len(base) - base_pos, len(target) - target_pos)
+    length = 0
+    while length + 256 <= limit and base[base_pos + length:base_pos + length + 256] == target[target_pos + length:target_pos + length + 256]:
+        length += 256
+    while length < limit and base[base_pos + length] == target[target_pos + length]:
+        length += 1
+    return length
+
+
+def build_index(base):
+    index = {}
+    for pos in range(0, len(base) - WINDOW + 1, INDEX_STEP):
+        candidates = index.setdefault(base[pos:pos + WINDOW], [])
+        if len(candidates) < MAX_CANDIDATES:
+            candidates.append(pos)
+    return index
+
+
+def find_matches(base, target):
+    """Greedy exact matches (target_pos, base_pos, length), in target order and not overlapping"""
+    index = build_index(base)
+    matches = []
+    previous_end = 0
+    pos = 0
+    while pos + WINDOW <= len(target):
+        candidates = index.get(target[pos:pos + WINDOW])
+        best_length = 0
+        best_base = 0
+        if candidates:
+            for base_pos in candidates:
+                length = match_length(base, base_pos, target, pos)
+                if length > best_length:
+                    best_length = length
+                    best_base = base_pos
+        if best_length < MIN_MATCH:
+            pos += 1
+            continue
+
+        # The index only holds every INDEX_STEP-th window, the match may start a little earlier
+        back = 0
+        while pos - back > previous_end and best_base - back > 0 and target[pos - back - 1] == base[best_base - back - 1]:
+            back += 1
+        matches.append((pos - back, best_base - back, best_length + back))
+        pos += best_length
+        previous_end = pos
+    return matches
+
+
+def extend_forward(base, target, start, end, offset):
+    """Length of the best approximate match of target[start:end] with the base at `offset`, bsdiff style"""
+    score = 0
+    best_score = 0
+    best_length = 0
+    for i in range(end - start):
+        base_pos = start + i + offset
+        if base_pos >= len(base):
+            break
+        if base[base_pos] == target[start + i]:
+            score += 1
+        if score * 2 - (i + 1) > best_score * 2 - best_length:
+            best_score = score
+            best_length = i + 1
+        elif i - best_length > EXTEND_LIMIT:
+            break
+    return best_length
+
+
+def extend_backward(base, target, start, end, offset):
+    score = 0
+    best_score = 0
+    best_length = 0
+    for i in range(end - start):
+        base_pos = end - 1 - i + offset
+        if base_pos < 0:
+            break
+        if base[base_pos] == target[end - 1 - i]:
+            score += 1
+        if score * 2 - (i + 1) > best_score * 2 - best_length:
+            best_score = score
+            best_length = i + 1
+        elif i - best_length > EXTEND_LIMIT:
+            break
+    return best_length
+
+
+def plan_segments(base, target):
+    """Split the target into (target_pos, base_pos, add_length) segments, literals fill the gaps between them"""
+    segments = []
+    # The images start alike, so the first segment follows the base from offset 0
+    seg_target, seg_base = 0, 0
+    previous_end, previous_offset = 0, 0
+    for target_pos, base_pos, length in find_matches(base, target) + [(len(target), None, 0)]:
+        forward = extend_forward(base, target, previous_end, target_pos, previous_offset)
+        backward = 0
+        if base_pos is not None:
+            offset = base_pos - target_pos
+            backward = extend_backward(base, target, previous_end, target_pos, offset)
+            overlap = forward + backward - (target_pos - previous_end)
+            if overlap > 0:
+                # Give each byte of the overlap to the alignment that matches it
+                score = 0
+                best_score = 0
+                split = 0
+                for i in range(overlap):
+                    pos = previous_end + forward - overlap + i
+                    if target[pos] == base[pos + previous_offset]:
+                        score += 1
+                    if target[pos] == base[pos + offset]:
+                        score -= 1
+                    if score > best_score:
+                        best_score = score
+                        split = i + 1
+                forward += split - overlap
+                backward -= split
+        segments.append((seg_target, seg_base, previous_end + forward - seg_target))
+        if base_pos is None:
+            break
+        seg_target = target_pos - backward
+        seg_base = base_pos - backward
+        previous_end = target_pos + length
+        previous_offset = base_pos - target_pos
+    return segments
+
+
+def encode_add(out, diff):
+    pairs = []
+    zero = 0
+    pos = 0
+    for run in re.finditer(b'\\x00{%d,}' % MIN_ZERO_RUN, diff):
+        start, end = run.span()
+        if start > pos:
+            pairs.append((zero, diff[pos:start]))
+            zero = 0
+        zero += end - start
+        pos = end
+    if zero or pos < len(diff):
+        pairs.append((zero, diff[pos:]))
+    for zero, literal in pairs:
+        write_varint(out, zero)
+        write_varint(out, len(literal))
+        out += literal
+
+
+def make_patch(base, target):
+    out = bytearray(struct.pack(HEADER_FORMAT, MAGIC, len(base), len(target),
+                                hashlib.sha256(base).digest(), hashlib.sha256(target).digest()))
+    segments = plan_segments(base, target)
+    for i, (target_pos, base_pos, add_length) in enumerate(segments):
+        if i + 1 < len(segments):
+            next_target, next_base, _ = segments[i + 1]
+        else:
+            next_target, next_base = len(target), base_pos + add_length
+        write_varint(out, add_length)
+        write_varint(out, next_target - target_pos - add_length)
+        write_varint(out, zigzag(next_base - base_pos - add_length))
+        if add_length:
+            new = target[target_pos:target_pos + add_length]
+            old = base[base_pos:base_pos + add_length]
+            encode_add(out, bytes((a - b) & 0xFF for a, b in zip(new, old)))
+        out += target[target_pos + add_length:next_target]
+    return bytes(out)
+
+
+def apply_patch(base, patch):
+    """Reference for DeltaPatch::Read, raises ValueError on a patch that does not fit the base"""
+    magic, base_size, target_size, base_sha256, target_sha256 = struct.unpack_from(HEADER_FORMAT, patch)
+    if magic != MAGIC:
+        raise ValueError('not a firmware patch')
+    if base_size != len(base) or hashlib.sha256(base).digest() != base_sha256:
+        raise ValueError('patch was made for a different base image')
+
+    target = bytearray()
+    pos = struct.calcsize(HEADER_FORMAT)
+    base_pos = 0
+    while len(target) < target_size:
+        add_length, pos = read_varint(patch, pos)
+        copy_length, pos = read_varint(patch, pos)
+        seek, pos = read_varint(patch, pos)
+        if base_pos + add_length > base_size or len(target) + add_length + copy_length > target_size:
+            raise ValueError('record out of range')
+        end = base_pos + add_length
+        while base_pos < end:
+            zero, pos = read_varint(patch, pos)
+            literal, pos = read_varint(patch, pos)
+            if zero + literal == 0 or base_pos + zero + literal > end:
+                raise ValueError('add run out of range')
+            target += base[base_pos:base_pos + zero]
+            base_pos += zero
+            target += bytes((b + d) & 0xFF for b, d in zip(base[base_pos:base_pos + literal], patch[pos:pos + literal]))
+            base_pos += literal
+            pos += literal
+        target += patch[pos:pos + copy_length]
+        pos += copy_length
+        base_pos += unzigzag(seek)
+        if base_pos < 0 or base_pos > base_size:
+            raise ValueError('seek out of range')
+
+    if hashlib.sha256(target).digest() != target_sha256:
+        raise ValueError('target SHA-256 mismatch')
+    return bytes(target)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Make and apply firmware delta patches')
+    subparsers = parser.add_subparsers(dest='command', required=True)
+    diff_parser = subparsers.add_parser('diff', help='Make a patch from base to target')
+    diff_parser.add_argument('base', help='Firmware the device is running')
+    diff_parser.add_argument('target', help='New firmware')
+    diff_parser.add_argument('patch', help='Output patch')
+    apply_parser = subparsers.add_parser('apply', help='Rebuild the target from base and patch')
+    apply_parser.add_argument('base', help='Firmware the patch was made from')
+    apply_parser.add_argument('patch', help='Patch')
+    apply_parser.add_argument('output', help='Output firmware')
+    args = parser.parse_args()
+
+    with open(args.base, 'rb') as f:
+        base = f.read()
+
+    if args.command == 'diff':
+        with open(args.target, 'rb') as f:
+            target = f.read()
+        patch = make_patch(base, target)
+        if apply_patch(base, patch) != target:
+            print('Patch does not rebuild the target', file=sys.stderr)
+            sys.exit(1)
+        with open(args.patch, 'wb') as f:
+            f.write(patch)
+        print(f'{args.patch}: {len(patch)} bytes, {len(patch) * 100 / max(len(target), 1):.1f}% of {len(target)} bytes')
+    else:
+        with open(args.patch, 'rb') as f:
+            patch = f.read()
+        try:
+            target = apply_patch(base, patch)
+        except (ValueError, IndexError, struct.error) as e:
+            print(f'Failed to apply patch: {e}', file=sys.stderr)
+            sys.exit(1)
+        with open(args.output, 'wb') as f:
+            f.write(target)
+        print(f'{args.output}: {len(target)} bytes')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,74 @@
+#! /usr/bin/env python3
+"""
+Local stand-in for the OTA check version endpoint, to measure time to idle with a cold and a warm
+response cache (see Ota::CheckVersion and the "Idle ... ms after boot" log line).
+
+Every request is answered with the JSON file given on the command line, re-read on each request
+so it can be edited while the device runs, plus the current server_time. The ETag covers
+everything but server_time, and a request whose If-None-Match matches it gets a 304.
+
+    ota_check_server.py response.json --port 8002 --delay 500
+    idf.py menuconfig  # Xiaozhi Assistant -> Default OTA URL = http://<this host>:8002/ota/
+"""
+import argparse
+import hashlib
+import json
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+def make_handler(response_file, delay):
+    class Handler(BaseHTTPRequestHandler):
+        def handle_check(self):
+            length = int(self.headers.get('Content-Length', 0))
+            if length:
+                self.rfile.read(length)
+            time.sleep(delay / 1000)
+
+            with open(response_file, 'rb') as f:
+                response = json.load(f)
+            response.pop('server_time', None)
+            etag = '"%s"' % hashlib.sha256(json.dumps(response, sort_keys=True).encode()).hexdigest()[:32]
+
+            if self.headers.get('If-None-Match') == etag:
+                self.send_response(304)
+                self.send_header('ETag', etag)
+                self.end_headers()
+                return
+
+            response['server_time'] = {'timestamp': int(time.time() * 1000), 'timezone_offset': 0}
+            body = json.dumps(response).encode()
+            self.send_response(200)
+            self.send_header('Content-Type', 'application/json')
+            self.send_header('Content-Length', str(len(body)))
+            self.send_header('ETag', etag)
+            self.end_headers()
+            self.wfile.write(body)
+
+        do_GET = handle_check
+        do_POST = handle_check
+
+        def log_message(self, format, *args):
+            print(f'{self.address_string()} {self.headers.get("Device-Id", "-")} '
+                  f'If-None-Match={self.headers.get("If-None-Match", "-")} {format % args}')
+
+    return Handler
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Local OTA check version server with ETag support')
+    parser.add_argument('response', help='JSON response, without server_time')
+    parser.add_argument('--port', type=int, default=8002, help='Port to listen on')
+    parser.add_argument('--delay', type=int, default=0, help='Extra delay per request in ms, to mimic a remote server')
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer(('0.0.0.0', args.port), make_handler(args.response, args.delay))
+    print(f'Serving {args.response} on port {args.port}')
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,143 @@
+// Assets block table: the CRC table saved to NVS is loaded back for the same image only, a changed byte is
+// found by the check of its block and by the background scan, and then the saved table is dropped
+#include "asset_block_table.h"
+#include "host_test.h"
+#include "settings.h"
+
+#include <esp_rom_crc.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+// Same header as the packer writes: file count, 16-bit sum of the rest of the image, length after the header
+struct Image {
+    std::vector<char> data;
+    uint32_t files = 42;
+    uint32_t checksum = 0;
+    uint32_t length = 0;
+
+    explicit Image(size_t size) : data(size) {
+        uint32_t seed = 7;
+        for (auto& byte : data) {
+            seed = seed * 1664525u + 1013904223u;
+            byte = (char)(seed >> 24);
+        }
+        for (size_t i = 12; i < size; i++) {
+            checksum += (uint8_t)data[i];
+        }
+        checksum &= 0xFFFF;
+        length = size - 12;
+    }
+};
+
+static std::string StoredString(const char* key) {
+    nvs_handle_t handle;
+    if (nvs_open("assets_hash", NVS_READONLY, &handle) != ESP_OK) {
+        return "";
+    }
+    std::string value;
+    size_t length = 0;
+    if (nvs_get_str(handle, key, nullptr, &length) == ESP_OK) {
+        value.resize(length);
+        nvs_get_str(handle, key, value.data(), &length);
+        value.resize(length - 1);
+    }
+    nvs_close(handle);
+    return value;
+}
+
+static bool SavedTableDropped() {
+    return Settings("assets_hash").GetString("blocks").empty();
+}
+
+static void TestRoundTrip() {
+    Image image(24 * 64 * 1024 + 777);
+    AssetBlockTable table;
+    table.Reset(image.data.data(), image.data.size());
+    CHECK(!table.Load(image.files, image.checksum, image.length));
+    CHECK(table.Hash() == image.checksum);
+    CHECK(table.block_count() == 25);
+    table.Save(image.files, image.checksum, image.length);
+    Settings::Flush();
+
+    // Committed to NVS as one hex CRC per block
+    std::string blocks = StoredString("blocks");
+    CHECK(blocks.size() == 25 * 8);
+    char hex[9];
+    snprintf(hex, sizeof(hex), "%08lx",
+             (unsigned long)esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(image.data.data()) + 64 * 1024,
+                                             64 * 1024));
+    CHECK(blocks.substr(8, 8) == hex);
+
+    AssetBlockTable loaded;
+    loaded.Reset(image.data.data(), image.data.size());
+    CHECK(loaded.Load(image.files, image.checksum, image.length));
+    CHECK(loaded.block_count() == 25);
+    CHECK(loaded.Verify(0, image.data.size()));
+
+    // Only for the image it was made for
+    CHECK(!loaded.Load(image.files + 1, image.checksum, image.length));
+    CHECK(!loaded.Load(image.files, image.checksum ^ 1, image.length));
+    loaded.Reset(image.data.data(), image.data.size() - 1);
+    CHECK(!loaded.Load(image.files, image.checksum, image.length - 1));
+
+    // A big image gets bigger blocks so the table stays within kMaxBlocks
+    AssetBlockTable big;
+    big.Reset(image.data.data(), 30 * 1024 * 1024);
+    CHECK(big.block_size() == 128 * 1024);
+
+    // The root hash covers the table itself
+    {
+        Settings settings("assets_hash", true);
+        std::string tampered = blocks;
+        tampered[8] = tampered[8] == '0' ? '1' : '0';
+        settings.SetString("blocks", tampered);
+    }
+    loaded.Reset(image.data.data(), image.data.size());
+    CHECK(!loaded.Load(image.files, image.checksum, image.length));
+    AssetBlockTable::Drop();
+    Settings::Flush();
+    CHECK(StoredString("blocks").empty());
+}
+
+static void TestFlippedByte() {
+    Image image(24 * 64 * 1024 + 777);
+    AssetBlockTable table;
+    table.Reset(image.data.data(), image.data.size());
+    table.Hash();
+    table.Save(image.files, image.checksum, image.length);
+
+    image.data[5 * 64 * 1024 + 1234] ^= 0x10;
+    table.Reset(image.data.data(), image.data.size());
+    CHECK(table.Load(image.files, image.checksum, image.length));
+    // Blocks are checked when used, the other blocks are fine
+    CHECK(table.Verify(4 * 64 * 1024, 64 * 1024));
+    CHECK(!SavedTableDropped());
+    CHECK(!table.Verify(5 * 64 * 1024 + 1000, 500));
+    // The next boot checks the whole image again
+    CHECK(SavedTableDropped());
+    CHECK(!table.Load(image.files, image.checksum, image.length));
+
+    // The background scan finds it without any asset being used
+    image.data[5 * 64 * 1024 + 1234] ^= 0x10;
+    table.Reset(image.data.data(), image.data.size());
+    table.Hash();
+    table.Save(image.files, image.checksum, image.length);
+    image.data[20 * 64 * 1024] ^= 0x01;
+    table.Reset(image.data.data(), image.data.size());
+    CHECK(table.Load(image.files, image.checksum, image.length));
+    table.StartScan();
+    for (int i = 0; i < 5000 && !SavedTableDropped(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    table.StopScan();
+    CHECK(SavedTableDropped());
+}
+
+int main() {
+    TestRoundTrip();
+    TestFlippedByte();
+    printf("asset_block_table_test passed\n");
+    return 0;
+}
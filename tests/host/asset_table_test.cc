@@ -0,0 +1,249 @@
+// Asset table: lookups through the perfect hash index and the linear fallback find every packed asset
+#include "asset_table.h"
+#include "host_test.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+struct Asset {
+    std::string name;
+    std::vector<uint8_t> data;
+};
+
+static std::vector<uint8_t> MakeData(size_t size, uint32_t seed) {
+    std::vector<uint8_t> data(size);
+    for (auto& byte : data) {
+        seed = seed * 1664525u + 1013904223u;
+        byte = (uint8_t)(seed >> 24);
+    }
+    return data;
+}
+
+static std::string TableName(const std::string& name) {
+    return name.substr(0, 32);
+}
+
+// Same image layout as pack_assets_simple(), the table in the given order
+static std::vector<uint8_t> Pack(const std::vector<Asset>& assets) {
+    size_t data_start = 12 + assets.size() * sizeof(mmap_assets_table);
+    std::vector<uint8_t> image(data_start);
+    uint32_t count = assets.size();
+    memcpy(image.data(), &count, 4);
+    for (size_t i = 0; i < assets.size(); i++) {
+        mmap_assets_table item = {};
+        memcpy(item.asset_name, assets[i].name.data(), std::min(assets[i].name.size(), sizeof(item.asset_name)));
+        item.asset_size = assets[i].data.size();
+        item.asset_offset = image.size() - data_start;
+        memcpy(image.data() + 12 + i * sizeof(item), &item, sizeof(item));
+        image.push_back('Z');
+        image.push_back('Z');
+        image.insert(image.end(), assets[i].data.begin(), assets[i].data.end());
+    }
+    return image;
+}
+
+// Hash and displace with one key per bucket, the index entry first and the assets in slot order
+static std::vector<Asset> AddIndex(const std::vector<Asset>& assets, uint32_t version = 1) {
+    uint32_t keys = assets.size();
+    std::vector<std::vector<size_t>> buckets(keys);
+    for (size_t i = 0; i < assets.size(); i++) {
+        buckets[AssetTable::Hash(TableName(assets[i].name), 0) % keys].push_back(i);
+    }
+    std::vector<size_t> order(keys);
+    for (size_t i = 0; i < keys; i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    std::vector<uint16_t> seeds(keys);
+    std::vector<int> slots(keys, -1);
+    for (size_t bucket : order) {
+        if (buckets[bucket].empty()) {
+            continue;
+        }
+        bool placed = false;
+        for (uint32_t seed = 1; seed < 0x10000 && !placed; seed++) {
+            std::vector<uint32_t> wanted;
+            for (size_t i : buckets[bucket]) {
+                uint32_t slot = AssetTable::Hash(TableName(assets[i].name), seed) % keys;
+                if (slots[slot] >= 0 || std::find(wanted.begin(), wanted.end(), slot) != wanted.end()) {
+                    break;
+                }
+                wanted.push_back(slot);
+            }
+            if (wanted.size() == buckets[bucket].size()) {
+                for (size_t k = 0; k < wanted.size(); k++) {
+                    slots[wanted[k]] = buckets[bucket][k];
+                }
+                seeds[bucket] = seed;
+                placed = true;
+            }
+        }
+        CHECK(placed);
+    }
+
+    Asset index = { AssetTable::kIndexName, {'X', 'Z', 'P', 'H'} };
+    uint32_t header[3] = { version, keys, keys };
+    index.data.insert(index.data.end(), (uint8_t*)header, (uint8_t*)header + sizeof(header));
+    for (uint16_t seed : seeds) {
+        index.data.push_back(seed & 0xFF);
+        index.data.push_back(seed >> 8);
+    }
+    std::vector<Asset> table = { index };
+    for (int slot : slots) {
+        table.push_back(assets[slot]);
+    }
+    return table;
+}
+
+static std::vector<Asset> MakeAssets(size_t count) {
+    std::vector<Asset> assets;
+    for (size_t i = 0; i < count; i++) {
+        assets.push_back({ "emoji_" + std::to_string(i) + ".png", MakeData(1 + i * 7 % 300, i) });
+    }
+    // Uses all 32 bytes of the name, so it is not NUL terminated in the table
+    assets.push_back({ "a_name_of_exactly_thirty_two_b.x", MakeData(33, 1001) });
+    CHECK(assets.back().name.size() == 32);
+    return assets;
+}
+
+static void ExpectFound(const AssetTable& table, const std::vector<uint8_t>& image, const Asset& asset) {
+    auto item = table.Find(TableName(asset.name));
+    if (item == nullptr) {
+        fprintf(stderr, "%s not found\n", asset.name.c_str());
+        exit(1);
+    }
+    CHECK(item->asset_size == asset.data.size());
+    const uint8_t* data = image.data() + table.data_offset() + item->asset_offset;
+    CHECK(data[0] == 'Z' && data[1] == 'Z');
+    CHECK(memcmp(data + 2, asset.data.data(), asset.data.size()) == 0);
+}
+
+static void ExpectUnknownNames(const AssetTable& table) {
+    CHECK(table.Find("") == nullptr);
+    CHECK(table.Find("emoji_") == nullptr);
+    CHECK(table.Find("emoji_1.pn") == nullptr);
+    CHECK(table.Find("emoji_1.png2") == nullptr);
+    CHECK(table.Find("missing.png") == nullptr);
+    CHECK(table.Find("a_name_of_exactly_thirty_two_b.x.png") == nullptr);
+    CHECK(table.Find("a_name_of_exactly_thirty_two_b.") == nullptr);
+}
+
+static void TestLinearLookup() {
+    auto assets = MakeAssets(20);
+    auto image = Pack(assets);
+    AssetTable table;
+    CHECK(!table.loaded());
+    CHECK(table.Find("emoji_1.png") == nullptr);
+
+    table.Load((const char*)image.data(), assets.size());
+    CHECK(table.loaded());
+    CHECK(!table.has_index());
+    CHECK(table.size() == assets.size());
+    for (auto& asset : assets) {
+        ExpectFound(table, image, asset);
+    }
+    ExpectUnknownNames(table);
+
+    table.Clear();
+    CHECK(!table.loaded());
+    CHECK(table.Find("emoji_1.png") == nullptr);
+}
+
+static void TestIndexLookup() {
+    auto assets = MakeAssets(300);
+    auto packed = AddIndex(assets);
+    auto image = Pack(packed);
+    AssetTable table;
+    table.Load((const char*)image.data(), packed.size());
+    CHECK(table.has_index());
+    for (auto& asset : assets) {
+        ExpectFound(table, image, asset);
+    }
+    ExpectUnknownNames(table);
+    CHECK(table.Find(AssetTable::kIndexName) == nullptr);
+}
+
+// An index that does not describe the table is ignored, names are still found by scanning
+static void TestUnusableIndex() {
+    auto assets = MakeAssets(50);
+    auto packed = AddIndex(assets, 2);
+    auto image = Pack(packed);
+    AssetTable table;
+    table.Load((const char*)image.data(), packed.size());
+    CHECK(!table.has_index());
+    for (auto& asset : assets) {
+        ExpectFound(table, image, asset);
+    }
+
+    // Key count of a table with one more asset than the index was made for
+    packed = AddIndex(assets);
+    packed.push_back({ "extra.png", MakeData(10, 7) });
+    image = Pack(packed);
+    table.Load((const char*)image.data(), packed.size());
+    CHECK(!table.has_index());
+    ExpectFound(table, image, packed.back());
+
+    // Seeds cut off by the asset size
+    packed = AddIndex(assets);
+    packed[0].data.resize(packed[0].data.size() - 1);
+    image = Pack(packed);
+    table.Load((const char*)image.data(), packed.size());
+    CHECK(!table.has_index());
+    ExpectFound(table, image, assets[7]);
+}
+
+// Images made by scripts/build_default_assets.py
+static void TestScriptImage(const char* python, const char* scripts) {
+    char dir[] = "/tmp/asset_table_test.XXXXXX";
+    CHECK(mkdtemp(dir) != nullptr);
+    std::string assets_dir = std::string(dir) + "/assets";
+    std::string image_path = std::string(dir) + "/assets.bin";
+    CHECK(system(("mkdir " + assets_dir).c_str()) == 0);
+
+    auto assets = MakeAssets(300);
+    assets.push_back({ "a_name_longer_than_thirty_two_bytes_is_cut.png", MakeData(50, 2000) });
+    for (auto& asset : assets) {
+        std::ofstream file(assets_dir + "/" + asset.name, std::ios::binary);
+        file.write((const char*)asset.data.data(), asset.data.size());
+    }
+    std::string command = std::string(python) + " -B -c \"import sys; sys.path.insert(0, '" + scripts +
+        "'); import build_default_assets as b; b.pack_assets_simple('" + assets_dir + "', '" + dir + "', '" +
+        image_path + "', 'assets')\" > /dev/null";
+    CHECK(system(command.c_str()) == 0);
+
+    std::ifstream file(image_path, std::ios::binary);
+    std::vector<uint8_t> image((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    CHECK(image.size() > 12);
+    uint32_t files;
+    memcpy(&files, image.data(), 4);
+    CHECK(files == assets.size() + 1);
+
+    AssetTable table;
+    table.Load((const char*)image.data(), files);
+    CHECK(table.has_index());
+    for (auto& asset : assets) {
+        ExpectFound(table, image, asset);
+    }
+    ExpectUnknownNames(table);
+
+    CHECK(system(("rm -rf " + std::string(dir)).c_str()) == 0);
+    printf("script image: %u assets\n", (unsigned)files);
+}
+
+int main(int argc, char** argv) {
+    TestLinearLookup();
+    TestIndexLookup();
+    TestUnusableIndex();
+    if (argc == 3) {
+        TestScriptImage(argv[1], argv[2]);
+    }
+    printf("asset_table_test passed\n");
+    return 0;
+}
@@ -0,0 +1,354 @@
+// Assets update: successive manifests applied to a partition only fetch the blocks that changed, an update
+// cut short resumes from GetInterruptedDownloadUrl() and a manifest that does not add up is not trusted.
+// The saved block table is gone before the partition is touched. Prints the bytes transferred for each step.
+#include "assets_update.h"
+#include "asset_block_table.h"
+#include "board.h"
+#include "host_test.h"
+#include "settings.h"
+
+#include <mbedtls/sha256.h>
+
+#include <climits>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+static const char* kUrl = "http://example.com/assets.bin";
+static const size_t kBlockSize = 64 * 1024;
+
+// Serves the image and its manifest (url + ".manifest"), honoring "bytes=a-b" and "bytes=a-" ranges
+class FakeServer : public NetworkInterface {
+public:
+    std::vector<uint8_t> image;
+    std::string manifest;  // Empty for no manifest
+    std::string etag = "\"v1\"";
+    size_t fail_after = SIZE_MAX;  // Bytes served before the network goes down for good
+    size_t served = 0;
+    std::vector<std::string> ranges;  // Range headers of the image requests
+    std::function<void()> on_open;
+
+    std::unique_ptr<Http> CreateHttp(int connect_id) override;
+
+    bool down() const { return served >= fail_after; }
+};
+
+class FakeHttp : public Http {
+public:
+    explicit FakeHttp(FakeServer* server) : server_(server) {}
+
+    void SetHeader(const std::string& key, const std::string& value) override {
+        if (key == "Range") {
+            range_ = value;
+        } else if (key == "If-Range") {
+            if_range_ = value;
+        }
+    }
+
+    bool Open(const std::string& method, const std::string& url) override {
+        if (server_->down()) {
+            return false;
+        }
+        if (server_->on_open) {
+            server_->on_open();
+        }
+        if (url == std::string(kUrl) + ".manifest") {
+            status_ = server_->manifest.empty() ? 404 : 200;
+            body_.assign(server_->manifest.begin(), server_->manifest.end());
+            start_ = 0;
+            end_ = body_.size();
+            return true;
+        }
+        CHECK(url == kUrl);
+        server_->ranges.push_back(range_);
+        body_ = server_->image;
+        status_ = 200;
+        start_ = 0;
+        end_ = body_.size();
+        if (!range_.empty() && (if_range_.empty() || if_range_ == server_->etag)) {
+            size_t dash = range_.find('-');
+            start_ = std::stoul(range_.substr(strlen("bytes="), dash));
+            if (dash + 1 < range_.size()) {
+                end_ = std::stoul(range_.substr(dash + 1)) + 1;
+            }
+            status_ = 206;
+        }
+        return true;
+    }
+
+    void Close() override {}
+
+    int Read(char* buffer, size_t buffer_size) override {
+        if (server_->down()) {
+            return -1;
+        }
+        size_t size = std::min({buffer_size, end_ - start_, (size_t)1460, server_->fail_after - server_->served});
+        memcpy(buffer, body_.data() + start_, size);
+        start_ += size;
+        server_->served += size;
+        return (int)size;
+    }
+
+    std::string ReadAll() override {
+        std::string body(body_.begin() + start_, body_.begin() + end_);
+        server_->served += body.size();
+        start_ = end_;
+        return body;
+    }
+
+    int GetStatusCode() override { return status_; }
+    size_t GetBodyLength() override { return end_ - start_; }
+
+    std::string GetResponseHeader(const std::string& key) const override {
+        return key == "ETag" ? server_->etag : "";
+    }
+
+private:
+    FakeServer* server_;
+    std::string range_;
+    std::string if_range_;
+    std::vector<uint8_t> body_;
+    int status_ = 0;
+    size_t start_ = 0;
+    size_t end_ = 0;
+};
+
+std::unique_ptr<Http> FakeServer::CreateHttp(int connect_id) {
+    return std::make_unique<FakeHttp>(this);
+}
+
+struct FakePartition {
+    std::vector<uint8_t> flash;
+    esp_partition_t partition = {};
+
+    explicit FakePartition(size_t size) : flash(size, 0xFF) {
+        partition.address = 0x800000;
+        partition.size = size;
+        partition.erase_size = 4096;
+        strcpy(partition.label, "assets");
+        partition.host_data = flash.data();
+    }
+
+    bool Holds(const std::vector<uint8_t>& data) const {
+        return memcmp(flash.data(), data.data(), data.size()) == 0;
+    }
+};
+
+static std::vector<uint8_t> MakeImage(size_t size) {
+    std::vector<uint8_t> image(size);
+    uint32_t seed = 1;
+    for (auto& byte : image) {
+        seed = seed * 1664525u + 1013904223u;
+        byte = (uint8_t)(seed >> 24);
+    }
+    return image;
+}
+
+// Changes a few bytes in each of `blocks`, like an emoji being replaced
+static void Touch(std::vector<uint8_t>& image, std::initializer_list<size_t> blocks) {
+    for (size_t block : blocks) {
+        for (size_t i = 0; i < 50; i++) {
+            image[block * kBlockSize + 100 + i] ^= 0x5A;
+        }
+    }
+}
+
+// Same layout as write_manifest() in scripts/build_default_assets.py, without asset entries
+static std::string MakeManifest(const std::vector<uint8_t>& image) {
+    auto put32 = [](std::string& out, uint32_t value) {
+        out.append(reinterpret_cast<const char*>(&value), 4);
+    };
+    uint32_t block_count = (image.size() + kBlockSize - 1) / kBlockSize;
+    std::string manifest = "XZAM";
+    put32(manifest, 1);
+    put32(manifest, image.size());
+    put32(manifest, kBlockSize);
+    put32(manifest, block_count);
+    put32(manifest, 0);
+    uint8_t digest[32];
+    mbedtls_sha256(image.data(), image.size(), digest, 0);
+    manifest.append(reinterpret_cast<const char*>(digest), sizeof(digest));
+    for (size_t offset = 0; offset < image.size(); offset += kBlockSize) {
+        mbedtls_sha256(image.data() + offset, std::min(kBlockSize, image.size() - offset), digest, 0);
+        manifest.append(reinterpret_cast<const char*>(digest), 16);
+    }
+    return manifest;
+}
+
+static std::string BlockRange(size_t first, size_t last, size_t image_size) {
+    size_t end = std::min((last + 1) * kBlockSize, image_size);
+    return "bytes=" + std::to_string(first * kBlockSize) + "-" + std::to_string(end - 1);
+}
+
+// Publishes `image` and applies it, returns the bytes transferred
+static size_t Apply(FakeServer& server, FakePartition& flash, const std::vector<uint8_t>& image) {
+    server.image = image;
+    server.manifest = MakeManifest(image);
+    server.served = 0;
+    server.ranges.clear();
+    CHECK(AssetsUpdate(&flash.partition).Download(kUrl, nullptr));
+    CHECK(flash.Holds(image));
+    CHECK(AssetsUpdate::GetInterruptedDownloadUrl().empty());
+    return server.served;
+}
+
+static void TestSuccessiveManifests() {
+    FakeServer server;
+    Board::GetInstance().SetNetwork(&server);
+    FakePartition flash(2 * 1024 * 1024);
+    auto image = MakeImage(24 * kBlockSize + 777);
+
+    // An empty partition differs everywhere, the whole file is downloaded
+    size_t served = Apply(server, flash, image);
+    CHECK(server.ranges.size() == 1 && server.ranges[0].empty());
+    printf("first install:       %7zu bytes of %zu\n", served, image.size());
+
+    // Unchanged blocks are not fetched at all
+    served = Apply(server, flash, image);
+    CHECK(server.ranges.empty());
+    CHECK(served == server.manifest.size());
+    printf("same version:        %7zu bytes (manifest only)\n", served);
+
+    // Changed blocks are rewritten, nearby ones in one request, the last block with its odd size
+    Touch(image, {3, 5, 14, 24});
+    served = Apply(server, flash, image);
+    CHECK(server.ranges.size() == 3);
+    CHECK(server.ranges[0] == BlockRange(3, 5, image.size()));
+    CHECK(server.ranges[1] == BlockRange(14, 14, image.size()));
+    CHECK(server.ranges[2] == BlockRange(24, 24, image.size()));
+    printf("blocks 3, 5, 14, 24: %7zu bytes in %zu requests\n", served, server.ranges.size());
+
+    Touch(image, {10});
+    served = Apply(server, flash, image);
+    CHECK(server.ranges.size() == 1 && server.ranges[0] == BlockRange(10, 10, image.size()));
+    CHECK(served == server.manifest.size() + kBlockSize);
+    printf("block 10:            %7zu bytes\n", served);
+}
+
+// A reset in the middle of an update leaves its URL behind, doing it again fetches what is still missing
+static void TestInterruptedUpdateResumes() {
+    FakeServer server;
+    Board::GetInstance().SetNetwork(&server);
+    FakePartition flash(2 * 1024 * 1024);
+    auto image = MakeImage(24 * kBlockSize + 777);
+    Apply(server, flash, image);
+
+    Touch(image, {2, 12, 20});
+    server.image = image;
+    server.manifest = MakeManifest(image);
+    server.served = 0;
+    server.ranges.clear();
+    // The network goes away during the second range
+    server.fail_after = server.manifest.size() + kBlockSize + kBlockSize / 2;
+    CHECK(!AssetsUpdate(&flash.partition).Download(kUrl, nullptr));
+    CHECK(server.ranges.size() == 2);
+    CHECK(AssetsUpdate::GetInterruptedDownloadUrl() == kUrl);
+
+    // After the reboot the first block is already in place
+    server.fail_after = SIZE_MAX;
+    server.served = 0;
+    server.ranges.clear();
+    CHECK(AssetsUpdate(&flash.partition).Download(AssetsUpdate::GetInterruptedDownloadUrl(), nullptr));
+    CHECK(flash.Holds(image));
+    CHECK(AssetsUpdate::GetInterruptedDownloadUrl().empty());
+    CHECK(server.ranges.size() == 2);
+    CHECK(server.ranges[0] == BlockRange(12, 12, image.size()));
+    CHECK(server.ranges[1] == BlockRange(20, 20, image.size()));
+    printf("resumed update:      %7zu bytes\n", server.served);
+}
+
+// A manifest that does not add up is ignored and the whole file downloaded instead
+static void TestCorruptManifestRejected() {
+    FakeServer server;
+    Board::GetInstance().SetNetwork(&server);
+    FakePartition flash(2 * 1024 * 1024);
+    auto image = MakeImage(24 * kBlockSize + 777);
+    Apply(server, flash, image);
+    Touch(image, {7});
+    server.image = image;
+
+    auto whole_file = [&](const std::string& manifest) {
+        server.manifest = manifest;
+        server.served = 0;
+        server.ranges.clear();
+        CHECK(AssetsUpdate(&flash.partition).Download(kUrl, nullptr));
+        CHECK(flash.Holds(image));
+        CHECK(!server.ranges.empty() && server.ranges.back().empty());
+    };
+
+    std::string good = MakeManifest(image);
+    std::string bad = good;
+    bad[0] = 'Y';
+    whole_file(bad);
+    // Block count that does not cover the image
+    bad = good;
+    bad[16]++;
+    whole_file(bad);
+    // Truncated block hashes
+    whole_file(good.substr(0, good.size() - 1));
+    // Block size that is not a whole number of sectors
+    bad = good;
+    bad[12] = 1;
+    whole_file(bad);
+
+    // Block hashes that say nothing changed while the image did: the image hash catches it
+    std::string stale = MakeManifest(image);
+    Touch(image, {7});
+    server.image = image;
+    good = MakeManifest(image);
+    memcpy(&stale[24], &good[24], 32);
+    whole_file(stale);
+    CHECK(server.ranges.size() == 1);
+}
+
+// Without the flush an update cut short by a power loss would leave new blocks checked against the old table
+static void TestBlockTableDroppedFirst() {
+    FakeServer server;
+    Board::GetInstance().SetNetwork(&server);
+    FakePartition flash(2 * 1024 * 1024);
+    auto image = MakeImage(24 * kBlockSize + 777);
+    Apply(server, flash, image);
+
+    // What InitializePartition() saves once it has checked the image
+    AssetBlockTable table;
+    table.Reset(reinterpret_cast<const char*>(flash.flash.data()), image.size());
+    table.Hash();
+    table.Save(3, 0x1234, image.size() - 12);
+    Settings::Flush();
+
+    Touch(image, {4});
+    server.image = image;
+    server.manifest = MakeManifest(image);
+    server.served = 0;
+    server.fail_after = server.manifest.size() + kBlockSize / 2;
+    auto untouched = flash.flash;
+    bool checked = false;
+    server.on_open = [&]() {
+        if (checked) {
+            return;
+        }
+        // Committed to NVS, not only dropped from the settings cache
+        nvs_handle_t handle;
+        if (nvs_open("assets_hash", NVS_READONLY, &handle) == ESP_OK) {
+            size_t length = 0;
+            CHECK(nvs_get_str(handle, "blocks", nullptr, &length) == ESP_ERR_NVS_NOT_FOUND);
+            nvs_close(handle);
+        }
+        CHECK(flash.flash == untouched);
+        checked = true;
+    };
+    CHECK(!AssetsUpdate(&flash.partition).Download(kUrl, nullptr));
+    CHECK(checked);
+    CHECK(!flash.Holds(image) && flash.flash != untouched);
+    CHECK(!table.Load(3, 0x1234, image.size() - 12));
+}
+
+int main() {
+    TestSuccessiveManifests();
+    TestInterruptedUpdateResumes();
+    TestCorruptManifestRejected();
+    TestBlockTableDroppedFirst();
+    printf("assets_update_test passed\n");
+    return 0;
+}
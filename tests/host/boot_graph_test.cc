@@ -0,0 +1,121 @@
+// Boot graph: independent steps overlap, dependencies are respected, broken graphs and failed tasks do not hang
+#include "boot_graph.h"
+#include "host_test.h"
+
+#include <esp_timer.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+// Simulated boot: the assets checksum runs on core 1 while display, network and audio run here
+static void TestParallelBoot() {
+    auto main_thread = std::this_thread::get_id();
+    std::atomic<int> order{0};
+    int display_at = -1, network_at = -1, audio_at = -1, assets_at = -1, mcp_at = -1;
+    bool steps_on_main = true;
+    bool assets_on_main = true;
+
+    BootGraph graph;
+    graph.AddStep("display", {}, [&] {
+        std::this_thread::sleep_for(100ms);
+        steps_on_main = steps_on_main && std::this_thread::get_id() == main_thread;
+        display_at = order++;
+    });
+    graph.AddStep("network", {"display"}, [&] {
+        std::this_thread::sleep_for(50ms);
+        network_at = order++;
+    });
+    graph.AddStep("audio", {}, [&] {
+        std::this_thread::sleep_for(150ms);
+        steps_on_main = steps_on_main && std::this_thread::get_id() == main_thread;
+        audio_at = order++;
+    });
+    graph.AddStep("assets", {}, [&] {
+        std::this_thread::sleep_for(300ms);
+        assets_on_main = std::this_thread::get_id() == main_thread;
+        assets_at = order++;
+    }, 1);
+    graph.AddStep("mcp", {"display", "assets"}, [&] {
+        mcp_at = order++;
+    });
+
+    int64_t start = esp_timer_get_time();
+    CHECK(graph.Run());
+    int64_t total_ms = (esp_timer_get_time() - start) / 1000;
+    printf("simulated boot: %lld ms, 600 ms one step after another\n", (long long)total_ms);
+    CHECK(total_ms < 350);
+
+    CHECK(order == 5);
+    CHECK(steps_on_main);
+    CHECK(!assets_on_main);
+    CHECK(network_at > display_at);
+    CHECK(audio_at >= 0);
+    CHECK(mcp_at > display_at && mcp_at > assets_at);
+
+    auto json = BootTimeline::GetInstance().ToJson();
+    CHECK(json.front() == '[' && json.back() == ']');
+    for (const char* name : {"display", "network", "audio", "assets", "mcp"}) {
+        CHECK(json.find(std::string("{\"name\":\"") + name + "\",\"start_us\":") != std::string::npos);
+    }
+}
+
+// Without memory for the task a pinned step runs on the calling task, its dependents still run
+static void TestTaskCreationFailure() {
+    auto main_thread = std::this_thread::get_id();
+    int assets_runs = 0, mcp_runs = 0;
+    bool assets_on_main = false;
+
+    BootGraph graph;
+    graph.AddStep("display", {}, [] {});
+    graph.AddStep("assets", {}, [&] {
+        assets_runs++;
+        assets_on_main = std::this_thread::get_id() == main_thread;
+    }, 1);
+    graph.AddStep("mcp", {"display", "assets"}, [&] {
+        mcp_runs++;
+    });
+
+    freertos_host_fail_task_creation(1);
+    CHECK(graph.Run());
+    CHECK(assets_runs == 1);
+    CHECK(assets_on_main);
+    CHECK(mcp_runs == 1);
+}
+
+static void TestBrokenGraphs() {
+    int runs = 0;
+    auto step = [&runs] { runs++; };
+
+    BootGraph circular;
+    circular.AddStep("start", {}, step);
+    circular.AddStep("a", {"start", "b"}, step);
+    circular.AddStep("b", {"a"}, step, 1);
+    CHECK(!circular.Run());
+
+    BootGraph self;
+    self.AddStep("a", {"a"}, step);
+    CHECK(!self.Run());
+
+    BootGraph unknown;
+    unknown.AddStep("a", {}, step);
+    unknown.AddStep("b", {"a", "x"}, step);
+    CHECK(!unknown.Run());
+
+    CHECK(runs == 0);
+
+    BootGraph empty;
+    CHECK(empty.Run());
+}
+
+int main() {
+    TestParallelBoot();
+    TestTaskCreationFailure();
+    TestBrokenGraphs();
+    printf("boot_graph_test passed\n");
+    return 0;
+}
@@ -0,0 +1,326 @@
+// Chat message list: a fixed pool of rows shows a window of the history, scrolling rebinds rows without moving
+// the visible bubbles, assistant sentences merge only within a turn. Prints the cost for 20, 100 and 500 messages.
+#include "chat_message_list.h"
+#include "host_test.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// The theme only supplies colors and spacing to the list
+LvglTheme::LvglTheme(const std::string& name) : Theme(name) {}
+
+static LvglTheme theme("light");
+
+static lv_obj_t* CreateContent() {
+    lv_obj_t* content = lv_obj_create(nullptr);
+    lv_obj_set_size(content, LV_HOR_RES, 240);
+    return content;
+}
+
+static std::string MessageText(int i) {
+    std::string text = "message " + std::to_string(i);
+    // Every seventh message wraps over several lines
+    if (i % 7 == 3) {
+        text += ": " + std::string(90, 'x');
+    }
+    return text;
+}
+
+static void AddMessages(ChatMessageList* list, int from, int to) {
+    for (int i = from; i < to; i++) {
+        list->AddMessage(i % 2 == 0 ? "user" : "assistant", MessageText(i).c_str(), &theme);
+        lv_host_run_async();
+    }
+}
+
+static lv_obj_t* RowLabel(lv_obj_t* row) {
+    if (lv_obj_get_child_cnt(row) == 0) {
+        return nullptr;
+    }
+    return lv_obj_get_child(lv_obj_get_child(row, 0), 0);
+}
+
+// Texts of the rows on the content, image bubbles as "<image>"
+static std::vector<std::string> ShownTexts(lv_obj_t* content) {
+    std::vector<std::string> texts;
+    for (uint32_t i = 0; i < lv_obj_get_child_cnt(content); i++) {
+        lv_obj_t* child = lv_obj_get_child(content, i);
+        if (!lv_obj_has_flag(child, LV_OBJ_FLAG_HIDDEN)) {
+            lv_obj_t* label = RowLabel(child);
+            texts.push_back(label != nullptr ? lv_label_get_text(label) : "<image>");
+        }
+    }
+    return texts;
+}
+
+// The rows show the history from first_shown() on, in order. `dropped` messages fell out of the history.
+static void CheckWindow(lv_obj_t* content, ChatMessageList* list, int dropped = 0) {
+    auto texts = ShownTexts(content);
+    CHECK(texts.size() == list->size());
+    for (size_t i = 0; i < texts.size(); i++) {
+        CHECK(texts[i] == MessageText(dropped + list->first_shown() + i));
+    }
+}
+
+// Position of the row showing `text` relative to the top of the viewport
+static int32_t ScreenY(lv_obj_t* content, const std::string& text) {
+    for (uint32_t i = 0; i < lv_obj_get_child_cnt(content); i++) {
+        lv_obj_t* child = lv_obj_get_child(content, i);
+        lv_obj_t* label = RowLabel(child);
+        if (!lv_obj_has_flag(child, LV_OBJ_FLAG_HIDDEN) && label != nullptr && text == lv_label_get_text(label)) {
+            return lv_obj_get_y(child) - lv_obj_get_scroll_y(content);
+        }
+    }
+    fprintf(stderr, "\"%s\" is not shown\n", text.c_str());
+    exit(1);
+}
+
+// Text of the first row reaching into the viewport when it is scrolled to `scroll_y`
+static std::string TopOfView(lv_obj_t* content, int32_t scroll_y) {
+    for (uint32_t i = 0; i < lv_obj_get_child_cnt(content); i++) {
+        lv_obj_t* child = lv_obj_get_child(content, i);
+        lv_obj_t* label = RowLabel(child);
+        if (!lv_obj_has_flag(child, LV_OBJ_FLAG_HIDDEN) && label != nullptr &&
+            lv_obj_get_y(child) + lv_obj_get_height(child) > scroll_y) {
+            return lv_label_get_text(label);
+        }
+    }
+    CHECK(false);
+    return "";
+}
+
+// Scroll by `step` until the end is reached, checking that the bubble scrolled to the top of the viewport stays
+// there, however the rows are rebound underneath it
+static void ScrollToEnd(lv_obj_t* content, ChatMessageList* list, int32_t step, int dropped = 0) {
+    for (int i = 0; i < 10000; i++) {
+        int32_t before = lv_obj_get_scroll_y(content);
+        // Scrolling is bounded by the content, which may have shrunk below the current position
+        int32_t end = before + lv_obj_get_scroll_bottom(content);
+        int32_t distance = std::min(std::max(before + step, 0), end) - before;
+        if (distance == 0) {
+            return;
+        }
+        std::string top = TopOfView(content, before + distance);
+        int32_t top_y = ScreenY(content, top) - distance;
+        lv_obj_scroll_to_y(content, before + step, LV_ANIM_OFF);
+
+        CheckWindow(content, list, dropped);
+        CHECK(list->size() <= list->row_count());
+        CHECK(ScreenY(content, top) == top_y);
+    }
+    CHECK(false);
+}
+
+static void TestWindow() {
+    lv_obj_t* content = CreateContent();
+    auto list = ChatMessageList::Attach(content, 100, 20);
+    CHECK(ChatMessageList::Attach(content, 100, 20) == list);
+    AddMessages(list, 0, 60);
+
+    CHECK(list->message_count() == 60);
+    CHECK(list->row_count() == 20);
+    CHECK(list->first_shown() == 40);
+    CheckWindow(content, list);
+    // One content object, then a container, bubble and label per row
+    CHECK(lv_host_get_stats().objects_alive == 1 + 20 * 3);
+    // The newest message is scrolled into view
+    CHECK(lv_obj_get_scroll_bottom(content) == 0);
+    lv_obj_delete(content);
+    CHECK(lv_host_get_stats().objects_alive == 0);
+}
+
+static void TestScrollBackAndForth() {
+    lv_obj_t* content = CreateContent();
+    auto list = ChatMessageList::Attach(content, 100, 20);
+    AddMessages(list, 0, 60);
+
+    ScrollToEnd(content, list, -40);
+    CHECK(list->first_shown() == 0);
+    CHECK(lv_obj_get_scroll_y(content) == 0);
+    CHECK(ShownTexts(content).front() == MessageText(0));
+
+    ScrollToEnd(content, list, 40);
+    CHECK(list->first_shown() + list->size() == 60);
+    CHECK(lv_obj_get_scroll_bottom(content) == 0);
+
+    // Large jumps move the window one step per scroll event, never past either end
+    ScrollToEnd(content, list, -1000);
+    CHECK(list->first_shown() == 0);
+    ScrollToEnd(content, list, 1000);
+    CHECK(list->first_shown() + list->size() == 60);
+    CHECK(list->row_count() == 20);
+    lv_obj_delete(content);
+}
+
+// A new message while older ones are in view brings back the newest ones
+static void TestAddWhileScrolledBack() {
+    lv_obj_t* content = CreateContent();
+    auto list = ChatMessageList::Attach(content, 100, 20);
+    AddMessages(list, 0, 60);
+    ScrollToEnd(content, list, -40);
+    CHECK(list->first_shown() == 0);
+
+    AddMessages(list, 60, 61);
+    CHECK(list->first_shown() == 41);
+    CheckWindow(content, list);
+    CHECK(lv_obj_get_scroll_bottom(content) == 0);
+    CHECK(list->row_count() == 20);
+    lv_obj_delete(content);
+}
+
+static void TestHistoryLimit() {
+    lv_obj_t* content = CreateContent();
+    auto list = ChatMessageList::Attach(content, 50, 20);
+    AddMessages(list, 0, 80);
+    CHECK(list->message_count() == 50);
+    ScrollToEnd(content, list, -40, 30);
+    CHECK(ShownTexts(content).front() == MessageText(30));
+    lv_obj_delete(content);
+
+    // With fewer messages than rows the oldest row is released
+    content = CreateContent();
+    list = ChatMessageList::Attach(content, 5, 20);
+    AddMessages(list, 0, 8);
+    CHECK(list->message_count() == 5);
+    CHECK(list->size() == 5);
+    CHECK(list->first_shown() == 0);
+    auto texts = ShownTexts(content);
+    CHECK(texts.front() == MessageText(3) && texts.back() == MessageText(7));
+    lv_obj_delete(content);
+}
+
+static void TestTurns() {
+    lv_obj_t* content = CreateContent();
+    auto list = ChatMessageList::Attach(content, 100, 20);
+
+    lv_obj_t* label = list->AddMessage("assistant", "Hello.", &theme);
+    CHECK(list->AppendToLast("assistant", "How are you?") == label);
+    CHECK(std::string(lv_label_get_text(label)) == "Hello. How are you?");
+    CHECK(list->message_count() == 1);
+    CHECK(lv_obj_get_style_width(label, LV_PART_MAIN) == 19 * 8);
+
+    // A finished turn is not continued
+    list->EndTurn();
+    CHECK(list->AppendToLast("assistant", "Bye.") == nullptr);
+
+    // Neither after someone else spoke, nor for user messages
+    list->AddMessage("assistant", "One.", &theme);
+    list->AddMessage("user", "Hi", &theme);
+    CHECK(list->AppendToLast("assistant", "Two.") == nullptr);
+    CHECK(list->AppendToLast("user", "there") == nullptr);
+    list->AddMessage("assistant", "Three.", &theme);
+    list->AddMessage("system", "Connecting", &theme);
+    CHECK(list->AppendToLast("assistant", "Four.") == nullptr);
+
+    // CJK sentences are joined without a space
+    label = list->AddMessage("assistant", "你好。", &theme);
+    CHECK(list->AppendToLast("assistant", "再见。") == label);
+    CHECK(std::string(lv_label_get_text(label)) == "你好。再见。");
+
+    // The merged text is measured as a whole, so pairs are kerned: 5 glyphs, two "AV" pairs
+    list->EndTurn();
+    label = list->AddMessage("assistant", "AV", &theme);
+    uint32_t measures = lv_host_get_stats().text_measures;
+    list->AppendToLast("assistant", "AV");
+    CHECK(lv_host_get_stats().text_measures == measures + 1);
+    CHECK(lv_obj_get_style_width(label, LV_PART_MAIN) == 5 * 8 - 2 * 2);
+    CHECK(list->message_count() == 7);
+    lv_obj_delete(content);
+}
+
+static void TestRemoveAndClear() {
+    lv_obj_t* content = CreateContent();
+    auto list = ChatMessageList::Attach(content, 100, 3);
+    list->AddMessage("user", "message 0", &theme);
+    list->AddMessage("system", "Connecting", &theme);
+    CHECK(list->RemoveLastIfRole("system"));
+    CHECK(!list->RemoveLastIfRole("system"));
+    CHECK(list->message_count() == 1);
+    CHECK(ShownTexts(content) == std::vector<std::string>{ MessageText(0) });
+
+    // Image bubbles above the rows are deleted once the row below them is recycled
+    AddMessages(list, 1, 3);
+    lv_obj_t* image = lv_obj_create(content);
+    lv_obj_set_height(image, 50);
+    CHECK(list->size() == 4);
+    AddMessages(list, 3, 7);
+    CHECK(list->size() == 3);
+    CheckWindow(content, list);
+    CHECK(lv_host_get_stats().objects_alive == 1 + 3 * 3);
+
+    image = lv_obj_create(content);
+    lv_obj_set_height(image, 50);
+    list->Clear();
+    CHECK(list->size() == 0);
+    CHECK(list->message_count() == 0);
+    CHECK(lv_host_get_stats().objects_alive == 1 + 3 * 3);
+
+    // The rows are reused after clearing
+    uint32_t created = lv_host_get_stats().objects_created;
+    AddMessages(list, 0, 3);
+    CHECK(lv_host_get_stats().objects_created == created);
+    CheckWindow(content, list);
+    lv_obj_delete(content);
+}
+
+// Streams `count` messages with four sentences per answer, then scrolls back to the first message.
+// rows == count is the list without virtualization: every message keeps its own objects.
+static void Benchmark(int count, size_t rows) {
+    lv_host_reset_stats();
+    auto start = std::chrono::steady_clock::now();
+    lv_obj_t* content = CreateContent();
+    auto list = ChatMessageList::Attach(content, count, rows);
+    for (int i = 0; i < count; i++) {
+        if (i % 2 == 0) {
+            list->AddMessage("user", MessageText(i).c_str(), &theme);
+        } else {
+            list->AddMessage("assistant", "First sentence.", &theme);
+            for (int j = 0; j < 3; j++) {
+                lv_host_run_async();
+                list->AppendToLast("assistant", "Another sentence of the answer.");
+            }
+            list->EndTurn();
+        }
+        lv_host_run_async();
+    }
+    auto added = std::chrono::steady_clock::now();
+    lv_host_stats_t add_stats = lv_host_get_stats();
+
+    while (lv_obj_get_scroll_top(content) > 0) {
+        lv_obj_scroll_to_y(content, lv_obj_get_scroll_y(content) - 40, LV_ANIM_OFF);
+    }
+    CHECK(list->first_shown() == 0);
+    CHECK(ShownTexts(content).front() == MessageText(0));
+    auto scrolled = std::chrono::steady_clock::now();
+    lv_host_stats_t stats = lv_host_get_stats();
+
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    printf("%3d messages, %3u rows: %4u objects (%4u created), %4u text measures, "
+           "%8llu children walked adding, %9llu scrolling back, %6lld us adding, %6lld us scrolling\n",
+           count, (unsigned)rows, add_stats.objects_alive, add_stats.objects_created, add_stats.text_measures,
+           (unsigned long long)add_stats.children_visited,
+           (unsigned long long)(stats.children_visited - add_stats.children_visited),
+           (long long)duration_cast<microseconds>(added - start).count(),
+           (long long)duration_cast<microseconds>(scrolled - added).count());
+    if (rows < (size_t)count) {
+        CHECK(add_stats.objects_alive == 1 + rows * 3);
+    }
+    lv_obj_delete(content);
+}
+
+int main() {
+    TestWindow();
+    TestScrollBackAndForth();
+    TestAddWhileScrolledBack();
+    TestHistoryLimit();
+    TestTurns();
+    TestRemoveAndClear();
+    for (int count : { 20, 100, 500 }) {
+        Benchmark(count, 20);
+        Benchmark(count, count);
+    }
+    printf("chat_message_list_test passed\n");
+    return 0;
+}
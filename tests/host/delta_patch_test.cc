@@ -0,0 +1,307 @@
+// Delta patches: the target is rebuilt for any read size, malformed patches fail without overruns.
+// Given a Python interpreter and scripts/firmware_delta.py, patches made by the script are applied too.
+#include "delta_patch.h"
+#include "host_test.h"
+
+#include <mbedtls/sha256.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static std::vector<uint8_t> RandomBytes(size_t size, uint32_t seed) {
+    std::vector<uint8_t> data(size);
+    for (auto& byte : data) {
+        seed = seed * 1664525u + 1013904223u;
+        byte = seed >> 24;
+    }
+    return data;
+}
+
+static void AppendLe32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(value >> (i * 8));
+    }
+}
+
+static void AppendVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(value);
+}
+
+// Writes patch records and applies them to the base on the side, to know the expected target
+class PatchWriter {
+public:
+    explicit PatchWriter(const std::vector<uint8_t>& base) : base_(base) {}
+
+    // `diff` is added to the base at the cursor, then `copy` is appended, then the cursor moves by `seek`
+    void Record(const std::vector<uint8_t>& diff, const std::vector<uint8_t>& copy, int64_t seek) {
+        AppendVarint(records_, diff.size());
+        AppendVarint(records_, copy.size());
+        AppendVarint(records_, seek >= 0 ? seek * 2 : -seek * 2 - 1);
+        size_t i = 0;
+        while (i < diff.size()) {
+            size_t zero = 0;
+            while (i + zero < diff.size() && diff[i + zero] == 0) {
+                zero++;
+            }
+            size_t literal = 0;
+            while (i + zero + literal < diff.size() && diff[i + zero + literal] != 0) {
+                literal++;
+            }
+            AppendVarint(records_, zero);
+            AppendVarint(records_, literal);
+            records_.insert(records_.end(), diff.begin() + i + zero, diff.begin() + i + zero + literal);
+            i += zero + literal;
+        }
+        records_.insert(records_.end(), copy.begin(), copy.end());
+
+        for (size_t k = 0; k < diff.size(); k++) {
+            target_.push_back(base_[cursor_ + k] + diff[k]);
+        }
+        target_.insert(target_.end(), copy.begin(), copy.end());
+        cursor_ += diff.size() + seek;
+    }
+
+    const std::vector<uint8_t>& target() const { return target_; }
+    size_t cursor() const { return cursor_; }
+
+    std::vector<uint8_t> Finish() const {
+        std::vector<uint8_t> patch = {'X', 'Z', 'D', '1'};
+        AppendLe32(patch, base_.size());
+        AppendLe32(patch, target_.size());
+        uint8_t digest[32];
+        mbedtls_sha256(base_.data(), base_.size(), digest, 0);
+        patch.insert(patch.end(), digest, digest + 32);
+        mbedtls_sha256(target_.data(), target_.size(), digest, 0);
+        patch.insert(patch.end(), digest, digest + 32);
+        patch.insert(patch.end(), records_.begin(), records_.end());
+        return patch;
+    }
+
+private:
+    const std::vector<uint8_t>& base_;
+    std::vector<uint8_t> records_;
+    std::vector<uint8_t> target_;
+    size_t cursor_ = 0;
+};
+
+enum class Outcome {
+    kBeginFailed,
+    kReadFailed,
+    kVerifyFailed,
+    kVerified,
+};
+
+// Applies `patch` handing out at most `patch_read` patch bytes per call and reading `target_read`
+// target bytes at a time
+static Outcome Apply(const std::vector<uint8_t>& base, const std::vector<uint8_t>& patch, size_t patch_read,
+    size_t target_read, std::vector<uint8_t>* target = nullptr) {
+    size_t patch_pos = 0;
+    DeltaPatch delta([&](uint8_t* buffer, size_t size) {
+        size = std::min({size, patch_read, patch.size() - patch_pos});
+        memcpy(buffer, patch.data() + patch_pos, size);
+        patch_pos += size;
+        return (int)size;
+    }, [&](size_t offset, uint8_t* buffer, size_t size) {
+        if (offset > base.size() || size > base.size() - offset) {
+            return false;
+        }
+        memcpy(buffer, base.data() + offset, size);
+        return true;
+    });
+    if (!delta.Begin()) {
+        return Outcome::kBeginFailed;
+    }
+
+    std::vector<uint8_t> output;
+    std::vector<uint8_t> buffer(target_read);
+    while (true) {
+        int ret = delta.Read(buffer.data(), buffer.size());
+        if (ret < 0) {
+            return Outcome::kReadFailed;
+        }
+        if (ret == 0) {
+            break;
+        }
+        CHECK((size_t)ret <= buffer.size());
+        output.insert(output.end(), buffer.begin(), buffer.begin() + ret);
+    }
+    CHECK(output.size() <= delta.target_size());
+    if (target != nullptr) {
+        *target = output;
+    }
+    return delta.Verify() ? Outcome::kVerified : Outcome::kVerifyFailed;
+}
+
+// Sparse differences, zero runs longer than a read, backward and forward seeks
+static PatchWriter MakeRecords(const std::vector<uint8_t>& base) {
+    PatchWriter writer(base);
+    std::vector<uint8_t> diff(20000, 0);
+    for (size_t i = 0; i < diff.size(); i += 97) {
+        diff[i] = 0x34;
+        diff[i + 1] = 0x12;
+    }
+    writer.Record(diff, RandomBytes(700, 1), -5000);
+    writer.Record(std::vector<uint8_t>(3000, 0), {}, 12000);
+    writer.Record(RandomBytes(1500, 2), RandomBytes(5, 3), 0);
+    writer.Record({}, RandomBytes(2000, 4), 100);
+    writer.Record(std::vector<uint8_t>(base.size() - writer.cursor(), 0), {}, 0);
+    return writer;
+}
+
+static void TestReadSizes() {
+    auto base = RandomBytes(64 * 1024, 7);
+    PatchWriter writer = MakeRecords(base);
+    auto patch = writer.Finish();
+
+    for (size_t patch_read : {1, 100, 512, 513, 100000}) {
+        for (size_t target_read : {1, 7, 511, 4096, 100000}) {
+            std::vector<uint8_t> target;
+            CHECK(Apply(base, patch, patch_read, target_read, &target) == Outcome::kVerified);
+            CHECK(target == writer.target());
+        }
+    }
+}
+
+static void TestWrongBase() {
+    auto base = RandomBytes(64 * 1024, 7);
+    auto patch = MakeRecords(base).Finish();
+    base[40000] ^= 0x01;
+    CHECK(Apply(base, patch, 512, 4096) == Outcome::kBeginFailed);
+    base.pop_back();
+    CHECK(Apply(base, patch, 512, 4096) == Outcome::kBeginFailed);
+}
+
+static void TestMalformed() {
+    auto base = RandomBytes(64 * 1024, 7);
+    auto patch = MakeRecords(base).Finish();
+
+    auto bad_magic = patch;
+    bad_magic[3] = '2';
+    CHECK(Apply(base, bad_magic, 512, 4096) == Outcome::kBeginFailed);
+
+    // Every truncation ends in an error, never in a verified image
+    for (size_t size = 0; size < patch.size(); size += size < DeltaPatch::kHeaderSize + 64 ? 1 : 37) {
+        std::vector<uint8_t> truncated(patch.begin(), patch.begin() + size);
+        CHECK(Apply(base, truncated, 512, 4096) != Outcome::kVerified);
+    }
+
+    auto wrong_target = patch;
+    wrong_target[DeltaPatch::kHeaderSize - 1] ^= 0x01;
+    CHECK(Apply(base, wrong_target, 512, 4096) == Outcome::kVerifyFailed);
+
+    auto flipped = patch;
+    flipped[patch.size() - 1000] ^= 0x40;
+    CHECK(Apply(base, flipped, 512, 4096) != Outcome::kVerified);
+
+    // Records pointing outside the base or the target
+    PatchWriter seek_before_start(base);
+    seek_before_start.Record(std::vector<uint8_t>(100, 0), {}, -200);
+    seek_before_start.Record({}, RandomBytes(10, 5), 0);
+    CHECK(Apply(base, seek_before_start.Finish(), 512, 4096) == Outcome::kReadFailed);
+
+    PatchWriter seek_past_end(base);
+    seek_past_end.Record(std::vector<uint8_t>(100, 0), {}, base.size());
+    seek_past_end.Record({}, RandomBytes(10, 5), 0);
+    CHECK(Apply(base, seek_past_end.Finish(), 512, 4096) == Outcome::kReadFailed);
+
+    // The last record copies 100 bytes, turned into adding 100 bytes from 50 bytes before the base end
+    PatchWriter add_past_base(base);
+    add_past_base.Record(std::vector<uint8_t>(100, 0), {}, base.size() - 150);
+    add_past_base.Record({}, RandomBytes(100, 6), 0);
+    auto add_past_patch = add_past_base.Finish();
+    size_t control = add_past_patch.size() - 100 - 3;
+    CHECK(add_past_patch[control] == 0 && add_past_patch[control + 1] == 100);
+    std::swap(add_past_patch[control], add_past_patch[control + 1]);
+    CHECK(Apply(base, add_past_patch, 512, 4096) == Outcome::kReadFailed);
+}
+
+static std::vector<uint8_t> LoadFile(const std::string& path) {
+    std::vector<uint8_t> data;
+    FILE* file = fopen(path.c_str(), "rb");
+    CHECK(file != nullptr);
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    fclose(file);
+    return data;
+}
+
+static void SaveFile(const std::string& path, const std::vector<uint8_t>& data) {
+    FILE* file = fopen(path.c_str(), "wb");
+    CHECK(file != nullptr);
+    CHECK(fwrite(data.data(), 1, data.size(), file) == data.size());
+    fclose(file);
+}
+
+// A new build: inserted and removed code, relocated pointers and a longer tail
+static void TestScriptPatch(const char* python, const char* script) {
+    std::vector<uint8_t> base;
+    uint32_t seed = 1;
+    while (base.size() < 300 * 1024) {
+        seed = seed * 1664525u + 1013904223u;
+        if (seed & 0x100) {
+            auto chunk = RandomBytes(10 + (seed >> 20) % 400, seed);
+            base.insert(base.end(), chunk.begin(), chunk.end());
+        } else {
+            base.insert(base.end(), 1 + (seed >> 24) % 64, "\x00\xff\x3c\x40"[(seed >> 16) & 3]);
+        }
+    }
+    auto target = base;
+    auto inserted = RandomBytes(5000, 11);
+    target.insert(target.begin() + 20000, inserted.begin(), inserted.end());
+    target.erase(target.begin() + 100000, target.begin() + 103000);
+    for (size_t p = 120000; p < 180000; p += 200) {
+        uint32_t value;
+        memcpy(&value, &target[p], 4);
+        value += 0x1234;
+        memcpy(&target[p], &value, 4);
+    }
+    auto tail = RandomBytes(10000, 12);
+    target.insert(target.end(), tail.begin(), tail.end());
+    target[0] = 0xE9;
+
+    char dir[] = "/tmp/delta_patch_test.XXXXXX";
+    CHECK(mkdtemp(dir) != nullptr);
+    std::string base_path = std::string(dir) + "/base.bin";
+    std::string target_path = std::string(dir) + "/target.bin";
+    std::string patch_path = std::string(dir) + "/firmware.patch";
+    SaveFile(base_path, base);
+    SaveFile(target_path, target);
+    std::string command = std::string(python) + " " + script + " diff " + base_path + " " + target_path + " " +
+        patch_path + " > /dev/null";
+    CHECK(system(command.c_str()) == 0);
+    auto patch = LoadFile(patch_path);
+    CHECK(patch.size() < target.size() / 4);
+
+    std::vector<uint8_t> rebuilt;
+    CHECK(Apply(base, patch, 1460, 4096, &rebuilt) == Outcome::kVerified);
+    CHECK(rebuilt == target);
+    CHECK(Apply(base, patch, 1, 3) == Outcome::kVerified);
+
+    unlink(base_path.c_str());
+    unlink(target_path.c_str());
+    unlink(patch_path.c_str());
+    rmdir(dir);
+    printf("script patch: %u bytes for a %u byte image\n", (unsigned)patch.size(), (unsigned)target.size());
+}
+
+int main(int argc, char** argv) {
+    TestReadSizes();
+    TestWrongBase();
+    TestMalformed();
+    if (argc == 3) {
+        TestScriptPatch(argv[1], argv[2]);
+    }
+    printf("delta_patch_test passed\n");
+    return 0;
+}
@@ -0,0 +1,243 @@
+// 回放 application.c 的事件序列，检查状态、动作与转换追踪
+#include "device_state_machine.h"
+#include "host_test.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#define MAX_ACTIONS 64
+
+static device_action_t s_actions[MAX_ACTIONS];
+static size_t s_action_count;
+static int s_state_changes;
+
+static void on_action(device_action_t action, device_event_t event, void* user_data) {
+    CHECK(s_action_count < MAX_ACTIONS);
+    s_actions[s_action_count++] = action;
+}
+
+static void on_state_change(device_state_t old_state, device_state_t new_state, void* user_data) {
+    CHECK(old_state != new_state);
+    s_state_changes++;
+}
+
+typedef struct {
+    device_event_t event;
+    int result;
+    device_state_t state;
+    device_action_t action;     // DEVICE_ACTION_NONE 表示不应触发动作
+} replay_step_t;
+
+static const replay_step_t s_session[] = {
+    // application_start()
+    { DEVICE_EVENT_WAKE_WORD,         -2, DEVICE_STATE_STARTING,         DEVICE_ACTION_NONE },
+    { DEVICE_EVENT_WIFI_CONFIG,        0, DEVICE_STATE_WIFI_CONFIGURING, DEVICE_ACTION_NONE },
+    { DEVICE_EVENT_NETWORK_CONNECTED,  0, DEVICE_STATE_IDLE,             DEVICE_ACTION_NONE },
+    // 空闲时的麦克风数据不上传
+    { DEVICE_EVENT_UPLINK_PACKET,     -2, DEVICE_STATE_IDLE,             DEVICE_ACTION_NONE },
+    // 唤醒后只标记第一个上行包
+    { DEVICE_EVENT_WAKE_WORD,          0, DEVICE_STATE_LISTENING,        DEVICE_ACTION_START_LISTENING },
+    { DEVICE_EVENT_UPLINK_PACKET,      0, DEVICE_STATE_LISTENING,        DEVICE_ACTION_MARK_UPLINK },
+    { DEVICE_EVENT_UPLINK_PACKET,      0, DEVICE_STATE_LISTENING,        DEVICE_ACTION_NONE },
+    { DEVICE_EVENT_UPLINK_PACKET,      0, DEVICE_STATE_LISTENING,        DEVICE_ACTION_NONE },
+    { DEVICE_EVENT_TTS_START,          0, DEVICE_STATE_SPEAKING,         DEVICE_ACTION_START_SPEAKING },
+    { DEVICE_EVENT_UPLINK_PACKET,     -2, DEVICE_STATE_SPEAKING,         DEVICE_ACTION_NONE },
+    // 打断后重新进入聆听，再次标记
+    { DEVICE_EVENT_WAKE_WORD,          0, DEVICE_STATE_LISTENING,        DEVICE_ACTION_ABORT_SPEAKING },
+    { DEVICE_EVENT_UPLINK_PACKET,      0, DEVICE_STATE_LISTENING,        DEVICE_ACTION_MARK_UPLINK },
+    { DEVICE_EVENT_TTS_START,          0, DEVICE_STATE_SPEAKING,         DEVICE_ACTION_START_SPEAKING },
+    { DEVICE_EVENT_TTS_STOP,           0, DEVICE_STATE_LISTENING,        DEVICE_ACTION_START_LISTENING },
+    { DEVICE_EVENT_STOP_LISTENING,     0, DEVICE_STATE_IDLE,             DEVICE_ACTION_STOP_LISTENING },
+    { DEVICE_EVENT_TTS_START,          0, DEVICE_STATE_SPEAKING,         DEVICE_ACTION_START_SPEAKING },
+    { DEVICE_EVENT_CHANNEL_CLOSED,     0, DEVICE_STATE_IDLE,             DEVICE_ACTION_CLOSE_CHANNEL },
+    { DEVICE_EVENT_ERROR,              0, DEVICE_STATE_ERROR,            DEVICE_ACTION_NONE },
+    { DEVICE_EVENT_WAKE_WORD,         -2, DEVICE_STATE_ERROR,            DEVICE_ACTION_NONE },
+    { DEVICE_EVENT_WIFI_CONFIG,        0, DEVICE_STATE_WIFI_CONFIGURING, DEVICE_ACTION_NONE },
+};
+
+#define SESSION_STEPS (sizeof(s_session) / sizeof(s_session[0]))
+
+static void test_replay(void) {
+    device_state_machine_t* sm = device_state_machine_create();
+    CHECK(sm != NULL);
+    device_state_machine_set_action_callback(sm, on_action, NULL);
+    CHECK(device_state_machine_add_listener(sm, on_state_change, NULL) >= 0);
+
+    size_t committed = 0;
+    int state_changes = 0;
+    for (size_t i = 0; i < SESSION_STEPS; i++) {
+        const replay_step_t* step = &s_session[i];
+        device_state_t before = device_state_machine_get_state(sm);
+        size_t actions_before = s_action_count;
+
+        CHECK(device_state_machine_accepts(sm, step->event) == (step->result == 0));
+        CHECK(device_state_machine_dispatch(sm, step->event) == step->result);
+        CHECK(device_state_machine_get_state(sm) == step->state);
+
+        if (step->action == DEVICE_ACTION_NONE) {
+            CHECK(s_action_count == actions_before);
+        } else {
+            CHECK(s_action_count == actions_before + 1);
+            CHECK(s_actions[actions_before] == step->action);
+        }
+
+        // 状态变化和首个上行包会写入追踪
+        if (step->result == 0 && (before != step->state || step->action == DEVICE_ACTION_MARK_UPLINK)) {
+            committed++;
+        }
+        if (before != step->state) {
+            state_changes++;
+        }
+    }
+    CHECK(s_state_changes == state_changes);
+
+    device_state_trace_entry_t trace[DEVICE_STATE_TRACE_SIZE];
+    size_t count = device_state_machine_get_trace(sm, trace, DEVICE_STATE_TRACE_SIZE);
+    CHECK(count == committed);
+    for (size_t i = 1; i < count; i++) {
+        CHECK(trace[i].timestamp_us >= trace[i - 1].timestamp_us);
+        CHECK(trace[i].from == trace[i - 1].to);
+    }
+    CHECK(trace[0].event == DEVICE_EVENT_WIFI_CONFIG);
+    CHECK(trace[0].from == DEVICE_STATE_STARTING);
+
+    // 最近一次唤醒到其后第一个上行包
+    CHECK(device_state_machine_trace_latency_us(sm, DEVICE_EVENT_WAKE_WORD, DEVICE_EVENT_UPLINK_PACKET) >= 0);
+    CHECK(device_state_machine_trace_latency_us(sm, DEVICE_EVENT_CHANNEL_CLOSED, DEVICE_EVENT_TTS_STOP) == -1);
+
+    device_state_machine_clear_trace(sm);
+    CHECK(device_state_machine_get_trace(sm, trace, DEVICE_STATE_TRACE_SIZE) == 0);
+    CHECK(device_state_machine_trace_latency_us(sm, DEVICE_EVENT_WAKE_WORD, DEVICE_EVENT_UPLINK_PACKET) == -1);
+
+    device_state_machine_destroy(sm);
+}
+
+// 追踪环形缓冲区溢出后只保留最新的条目
+static void test_trace_wraps(void) {
+    device_state_machine_t* sm = device_state_machine_create();
+    CHECK(sm != NULL);
+    CHECK(device_state_machine_dispatch(sm, DEVICE_EVENT_WIFI_CONFIG) == 0);
+    CHECK(device_state_machine_dispatch(sm, DEVICE_EVENT_NETWORK_CONNECTED) == 0);
+
+    const int rounds = DEVICE_STATE_TRACE_SIZE;
+    for (int i = 0; i < rounds; i++) {
+        CHECK(device_state_machine_dispatch(sm, DEVICE_EVENT_START_LISTENING) == 0);
+        CHECK(device_state_machine_dispatch(sm, DEVICE_EVENT_STOP_LISTENING) == 0);
+    }
+
+    device_state_trace_entry_t trace[DEVICE_STATE_TRACE_SIZE + 4];
+    size_t count = device_state_machine_get_trace(sm, trace, DEVICE_STATE_TRACE_SIZE + 4);
+    CHECK(count == DEVICE_STATE_TRACE_SIZE);
+    CHECK(trace[count - 1].event == DEVICE_EVENT_STOP_LISTENING);
+    CHECK(trace[count - 2].event == DEVICE_EVENT_START_LISTENING);
+
+    // 只取最新的两条
+    count = device_state_machine_get_trace(sm, trace, 2);
+    CHECK(count == 2);
+    CHECK(trace[0].event == DEVICE_EVENT_START_LISTENING);
+    CHECK(trace[1].event == DEVICE_EVENT_STOP_LISTENING);
+
+    device_state_machine_destroy(sm);
+}
+
+static void test_invalid_arguments(void) {
+    CHECK(device_state_machine_dispatch(NULL, DEVICE_EVENT_WAKE_WORD) == -1);
+    CHECK(!device_state_machine_accepts(NULL, DEVICE_EVENT_WAKE_WORD));
+    CHECK(strcmp(device_state_machine_event_name(DEVICE_EVENT_MAX), "direct") == 0);
+    CHECK(strcmp(device_state_machine_state_name(DEVICE_STATE_MAX), "invalid_state") == 0);
+
+    device_state_machine_t* sm = device_state_machine_create();
+    CHECK(sm != NULL);
+    CHECK(device_state_machine_dispatch(sm, DEVICE_EVENT_MAX) == -1);
+    CHECK(!device_state_machine_accepts(sm, DEVICE_EVENT_MAX));
+    device_state_machine_destroy(sm);
+}
+
+#define DISPATCH_ROUNDS 20000
+
+static atomic_int s_concurrent_actions;
+static atomic_bool s_dispatch_done;
+
+// 动作回调在锁外执行，可以读取追踪
+static void on_concurrent_action(device_action_t action, device_event_t event, void* user_data) {
+    device_state_machine_t* sm = (device_state_machine_t*)user_data;
+    device_state_machine_trace_latency_us(sm, DEVICE_EVENT_WAKE_WORD, DEVICE_EVENT_UPLINK_PACKET);
+    atomic_fetch_add(&s_concurrent_actions, 1);
+}
+
+typedef struct {
+    device_state_machine_t* sm;
+    device_event_t events[2];
+    int accepted;
+} dispatcher_t;
+
+static void* dispatcher_thread(void* arg) {
+    dispatcher_t* dispatcher = (dispatcher_t*)arg;
+    for (int i = 0; i < DISPATCH_ROUNDS; i++) {
+        int result = device_state_machine_dispatch(dispatcher->sm, dispatcher->events[i & 1]);
+        CHECK(result == 0 || result == -2);
+        dispatcher->accepted += result == 0;
+    }
+    return NULL;
+}
+
+// 追踪中相邻两条必须首尾相接
+static void* trace_reader_thread(void* arg) {
+    device_state_machine_t* sm = (device_state_machine_t*)arg;
+    device_state_trace_entry_t trace[DEVICE_STATE_TRACE_SIZE];
+    while (!atomic_load(&s_dispatch_done)) {
+        size_t count = device_state_machine_get_trace(sm, trace, DEVICE_STATE_TRACE_SIZE);
+        for (size_t i = 1; i < count; i++) {
+            CHECK(trace[i].from == trace[i - 1].to);
+            CHECK(trace[i].timestamp_us >= trace[i - 1].timestamp_us);
+        }
+    }
+    return NULL;
+}
+
+// 唤醒词、协议与主任务同时分发事件
+static void test_concurrent_dispatch(void) {
+    device_state_machine_t* sm = device_state_machine_create();
+    CHECK(sm != NULL);
+    device_state_machine_set_action_callback(sm, on_concurrent_action, sm);
+    CHECK(device_state_machine_dispatch(sm, DEVICE_EVENT_WIFI_CONFIG) == 0);
+    CHECK(device_state_machine_dispatch(sm, DEVICE_EVENT_NETWORK_CONNECTED) == 0);
+    device_state_machine_clear_trace(sm);
+
+    dispatcher_t dispatchers[] = {
+        { sm, { DEVICE_EVENT_WAKE_WORD, DEVICE_EVENT_UPLINK_PACKET }, 0 },
+        { sm, { DEVICE_EVENT_TTS_START, DEVICE_EVENT_TTS_STOP }, 0 },
+        { sm, { DEVICE_EVENT_STOP_LISTENING, DEVICE_EVENT_CHANNEL_CLOSED }, 0 },
+    };
+    const int dispatcher_count = sizeof(dispatchers) / sizeof(dispatchers[0]);
+    pthread_t threads[sizeof(dispatchers) / sizeof(dispatchers[0])];
+    pthread_t reader;
+    CHECK(pthread_create(&reader, NULL, trace_reader_thread, sm) == 0);
+    for (int i = 0; i < dispatcher_count; i++) {
+        CHECK(pthread_create(&threads[i], NULL, dispatcher_thread, &dispatchers[i]) == 0);
+    }
+    int accepted = 0;
+    for (int i = 0; i < dispatcher_count; i++) {
+        pthread_join(threads[i], NULL);
+        accepted += dispatchers[i].accepted;
+    }
+    atomic_store(&s_dispatch_done, true);
+    pthread_join(reader, NULL);
+
+    // 除重复的上行包外每次成功分发都带有动作
+    CHECK(accepted > 0);
+    CHECK(atomic_load(&s_concurrent_actions) <= accepted);
+    device_state_t state = device_state_machine_get_state(sm);
+    CHECK(state == DEVICE_STATE_IDLE || state == DEVICE_STATE_LISTENING || state == DEVICE_STATE_SPEAKING);
+    device_state_machine_destroy(sm);
+}
+
+int main(void) {
+    test_replay();
+    test_trace_wraps();
+    test_invalid_arguments();
+    test_concurrent_dispatch();
+    printf("device_state_machine_test passed\n");
+    return 0;
+}
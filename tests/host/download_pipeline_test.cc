@@ -0,0 +1,428 @@
+// Download pipeline: resumed downloads match the served file, failures end instead of hanging. Prints the
+// throughput of the pipeline against the sequential read, erase, write loop it replaced, over a network and
+// flash that take time.
+#include "download_pipeline.h"
+#include "board.h"
+#include "host_test.h"
+#include "settings.h"
+
+#include <freertos/task.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char* kUrl = "http://example.com/firmware.bin";
+static const char* kJournal = "test_journal";
+
+// Serves `data`, honoring Range and If-Range requests when `support_range` is set
+class FakeServer : public NetworkInterface {
+public:
+    std::vector<uint8_t> data;
+    std::string etag = "\"v1\"";
+    bool support_range = true;
+    bool support_if_range = true;
+    size_t drop_after = SIZE_MAX;  // Bytes served on each connection before it fails
+    int segment_us = 0;            // Time each segment takes to arrive
+    int max_opens = INT_MAX;       // Later connections fail to open
+    int opens = 0;
+    size_t served = 0;
+    std::vector<std::string> if_ranges;
+
+    std::unique_ptr<Http> CreateHttp(int connect_id) override;
+};
+
+class FakeHttp : public Http {
+public:
+    explicit FakeHttp(FakeServer* server) : server_(server) {}
+
+    void SetHeader(const std::string& key, const std::string& value) override {
+        if (key == "Range") {
+            range_start_ = std::stoul(value.substr(strlen("bytes=")));
+            has_range_ = true;
+        } else if (key == "If-Range") {
+            if_range_ = value;
+        }
+    }
+
+    bool Open(const std::string& method, const std::string& url) override {
+        if (++server_->opens > server_->max_opens) {
+            return false;
+        }
+        server_->if_ranges.push_back(if_range_);
+        status_ = 200;
+        position_ = 0;
+        if (has_range_ && server_->support_range) {
+            if (server_->support_if_range && !if_range_.empty() && if_range_ != server_->etag) {
+                status_ = 200;
+            } else if (range_start_ >= server_->data.size()) {
+                status_ = 416;
+                position_ = server_->data.size();
+            } else {
+                status_ = 206;
+                position_ = range_start_;
+            }
+        }
+        limit_ = server_->drop_after == SIZE_MAX ? SIZE_MAX : position_ + server_->drop_after;
+        return true;
+    }
+
+    void Close() override {}
+
+    int Read(char* buffer, size_t buffer_size) override {
+        if (position_ >= limit_) {
+            return -1;
+        }
+        size_t size = std::min({buffer_size, server_->data.size() - position_, limit_ - position_, (size_t)1460});
+        if (server_->segment_us > 0 && size > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(server_->segment_us));
+        }
+        memcpy(buffer, server_->data.data() + position_, size);
+        position_ += size;
+        server_->served += size;
+        return (int)size;
+    }
+
+    int GetStatusCode() override { return status_; }
+    size_t GetBodyLength() override { return server_->data.size() - position_; }
+
+    std::string GetResponseHeader(const std::string& key) const override {
+        return key == "ETag" ? server_->etag : "";
+    }
+
+private:
+    FakeServer* server_;
+    size_t range_start_ = 0;
+    bool has_range_ = false;
+    std::string if_range_;
+    int status_ = 0;
+    size_t position_ = 0;
+    size_t limit_ = SIZE_MAX;
+};
+
+std::unique_ptr<Http> FakeServer::CreateHttp(int connect_id) {
+    return std::make_unique<FakeHttp>(this);
+}
+
+struct FakePartition {
+    std::vector<uint8_t> flash;
+    esp_partition_t partition = {};
+
+    explicit FakePartition(size_t size) : flash(size, 0xFF) {
+        partition.address = 0x100000;
+        partition.size = size;
+        partition.erase_size = 4096;
+        strcpy(partition.label, "ota_0");
+        partition.host_data = flash.data();
+    }
+
+    bool Holds(const std::vector<uint8_t>& data) const {
+        return memcmp(flash.data(), data.data(), data.size()) == 0;
+    }
+};
+
+static std::vector<uint8_t> MakeFirmware(size_t size) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = (uint8_t)((i * 2654435761u) >> 13);
+    }
+    data[0] = 0xE9;
+    return data;
+}
+
+static bool JournalEmpty() {
+    return Settings(kJournal).GetString("url").empty();
+}
+
+// Offset of the journal as committed to NVS, not as held in the settings cache
+static int32_t CommittedOffset() {
+    nvs_handle_t handle;
+    int32_t offset = 0;
+    if (nvs_open(kJournal, NVS_READONLY, &handle) == ESP_OK) {
+        nvs_get_i32(handle, "offset", &offset);
+        nvs_close(handle);
+    }
+    return offset;
+}
+
+static void TestResumesAfterDrops() {
+    FakeServer server;
+    server.data = MakeFirmware(1024 * 1024 + 777);
+    server.drop_after = 300 * 1024;
+    Board::GetInstance().SetNetwork(&server);
+
+    FakePartition flash(2 * 1024 * 1024);
+    DownloadPipeline pipeline(&flash.partition);
+    size_t length = 0;
+    CHECK(pipeline.Download(kUrl, kJournal, nullptr, length));
+    CHECK(length == server.data.size());
+    CHECK(flash.Holds(server.data));
+    CHECK(server.opens == 4);
+    // Every connection continued where the previous one stopped, less than a chunk is fetched twice
+    CHECK(server.served < server.data.size() + 4 * 32 * 1024);
+    CHECK(JournalEmpty());
+}
+
+static void TestResumesAfterReboot() {
+    FakeServer server;
+    server.data = MakeFirmware(1024 * 1024);
+    server.support_range = false;
+    server.drop_after = 600 * 1024;
+    Board::GetInstance().SetNetwork(&server);
+
+    // Without Range support every attempt starts over and fails at the same point
+    FakePartition flash(2 * 1024 * 1024);
+    size_t length = 0;
+    {
+        DownloadPipeline pipeline(&flash.partition);
+        CHECK(!pipeline.Download(kUrl, kJournal, nullptr, length));
+    }
+    CHECK(Settings(kJournal).GetInt("offset") >= 512 * 1024);
+    // The journal survives a power loss, it does not wait for the settings commit delay
+    CHECK(CommittedOffset() == Settings(kJournal).GetInt("offset"));
+
+    // A new pipeline picks up the journal once the server resumes
+    server.support_range = true;
+    server.drop_after = SIZE_MAX;
+    server.served = 0;
+    {
+        DownloadPipeline pipeline(&flash.partition);
+        CHECK(pipeline.Download(kUrl, kJournal, nullptr, length));
+    }
+    CHECK(server.served <= server.data.size() - 512 * 1024);
+    CHECK(flash.Holds(server.data));
+    CHECK(JournalEmpty());
+}
+
+static void TestCorruptedFlashRestarts() {
+    FakeServer server;
+    server.data = MakeFirmware(1024 * 1024);
+    server.support_range = false;
+    server.drop_after = 600 * 1024;
+    Board::GetInstance().SetNetwork(&server);
+
+    FakePartition flash(2 * 1024 * 1024);
+    size_t length = 0;
+    {
+        DownloadPipeline pipeline(&flash.partition);
+        CHECK(!pipeline.Download(kUrl, kJournal, nullptr, length));
+    }
+    flash.flash[5000] ^= 0x01;
+
+    server.support_range = true;
+    server.drop_after = SIZE_MAX;
+    server.served = 0;
+    DownloadPipeline pipeline(&flash.partition);
+    CHECK(pipeline.Download(kUrl, kJournal, nullptr, length));
+    CHECK(server.served == server.data.size());
+    CHECK(flash.Holds(server.data));
+}
+
+// Interrupts a download so that its journal stays behind, like a reboot in the middle
+static void LeaveJournal(FakeServer& server, FakePartition& flash, size_t drop_after) {
+    server.drop_after = drop_after;
+    server.max_opens = server.opens + 1;
+    DownloadPipeline pipeline(&flash.partition);
+    size_t length = 0;
+    CHECK(!pipeline.Download(kUrl, kJournal, nullptr, length));
+    CHECK(Settings(kJournal).GetInt("offset") > 0);
+    server.drop_after = SIZE_MAX;
+    server.max_opens = INT_MAX;
+    server.served = 0;
+}
+
+// A file replaced by one of the same size is downloaded again instead of being spliced
+static void TestChangedFileRestarts() {
+    FakeServer server;
+    server.data = MakeFirmware(1024 * 1024);
+    Board::GetInstance().SetNetwork(&server);
+    FakePartition flash(2 * 1024 * 1024);
+    LeaveJournal(server, flash, 600 * 1024);
+
+    std::reverse(server.data.begin() + 1, server.data.end());
+    server.etag = "\"v2\"";
+    DownloadPipeline pipeline(&flash.partition);
+    size_t length = 0;
+    CHECK(pipeline.Download(kUrl, kJournal, nullptr, length));
+    CHECK(server.if_ranges.back() == "\"v1\"");
+    CHECK(server.served == server.data.size());
+    CHECK(flash.Holds(server.data));
+}
+
+// 416 for a file that shrank below the journaled offset
+static void TestRangeNotSatisfiableRestarts() {
+    FakeServer server;
+    server.data = MakeFirmware(1024 * 1024);
+    server.support_if_range = false;
+    Board::GetInstance().SetNetwork(&server);
+    FakePartition flash(2 * 1024 * 1024);
+    LeaveJournal(server, flash, 600 * 1024);
+
+    server.data.resize(256 * 1024);
+    int opens = server.opens;
+    DownloadPipeline pipeline(&flash.partition);
+    size_t length = 0;
+    CHECK(pipeline.Download(kUrl, kJournal, nullptr, length));
+    CHECK(server.opens == opens + 2);
+    CHECK(length == server.data.size());
+    CHECK(flash.Holds(server.data));
+    CHECK(JournalEmpty());
+}
+
+// 206 whose length does not add up to the journaled file
+static void TestMismatchedPartialRestarts() {
+    FakeServer server;
+    server.data = MakeFirmware(1024 * 1024);
+    server.support_if_range = false;
+    Board::GetInstance().SetNetwork(&server);
+    FakePartition flash(2 * 1024 * 1024);
+    LeaveJournal(server, flash, 600 * 1024);
+
+    server.data = MakeFirmware(1536 * 1024);
+    int opens = server.opens;
+    DownloadPipeline pipeline(&flash.partition);
+    size_t length = 0;
+    CHECK(pipeline.Download(kUrl, kJournal, nullptr, length));
+    CHECK(server.opens == opens + 2);
+    CHECK(length == server.data.size());
+    CHECK(flash.Holds(server.data));
+}
+
+// A file larger than the partition fails at once
+static void TestOversizedBodyFails() {
+    FakeServer server;
+    server.data = MakeFirmware(1024 * 1024 + 1);
+    Board::GetInstance().SetNetwork(&server);
+    FakePartition flash(1024 * 1024);
+    DownloadPipeline pipeline(&flash.partition);
+    size_t length = 0;
+    CHECK(!pipeline.Download(kUrl, kJournal, nullptr, length));
+    CHECK(server.opens == 1);
+    CHECK(server.served == 0);
+}
+
+// A rejected image is never written and not downloaded again
+static void TestHeaderCheckRejects() {
+    FakeServer server;
+    server.data = MakeFirmware(256 * 1024);
+    server.data[0] = '<';
+    Board::GetInstance().SetNetwork(&server);
+
+    FakePartition flash(1024 * 1024);
+    DownloadPipeline pipeline(&flash.partition);
+    pipeline.SetHeaderCheck([](const uint8_t* data, size_t size) {
+        return data[0] == 0xE9;
+    });
+    size_t length = 0;
+    CHECK(!pipeline.Download(kUrl, kJournal, nullptr, length));
+    CHECK(server.opens == 1);
+    CHECK(std::all_of(flash.flash.begin(), flash.flash.end(), [](uint8_t byte) { return byte == 0xFF; }));
+
+    server.data[0] = 0xE9;
+    CHECK(pipeline.Download(kUrl, kJournal, nullptr, length));
+    CHECK(flash.Holds(server.data));
+}
+
+// Without a writer nobody returns the chunks, Run() has to fail instead of waiting forever
+static void TestWriterTaskFailure() {
+    FakePartition flash(1024 * 1024);
+    DownloadPipeline pipeline(&flash.partition);
+    int reads = 0;
+    auto read = [&reads](uint8_t* buffer, size_t size) {
+        reads++;
+        memset(buffer, 0x5A, size);
+        return (int)size;
+    };
+
+    freertos_host_fail_task_creation(1);
+    CHECK(!pipeline.Run(read, 0, 512 * 1024, nullptr));
+    CHECK(reads == 0);
+
+    CHECK(pipeline.Run(read, 0, 512 * 1024, nullptr));
+    CHECK(flash.flash[512 * 1024 - 1] == 0x5A);
+    CHECK(flash.flash[512 * 1024] == 0xFF);
+}
+
+// What the pipeline replaced: fill a 4 KB buffer from the connection, then erase its sector and write it, like
+// esp_ota_write() with OTA_WITH_SEQUENTIAL_WRITES on the downloading task
+static bool SequentialDownload(Http* http, const esp_partition_t* partition, size_t length) {
+    std::vector<uint8_t> buffer(4096);
+    size_t offset = 0;
+    while (offset < length) {
+        size_t filled = 0;
+        while (filled < buffer.size() && offset + filled < length) {
+            int ret = http->Read(reinterpret_cast<char*>(buffer.data() + filled), buffer.size() - filled);
+            if (ret <= 0) {
+                return false;
+            }
+            filled += ret;
+        }
+        if (esp_partition_erase_range(partition, offset, buffer.size()) != ESP_OK ||
+            esp_partition_write(partition, offset, buffer.data(), filled) != ESP_OK) {
+            return false;
+        }
+        offset += filled;
+    }
+    return true;
+}
+
+static long long KBps(size_t bytes, long long us) {
+    return us > 0 ? (long long)(bytes * 1000000ULL / 1024 / us) : 0;
+}
+
+// Times are a tenth of the real ones so the test stays short: a 4 KB sector erases in 4 ms (~40 ms on
+// the target's NOR flash), 1 KB programs in 0.2 ms and a 1460 byte segment arrives every `segment_us`
+static void BenchmarkThroughput(const char* network, int segment_us) {
+    FakeServer server;
+    server.data = MakeFirmware(384 * 1024);
+    server.segment_us = segment_us;
+    esp_partition_host_set_timing(4000, 200);
+
+    FakePartition before(512 * 1024);
+    auto http = server.CreateHttp(0);
+    CHECK(http->Open("GET", kUrl));
+    auto start = std::chrono::steady_clock::now();
+    CHECK(SequentialDownload(http.get(), &before.partition, server.data.size()));
+    long long before_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    CHECK(before.Holds(server.data));
+
+    FakePartition after(512 * 1024);
+    DownloadPipeline pipeline(&after.partition);
+    http = server.CreateHttp(0);
+    CHECK(http->Open("GET", kUrl));
+    CHECK(pipeline.Run(http.get(), 0, server.data.size(), nullptr));
+    CHECK(after.Holds(server.data));
+    esp_partition_host_set_timing(0, 0);
+
+    auto& stats = pipeline.stats();
+    CHECK(stats.bytes == server.data.size());
+    printf("%-5s %zu KB: sequential %5lld ms (%4lld KB/s); pipelined %5lld ms (%4lld KB/s), read %lld ms, "
+           "waiting for flash %lld ms, write %lld ms, erase %lld ms, waiting for network %lld ms\n",
+           network, server.data.size() / 1024, before_us / 1000, KBps(server.data.size(), before_us),
+           (long long)stats.total_us / 1000, KBps(stats.bytes, stats.total_us), (long long)stats.read_us / 1000,
+           (long long)stats.reader_wait_us / 1000, (long long)stats.write_us / 1000,
+           (long long)stats.erase_us / 1000, (long long)stats.writer_idle_us / 1000);
+    // Overlapping has to hide most of the smaller of network and flash time, not just win by noise
+    CHECK(stats.total_us * 5 < before_us * 4);
+}
+
+int main() {
+    TestResumesAfterDrops();
+    TestResumesAfterReboot();
+    TestCorruptedFlashRestarts();
+    TestChangedFileRestarts();
+    TestRangeNotSatisfiableRestarts();
+    TestMismatchedPartialRestarts();
+    TestOversizedBodyFails();
+    TestHeaderCheckRejects();
+    TestWriterTaskFailure();
+    BenchmarkThroughput("fast", 700);
+    BenchmarkThroughput("slow", 3000);
+    printf("download_pipeline_test passed\n");
+    return 0;
+}
@@ -0,0 +1,171 @@
+// 事件系统：同步/延迟投递、队列满丢弃、取消订阅后的宽限期
+#include "event_system.h"
+#include "host_test.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#define LISTENER_MAGIC 0x4c495354u
+
+typedef struct {
+    uint32_t magic;
+    atomic_int calls;
+} listener_state_t;
+
+static void count_callback(const event_t* event, void* user_data) {
+    listener_state_t* state = (listener_state_t*)user_data;
+    // 监听器释放后仍被回调时 ASan 在此报告 use-after-free
+    CHECK(state->magic == LISTENER_MAGIC);
+    atomic_fetch_add(&state->calls, 1);
+}
+
+static event_listener_t make_listener(listener_state_t* state, event_type_t type,
+                                      event_delivery_t delivery) {
+    event_listener_t listener = {
+        .callback = count_callback,
+        .user_data = state,
+        .event_mask = EVENT_MASK(type),
+        .delivery = delivery,
+        .next = NULL
+    };
+    return listener;
+}
+
+static void test_sync_and_deferred(void) {
+    event_system_init();
+    event_system_reset_stats();
+
+    listener_state_t sync_state = { LISTENER_MAGIC, 0 };
+    listener_state_t deferred_state = { LISTENER_MAGIC, 0 };
+    listener_state_t other_state = { LISTENER_MAGIC, 0 };
+    event_listener_t sync_listener = make_listener(&sync_state, EVENT_VAD_CHANGE, EVENT_DELIVERY_SYNC);
+    event_listener_t deferred_listener = make_listener(&deferred_state, EVENT_VAD_CHANGE, EVENT_DELIVERY_DEFERRED);
+    event_listener_t other_listener = make_listener(&other_state, EVENT_OTA_START, EVENT_DELIVERY_SYNC);
+    CHECK(event_subscribe(&sync_listener) == 0);
+    CHECK(event_subscribe(&deferred_listener) == 0);
+    CHECK(event_subscribe(&other_listener) == 0);
+
+    event_publish_type(EVENT_VAD_CHANGE);
+    event_publish_type(EVENT_VAD_CHANGE);
+    CHECK(atomic_load(&sync_state.calls) == 2);
+    CHECK(atomic_load(&deferred_state.calls) == 0);
+    CHECK(atomic_load(&other_state.calls) == 0);
+    CHECK(event_system_pending() == 2);
+
+    CHECK(event_system_dispatch_pending(1) == 1);
+    CHECK(event_system_dispatch_pending(16) == 1);
+    CHECK(atomic_load(&deferred_state.calls) == 2);
+    CHECK(event_system_pending() == 0);
+
+    // 队列满后丢弃并计数
+    for (int i = 0; i < EVENT_QUEUE_SIZE + 3; i++) {
+        event_publish_type(EVENT_VAD_CHANGE);
+    }
+    event_system_stats_t stats;
+    event_system_get_stats(&stats);
+    CHECK(stats.dropped == 3);
+    CHECK(stats.queue_high_water == EVENT_QUEUE_SIZE);
+    CHECK(event_system_dispatch_pending(EVENT_QUEUE_SIZE * 2) == EVENT_QUEUE_SIZE);
+
+    // 取消订阅后已入队的事件不再投递给该监听器
+    event_publish_type(EVENT_VAD_CHANGE);
+    CHECK(event_unsubscribe(&deferred_listener) == 0);
+    int before = atomic_load(&deferred_state.calls);
+    CHECK(event_system_dispatch_pending(16) == 1);
+    CHECK(atomic_load(&deferred_state.calls) == before);
+    CHECK(event_unsubscribe(&deferred_listener) == -1);
+
+    event_system_deinit();
+    event_publish_type(EVENT_VAD_CHANGE);
+    CHECK(atomic_load(&sync_state.calls) == EVENT_QUEUE_SIZE + 3 + 2 + 1);
+}
+
+static event_listener_t s_self_listener;
+static int s_self_result;
+
+static void unsubscribe_self(const event_t* event, void* user_data) {
+    s_self_result = event_unsubscribe(&s_self_listener);
+}
+
+// 回调内等待宽限期会等到自己，必须被拒绝
+static void test_unsubscribe_in_callback(void) {
+    event_system_init();
+    s_self_listener = (event_listener_t){
+        .callback = unsubscribe_self,
+        .event_mask = EVENT_MASK(EVENT_BUTTON_PRESS),
+        .delivery = EVENT_DELIVERY_SYNC
+    };
+    CHECK(event_subscribe(&s_self_listener) == 0);
+    event_publish_type(EVENT_BUTTON_PRESS);
+    CHECK(s_self_result == -2);
+    CHECK(event_unsubscribe(&s_self_listener) == 0);
+    event_system_deinit();
+}
+
+static atomic_bool s_stop;
+
+static void* publisher_thread(void* arg) {
+    while (!atomic_load(&s_stop)) {
+        event_publish_type(EVENT_STATE_CHANGE);
+    }
+    return NULL;
+}
+
+static void* dispatcher_thread(void* arg) {
+    while (!atomic_load(&s_stop)) {
+        event_system_dispatch_pending(EVENT_QUEUE_SIZE);
+    }
+    return NULL;
+}
+
+// 取消订阅返回后立即释放监听器，并发的发布者不能再访问它
+static void test_unsubscribe_then_free(void) {
+    event_system_init();
+    atomic_store(&s_stop, false);
+
+    pthread_t publishers[3];
+    pthread_t dispatcher;
+    for (int i = 0; i < 3; i++) {
+        CHECK(pthread_create(&publishers[i], NULL, publisher_thread, NULL) == 0);
+    }
+    CHECK(pthread_create(&dispatcher, NULL, dispatcher_thread, NULL) == 0);
+
+    int delivered = 0;
+    for (int i = 0; i < 200; i++) {
+        listener_state_t* state = malloc(sizeof(listener_state_t));
+        event_listener_t* listener = malloc(sizeof(event_listener_t));
+        CHECK(state != NULL && listener != NULL);
+        state->magic = LISTENER_MAGIC;
+        atomic_init(&state->calls, 0);
+        *listener = make_listener(state, EVENT_STATE_CHANGE,
+                                  (i & 1) ? EVENT_DELIVERY_DEFERRED : EVENT_DELIVERY_SYNC);
+
+        CHECK(event_subscribe(listener) == 0);
+        // 等到回调真正开始进入，让取消订阅与发布者重叠
+        for (int spin = 0; spin < 100000 && atomic_load(&state->calls) == 0; spin++) {
+        }
+        CHECK(event_unsubscribe(listener) == 0);
+        delivered += atomic_load(&state->calls);
+
+        memset(state, 0, sizeof(*state));
+        free(state);
+        free(listener);
+    }
+
+    atomic_store(&s_stop, true);
+    for (int i = 0; i < 3; i++) {
+        pthread_join(publishers[i], NULL);
+    }
+    pthread_join(dispatcher, NULL);
+    event_system_deinit();
+    printf("200 listeners churned, %d callbacks delivered\n", delivered);
+}
+
+int main(void) {
+    test_sync_and_deferred();
+    test_unsubscribe_in_callback();
+    test_unsubscribe_then_free();
+    printf("event_system_test passed\n");
+    return 0;
+}
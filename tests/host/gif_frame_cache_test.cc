@@ -0,0 +1,219 @@
+// GIF frame cache: decoded clips replay like gifdec, over-budget clips are decoded once
+#include "gif_frame_cache.h"
+#include "gifdec.h"
+#include "host_test.h"
+
+#include <cstring>
+#include <vector>
+
+// Budget set by CONFIG_EMOJI_GIF_FRAME_CACHE_SIZE_KB in CMakeLists.txt
+static const size_t kCapacity = 64 * 1024;
+
+struct Rect {
+    uint16_t x, y, w, h;
+};
+
+static void AppendU16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(value & 0xFF);
+    out.push_back(value >> 8);
+}
+
+// LZW stream of literal codes only, cleared before the code size would grow past 9 bits
+static void AppendImageData(std::vector<uint8_t>& out, const std::vector<uint8_t>& indices) {
+    std::vector<uint8_t> bytes;
+    uint32_t bits = 0;
+    int bit_count = 0;
+    auto emit = [&](uint32_t code) {
+        bits |= code << bit_count;
+        bit_count += 9;
+        while (bit_count >= 8) {
+            bytes.push_back(bits & 0xFF);
+            bits >>= 8;
+            bit_count -= 8;
+        }
+    };
+    emit(256);
+    int since_clear = 0;
+    for (uint8_t index : indices) {
+        if (since_clear == 250) {
+            emit(256);
+            since_clear = 0;
+        }
+        emit(index);
+        since_clear++;
+    }
+    emit(257);
+    if (bit_count > 0) {
+        bytes.push_back(bits & 0xFF);
+    }
+
+    out.push_back(8);
+    for (size_t i = 0; i < bytes.size(); i += 255) {
+        size_t n = std::min<size_t>(255, bytes.size() - i);
+        out.push_back(static_cast<uint8_t>(n));
+        out.insert(out.end(), bytes.begin() + i, bytes.begin() + i + n);
+    }
+    out.push_back(0);
+}
+
+// A looping GIF whose first frame covers the image and later frames patch `patches`
+static std::vector<uint8_t> MakeGif(uint16_t width, uint16_t height, const std::vector<Rect>& patches) {
+    std::vector<uint8_t> gif = { 'G', 'I', 'F', '8', '9', 'a' };
+    AppendU16(gif, width);
+    AppendU16(gif, height);
+    gif.insert(gif.end(), { 0xF7, 0, 0 });
+    for (int i = 0; i < 256; i++) {
+        gif.insert(gif.end(), { uint8_t(i * 7), uint8_t(i * 13), uint8_t(255 - i) });
+    }
+    const uint8_t netscape[] = { 0x21, 0xFF, 0x0B, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 0x03, 0x01 };
+    gif.insert(gif.end(), netscape, netscape + sizeof(netscape));
+    AppendU16(gif, 0);
+    gif.push_back(0);
+
+    std::vector<Rect> frames = { { 0, 0, width, height } };
+    frames.insert(frames.end(), patches.begin(), patches.end());
+    for (size_t f = 0; f < frames.size(); f++) {
+        const Rect& rect = frames[f];
+        // Graphic control: keep the previous frame, 50 ms
+        gif.insert(gif.end(), { 0x21, 0xF9, 0x04, 1 << 2 });
+        AppendU16(gif, 5);
+        gif.insert(gif.end(), { 0, 0 });
+
+        gif.push_back(0x2C);
+        AppendU16(gif, rect.x);
+        AppendU16(gif, rect.y);
+        AppendU16(gif, rect.w);
+        AppendU16(gif, rect.h);
+        gif.push_back(0);
+
+        std::vector<uint8_t> indices(static_cast<size_t>(rect.w) * rect.h);
+        for (size_t i = 0; i < indices.size(); i++) {
+            indices[i] = static_cast<uint8_t>((i / 3 + f * 40) & 0xFF);
+        }
+        AppendImageData(gif, indices);
+    }
+    gif.push_back(0x3B);
+    return gif;
+}
+
+static lv_img_dsc_t MakeDescriptor(const std::vector<uint8_t>& gif) {
+    lv_img_dsc_t dsc = {};
+    dsc.data = gif.data();
+    dsc.data_size = static_cast<uint32_t>(gif.size());
+    return dsc;
+}
+
+// Every frame replayed from the clip must match gifdec's own rendering in RGB565
+static void TestReplayMatchesGifdec() {
+    auto gif = MakeGif(40, 30, { { 5, 4, 10, 8 }, { 20, 10, 20, 20 }, { 0, 29, 40, 1 } });
+    auto dsc = MakeDescriptor(gif);
+    auto& cache = GifFrameCache::GetInstance();
+    cache.Clear();
+
+    auto clip = cache.Acquire("replay", &dsc);
+    CHECK(clip != nullptr);
+    CHECK(clip->frames().size() == 4);
+    CHECK(!clip->has_alpha());
+    CHECK(clip->loop_count() == 0);
+
+    gd_GIF* reference = gd_open_gif_data(gif.data());
+    CHECK(reference != nullptr);
+    std::vector<uint8_t> canvas(clip->canvas_size());
+    for (size_t i = 0; i < clip->frames().size(); i++) {
+        CHECK(gd_get_frame(reference) == 1);
+        gd_render_frame(reference, reference->canvas);
+        clip->ApplyFrame(i, canvas.data());
+        CHECK(clip->frames()[i].delay_ms == 50);
+        for (size_t p = 0; p < 40 * 30; p++) {
+            const uint8_t* bgra = &reference->canvas[p * 4];
+            uint16_t expected = ((bgra[2] & 0xF8) << 8) | ((bgra[1] & 0xFC) << 3) | (bgra[0] >> 3);
+            uint16_t actual;
+            memcpy(&actual, &canvas[p * 2], sizeof(actual));
+            CHECK(actual == expected);
+        }
+    }
+    gd_close_gif(reference);
+
+    // Patches are stored instead of full frames
+    CHECK(clip->memory_size() < 40 * 30 * 2 * 2);
+    CHECK(cache.Acquire("replay", &dsc) == clip);
+    CHECK(cache.hits() == 1);
+    CHECK(cache.misses() == 1);
+    CHECK(cache.used() == clip->memory_size());
+}
+
+// Clips that cannot fit return nullptr and are not decoded again on the next request
+static void TestOverBudgetIsRemembered() {
+    auto& cache = GifFrameCache::GetInstance();
+    cache.Clear();
+    uint32_t misses = cache.misses();
+
+    // Rejected from the header alone: one RGB565 frame is already over the budget
+    auto huge = MakeGif(200, 200, {});
+    auto huge_dsc = MakeDescriptor(huge);
+    CHECK(cache.Acquire("huge", &huge_dsc) == nullptr);
+    CHECK(cache.misses() == misses + 1);
+    CHECK(cache.Acquire("huge", &huge_dsc) == nullptr);
+    CHECK(cache.misses() == misses + 1);
+
+    // The first frame fits, the full-frame patches that follow do not
+    std::vector<Rect> patches(4, Rect{ 0, 0, 150, 150 });
+    auto long_clip = MakeGif(150, 150, patches);
+    CHECK(150 * 150 * 2 <= kCapacity);
+    auto long_dsc = MakeDescriptor(long_clip);
+    CHECK(cache.Acquire("long", &long_dsc) == nullptr);
+    CHECK(cache.misses() == misses + 2);
+    CHECK(cache.Acquire("long", &long_dsc) == nullptr);
+    CHECK(cache.misses() == misses + 2);
+    CHECK(cache.used() == 0);
+
+    // The same emotion from another collection is a different clip and is tried again
+    auto small = MakeGif(16, 16, {});
+    auto small_dsc = MakeDescriptor(small);
+    CHECK(cache.Acquire("long", &small_dsc) != nullptr);
+    CHECK(cache.misses() == misses + 3);
+
+    // Clear() forgets rejections too
+    cache.Clear();
+    CHECK(cache.Acquire("huge", &huge_dsc) == nullptr);
+    CHECK(cache.misses() == misses + 4);
+
+    const uint8_t garbage[16] = { 'n', 'o', 't', ' ', 'a', ' ', 'g', 'i', 'f' };
+    lv_img_dsc_t garbage_dsc = {};
+    garbage_dsc.data = garbage;
+    garbage_dsc.data_size = sizeof(garbage);
+    CHECK(cache.Acquire("garbage", &garbage_dsc) == nullptr);
+    CHECK(cache.Acquire("garbage", &garbage_dsc) == nullptr);
+    CHECK(cache.misses() == misses + 5);
+}
+
+// Inserting past the budget evicts the least recently used clip
+static void TestEviction() {
+    auto& cache = GifFrameCache::GetInstance();
+    cache.Clear();
+    auto first = MakeGif(150, 130, {});
+    auto second = MakeGif(150, 130, {});
+    auto first_dsc = MakeDescriptor(first);
+    auto second_dsc = MakeDescriptor(second);
+
+    auto first_clip = cache.Acquire("first", &first_dsc);
+    CHECK(first_clip != nullptr);
+    auto second_clip = cache.Acquire("second", &second_dsc);
+    CHECK(second_clip != nullptr);
+    CHECK(first_clip->memory_size() + second_clip->memory_size() > kCapacity);
+    CHECK(cache.used() == second_clip->memory_size());
+
+    // The evicted clip stays valid for whoever still holds it
+    CHECK(first_clip->frames().size() == 1);
+    uint32_t misses = cache.misses();
+    CHECK(cache.Acquire("first", &first_dsc) != first_clip);
+    CHECK(cache.misses() == misses + 1);
+}
+
+int main() {
+    TestReplayMatchesGifdec();
+    TestOverBudgetIsRemembered();
+    TestEviction();
+    printf("gif_frame_cache_test passed\n");
+    return 0;
+}
@@ -0,0 +1,277 @@
+// gifdec LZW decoder: KwKwK codes, code size growth to 12 bits, clear codes mid-stream, interlacing, strings wrapping rows
+#include "gifdec.h"
+#include "host_test.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <vector>
+
+// What the encoded stream exercises, so every test can check it covers its case
+struct LzwStats {
+    int max_code_size = 0;
+    int clears = 0;
+    int kwkwk = 0;
+    int longest = 0;
+};
+
+static void AppendU16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(value & 0xFF);
+    out.push_back(value >> 8);
+}
+
+// Plain GIF LZW encoder, clears the table when it is full like giflib
+static std::vector<uint8_t> LzwEncode(const std::vector<uint8_t>& pixels, int min_code_size, LzwStats* stats) {
+    const int clear_code = 1 << min_code_size;
+    std::vector<uint8_t> bytes;
+    uint32_t bits = 0;
+    int bit_count = 0;
+    int code_size = min_code_size + 1;
+    auto emit = [&](int code) {
+        bits |= (uint32_t)code << bit_count;
+        bit_count += code_size;
+        while (bit_count >= 8) {
+            bytes.push_back(bits & 0xFF);
+            bits >>= 8;
+            bit_count -= 8;
+        }
+        stats->max_code_size = std::max(stats->max_code_size, code_size);
+    };
+
+    std::map<uint32_t, int> table;
+    std::vector<int> length(4096, 1);
+    int next_code = clear_code + 2;
+    int last_added = -1;
+    emit(clear_code);
+    stats->clears++;
+
+    int current = pixels[0];
+    for (size_t i = 1; i <= pixels.size(); i++) {
+        if (i < pixels.size()) {
+            auto found = table.find((uint32_t)current << 8 | pixels[i]);
+            if (found != table.end()) {
+                current = found->second;
+                continue;
+            }
+        }
+        emit(current);
+        // The decoder has not defined the code added right after the previous one yet
+        if (current == last_added) {
+            stats->kwkwk++;
+        }
+        stats->longest = std::max(stats->longest, length[current]);
+        if (i == pixels.size()) {
+            break;
+        }
+        length[next_code] = length[current] + 1;
+        table[(uint32_t)current << 8 | pixels[i]] = next_code;
+        last_added = next_code++;
+        if (next_code > (1 << code_size) && code_size < 12) {
+            code_size++;
+        }
+        if (next_code == 4096) {
+            emit(clear_code);
+            stats->clears++;
+            table.clear();
+            code_size = min_code_size + 1;
+            next_code = clear_code + 2;
+            last_added = -1;
+        }
+        current = pixels[i];
+    }
+    emit(clear_code + 1);
+    if (bit_count > 0) {
+        bytes.push_back(bits & 0xFF);
+    }
+
+    std::vector<uint8_t> out = { (uint8_t)min_code_size };
+    for (size_t i = 0; i < bytes.size(); i += 255) {
+        size_t n = std::min<size_t>(255, bytes.size() - i);
+        out.push_back((uint8_t)n);
+        out.insert(out.end(), bytes.begin() + i, bytes.begin() + i + n);
+    }
+    out.push_back(0);
+    return out;
+}
+
+// Rows in the order an interlaced image sends them
+static std::vector<int> InterlacedRows(int height) {
+    std::vector<int> rows;
+    const int start[4] = { 0, 4, 2, 1 };
+    const int step[4] = { 8, 8, 4, 2 };
+    for (int pass = 0; pass < 4; pass++) {
+        for (int y = start[pass]; y < height; y += step[pass]) {
+            rows.push_back(y);
+        }
+    }
+    return rows;
+}
+
+struct Frame {
+    uint16_t x, y, w, h;
+    bool interlaced;
+    std::vector<uint8_t> indices;     // Row by row in display order
+};
+
+// GIF with a 256 color table and the given frames, each kept under the next one
+static std::vector<uint8_t> MakeGif(uint16_t width, uint16_t height, const std::vector<Frame>& frames,
+                                    int min_code_size, LzwStats* stats) {
+    std::vector<uint8_t> gif = { 'G', 'I', 'F', '8', '9', 'a' };
+    AppendU16(gif, width);
+    AppendU16(gif, height);
+    gif.insert(gif.end(), { 0xF7, 0, 0 });
+    for (int i = 0; i < 256; i++) {
+        gif.insert(gif.end(), { uint8_t(i), uint8_t(i * 3), uint8_t(255 - i) });
+    }
+    for (auto& frame : frames) {
+        gif.insert(gif.end(), { 0x21, 0xF9, 0x04, 1 << 2 });
+        AppendU16(gif, 10);
+        gif.insert(gif.end(), { 0, 0 });
+
+        gif.push_back(0x2C);
+        AppendU16(gif, frame.x);
+        AppendU16(gif, frame.y);
+        AppendU16(gif, frame.w);
+        AppendU16(gif, frame.h);
+        gif.push_back(frame.interlaced ? 0x40 : 0);
+
+        std::vector<uint8_t> sent;
+        std::vector<int> rows;
+        for (int y = 0; y < frame.h; y++) {
+            rows.push_back(y);
+        }
+        if (frame.interlaced) {
+            rows = InterlacedRows(frame.h);
+        }
+        for (int y : rows) {
+            sent.insert(sent.end(), frame.indices.begin() + y * frame.w, frame.indices.begin() + (y + 1) * frame.w);
+        }
+        auto data = LzwEncode(sent, min_code_size, stats);
+        gif.insert(gif.end(), data.begin(), data.end());
+    }
+    gif.push_back(0x3B);
+    return gif;
+}
+
+static std::vector<uint8_t> Random(size_t size, int colors, uint32_t seed) {
+    std::vector<uint8_t> data(size);
+    for (auto& value : data) {
+        seed = seed * 1664525u + 1013904223u;
+        value = (uint8_t)((seed >> 16) % colors);
+    }
+    return data;
+}
+
+// Decodes the first frame and compares the index buffer with the frame that was encoded
+static void ExpectDecoded(const Frame& frame, int min_code_size, LzwStats* stats) {
+    auto gif = MakeGif(frame.w, frame.h, { frame }, min_code_size, stats);
+    gd_GIF* decoder = gd_open_gif_data(gif.data());
+    CHECK(decoder != nullptr);
+    CHECK(gd_get_frame(decoder) == 1);
+    if (memcmp(decoder->frame, frame.indices.data(), frame.indices.size()) != 0) {
+        fprintf(stderr, "%ux%u frame (interlaced %d, min code size %d) decoded wrong\n",
+                frame.w, frame.h, frame.interlaced, min_code_size);
+        exit(1);
+    }
+    CHECK(gd_get_frame(decoder) == 0);
+    gd_close_gif(decoder);
+}
+
+// Runs of one color make the encoder send the code it has just added
+static void TestKwKwK() {
+    Frame frame = { 0, 0, 48, 20, false, std::vector<uint8_t>(48 * 20, 3) };
+    for (size_t i = 500; i < 700; i++) {
+        frame.indices[i] = (i / 50) % 4;
+    }
+    LzwStats stats;
+    ExpectDecoded(frame, 2, &stats);
+    CHECK(stats.kwkwk > 10);
+    CHECK(stats.clears == 1);
+}
+
+// Enough distinct strings to reach 12-bit codes without filling the table
+static void TestCodeSizeGrowth() {
+    Frame frame = { 0, 0, 64, 48, false, Random(64 * 48, 256, 1) };
+    LzwStats stats;
+    ExpectDecoded(frame, 8, &stats);
+    CHECK(stats.max_code_size == 12);
+    CHECK(stats.clears == 1);
+}
+
+// The table fills up several times, after each clear code the code size starts over
+static void TestClearMidStream() {
+    Frame frame = { 0, 0, 120, 100, false, Random(120 * 100, 256, 2) };
+    LzwStats stats;
+    ExpectDecoded(frame, 8, &stats);
+    CHECK(stats.clears >= 3);
+
+    // With few colors the strings get long before the table is full
+    frame = { 0, 0, 300, 200, false, Random(300 * 200, 4, 3) };
+    stats = LzwStats();
+    ExpectDecoded(frame, 2, &stats);
+    CHECK(stats.clears >= 2);
+    CHECK(stats.kwkwk > 0);
+}
+
+// Every height, including the ones with empty passes, and strings crossing from one pass to the next
+static void TestInterlaced() {
+    for (uint16_t height = 1; height <= 20; height++) {
+        Frame frame = { 0, 0, 7, height, true, std::vector<uint8_t>(7 * height) };
+        for (size_t i = 0; i < frame.indices.size(); i++) {
+            frame.indices[i] = (i / 7) % 5;
+        }
+        LzwStats stats;
+        ExpectDecoded(frame, 3, &stats);
+    }
+    // Rows of one pass share a color, so long strings run over rows that are far apart on screen
+    Frame frame = { 0, 0, 33, 61, true, Random(33 * 61, 4, 4) };
+    for (int y = 0; y < 61; y++) {
+        if (y % 5 != 0) {
+            uint8_t pass = y % 8 == 0 ? 0 : y % 8 == 4 ? 1 : y % 2 == 0 ? 2 : 3;
+            std::fill(frame.indices.begin() + y * 33, frame.indices.begin() + (y + 1) * 33, pass);
+        }
+    }
+    LzwStats stats;
+    ExpectDecoded(frame, 2, &stats);
+    CHECK(stats.longest > 33);
+}
+
+// Strings longer than several rows of a narrow frame, also inside a rectangle of a wider image
+static void TestRowWrap() {
+    Frame frame = { 0, 0, 3, 200, false, std::vector<uint8_t>(3 * 200) };
+    for (size_t i = 0; i < frame.indices.size(); i++) {
+        frame.indices[i] = (i / 97) % 2;
+    }
+    LzwStats stats;
+    ExpectDecoded(frame, 2, &stats);
+    CHECK(stats.longest > 3 * 4);
+
+    // The patch must stay inside its rectangle and keep the image stride
+    Frame background = { 0, 0, 20, 12, false, Random(20 * 12, 256, 5) };
+    Frame patch = { 5, 3, 3, 8, false, std::vector<uint8_t>(3 * 8, 9) };
+    stats = LzwStats();
+    auto gif = MakeGif(20, 12, { background, patch }, 8, &stats);
+    CHECK(stats.longest > 3);
+    gd_GIF* decoder = gd_open_gif_data(gif.data());
+    CHECK(decoder != nullptr);
+    CHECK(gd_get_frame(decoder) == 1);
+    CHECK(gd_get_frame(decoder) == 1);
+    for (int y = 0; y < 12; y++) {
+        for (int x = 0; x < 20; x++) {
+            bool inside = x >= 5 && x < 8 && y >= 3 && y < 11;
+            uint8_t expected = inside ? 9 : background.indices[y * 20 + x];
+            CHECK(decoder->frame[y * 20 + x] == expected);
+        }
+    }
+    gd_close_gif(decoder);
+}
+
+int main() {
+    TestKwKwK();
+    TestCodeSizeGrowth();
+    TestClearMidStream();
+    TestInterlaced();
+    TestRowWrap();
+    printf("gifdec_test passed\n");
+    return 0;
+}
@@ -0,0 +1,310 @@
+// JPEG encoding: the row callback path produces the same file as the in-memory path, RGB565X is read in its own
+// byte order, failures on either side stop the encoder. Prints peak heap and time of a screen snapshot taken as a
+// full frame and band by band, and of encoding camera frames in every input format.
+#include "image_to_jpeg.h"
+#include "host_test.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__SANITIZE_ADDRESS__)
+extern "C" size_t __sanitizer_get_current_allocated_bytes(void);
+extern "C" int __sanitizer_install_malloc_and_free_hooks(void (*malloc_hook)(const volatile void*, size_t),
+                                                         void (*free_hook)(const volatile void*));
+static size_t HeapInUse() { return __sanitizer_get_current_allocated_bytes(); }
+#else
+#include <malloc.h>
+// Large blocks are mapped separately and only show up in hblkhd
+static size_t HeapInUse() {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+#endif
+
+// Highest heap use above the level at Start(). Under ASan every allocation is seen, otherwise the heap is
+// sampled whenever the encoder calls back, which misses buffers freed before the first callback.
+struct PeakHeap {
+    size_t base = 0;
+    size_t peak = 0;
+    void Start();
+    void Stop();
+    void Sample() {
+        size_t used = HeapInUse();
+        if (used > base && used - base > peak) {
+            peak = used - base;
+        }
+    }
+};
+
+static PeakHeap* active_heap = nullptr;
+
+void PeakHeap::Start() {
+#if defined(__SANITIZE_ADDRESS__)
+    static bool hooked = __sanitizer_install_malloc_and_free_hooks(
+        [](const volatile void*, size_t) {
+            if (active_heap != nullptr) {
+                active_heap->Sample();
+            }
+        }, nullptr);
+    (void)hooked;
+#endif
+    base = HeapInUse();
+    peak = 0;
+    active_heap = this;
+}
+
+void PeakHeap::Stop() {
+    Sample();
+    active_heap = nullptr;
+}
+
+struct Output {
+    std::string jpeg;
+    bool ended = false;
+    size_t accept = SIZE_MAX;   // Bytes the callback takes before it refuses
+    PeakHeap* heap = nullptr;
+};
+
+static size_t CollectJpeg(void* arg, size_t index, const void* data, size_t len) {
+    auto output = static_cast<Output*>(arg);
+    if (output->heap != nullptr) {
+        output->heap->Sample();
+    }
+    if (index == 1) {
+        output->ended = true;
+        return 0;
+    }
+    size_t taken = std::min(len, output->accept - std::min(output->accept, output->jpeg.size()));
+    output->jpeg.append(static_cast<const char*>(data), taken);
+    return taken;
+}
+
+// Something like a UI: gradients, flat panels and sharp text-like edges. RGB565 in big endian order (RGB565X).
+static void RenderRows(uint8_t* dst, uint16_t width, uint16_t y, uint16_t rows, size_t stride) {
+    for (int r = 0; r < rows; r++) {
+        uint8_t* p = dst + r * stride;
+        int sy = y + r;
+        for (int x = 0; x < width; x++) {
+            uint16_t c;
+            if (sy % 40 < 24 && x % 9 < 5 && (x / 9 + sy / 40) % 3 != 0) {
+                c = 0xFFFF;
+            } else if (sy < 30) {
+                c = 0x18E3;
+            } else {
+                c = (uint16_t)(((x * 31 / width) << 11) | ((sy * 63 / 480 % 64) << 5) | 12);
+            }
+            p[x * 2] = c >> 8;
+            p[x * 2 + 1] = c & 0xFF;
+        }
+    }
+}
+
+static std::vector<uint8_t> Frame(uint16_t width, uint16_t height) {
+    std::vector<uint8_t> frame((size_t)width * height * 2);
+    RenderRows(frame.data(), width, 0, height, (size_t)width * 2);
+    return frame;
+}
+
+struct RowsSource {
+    const uint8_t* frame;
+    uint16_t width;
+    int fail_at = -1;
+    PeakHeap* heap = nullptr;
+};
+
+static bool CopyRows(void* arg, uint16_t y, uint16_t rows, uint8_t* dst, size_t stride) {
+    auto source = static_cast<RowsSource*>(arg);
+    if (source->heap != nullptr) {
+        source->heap->Sample();
+    }
+    if (y == source->fail_at) {
+        return false;
+    }
+    for (int r = 0; r < rows; r++) {
+        memcpy(dst + r * stride, source->frame + (size_t)(y + r) * source->width * 2, (size_t)source->width * 2);
+    }
+    return true;
+}
+
+static bool IsJpeg(const std::string& jpeg) {
+    return jpeg.size() > 4 && (uint8_t)jpeg[0] == 0xFF && (uint8_t)jpeg[1] == 0xD8 &&
+           (uint8_t)jpeg[jpeg.size() - 2] == 0xFF && (uint8_t)jpeg[jpeg.size() - 1] == 0xD9;
+}
+
+// Including heights that end in a partial MCU row, which both paths pad by repeating the last row
+static void TestRowsMatchMemory() {
+    const uint16_t sizes[][2] = { { 320, 240 }, { 100, 70 }, { 64, 8 }, { 2, 1 } };
+    for (auto& size : sizes) {
+        auto frame = Frame(size[0], size[1]);
+        Output memory;
+        CHECK(image_to_jpeg_cb(frame.data(), frame.size(), size[0], size[1], V4L2_PIX_FMT_RGB565X, 80,
+                               CollectJpeg, &memory));
+        CHECK(memory.ended);
+        CHECK(IsJpeg(memory.jpeg));
+
+        RowsSource source = { frame.data(), size[0] };
+        Output rows;
+        CHECK(image_to_jpeg_rows_cb(size[0], size[1], V4L2_PIX_FMT_RGB565X, 80, CopyRows, &source,
+                                    CollectJpeg, &rows));
+        CHECK(rows.ended);
+        CHECK(rows.jpeg == memory.jpeg);
+
+        uint8_t* out = nullptr;
+        size_t out_len = 0;
+        CHECK(image_to_jpeg(frame.data(), frame.size(), size[0], size[1], V4L2_PIX_FMT_RGB565X, 80, &out, &out_len));
+        CHECK(std::string((const char*)out, out_len) == memory.jpeg);
+        free(out);
+    }
+}
+
+// The same picture in either RGB565 byte order gives the same file
+static void TestByteOrder() {
+    auto big_endian = Frame(160, 96);
+    auto little_endian = big_endian;
+    for (size_t i = 0; i < little_endian.size(); i += 2) {
+        std::swap(little_endian[i], little_endian[i + 1]);
+    }
+    Output be, le;
+    CHECK(image_to_jpeg_cb(big_endian.data(), big_endian.size(), 160, 96, V4L2_PIX_FMT_RGB565X, 80, CollectJpeg, &be));
+    CHECK(image_to_jpeg_cb(little_endian.data(), little_endian.size(), 160, 96, V4L2_PIX_FMT_RGB565, 80,
+                           CollectJpeg, &le));
+    CHECK(be.jpeg == le.jpeg);
+
+    Output wrong;
+    CHECK(image_to_jpeg_cb(big_endian.data(), big_endian.size(), 160, 96, V4L2_PIX_FMT_RGB565, 80,
+                           CollectJpeg, &wrong));
+    CHECK(wrong.jpeg != be.jpeg);
+}
+
+static void TestFailures() {
+    auto frame = Frame(320, 240);
+
+    // The source gives up in the middle
+    RowsSource source = { frame.data(), 320 };
+    source.fail_at = 64;
+    Output output;
+    CHECK(!image_to_jpeg_rows_cb(320, 240, V4L2_PIX_FMT_RGB565X, 80, CopyRows, &source, CollectJpeg, &output));
+    CHECK(!output.ended);
+
+    // The output refuses data: encoding stops without the end signal
+    source.fail_at = -1;
+    output = Output();
+    output.accept = 1000;
+    CHECK(!image_to_jpeg_rows_cb(320, 240, V4L2_PIX_FMT_RGB565X, 80, CopyRows, &source, CollectJpeg, &output));
+    CHECK(!output.ended);
+    CHECK(output.jpeg.size() == 1000);
+
+    output = Output();
+    output.accept = 1000;
+    CHECK(!image_to_jpeg_cb(frame.data(), frame.size(), 320, 240, V4L2_PIX_FMT_RGB565X, 80, CollectJpeg, &output));
+    CHECK(!output.ended);
+
+    CHECK(!image_to_jpeg_rows_cb(320, 240, V4L2_PIX_FMT_RGB565X, 80, nullptr, &source, CollectJpeg, &output));
+}
+
+static long long Microseconds(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+// Screen snapshot as LvglDisplay takes it: rendering the full frame first (lv_snapshot_take) and then encoding it,
+// or rendering each MCU row into the encoder's input buffer. The JPEG is kept until it is uploaded in both cases.
+static void BenchmarkSnapshot(uint16_t width, uint16_t height) {
+    PeakHeap heap;
+    Output full;
+    full.heap = &heap;
+    heap.Start();
+    auto start = std::chrono::steady_clock::now();
+    {
+        std::vector<uint8_t> frame((size_t)width * height * 2);
+        RenderRows(frame.data(), width, 0, height, (size_t)width * 2);
+        CHECK(image_to_jpeg_cb(frame.data(), frame.size(), width, height, V4L2_PIX_FMT_RGB565X, 80,
+                               CollectJpeg, &full));
+    }
+    long long full_us = Microseconds(start);
+    heap.Stop();
+    size_t full_peak = heap.peak;
+
+    struct Renderer {
+        uint16_t width;
+        PeakHeap* heap;
+    } renderer = { width, &heap };
+    Output banded;
+    banded.heap = &heap;
+    heap.Start();
+    start = std::chrono::steady_clock::now();
+    CHECK(image_to_jpeg_rows_cb(width, height, V4L2_PIX_FMT_RGB565X, 80,
+        [](void* arg, uint16_t y, uint16_t rows, uint8_t* dst, size_t stride) -> bool {
+            auto renderer = static_cast<Renderer*>(arg);
+            renderer->heap->Sample();
+            RenderRows(dst, renderer->width, y, rows, stride);
+            return true;
+        }, &renderer, CollectJpeg, &banded));
+    long long banded_us = Microseconds(start);
+    heap.Stop();
+
+    CHECK(banded.jpeg == full.jpeg);
+    printf("snapshot %4ux%-4u JPEG %6zu bytes: full frame peak %8zu bytes %7lld us, "
+           "banded peak %7zu bytes %7lld us\n",
+           width, height, full.jpeg.size(), full_peak, full_us, heap.peak, banded_us);
+    CHECK(heap.peak < full_peak);
+}
+
+// A camera frame in each input format image_to_jpeg_cb takes. Peak heap counts what the encoder allocates on top of
+// the source frame and the collected output, time is the best of three runs.
+static void BenchmarkEncode(uint16_t width, uint16_t height) {
+    const struct {
+        const char* name;
+        v4l2_pix_fmt_t format;
+        int bytes_per_pixel;
+    } formats[] = {
+        { "RGB565", V4L2_PIX_FMT_RGB565, 2 }, { "RGB565X", V4L2_PIX_FMT_RGB565X, 2 },
+        { "RGB24", V4L2_PIX_FMT_RGB24, 3 },   { "YUYV", V4L2_PIX_FMT_YUYV, 2 },
+        { "UYVY", V4L2_PIX_FMT_UYVY, 2 },     { "YUV422P", V4L2_PIX_FMT_YUV422P, 2 },
+        { "GREY", V4L2_PIX_FMT_GREY, 1 },
+    };
+    for (auto& format : formats) {
+        // Smooth content with edges, the same bytes whatever the format means by them
+        std::vector<uint8_t> frame((size_t)width * height * format.bytes_per_pixel);
+        for (size_t i = 0; i < frame.size(); i++) {
+            size_t x = i % ((size_t)width * format.bytes_per_pixel), y = i / ((size_t)width * format.bytes_per_pixel);
+            frame[i] = (uint8_t)((x * 255 / width / format.bytes_per_pixel + y / 4) ^ ((y / 32 + x / 48) % 2 ? 0x40 : 0));
+        }
+
+        PeakHeap heap;
+        long long best_us = 0;
+        size_t jpeg_size = 0;
+        for (int run = 0; run < 3; run++) {
+            Output output;
+            output.heap = &heap;
+            output.jpeg.reserve(frame.size() * 2);
+            heap.Start();
+            auto start = std::chrono::steady_clock::now();
+            CHECK(image_to_jpeg_cb(frame.data(), frame.size(), width, height, format.format, 80, CollectJpeg,
+                                   &output));
+            long long us = Microseconds(start);
+            heap.Stop();
+            CHECK(output.ended && IsJpeg(output.jpeg));
+            best_us = run == 0 ? us : std::min(best_us, us);
+            jpeg_size = output.jpeg.size();
+        }
+        printf("encode %4ux%-4u %-7s JPEG %7zu bytes: peak %8zu bytes %7lld us\n", width, height, format.name,
+               jpeg_size, heap.peak, best_us);
+    }
+}
+
+int main() {
+    TestRowsMatchMemory();
+    TestByteOrder();
+    TestFailures();
+    BenchmarkSnapshot(320, 240);
+    BenchmarkSnapshot(480, 480);
+    BenchmarkSnapshot(800, 480);
+    BenchmarkEncode(320, 240);
+    BenchmarkEncode(640, 480);
+    BenchmarkEncode(1280, 720);
+    printf("image_to_jpeg_test passed\n");
+    return 0;
+}
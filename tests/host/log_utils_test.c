@@ -0,0 +1,146 @@
+// 日志工具：延迟模式的输出必须与立即格式化的结果一致
+#include "log_utils.h"
+#include "host_test.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+
+static char s_last[512];
+static atomic_uint s_emitted;
+
+static void capture_output(log_level_t level, const char* tag, const char* msg) {
+    snprintf(s_last, sizeof(s_last), "%s", msg);
+    atomic_fetch_add(&s_emitted, 1);
+}
+
+static void set_mode(bool deferred) {
+    log_config_t config = {
+        .level = LOG_LEVEL_VERBOSE,
+        .output_fn = capture_output,
+        .use_colors = false,
+        .print_timestamp = false,
+        .deferred = deferred
+    };
+    log_init(&config);
+}
+
+// 同一条日志分别立即输出和延迟输出，比较结果
+#define EXPECT_SAME_OUTPUT(...) do { \
+    char immediate[sizeof(s_last)]; \
+    set_mode(false); \
+    log_info("test", __VA_ARGS__); \
+    snprintf(immediate, sizeof(immediate), "%s", s_last); \
+    set_mode(true); \
+    s_last[0] = '\0'; \
+    log_info("test", __VA_ARGS__); \
+    CHECK(log_flush(1) == 1); \
+    if (strcmp(immediate, s_last) != 0) { \
+        fprintf(stderr, "%s:%d: deferred \"%s\" != immediate \"%s\"\n", \
+                __FILE__, __LINE__, s_last, immediate); \
+        exit(1); \
+    } \
+} while (0)
+
+static void test_formats(void) {
+    EXPECT_SAME_OUTPUT("plain text");
+    EXPECT_SAME_OUTPUT("int %d uint %u hex %x HEX %X oct %o", -5, 3000000000u, -1, 48879, 8);
+    EXPECT_SAME_OUTPUT("hh %hhx %hhd h %hd l %ld ll %lld z %zu", 300, 200, 70000, -7L, -9000000000LL, (size_t)77);
+    EXPECT_SAME_OUTPUT("str '%s' %-5s| %5s|%.*s|", "hello", "ab", "xy", 3, "abcdef");
+    EXPECT_SAME_OUTPUT("float %5.2f %e %g %.0f", 3.14159, 1e10, 0.0001, 2.5);
+    EXPECT_SAME_OUTPUT("char %c ptr %p pct %% star %*d|%-*d|", 'Z', (void*)0x1234, 6, 42, 4, 7);
+    EXPECT_SAME_OUTPUT("flags %+d % d %#x %05d", 3, 4, 255, -42);
+}
+
+static void test_deferred_copies_strings(void) {
+    set_mode(true);
+    char name[16] = "before";
+    log_info("test", "name=%s", name);
+    strcpy(name, "after");
+    CHECK(log_flush(8) == 1);
+    CHECK(strcmp(s_last, "name=before") == 0);
+
+    log_warn("test", "null %s", (const char*)NULL);
+    CHECK(log_flush(8) == 1);
+    CHECK(strstr(s_last, "null") == s_last);
+}
+
+static void test_deferred_truncation(void) {
+    set_mode(true);
+    log_stats_t before;
+    log_get_stats(&before);
+
+    log_debug("test", "many %d %d %d %d %d %d %d %d %d %d", 1, 2, 3, 4, 5, 6, 7, 8, 9, 10);
+    char long_string[LOG_DEFERRED_STRING_SIZE * 2];
+    memset(long_string, 'x', sizeof(long_string) - 1);
+    long_string[sizeof(long_string) - 1] = '\0';
+    log_debug("test", "long %s", long_string);
+    CHECK(log_flush(8) == 2);
+
+    log_stats_t after;
+    log_get_stats(&after);
+    CHECK(after.deferred_truncated - before.deferred_truncated == 2);
+    CHECK(strlen(s_last) < sizeof(long_string));
+}
+
+static void test_level_filter(void) {
+    set_mode(false);
+    log_set_level(LOG_LEVEL_WARN);
+    unsigned emitted = atomic_load(&s_emitted);
+    log_info("test", "filtered");
+    log_debug("test", "filtered");
+    CHECK(atomic_load(&s_emitted) == emitted);
+    log_error("test", "kept");
+    CHECK(atomic_load(&s_emitted) == emitted + 1);
+    CHECK(log_get_level() == LOG_LEVEL_WARN);
+}
+
+#define WRITER_COUNT 4
+#define RECORDS_PER_WRITER 2000
+
+static void* writer_thread(void* arg) {
+    for (int i = 0; i < RECORDS_PER_WRITER; i++) {
+        log_info("writer", "thread %d record %d", (int)(intptr_t)arg, i);
+    }
+    return NULL;
+}
+
+// 多个写者并发写入，队列满时丢弃；写入数 = 输出数
+static void test_concurrent_writers(void) {
+    set_mode(true);
+    while (log_flush(LOG_DEFERRED_QUEUE_SIZE) > 0) {
+    }
+    log_stats_t before;
+    log_get_stats(&before);
+
+    pthread_t writers[WRITER_COUNT];
+    for (intptr_t i = 0; i < WRITER_COUNT; i++) {
+        CHECK(pthread_create(&writers[i], NULL, writer_thread, (void*)i) == 0);
+    }
+    size_t flushed = 0;
+    for (int i = 0; i < 1000; i++) {
+        flushed += log_flush(LOG_DEFERRED_QUEUE_SIZE);
+    }
+    for (int i = 0; i < WRITER_COUNT; i++) {
+        pthread_join(writers[i], NULL);
+    }
+    flushed += log_flush(WRITER_COUNT * RECORDS_PER_WRITER);
+
+    log_stats_t after;
+    log_get_stats(&after);
+    uint32_t written = after.deferred_written - before.deferred_written;
+    uint32_t dropped = after.deferred_dropped - before.deferred_dropped;
+    CHECK(written + dropped == WRITER_COUNT * RECORDS_PER_WRITER);
+    CHECK(flushed == written);
+    printf("concurrent writers: %u written, %u dropped\n", written, dropped);
+}
+
+int main(void) {
+    test_formats();
+    test_deferred_copies_strings();
+    test_deferred_truncation();
+    test_level_filter();
+    test_concurrent_writers();
+    printf("log_utils_test passed\n");
+    return 0;
+}
@@ -0,0 +1,215 @@
+// LvglGlyphAtlas: text drawn through the atlas is identical to the font's own glyphs, the atlas stays within
+// its capacity and forgets a font when it is detached. Prints the cost of chat transcripts made of the locale
+// strings in main/assets/locales, drawn as messages arrive and then scrolled back, with and without the atlas.
+#include "lvgl_font.h"
+#include "cbin_font.h"
+#include "host_test.h"
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+static const int kScreenWidth = 320;
+static const int kScreenHeight = 240;
+static const int kBubbleWidth = kScreenWidth * 70 / 100;
+
+// Values of the "strings" object, one per line in the locale files
+static std::vector<std::string> LoadStrings(const std::string& locale) {
+    std::ifstream file(std::string(LOCALES_DIR) + "/" + locale + "/language.json");
+    CHECK(file.good());
+    std::vector<std::string> strings;
+    std::string line;
+    bool in_strings = false;
+    while (std::getline(file, line)) {
+        if (line.find("\"strings\"") != std::string::npos) {
+            in_strings = true;
+            continue;
+        }
+        size_t colon = line.find("\": \"");
+        if (!in_strings || colon == std::string::npos) {
+            continue;
+        }
+        std::string value;
+        for (size_t i = colon + 4; i < line.size() && line[i] != '"'; i++) {
+            if (line[i] == '\\' && i + 1 < line.size()) {
+                i++;
+                value += line[i] == 'n' ? '\n' : line[i];
+            } else {
+                value += line[i];
+            }
+        }
+        strings.push_back(value);
+    }
+    CHECK(!strings.empty());
+    return strings;
+}
+
+struct Screen {
+    std::vector<uint16_t> pixels = std::vector<uint16_t>((size_t)kScreenWidth * kScreenHeight);
+    lv_draw_buf_t* glyph_buf = lv_draw_buf_create(64, 64, LV_COLOR_FORMAT_A8, LV_STRIDE_AUTO);
+    uint64_t checksum = 0;
+
+    ~Screen() { lv_draw_buf_destroy(glyph_buf); }
+
+    void Clear() { std::fill(pixels.begin(), pixels.end(), 0x18E3); }
+
+    // Blends white glyphs like the software label renderer, wrapping at the bubble width. Returns the height.
+    int DrawLabel(const lv_font_t* font, const std::string& text, int left, int top) {
+        int x = left, y = top;
+        uint32_t i = 0;
+        while (i < text.size()) {
+            uint32_t letter = lv_text_encoded_next(text.c_str(), &i);
+            if (letter == '\n') {
+                x = left;
+                y += font->line_height;
+                continue;
+            }
+            lv_font_glyph_dsc_t g_dsc;
+            if (!lv_font_get_glyph_dsc(font, &g_dsc, letter, 0)) {
+                continue;
+            }
+            if (x + g_dsc.adv_w > left + kBubbleWidth) {
+                x = left;
+                y += font->line_height;
+            }
+            if (g_dsc.box_w > 0 && y + g_dsc.box_h > 0 && y < kScreenHeight) {
+                auto bitmap = static_cast<const lv_draw_buf_t*>(lv_font_get_glyph_bitmap(&g_dsc, glyph_buf));
+                CHECK(bitmap == glyph_buf);
+                for (int gy = 0; gy < g_dsc.box_h; gy++) {
+                    int sy = y + gy;
+                    if (sy < 0 || sy >= kScreenHeight) {
+                        continue;
+                    }
+                    const uint8_t* row = bitmap->data + (size_t)gy * bitmap->header.stride;
+                    uint16_t* dst = pixels.data() + (size_t)sy * kScreenWidth + x;
+                    for (int gx = 0; gx < g_dsc.box_w; gx++) {
+                        uint32_t a = row[gx];
+                        uint32_t d = dst[gx];
+                        uint32_t r = ((d >> 11) * (255 - a) + 31 * a) / 255;
+                        uint32_t g = (((d >> 5) & 0x3F) * (255 - a) + 63 * a) / 255;
+                        uint32_t b = ((d & 0x1F) * (255 - a) + 31 * a) / 255;
+                        dst[gx] = (uint16_t)(r << 11 | g << 5 | b);
+                    }
+                }
+            }
+            x += g_dsc.adv_w;
+        }
+        return y + font->line_height - top;
+    }
+
+    // The messages from `first` on, from the top of the screen down, alternating sides like the chat view
+    void DrawChat(const lv_font_t* font, const std::vector<std::string>& messages, int first) {
+        Clear();
+        int y = 0;
+        for (int i = first; i < (int)messages.size() && y < kScreenHeight; i++) {
+            y += DrawLabel(font, messages[i], i % 2 ? kScreenWidth - kBubbleWidth - 4 : 4, y) + 8;
+        }
+        for (uint16_t pixel : pixels) {
+            checksum = checksum * 31 + pixel;
+        }
+    }
+};
+
+struct Run {
+    long long us;
+    uint32_t rasterized;
+    uint32_t hits;
+    uint32_t misses;
+    size_t used;
+    uint64_t checksum;
+};
+
+// Each message arrives (warming the atlas with its text when attached) and the chat is redrawn with it at the
+// top, then the chat is scrolled back through the whole history
+static Run DrawTranscript(const std::vector<std::string>& messages, bool atlas) {
+    auto& glyph_atlas = LvglGlyphAtlas::GetInstance();
+    cbin_host_font_spec_t spec = { 20 };
+    LvglCBinFont cbin_font(&spec);
+    auto font = const_cast<lv_font_t*>(cbin_font.font());
+    if (!atlas) {
+        glyph_atlas.Detach(font);
+    }
+    uint32_t hits = glyph_atlas.hits(), misses = glyph_atlas.misses();
+
+    Screen screen;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < (int)messages.size(); i++) {
+        if (atlas) {
+            glyph_atlas.Warm(font, messages[i].c_str());
+        }
+        screen.DrawChat(font, messages, std::max(0, i - 3));
+    }
+    for (int i = (int)messages.size() - 1; i >= 0; i--) {
+        screen.DrawChat(font, messages, i);
+    }
+    long long us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start)
+                       .count();
+
+    Run run = { us, cbin_host_font_rasterized(font), glyph_atlas.hits() - hits, glyph_atlas.misses() - misses,
+                glyph_atlas.used(), screen.checksum };
+    CHECK(run.used <= glyph_atlas.capacity());
+    return run;
+}
+
+static void BenchmarkTranscript(const char* name, const std::vector<std::string>& messages) {
+    Run before = DrawTranscript(messages, false);
+    Run after = DrawTranscript(messages, true);
+    CHECK(after.checksum == before.checksum);
+    CHECK(before.hits == 0 && before.misses == 0);
+    CHECK(after.rasterized < before.rasterized);
+    uint32_t lookups = after.hits + after.misses;
+    printf("%-6s %4zu messages: without atlas %8lld us, %7u glyphs rasterized; with atlas %8lld us, %5u rasterized, "
+           "hit rate %3u%%, %6zu bytes\n",
+           name, messages.size(), before.us, before.rasterized, after.us, after.rasterized,
+           lookups ? (unsigned)(after.hits * 100ULL / lookups) : 0, after.used);
+}
+
+// Glyphs are rasterized once, detaching forgets them and gives the font its own callback back
+static void TestDetach() {
+    auto& glyph_atlas = LvglGlyphAtlas::GetInstance();
+    CHECK(glyph_atlas.capacity() == 256 * 1024);
+    cbin_host_font_spec_t spec = { 24 };
+    LvglCBinFont cbin_font(&spec);
+    auto font = const_cast<lv_font_t*>(cbin_font.font());
+    auto cached = font->get_glyph_bitmap;
+    glyph_atlas.Warm(font, "你好，世界 hello");
+    CHECK(glyph_atlas.used() > 0);
+    // Five CJK letters and h, e, l, o; the space has no bitmap
+    CHECK(cbin_host_font_rasterized(font) == 9);
+
+    // The second time every glyph comes from the atlas
+    glyph_atlas.Warm(font, "你好，世界 hello");
+    Screen screen;
+    screen.Clear();
+    screen.DrawLabel(font, "你好，世界 hello", 0, 0);
+    CHECK(cbin_host_font_rasterized(font) == 9);
+
+    glyph_atlas.Detach(font);
+    CHECK(glyph_atlas.used() == 0);
+    CHECK(font->get_glyph_bitmap != cached);
+    screen.DrawLabel(font, "你好", 0, 0);
+    CHECK(cbin_host_font_rasterized(font) == 11);
+}
+
+int main() {
+    TestDetach();
+
+    const char* locales[] = { "zh-CN", "ja-JP", "ko-KR", "en-US", "ru-RU", "ar-SA", "th-TH" };
+    std::vector<std::string> mixed;
+    for (auto locale : locales) {
+        auto strings = LoadStrings(locale);
+        BenchmarkTranscript(locale, strings);
+    }
+    // Fifteen scripts in turn, twenty messages each
+    for (int round = 0; round < 20; round++) {
+        for (auto locale : { "ar-SA", "bg-BG", "el-GR", "en-US", "fa-IR", "he-IL", "hi-IN", "ja-JP", "ko-KR",
+                             "ru-RU", "th-TH", "uk-UA", "vi-VN", "zh-CN", "zh-TW" }) {
+            auto strings = LoadStrings(locale);
+            mixed.push_back(strings[(round * 7) % strings.size()]);
+        }
+    }
+    BenchmarkTranscript("mixed", mixed);
+    printf("lvgl_font_test passed\n");
+    return 0;
+}
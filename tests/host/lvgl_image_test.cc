@@ -0,0 +1,246 @@
+// LvglAllocatedImage::ScaleToFit: JPEG is decoded at the IDCT scale that still covers the box, the rest is
+// resized in software without dropping detail when the factor left over is small (sizes the decoder cannot
+// scale, RGB565 input). Prints the cost of showing a camera preview zoomed by LVGL on every redraw against
+// scaling it once.
+#include "lvgl_image.h"
+#include "image_to_jpeg.h"
+#include "jpeg_to_image.h"
+#include "host_test.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+static uint16_t Rgb565(int r, int g, int b) {
+    return (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+}
+
+static void Channels(uint16_t pixel, int rgb[3]) {
+    rgb[0] = (pixel >> 11) * 255 / 31;
+    rgb[1] = ((pixel >> 5) & 0x3F) * 255 / 63;
+    rgb[2] = (pixel & 0x1F) * 255 / 31;
+}
+
+// A camera-like picture: smooth shading with a few hard edges, RGB565 little endian
+static std::vector<uint16_t> Picture(int width, int height) {
+    std::vector<uint16_t> pixels((size_t)width * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int r = x * 255 / width;
+            int g = y * 255 / height;
+            int b = 128 + (int)(100 * std::sin(x * 0.02) * std::cos(y * 0.03));
+            if ((x * 5 / width + y * 4 / height) % 2 == 0) {
+                r = 255 - r;
+            }
+            pixels[(size_t)y * width + x] = Rgb565(r, g, b);
+        }
+    }
+    return pixels;
+}
+
+static std::vector<uint8_t> Encode(const std::vector<uint16_t>& pixels, int width, int height) {
+    uint8_t* jpeg = nullptr;
+    size_t jpeg_len = 0;
+    CHECK(image_to_jpeg((uint8_t*)pixels.data(), pixels.size() * 2, width, height, V4L2_PIX_FMT_RGB565, 90,
+                        &jpeg, &jpeg_len));
+    std::vector<uint8_t> data(jpeg, jpeg + jpeg_len);
+    free(jpeg);
+    return data;
+}
+
+// Mean absolute difference per channel between `image` and `reference` averaged down to the image size
+static double MeanError(const lv_img_dsc_t* image, const std::vector<uint16_t>& reference, int ref_width,
+                        int ref_height) {
+    int width = image->header.w, height = image->header.h;
+    int stride = image->header.stride ? image->header.stride : width * 2;
+    double error = 0;
+    for (int y = 0; y < height; y++) {
+        auto row = reinterpret_cast<const uint16_t*>(image->data + (size_t)y * stride);
+        int y0 = y * ref_height / height, y1 = std::max(y0 + 1, (y + 1) * ref_height / height);
+        for (int x = 0; x < width; x++) {
+            int x0 = x * ref_width / width, x1 = std::max(x0 + 1, (x + 1) * ref_width / width);
+            int sum[3] = { 0, 0, 0 };
+            for (int sy = y0; sy < y1; sy++) {
+                for (int sx = x0; sx < x1; sx++) {
+                    int rgb[3];
+                    Channels(reference[(size_t)sy * ref_width + sx], rgb);
+                    sum[0] += rgb[0];
+                    sum[1] += rgb[1];
+                    sum[2] += rgb[2];
+                }
+            }
+            int count = (y1 - y0) * (x1 - x0);
+            int rgb[3];
+            Channels(row[x], rgb);
+            for (int c = 0; c < 3; c++) {
+                error += std::abs(rgb[c] - (double)sum[c] / count);
+            }
+        }
+    }
+    return error / (3.0 * width * height);
+}
+
+// The decoder stub reads back what the encoder stub wrote, at full size and at every IDCT scale
+static void TestDecode() {
+    auto picture = Picture(320, 240);
+    auto jpeg = Encode(picture, 320, 240);
+
+    uint8_t* out = nullptr;
+    size_t out_len = 0, width = 0, height = 0, stride = 0;
+    CHECK(jpeg_to_image(jpeg.data(), jpeg.size(), &out, &out_len, &width, &height, &stride) == ESP_OK);
+    CHECK(width == 320 && height == 240 && stride == 640 && out_len == 320 * 240 * 2);
+    LvglAllocatedImage full(out, out_len, width, height, stride, LV_COLOR_FORMAT_RGB565);
+    CHECK(MeanError(full.image_dsc(), picture, 320, 240) < 4);
+
+    // Both small boxes decode at 1/2, since 1/4 (80x60) and 1/8 (40x30) are not multiples of 8; a box larger
+    // than half the image decodes at full size
+    const int fits[][3] = { { 160, 120, 160 }, { 80, 60, 160 }, { 300, 300, 320 } };
+    for (auto& fit : fits) {
+        CHECK(jpeg_to_image_scaled(jpeg.data(), jpeg.size(), fit[0], fit[1], &out, &out_len, &width, &height,
+                                   &stride) == ESP_OK);
+        CHECK((int)width == fit[2] && height * 4 == width * 3);
+        LvglAllocatedImage scaled(out, out_len, width, height, stride, LV_COLOR_FORMAT_RGB565);
+        CHECK(MeanError(scaled.image_dsc(), picture, 320, 240) < 6);
+    }
+
+    // Not a JPEG
+    std::vector<uint8_t> garbage(jpeg.begin(), jpeg.begin() + 200);
+    garbage[2] = 0x00;
+    CHECK(jpeg_to_image(garbage.data(), garbage.size(), &out, &out_len, &width, &height, &stride) != ESP_OK);
+    CHECK(out == nullptr);
+}
+
+static void TestScaleToFitJpeg() {
+    // 640x480 into 224x120: 1/4 IDCT scaling gives 160x120, which already fits
+    auto picture = Picture(640, 480);
+    auto jpeg = Encode(picture, 640, 480);
+    LvglRawImage raw(jpeg.data(), jpeg.size());
+    auto scaled = LvglAllocatedImage::ScaleToFit(raw, 224, 120);
+    CHECK(scaled != nullptr);
+    CHECK(scaled->image_dsc()->header.w == 160 && scaled->image_dsc()->header.h == 120);
+    CHECK(MeanError(scaled->image_dsc(), picture, 640, 480) < 6);
+
+    // 1000x600 cannot be IDCT scaled (500x300 is not a multiple of 8), the whole factor is done in software
+    picture = Picture(1000, 600);
+    jpeg = Encode(picture, 1000, 600);
+    LvglRawImage unscalable(jpeg.data(), jpeg.size());
+    scaled = LvglAllocatedImage::ScaleToFit(unscalable, 100, 100);
+    CHECK(scaled != nullptr);
+    CHECK(scaled->image_dsc()->header.w == 100 && scaled->image_dsc()->header.h == 60);
+    CHECK(MeanError(scaled->image_dsc(), picture, 1000, 600) < 8);
+}
+
+// Shrinking by a large factor averages instead of picking single pixels: a one-pixel checkerboard turns grey
+static void TestScaleToFitAverages() {
+    const int width = 800, height = 480;
+    auto pixels = (uint16_t*)malloc((size_t)width * height * 2);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            pixels[(size_t)y * width + x] = (x + y) % 2 ? 0xFFFF : 0x0000;
+        }
+    }
+    LvglAllocatedImage board(pixels, (size_t)width * height * 2, width, height, width * 2, LV_COLOR_FORMAT_RGB565);
+    for (int box : { 400, 300, 100, 37 }) {
+        auto scaled = LvglAllocatedImage::ScaleToFit(board, box, box);
+        CHECK(scaled != nullptr);
+        auto dsc = scaled->image_dsc();
+        CHECK((int)dsc->header.w == box && (int)dsc->header.h == box * height / width);
+        auto out = reinterpret_cast<const uint16_t*>(dsc->data);
+        for (size_t i = 0; i < (size_t)dsc->header.w * dsc->header.h; i++) {
+            int rgb[3];
+            Channels(out[i], rgb);
+            CHECK(std::abs(rgb[1] - 128) < 16);
+        }
+    }
+
+    // Already fits: nothing to do
+    CHECK(LvglAllocatedImage::ScaleToFit(board, width, height) == nullptr);
+}
+
+// Stand-in for LVGL drawing an image zoomed to the box: bilinear sampling of every output pixel, as
+// lv_draw_sw_transform does for RGB565
+static void DrawZoomed(const lv_img_dsc_t* image, uint16_t* dst, int dst_width, int dst_height) {
+    int width = image->header.w, height = image->header.h;
+    int stride = image->header.stride ? image->header.stride : width * 2;
+    int32_t step_x = (width << 8) / dst_width, step_y = (height << 8) / dst_height;
+    for (int y = 0; y < dst_height; y++) {
+        int32_t fy = y * step_y;
+        int sy = std::min(fy >> 8, height - 2), wy = fy & 0xFF;
+        auto row0 = reinterpret_cast<const uint16_t*>(image->data + (size_t)sy * stride);
+        auto row1 = reinterpret_cast<const uint16_t*>(image->data + (size_t)(sy + 1) * stride);
+        for (int x = 0; x < dst_width; x++) {
+            int32_t fx = x * step_x;
+            int sx = std::min(fx >> 8, width - 2), wx = fx & 0xFF;
+            uint32_t out = 0;
+            for (uint32_t mask : { 0xF800u, 0x07E0u, 0x001Fu }) {
+                uint32_t top = ((row0[sx] & mask) * (256 - wx) + (row0[sx + 1] & mask) * wx) >> 8;
+                uint32_t bottom = ((row1[sx] & mask) * (256 - wx) + (row1[sx + 1] & mask) * wx) >> 8;
+                out |= ((top * (256 - wy) + bottom * wy) >> 8) & mask;
+            }
+            dst[(size_t)y * dst_width + x] = (uint16_t)out;
+        }
+    }
+}
+
+static void DrawUnscaled(const lv_img_dsc_t* image, uint16_t* dst, int dst_width) {
+    int stride = image->header.stride ? image->header.stride : image->header.w * 2;
+    for (int y = 0; y < (int)image->header.h; y++) {
+        memcpy(dst + (size_t)y * dst_width, image->data + (size_t)y * stride, image->header.w * 2);
+    }
+}
+
+static long long Microseconds(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+// A camera frame previewed in a 224x120 chat bubble (LcdDisplay on a 320x240 screen) and redrawn 30 times
+static void BenchmarkPreview(int width, int height) {
+    const int box_width = 224, box_height = 120, redraws = 30;
+    auto jpeg = Encode(Picture(width, height), width, height);
+    std::vector<uint16_t> screen((size_t)box_width * box_height);
+
+    // Before: decode at full size, LVGL zooms on every redraw
+    auto start = std::chrono::steady_clock::now();
+    uint8_t* out = nullptr;
+    size_t out_len = 0, out_width = 0, out_height = 0, out_stride = 0;
+    CHECK(jpeg_to_image(jpeg.data(), jpeg.size(), &out, &out_len, &out_width, &out_height, &out_stride) == ESP_OK);
+    LvglAllocatedImage full(out, out_len, out_width, out_height, out_stride, LV_COLOR_FORMAT_RGB565);
+    long long full_decode_us = Microseconds(start);
+    float zoom = std::min((float)box_width / width, (float)box_height / height);
+    int zoomed_width = (int)(width * zoom), zoomed_height = (int)(height * zoom);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < redraws; i++) {
+        DrawZoomed(full.image_dsc(), screen.data(), zoomed_width, zoomed_height);
+    }
+    long long full_draw_us = Microseconds(start);
+
+    // After: decode at the IDCT scale, resize once, draw 1:1
+    start = std::chrono::steady_clock::now();
+    LvglRawImage raw(jpeg.data(), jpeg.size());
+    auto scaled = LvglAllocatedImage::ScaleToFit(raw, box_width, box_height);
+    CHECK(scaled != nullptr);
+    long long scaled_decode_us = Microseconds(start);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < redraws; i++) {
+        DrawUnscaled(scaled->image_dsc(), screen.data(), box_width);
+    }
+    long long scaled_draw_us = Microseconds(start);
+
+    printf("preview %4dx%-4d JPEG %6zu bytes: full size %7lld us decode + %6lld us for %d redraws, %7u bytes kept; "
+           "scaled %6lld us + %5lld us, %6u bytes kept\n",
+           width, height, jpeg.size(), full_decode_us, full_draw_us, redraws, full.image_dsc()->data_size,
+           scaled_decode_us, scaled_draw_us, scaled->image_dsc()->data_size);
+}
+
+int main() {
+    TestDecode();
+    TestScaleToFitJpeg();
+    TestScaleToFitAverages();
+    BenchmarkPreview(320, 240);
+    BenchmarkPreview(640, 480);
+    BenchmarkPreview(1280, 720);
+    printf("lvgl_image_test passed\n");
+    return 0;
+}
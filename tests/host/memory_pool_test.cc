@@ -0,0 +1,189 @@
+// 内存池：单池耗尽/归还、分级选择与堆回退、在用字节统计与碎片率、多线程并发
+#include "memory_pool.h"
+#include "host_test.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void TestSinglePool() {
+    memory_pool_config_t config = { 32, 4, MEMORY_POOL_PLACEMENT_DEFAULT };
+    memory_pool_t* pool = memory_pool_create(&config);
+    CHECK(pool != nullptr);
+    CHECK(memory_pool_block_size(pool) >= 32);
+
+    void* blocks[4];
+    for (auto& block : blocks) {
+        block = memory_pool_alloc(pool);
+        CHECK(block != nullptr);
+        CHECK(reinterpret_cast<uintptr_t>(block) % MEMORY_POOL_ALIGNMENT == 0);
+        CHECK(memory_pool_owns(pool, block));
+        memset(block, 0xa5, 32);
+    }
+    CHECK(memory_pool_available(pool) == 0);
+    CHECK(memory_pool_alloc(pool) == nullptr);
+
+    int on_stack = 0;
+    CHECK(!memory_pool_owns(pool, &on_stack));
+
+    memory_pool_free(pool, blocks[2]);
+    CHECK(memory_pool_available(pool) == 1);
+    CHECK(memory_pool_alloc(pool) == blocks[2]);
+
+    memory_pool_stats_t stats;
+    memory_pool_get_stats(pool, &stats);
+    CHECK(stats.in_use == 4);
+    CHECK(stats.high_water == 4);
+    CHECK(stats.alloc_count == 5);
+    CHECK(stats.fail_count == 1);
+
+    for (auto& block : blocks) {
+        memory_pool_free(pool, block);
+    }
+    CHECK(memory_pool_available(pool) == 4);
+    memory_pool_destroy(pool);
+}
+
+static void TestPoolSet() {
+    const memory_pool_config_t classes[] = {
+        { 16, 2, MEMORY_POOL_PLACEMENT_DEFAULT },
+        { 64, 2, MEMORY_POOL_PLACEMENT_DEFAULT },
+    };
+    memory_pool_set_config_t config = {};
+    config.classes = classes;
+    config.class_count = 2;
+    config.fallback_to_heap = true;
+    memory_pool_set_t* set = memory_pool_set_create(&config);
+    CHECK(set != nullptr);
+
+    // 16 B 级别耗尽后落到 64 B，再耗尽后退回堆
+    std::vector<void*> blocks;
+    for (int i = 0; i < 5; i++) {
+        void* block = memory_pool_set_alloc(set, 10);
+        CHECK(block != nullptr);
+        blocks.push_back(block);
+    }
+    void* large = memory_pool_set_alloc(set, 1000);
+    CHECK(large != nullptr);
+
+    memory_pool_set_stats_t stats;
+    memory_pool_set_get_stats(set, &stats);
+    CHECK(stats.class_count == 2);
+    CHECK(stats.classes[0].in_use == 2);
+    CHECK(stats.classes[1].in_use == 2);
+    CHECK(stats.heap_fallback_count == 2);
+    int fragmentation = memory_pool_set_fragmentation(set);
+    CHECK(fragmentation > 0 && fragmentation <= 100);
+
+    for (void* block : blocks) {
+        memory_pool_set_free(set, block);
+    }
+    memory_pool_set_free(set, large);
+    memory_pool_set_get_stats(set, &stats);
+    CHECK(stats.classes[0].in_use == 0);
+    CHECK(stats.classes[1].in_use == 0);
+    memory_pool_set_destroy(set);
+
+    // 不允许回退时超出最大级别返回 NULL
+    config.fallback_to_heap = false;
+    set = memory_pool_set_create(&config);
+    CHECK(set != nullptr);
+    CHECK(memory_pool_set_alloc(set, 1000) == nullptr);
+    memory_pool_set_destroy(set);
+}
+
+static void TestConcurrentSet() {
+    memory_pool_set_t* set = memory_pool_set_create(nullptr);
+    CHECK(set != nullptr);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([set, t] {
+            for (int i = 0; i < 50000; i++) {
+                size_t size = static_cast<size_t>(i % 100) + 1;
+                auto* small = static_cast<uint8_t*>(memory_pool_set_alloc(set, size));
+                auto* medium = static_cast<uint8_t*>(memory_pool_set_alloc(set, 700));
+                CHECK(small != nullptr && medium != nullptr);
+                // 写入线程标记，释放前确认没有被其他线程同时拿到
+                small[0] = static_cast<uint8_t>(t);
+                medium[699] = static_cast<uint8_t>(t);
+                CHECK(small[0] == t && medium[699] == t);
+                memory_pool_set_free(set, small);
+                memory_pool_set_free(set, medium);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    memory_pool_set_stats_t stats;
+    memory_pool_set_get_stats(set, &stats);
+    for (size_t i = 0; i < stats.class_count; i++) {
+        CHECK(stats.classes[i].in_use == 0);
+    }
+    CHECK(stats.bytes_requested == 0 && stats.bytes_reserved == 0);
+    memory_pool_set_destroy(set);
+}
+
+// 统计只计在用的分配：全部释放后碎片率回到 0，重复释放不会多扣
+static void TestFragmentationAfterFree() {
+    const memory_pool_config_t classes[] = {
+        { 16, 2, MEMORY_POOL_PLACEMENT_DEFAULT },
+        { 64, 2, MEMORY_POOL_PLACEMENT_DEFAULT },
+    };
+    memory_pool_set_config_t config = {};
+    config.classes = classes;
+    config.class_count = 2;
+    config.fallback_to_heap = true;
+    memory_pool_set_t* set = memory_pool_set_create(&config);
+    CHECK(set != nullptr);
+
+    void* small = memory_pool_set_alloc(set, 4);
+    void* medium = memory_pool_set_alloc(set, 48);
+    void* heap = memory_pool_set_alloc(set, 1000);
+    CHECK(small != nullptr && medium != nullptr && heap != nullptr);
+    memset(heap, 0xA5, 1000);
+
+    memory_pool_set_stats_t stats;
+    memory_pool_set_get_stats(set, &stats);
+    CHECK(stats.heap_fallback_count == 1);
+    CHECK(stats.bytes_requested == 4 + 48 + 1000);
+    CHECK(stats.bytes_reserved == 16 + 64 + 1000);
+    CHECK(memory_pool_set_fragmentation(set) == 100 - (1052 * 100) / 1080);
+
+    memory_pool_set_free(set, small);
+    memory_pool_set_free(set, small);
+    memory_pool_set_get_stats(set, &stats);
+    CHECK(stats.bytes_requested == 48 + 1000);
+    CHECK(stats.bytes_reserved == 64 + 1000);
+
+    memory_pool_set_free(set, heap);
+    memory_pool_set_get_stats(set, &stats);
+    CHECK(stats.bytes_requested == 48);
+    CHECK(stats.bytes_reserved == 64);
+    CHECK(memory_pool_set_fragmentation(set) == 25);
+
+    memory_pool_set_free(set, medium);
+    memory_pool_set_get_stats(set, &stats);
+    CHECK(stats.bytes_requested == 0);
+    CHECK(stats.bytes_reserved == 0);
+    CHECK(memory_pool_set_fragmentation(set) == 0);
+
+    // 释放后重新分配的块按新的请求大小计
+    small = memory_pool_set_alloc(set, 16);
+    CHECK(memory_pool_set_fragmentation(set) == 0);
+    memory_pool_set_free(set, small);
+    memory_pool_set_destroy(set);
+}
+
+int main() {
+    TestSinglePool();
+    TestPoolSet();
+    TestFragmentationAfterFree();
+    TestConcurrentSet();
+    printf("memory_pool_test passed\n");
+    return 0;
+}
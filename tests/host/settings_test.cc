@@ -0,0 +1,312 @@
+// Settings cache: NVS is read once per namespace, writes are committed together by the commit task rather than
+// the timer task, failed commits are retried, views and change callbacks stay safe next to concurrent writes
+#include "settings.h"
+#include "host_test.h"
+
+#include <esp_timer.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Values as committed to the fake NVS, bypassing the cache
+static int32_t StoredInt(const char* ns, const char* key, int32_t default_value = -1) {
+    nvs_handle_t handle;
+    if (nvs_open(ns, NVS_READONLY, &handle) != ESP_OK) {
+        return default_value;
+    }
+    int32_t value = default_value;
+    nvs_get_i32(handle, key, &value);
+    nvs_close(handle);
+    return value;
+}
+
+static std::string StoredString(const char* ns, const char* key) {
+    nvs_handle_t handle;
+    if (nvs_open(ns, NVS_READONLY, &handle) != ESP_OK) {
+        return "";
+    }
+    char value[64] = "";
+    size_t length = sizeof(value);
+    nvs_get_str(handle, key, value, &length);
+    nvs_close(handle);
+    return value;
+}
+
+static esp_timer_handle_t CommitTimer() {
+    auto timer = esp_timer_host_find("settings_commit");
+    CHECK(timer != nullptr);
+    return timer;
+}
+
+// The timer only wakes the commit task, wait for it to have done its part
+template <typename Predicate>
+static bool WaitUntil(Predicate done) {
+    for (int i = 0; i < 5000; i++) {
+        if (done()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+static void TestReadsOnce() {
+    nvs_handle_t handle;
+    CHECK(nvs_open("read_once", NVS_READWRITE, &handle) == ESP_OK);
+    CHECK(nvs_set_str(handle, "name", "xiaozhi") == ESP_OK);
+    CHECK(nvs_set_i32(handle, "volume", 70) == ESP_OK);
+    CHECK(nvs_set_u8(handle, "muted", 1) == ESP_OK);
+    CHECK(nvs_commit(handle) == ESP_OK);
+    nvs_close(handle);
+
+    Settings settings("read_once");
+    CHECK(settings.GetString("name") == "xiaozhi");
+    int reads = nvs_host_read_count();
+    for (int i = 0; i < 100; i++) {
+        Settings again("read_once");
+        CHECK(again.GetString("name") == "xiaozhi");
+        CHECK(again.GetInt("volume") == 70);
+        CHECK(again.GetBool("muted"));
+        CHECK(again.GetString("missing", "default") == "default");
+        // A key of another type is not returned
+        CHECK(again.GetInt("name", 5) == 5);
+    }
+    CHECK(nvs_host_read_count() == reads);
+
+    Settings read_only("read_once");
+    read_only.SetInt("volume", 10);
+    CHECK(read_only.GetInt("volume") == 70);
+}
+
+static void TestWritesCommittedTogether() {
+    auto timer = CommitTimer();
+    int commits = nvs_host_commit_count();
+    int starts = esp_timer_host_start_count(timer);
+    {
+        Settings settings("batched", true);
+        settings.SetString("url", "http://example.com");
+        settings.SetInt("offset", 4096);
+        settings.SetBool("enabled", true);
+        CHECK(settings.GetInt("offset") == 4096);
+    }
+    CHECK(nvs_host_commit_count() == commits);
+    CHECK(StoredInt("batched", "offset") == -1);
+    CHECK(esp_timer_is_active(timer));
+
+    // Writes while a commit is pending do not push it back
+    for (int i = 0; i < 50; i++) {
+        Settings("batched", true).SetInt("offset", 4096 * i);
+    }
+    CHECK(esp_timer_host_start_count(timer) == starts + 1);
+
+    CHECK(esp_timer_host_fire(timer));
+    CHECK(WaitUntil([commits] { return nvs_host_commit_count() == commits + 1; }));
+    CHECK(StoredString("batched", "url") == "http://example.com");
+    CHECK(StoredInt("batched", "offset") == 4096 * 49);
+
+    // Unchanged values are not written again
+    Settings("batched", true).SetInt("offset", 4096 * 49);
+    CHECK(!esp_timer_is_active(timer));
+}
+
+static void TestEraseCommitted() {
+    auto timer = CommitTimer();
+    {
+        Settings settings("erase", true);
+        settings.SetInt("a", 1);
+        settings.SetInt("b", 2);
+        settings.SetInt("c", 3);
+    }
+    Settings::Flush();
+    CHECK(!esp_timer_is_active(timer));
+    CHECK(StoredInt("erase", "b") == 2);
+
+    Settings("erase", true).EraseKey("b");
+    Settings::Flush();
+    CHECK(StoredInt("erase", "a") == 1);
+    CHECK(StoredInt("erase", "b") == -1);
+
+    {
+        Settings settings("erase", true);
+        settings.EraseAll();
+        settings.SetInt("d", 4);
+        CHECK(settings.GetInt("a", -1) == -1);
+    }
+    Settings::Flush();
+    CHECK(StoredInt("erase", "a") == -1);
+    CHECK(StoredInt("erase", "c") == -1);
+    CHECK(StoredInt("erase", "d") == 4);
+}
+
+// A failed commit neither aborts nor loses the writes, they are committed once NVS works again
+static void TestFailedCommitRetried() {
+    auto timer = CommitTimer();
+    {
+        Settings settings("retry", true);
+        settings.SetInt("kept", 1);
+    }
+    Settings::Flush();
+
+    {
+        Settings settings("retry", true);
+        settings.SetString("url", "http://example.com/assets.bin");
+        settings.SetInt("kept", 2);
+        settings.EraseKey("missing");
+    }
+    nvs_host_fail_writes(ESP_ERR_NVS_NOT_ENOUGH_SPACE);
+    Settings::Flush();
+    CHECK(StoredString("retry", "url").empty());
+    CHECK(StoredInt("retry", "kept") == 1);
+    CHECK(Settings("retry").GetInt("kept") == 2);
+    // The retry is already scheduled
+    CHECK(esp_timer_is_active(timer));
+    CHECK(esp_timer_host_fire(timer));
+    CHECK(WaitUntil([timer] { return esp_timer_is_active(timer); }));
+
+    // Other namespaces are still committed
+    Settings("retry_other", true).SetInt("value", 9);
+    Settings::Flush();
+    CHECK(StoredInt("retry_other", "value") == -1);
+    nvs_host_fail_writes(ESP_OK);
+    CHECK(esp_timer_host_fire(timer));
+    CHECK(WaitUntil([] { return StoredInt("retry_other", "value") == 9; }));
+    CHECK(!esp_timer_is_active(timer));
+    CHECK(StoredString("retry", "url") == "http://example.com/assets.bin");
+    CHECK(StoredInt("retry", "kept") == 2);
+    CHECK(StoredInt("retry_other", "value") == 9);
+
+    // An erase of the whole namespace is retried too
+    Settings("retry", true).EraseAll();
+    nvs_host_fail_writes(ESP_FAIL);
+    Settings::Flush();
+    CHECK(StoredInt("retry", "kept") == 2);
+    nvs_host_fail_writes(ESP_OK);
+    Settings::Flush();
+    CHECK(StoredInt("retry", "kept") == -1);
+    CHECK(StoredString("retry", "url").empty());
+}
+
+// A commit that waits for flash keeps the commit task busy, not the esp_timer task
+static void TestCommitOffTimerTask() {
+    auto timer = CommitTimer();
+    Settings("slow", true).SetInt("value", 1);
+    nvs_host_set_commit_delay_ms(300);
+    auto start = std::chrono::steady_clock::now();
+    CHECK(esp_timer_host_fire(timer));
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(100));
+    CHECK(WaitUntil([] { return StoredInt("slow", "value") == 1; }));
+    nvs_host_set_commit_delay_ms(0);
+
+    // Flush() still commits before it returns
+    Settings("slow", true).SetInt("value", 2);
+    Settings::Flush();
+    CHECK(StoredInt("slow", "value") == 2);
+}
+
+// A view is the string as it was read, it outlives writes and erases of its key
+static void TestStringView() {
+    Settings settings("views", true);
+    settings.SetString("name", "xiaozhi");
+    auto view = settings.GetStringView("name");
+    CHECK(*view == "xiaozhi");
+    // Views of an unchanged value share the string instead of copying it again
+    CHECK(settings.GetStringView("name") == view);
+    CHECK(*settings.GetStringView("missing", "default") == "default");
+    CHECK(settings.GetStringView("missing")->empty());
+
+    settings.SetString("name", std::string(1000, 'x'));
+    CHECK(*view == "xiaozhi");
+    CHECK(*settings.GetStringView("name") == std::string(1000, 'x'));
+    settings.EraseAll();
+    CHECK(*view == "xiaozhi");
+    CHECK(settings.GetStringView("name")->empty());
+
+    // Readers holding views while another task keeps rewriting the key
+    std::atomic<bool> stop{false};
+    std::thread writer([&stop] {
+        Settings settings("views", true);
+        for (int i = 0; !stop; i++) {
+            settings.SetString("counter", std::string(100 + i % 50, 'a' + i % 26));
+        }
+    });
+    for (int i = 0; i < 20000; i++) {
+        auto counter = settings.GetStringView("counter");
+        if (!counter->empty()) {
+            CHECK(counter->find_first_not_of((*counter)[0]) == std::string::npos);
+        }
+    }
+    stop = true;
+    writer.join();
+}
+
+static void TestOnChange() {
+    std::vector<std::string> keys;
+    Settings::OnChange("watched", [&keys](const std::string& key) {
+        // Outside the cache lock, reading and writing settings from the callback does not deadlock
+        Settings settings("watched", true);
+        keys.push_back(key + "=" + settings.GetString(key));
+        Settings("watched_log", true).SetInt("count", keys.size());
+    });
+    {
+        Settings settings("watched", true);
+        settings.SetString("theme", "dark");
+        // Unchanged values are not reported
+        settings.SetString("theme", "dark");
+        settings.EraseKey("theme");
+        settings.EraseKey("theme");
+        settings.SetString("language", "zh-CN");
+        settings.EraseAll();
+    }
+    Settings("unwatched", true).SetInt("value", 1);
+    CHECK(keys.size() == 4);
+    CHECK(keys[0] == "theme=dark");
+    CHECK(keys[1] == "theme=");
+    CHECK(keys[2] == "language=zh-CN");
+    CHECK(keys[3] == "=");
+    CHECK(Settings("watched_log").GetInt("count") == 4);
+}
+
+static void TestConcurrentWriters() {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([t] {
+            std::string ns = "thread_" + std::to_string(t);
+            for (int i = 0; i < 2000; i++) {
+                Settings settings(ns, true);
+                settings.SetInt("counter", i);
+                settings.SetString("text", std::to_string(i));
+                CHECK(settings.GetInt("counter") == i);
+                CHECK(settings.GetString("text") == std::to_string(i));
+                if (i % 100 == 0) {
+                    Settings::Flush();
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    Settings::Flush();
+    for (int t = 0; t < 4; t++) {
+        std::string ns = "thread_" + std::to_string(t);
+        CHECK(StoredInt(ns.c_str(), "counter") == 1999);
+        CHECK(StoredString(ns.c_str(), "text") == "1999");
+    }
+}
+
+int main() {
+    TestReadsOnce();
+    TestWritesCommittedTogether();
+    TestEraseCommitted();
+    TestFailedCommitRetried();
+    TestCommitOffTimerTask();
+    TestStringView();
+    TestOnChange();
+    TestConcurrentWriters();
+    printf("settings_test passed\n");
+    return 0;
+}
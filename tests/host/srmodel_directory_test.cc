@@ -0,0 +1,224 @@
+// srmodels.bin directory: models and sizes of packed images, truncated or corrupted images are rejected
+#include "srmodel_directory.h"
+#include "host_test.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+struct File {
+    std::string name;
+    size_t size;
+};
+
+struct Model {
+    std::string name;
+    std::vector<File> files;
+};
+
+static void PutLe32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(value >> (i * 8));
+    }
+}
+
+static void PutName(std::vector<uint8_t>& out, const std::string& name) {
+    std::string fixed = name.substr(0, 32);
+    fixed.resize(32, '\0');
+    out.insert(out.end(), fixed.begin(), fixed.end());
+}
+
+// Same layout as pack_models(): the directory, then the data of every file in directory order
+static std::vector<uint8_t> Pack(const std::vector<Model>& models) {
+    size_t header = 4;
+    for (auto& model : models) {
+        header += 32 + 4 + model.files.size() * (32 + 8);
+    }
+    std::vector<uint8_t> out;
+    PutLe32(out, models.size());
+    size_t offset = header;
+    for (auto& model : models) {
+        PutName(out, model.name);
+        PutLe32(out, model.files.size());
+        for (auto& file : model.files) {
+            PutName(out, file.name);
+            PutLe32(out, offset);
+            PutLe32(out, file.size);
+            offset += file.size;
+        }
+    }
+    CHECK(out.size() == header);
+    for (size_t i = header; i < offset; i++) {
+        out.push_back((uint8_t)(i * 31));
+    }
+    return out;
+}
+
+static const std::vector<Model> kModels = {
+    { "wn9_nihaoxiaozhi_tts", { { "_MODEL_INFO_", 10 }, { "wn9_data", 1000 }, { "wn9_index", 100 } } },
+    { "nsnet2", { { "data", 50 } } },
+    { "mn6_cn", {} },
+    { "vadnet1_medium", { { "a", 1 }, { "b", 2 } } },
+    // Uses all 32 bytes of the name, which is not NUL terminated then
+    { "wn9_a_model_name_of_32_bytes_tts", { { "_MODEL_INFO_", 7 } } },
+};
+
+static void TestParse() {
+    auto image = Pack(kModels);
+    SrmodelDirectory directory;
+    CHECK(directory.Parse(image.data(), image.size()));
+    auto& models = directory.models();
+    CHECK(models.size() == kModels.size());
+    CHECK(models[0].name == "wn9_nihaoxiaozhi_tts" && models[0].size == 1110);
+    CHECK(models[1].name == "nsnet2" && models[1].size == 50);
+    CHECK(models[2].name == "mn6_cn" && models[2].size == 0);
+    CHECK(models[3].name == "vadnet1_medium" && models[3].size == 3);
+    CHECK(models[4].name == "wn9_a_model_name_of_32_bytes_tts" && models[4].size == 7);
+
+    // The first model containing both keywords, like esp_srmodel_filter()
+    CHECK(directory.Find("wn9") == &models[0]);
+    CHECK(directory.Find("wn9", "32_bytes") == &models[4]);
+    CHECK(directory.Find("nsnet", nullptr) == &models[1]);
+    CHECK(directory.Find(nullptr, "medium") == &models[3]);
+    CHECK(directory.Find("mn6", "cn") == &models[2]);
+    CHECK(directory.Find("mn7") == nullptr);
+    CHECK(directory.Find("wn9", "xiaoai") == nullptr);
+
+    std::vector<uint8_t> empty = { 0, 0, 0, 0 };
+    CHECK(directory.Parse(empty.data(), empty.size()));
+    CHECK(directory.models().empty());
+    CHECK(directory.Find("wn9") == nullptr);
+}
+
+// Every prefix of the image fails, the last file ends at the end of the image
+static void TestTruncated() {
+    auto image = Pack(kModels);
+    SrmodelDirectory directory;
+    for (size_t size = 0; size < image.size(); size++) {
+        std::vector<uint8_t> prefix(image.begin(), image.begin() + size);
+        CHECK(directory.Parse(image.data(), image.size()));
+        if (directory.Parse(prefix.data(), prefix.size())) {
+            fprintf(stderr, "image cut to %zu of %zu bytes was accepted\n", size, image.size());
+            exit(1);
+        }
+        CHECK(directory.models().empty());
+    }
+    CHECK(!directory.Parse(nullptr, 100));
+}
+
+static void SetLe32(std::vector<uint8_t>& image, size_t pos, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        image[pos + i] = value >> (i * 8);
+    }
+}
+
+// Position of the offset field of the first file of the first model
+static constexpr size_t kFirstOffset = 4 + 32 + 4 + 32;
+
+static void TestOversizedOffsets() {
+    auto image = Pack(kModels);
+    SrmodelDirectory directory;
+
+    auto bad = image;
+    SetLe32(bad, kFirstOffset, image.size() + 1);
+    CHECK(!directory.Parse(bad.data(), bad.size()));
+    CHECK(directory.models().empty());
+
+    // Ends one byte after the image
+    bad = image;
+    SetLe32(bad, kFirstOffset, image.size() - 9);
+    CHECK(!directory.Parse(bad.data(), bad.size()));
+
+    // offset + size wraps around in 32 bits
+    bad = image;
+    SetLe32(bad, kFirstOffset, 16);
+    SetLe32(bad, kFirstOffset + 4, 0xFFFFFFF8);
+    CHECK(!directory.Parse(bad.data(), bad.size()));
+
+    bad = image;
+    SetLe32(bad, kFirstOffset, 0xFFFFFFFF);
+    SetLe32(bad, kFirstOffset + 4, 0);
+    CHECK(!directory.Parse(bad.data(), bad.size()));
+
+    // An empty file right at the end is still inside the image
+    bad = image;
+    SetLe32(bad, kFirstOffset, image.size());
+    SetLe32(bad, kFirstOffset + 4, 0);
+    CHECK(directory.Parse(bad.data(), bad.size()));
+    CHECK(directory.models()[0].size == 1100);
+}
+
+// Counts larger than the image can hold fail before anything is reserved for them
+static void TestOversizedCounts() {
+    auto image = Pack(kModels);
+    SrmodelDirectory directory;
+
+    auto bad = image;
+    SetLe32(bad, 0, 0xFFFFFFFF);
+    CHECK(!directory.Parse(bad.data(), bad.size()));
+
+    bad = image;
+    SetLe32(bad, 0, kModels.size() + 1);
+    CHECK(!directory.Parse(bad.data(), bad.size()));
+
+    bad = image;
+    SetLe32(bad, 4 + 32, 0x10000000);
+    CHECK(!directory.Parse(bad.data(), bad.size()));
+    CHECK(directory.models().empty());
+
+    std::vector<uint8_t> header(8, 0xFF);
+    CHECK(!directory.Parse(header.data(), header.size()));
+}
+
+// Images made by pack_models() in scripts/build_default_assets.py
+static void TestScriptImage(const char* python, const char* scripts) {
+    char dir[] = "/tmp/srmodel_directory_test.XXXXXX";
+    CHECK(mkdtemp(dir) != nullptr);
+    size_t total = 0;
+    for (auto& model : kModels) {
+        std::string model_dir = std::string(dir) + "/" + model.name;
+        CHECK(system(("mkdir " + model_dir).c_str()) == 0);
+        for (auto& file : model.files) {
+            std::ofstream out(model_dir + "/" + file.name, std::ios::binary);
+            out << std::string(file.size, 'm');
+            total += file.size;
+        }
+    }
+    std::string command = std::string(python) + " -B -c \"import sys; sys.path.insert(0, '" + scripts +
+        "'); import build_default_assets as b; b.pack_models('" + dir + "')\" > /dev/null";
+    CHECK(system(command.c_str()) == 0);
+
+    std::ifstream file(std::string(dir) + "/srmodels.bin", std::ios::binary);
+    std::vector<uint8_t> image((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    SrmodelDirectory directory;
+    CHECK(directory.Parse(image.data(), image.size()));
+    CHECK(directory.models().size() == kModels.size());
+    // pack_models() lists the models in directory order, look them up by name
+    for (auto& model : kModels) {
+        auto found = directory.Find(model.name.c_str());
+        CHECK(found != nullptr && found->name == model.name);
+        size_t size = 0;
+        for (auto& file : model.files) {
+            size += file.size;
+        }
+        CHECK(found->size == size);
+    }
+    CHECK(!directory.Parse(image.data(), image.size() - 1));
+
+    CHECK(system(("rm -rf " + std::string(dir)).c_str()) == 0);
+    printf("script image: %zu models, %zu bytes of model data\n", kModels.size(), total);
+}
+
+int main(int argc, char** argv) {
+    TestParse();
+    TestTruncated();
+    TestOversizedOffsets();
+    TestOversizedCounts();
+    if (argc == 3) {
+        TestScriptImage(argv[1], argv[2]);
+    }
+    printf("srmodel_directory_test passed\n");
+    return 0;
+}
@@ -0,0 +1,189 @@
+// 字符串工具：SSO/竞技场/rope 与数字格式化（与 printf 结果逐一比对）
+#include "string_utils.h"
+#include "host_test.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+static void expect_float(double value, int decimals, const char* expected) {
+    string_t s;
+    string_init(&s);
+    CHECK(string_append_float(&s, value, decimals) == 0);
+    if (strcmp(string_cstr(&s), expected) != 0) {
+        fprintf(stderr, "%.17g with %d decimals: got \"%s\", expected \"%s\"\n",
+                value, decimals, string_cstr(&s), expected);
+        exit(1);
+    }
+    string_deinit(&s);
+
+    string_rope_t rope;
+    string_rope_init(&rope, NULL);
+    CHECK(string_rope_append_float(&rope, value, decimals) == 0);
+    string_t flat;
+    string_init(&flat);
+    CHECK(string_rope_flatten(&rope, &flat) == 0);
+    CHECK(strcmp(string_cstr(&flat), expected) == 0);
+    string_deinit(&flat);
+    string_rope_deinit(&rope);
+}
+
+static void expect_printf_float(double value, int decimals) {
+    char expected[400];
+    int clamped = decimals < 0 ? 0 : (decimals > 9 ? 9 : decimals);
+    snprintf(expected, sizeof(expected), "%.*f", clamped, value);
+    expect_float(value, decimals, expected);
+}
+
+static void test_float_special_values(void) {
+    expect_float(NAN, 2, "nan");
+    expect_float(INFINITY, 2, "inf");
+    expect_float(-INFINITY, 0, "-inf");
+
+    // 超出定点范围，结果长于内部缓冲区
+    expect_printf_float(1e300, 2);
+    expect_printf_float(-1e300, 9);
+    expect_printf_float(DBL_MAX, 9);
+    expect_printf_float(-DBL_MAX, 0);
+    expect_printf_float(4503599627370496.0, 0);
+    expect_printf_float(4503599627370495.5, 1);
+}
+
+static void test_float_rounding(void) {
+    // 与 printf 一样按精确值舍入，恰为 .5 时取偶
+    expect_float(0.5, 0, "0");
+    expect_float(1.5, 0, "2");
+    expect_float(2.5, 0, "2");
+    expect_float(-2.5, 0, "-2");
+    expect_float(0.125, 2, "0.12");
+    expect_float(0.375, 2, "0.38");
+    expect_float(1.005, 2, "1.00");     // 1.005 的二进制值略小于 1.005
+    expect_float(-0.0001, 2, "-0.00");
+    expect_float(-3.14159, 3, "-3.142");
+    expect_float(12.0, -1, "12");
+    expect_float(1.0 / 3.0, 20, "0.333333333");
+
+    for (int i = -2000; i <= 2000; i++) {
+        for (int decimals = 0; decimals <= 3; decimals++) {
+            expect_printf_float(i / 8.0, decimals);
+            expect_printf_float(i / 1000.0, decimals);
+        }
+    }
+
+    // 固定种子的伪随机值覆盖各个数量级
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for (int i = 0; i < 200000; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        double mantissa = (double)(state >> 11) / 9007199254740992.0;
+        int exponent = (int)(state % 40) - 20;
+        double value = ldexp(mantissa, exponent * 2) * ((state & 1) ? -1 : 1);
+        expect_printf_float(value, (int)(state >> 59) % 10);
+    }
+}
+
+static void test_integers(void) {
+    string_t s;
+    string_init(&s);
+    CHECK(string_append_int(&s, INT64_MIN) == 0);
+    CHECK(string_append_char(&s, ' ') == 0);
+    CHECK(string_append_uint(&s, UINT64_MAX) == 0);
+    CHECK(string_append_char(&s, ' ') == 0);
+    CHECK(string_append_int(&s, 0) == 0);
+    CHECK(strcmp(string_cstr(&s), "-9223372036854775808 18446744073709551615 0") == 0);
+    string_deinit(&s);
+}
+
+static void test_sso_and_growth(void) {
+    string_t s;
+    string_init(&s);
+    CHECK(string_append(&s, "short") == 0);
+    CHECK(s.data == s.sso);
+    for (int i = 0; i < 100; i++) {
+        CHECK(string_append_printf(&s, "[%d]", i) > 0);
+    }
+    CHECK(s.data != s.sso);
+    CHECK(strlen(string_cstr(&s)) == string_len(&s));
+    CHECK(strncmp(string_cstr(&s), "short[0][1]", 11) == 0);
+    string_deinit(&s);
+
+    string_t* json = string_create();
+    CHECK(json != NULL);
+    CHECK(string_append_json_string(json, "a\"b\\c\nd\x01") == 0);
+    CHECK(strcmp(string_cstr(json), "\"a\\\"b\\\\c\\nd\\u0001\"") == 0);
+    string_destroy(json);
+}
+
+static void test_arena(void) {
+    string_arena_t* arena = string_arena_create(256);
+    CHECK(arena != NULL);
+
+    string_t s;
+    string_init_arena(&s, arena);
+    for (int i = 0; i < 50; i++) {
+        CHECK(string_append(&s, "abcdefgh") == 0);
+    }
+    // 竞技场放不下后转为堆内存，内容保持不变
+    CHECK(string_len(&s) == 400);
+    CHECK(s.arena == NULL);
+    string_deinit(&s);
+
+    string_arena_reset(arena);
+    CHECK(string_arena_used(arena) == 0);
+    string_arena_destroy(arena);
+}
+
+static int count_visit(const char* data, size_t len, void* user_data) {
+    *(size_t*)user_data += len;
+    return 0;
+}
+
+static void test_rope(void) {
+    string_arena_t* arena = string_arena_create(1024);
+    CHECK(arena != NULL);
+
+    string_rope_t rope;
+    string_rope_init(&rope, arena);
+    string_t expected;
+    string_init(&expected);
+    for (int i = 0; i < 200; i++) {
+        CHECK(string_rope_append_json_string(&rope, "你好\n") == 0);
+        CHECK(string_rope_append_printf(&rope, ",%d,", i) > 0);
+        CHECK(string_rope_append_int(&rope, i) == 0);
+        CHECK(string_rope_append_float(&rope, 1e300, 1) == 0);
+        CHECK(string_append_json_string(&expected, "你好\n") == 0);
+        CHECK(string_append_printf(&expected, ",%d,%d%.1f", i, i, 1e300) > 0);
+    }
+    CHECK(rope.segment_count > 1);
+    CHECK(string_rope_len(&rope) == string_len(&expected));
+
+    size_t visited = 0;
+    CHECK(string_rope_foreach(&rope, count_visit, &visited) == 0);
+    CHECK(visited == string_len(&expected));
+
+    string_t flat;
+    string_init(&flat);
+    CHECK(string_rope_flatten(&rope, &flat) == 0);
+    CHECK(strcmp(string_cstr(&flat), string_cstr(&expected)) == 0);
+
+    char prefix[16];
+    CHECK(string_rope_copy_to(&rope, prefix, sizeof(prefix)) == sizeof(prefix) - 1);
+    CHECK(strncmp(prefix, string_cstr(&expected), sizeof(prefix) - 1) == 0);
+
+    string_deinit(&flat);
+    string_deinit(&expected);
+    string_rope_deinit(&rope);
+    string_arena_destroy(arena);
+}
+
+int main(void) {
+    test_float_special_values();
+    test_float_rounding();
+    test_integers();
+    test_sso_and_growth();
+    test_arena();
+    test_rope();
+    printf("string_utils_test passed\n");
+    return 0;
+}
@@ -0,0 +1,28 @@
+// Host stand-in for Board: only the network, which tests point at their fake HTTP server.
+#pragma once
+
+#include <memory>
+
+#include "http.h"
+
+class NetworkInterface {
+public:
+    virtual ~NetworkInterface() = default;
+    virtual std::unique_ptr<Http> CreateHttp(int connect_id = -1) = 0;
+};
+
+class Board {
+public:
+    static Board& GetInstance() {
+        static Board instance;
+        return instance;
+    }
+
+    NetworkInterface* GetNetwork() { return network_; }
+
+    // Host only
+    void SetNetwork(NetworkInterface* network) { network_ = network; }
+
+private:
+    NetworkInterface* network_ = nullptr;
+};
@@ -0,0 +1,21 @@
+// Host stand-in for cJSON: only building objects and arrays and printing them (cjson_host.cc).
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cJSON cJSON;
+
+cJSON* cJSON_CreateArray(void);
+cJSON* cJSON_CreateObject(void);
+cJSON* cJSON_AddStringToObject(cJSON* object, const char* name, const char* string);
+cJSON* cJSON_AddNumberToObject(cJSON* object, const char* name, double number);
+int cJSON_AddItemToArray(cJSON* array, cJSON* item);
+char* cJSON_PrintUnformatted(const cJSON* item);
+void cJSON_free(void* object);
+void cJSON_Delete(cJSON* item);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,28 @@
+// Host stand-in for the cbin font component. Fonts are generated instead of loaded (cbin_font_host.cc):
+// every glyph gets a made-up 4 bpp bitmap, stored compressed like LVGL's font format so that drawing a
+// glyph costs a decompression. There are no C binary images on the host.
+#pragma once
+
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Host only: what cbin_font_create() reads from `data` instead of a font file
+typedef struct {
+    uint16_t size;  // Line height in pixels, CJK glyphs are size x size
+} cbin_host_font_spec_t;
+
+lv_font_t* cbin_font_create(uint8_t* data);
+void cbin_font_delete(lv_font_t* font);
+
+// Host only: glyph bitmaps the font has decompressed since it was created
+uint32_t cbin_host_font_rasterized(const lv_font_t* font);
+
+static inline lv_img_dsc_t* cbin_img_dsc_create(uint8_t* data) { return NULL; }
+static inline void cbin_img_dsc_delete(lv_img_dsc_t* image_dsc) {}
+
+#ifdef __cplusplus
+}
+#endif
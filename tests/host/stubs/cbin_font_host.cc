@@ -0,0 +1,156 @@
+// Host cbin fonts. A glyph is generated the first time its descriptor is asked for and kept compressed:
+// rows XORed with the row above, then runs of 4 bpp values. Drawing decompresses it bit by bit and expands
+// it to A8, the work lv_font_fmt_txt does for a compressed font.
+#include "cbin_font.h"
+
+#include <string.h>
+
+#include <unordered_map>
+#include <vector>
+
+struct Glyph {
+    uint16_t width;
+    uint16_t height;
+    std::vector<uint8_t> bits;  // Pairs of 4 bit value and 4 bit run length - 1, high nibble first
+};
+
+struct HostFont {
+    lv_font_t font;
+    int size;
+    std::unordered_map<uint32_t, uint32_t> indexes;
+    std::vector<Glyph> glyphs;
+    uint32_t rasterized = 0;
+};
+
+static uint32_t Hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7FEB352D;
+    x ^= x >> 15;
+    x *= 0x846CA68B;
+    return x ^ (x >> 16);
+}
+
+// A few strokes with soft edges, different for every letter
+static std::vector<uint8_t> Draw(uint32_t letter, int width, int height) {
+    std::vector<uint8_t> pixels((size_t)width * height, 0);
+    uint32_t seed = Hash(letter);
+    int strokes = 3 + seed % 4;
+    for (int s = 0; s < strokes; s++) {
+        seed = Hash(seed + s);
+        bool horizontal = seed & 1;
+        int length = horizontal ? width : height;
+        int across = horizontal ? height : width;
+        int at = 1 + (seed >> 1) % (across > 2 ? across - 2 : 1);
+        int from = (seed >> 8) % (length / 2 + 1);
+        int to = length - (seed >> 16) % (length / 3 + 1);
+        for (int i = from; i < to; i++) {
+            for (int d = -1; d <= 1; d++) {
+                int a = at + d;
+                if (a < 0 || a >= across) {
+                    continue;
+                }
+                uint8_t& p = horizontal ? pixels[(size_t)a * width + i] : pixels[(size_t)i * width + a];
+                uint8_t value = d == 0 ? 15 : 6;
+                p = p > value ? p : value;
+            }
+        }
+    }
+    return pixels;
+}
+
+static void Compress(Glyph* glyph, const std::vector<uint8_t>& pixels) {
+    std::vector<uint8_t> filtered(pixels.size());
+    for (size_t i = 0; i < pixels.size(); i++) {
+        filtered[i] = i < glyph->width ? pixels[i] : pixels[i] ^ pixels[i - glyph->width];
+    }
+    for (size_t i = 0; i < filtered.size();) {
+        size_t run = 1;
+        while (run < 16 && i + run < filtered.size() && filtered[i + run] == filtered[i]) {
+            run++;
+        }
+        glyph->bits.push_back((uint8_t)(filtered[i] << 4 | (run - 1)));
+        i += run;
+    }
+}
+
+static uint32_t ReadBits(const uint8_t* data, uint32_t* bit, int count) {
+    uint32_t value = 0;
+    for (int k = 0; k < count; k++, (*bit)++) {
+        value = (value << 1) | ((data[*bit >> 3] >> (7 - (*bit & 7))) & 1);
+    }
+    return value;
+}
+
+static bool GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* g_dsc, uint32_t letter, uint32_t letter_next) {
+    auto host = static_cast<HostFont*>(font->user_data);
+    if (letter < 0x20 || letter == 0x200B) {
+        return false;
+    }
+    auto it = host->indexes.find(letter);
+    if (it == host->indexes.end()) {
+        Glyph glyph;
+        bool wide = letter >= 0x2E80;
+        glyph.width = (uint16_t)(letter < 0x80 ? host->size / 2 : wide ? host->size : host->size * 3 / 5);
+        glyph.height = (uint16_t)(wide ? host->size : host->size * 3 / 4);
+        Compress(&glyph, Draw(letter, glyph.width, glyph.height));
+        it = host->indexes.emplace(letter, (uint32_t)host->glyphs.size()).first;
+        host->glyphs.push_back(std::move(glyph));
+    }
+    const Glyph& glyph = host->glyphs[it->second];
+    g_dsc->adv_w = glyph.width + 1;
+    g_dsc->box_w = letter == ' ' ? 0 : glyph.width;
+    g_dsc->box_h = letter == ' ' ? 0 : glyph.height;
+    g_dsc->gid.index = it->second;
+    return true;
+}
+
+static const void* GetGlyphBitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf) {
+    auto host = static_cast<HostFont*>(g_dsc->resolved_font->user_data);
+    const Glyph& glyph = host->glyphs[g_dsc->gid.index];
+    if (lv_draw_buf_reshape(draw_buf, LV_COLOR_FORMAT_A8, glyph.width, glyph.height, LV_STRIDE_AUTO) == nullptr) {
+        return nullptr;
+    }
+    host->rasterized++;
+
+    uint32_t bit = 0;
+    uint32_t stride = draw_buf->header.stride;
+    int x = 0, y = 0;
+    while (y < glyph.height) {
+        uint32_t value = ReadBits(glyph.bits.data(), &bit, 4);
+        uint32_t run = ReadBits(glyph.bits.data(), &bit, 4) + 1;
+        for (uint32_t k = 0; k < run; k++) {
+            uint8_t* p = draw_buf->data + (size_t)y * stride + x;
+            // Undo the row filter, then 4 bpp to 8 bpp
+            uint8_t above = y > 0 ? p[-(int)stride] / 17 : 0;
+            *p = (uint8_t)((value ^ above) * 17);
+            if (++x == glyph.width) {
+                x = 0;
+                y++;
+            }
+        }
+    }
+    return draw_buf;
+}
+
+extern "C" {
+
+lv_font_t* cbin_font_create(uint8_t* data) {
+    auto spec = reinterpret_cast<const cbin_host_font_spec_t*>(data);
+    auto host = new HostFont();
+    host->size = spec->size;
+    host->font.line_height = spec->size + spec->size / 4;
+    host->font.get_glyph_dsc = GetGlyphDsc;
+    host->font.get_glyph_bitmap = GetGlyphBitmap;
+    host->font.user_data = host;
+    return &host->font;
+}
+
+void cbin_font_delete(lv_font_t* font) {
+    delete static_cast<HostFont*>(font->user_data);
+}
+
+uint32_t cbin_host_font_rasterized(const lv_font_t* font) {
+    return static_cast<HostFont*>(font->user_data)->rasterized;
+}
+
+}  // extern "C"
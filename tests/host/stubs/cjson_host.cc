@@ -0,0 +1,130 @@
+// 主机版 cJSON：只支持生成对象和数组，输出格式与 cJSON_PrintUnformatted 相同
+#include "cJSON.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct cJSON {
+    enum Type { kArray, kObject, kString, kNumber } type;
+    std::string name;
+    std::string string;
+    double number = 0;
+    std::vector<std::unique_ptr<cJSON>> children;
+};
+
+static cJSON* AddChild(cJSON* parent, cJSON::Type type, const char* name) {
+    if (parent == nullptr) {
+        return nullptr;
+    }
+    parent->children.push_back(std::make_unique<cJSON>());
+    auto child = parent->children.back().get();
+    child->type = type;
+    child->name = name != nullptr ? name : "";
+    return child;
+}
+
+static void PrintString(const std::string& text, std::string& out) {
+    out += '"';
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+static void Print(const cJSON* item, std::string& out) {
+    switch (item->type) {
+    case cJSON::kString:
+        PrintString(item->string, out);
+        break;
+    case cJSON::kNumber: {
+        // 与 cJSON 一样，整数不带小数部分
+        char number[32];
+        if (item->number == std::floor(item->number) && std::fabs(item->number) < 1e15) {
+            snprintf(number, sizeof(number), "%.0f", item->number);
+        } else {
+            snprintf(number, sizeof(number), "%1.15g", item->number);
+        }
+        out += number;
+        break;
+    }
+    case cJSON::kArray:
+    case cJSON::kObject:
+        out += item->type == cJSON::kArray ? '[' : '{';
+        for (size_t i = 0; i < item->children.size(); i++) {
+            if (i > 0) {
+                out += ',';
+            }
+            if (item->type == cJSON::kObject) {
+                PrintString(item->children[i]->name, out);
+                out += ':';
+            }
+            Print(item->children[i].get(), out);
+        }
+        out += item->type == cJSON::kArray ? ']' : '}';
+        break;
+    }
+}
+
+cJSON* cJSON_CreateArray(void) {
+    auto item = new cJSON();
+    item->type = cJSON::kArray;
+    return item;
+}
+
+cJSON* cJSON_CreateObject(void) {
+    auto item = new cJSON();
+    item->type = cJSON::kObject;
+    return item;
+}
+
+cJSON* cJSON_AddStringToObject(cJSON* object, const char* name, const char* string) {
+    auto item = AddChild(object, cJSON::kString, name);
+    if (item != nullptr) {
+        item->string = string;
+    }
+    return item;
+}
+
+cJSON* cJSON_AddNumberToObject(cJSON* object, const char* name, double number) {
+    auto item = AddChild(object, cJSON::kNumber, name);
+    if (item != nullptr) {
+        item->number = number;
+    }
+    return item;
+}
+
+int cJSON_AddItemToArray(cJSON* array, cJSON* item) {
+    if (array == nullptr || item == nullptr) {
+        return 0;
+    }
+    array->children.emplace_back(item);
+    return 1;
+}
+
+char* cJSON_PrintUnformatted(const cJSON* item) {
+    std::string out;
+    Print(item, out);
+    return strdup(out.c_str());
+}
+
+void cJSON_free(void* object) {
+    free(object);
+}
+
+void cJSON_Delete(cJSON* item) {
+    delete item;
+}
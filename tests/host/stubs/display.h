@@ -0,0 +1,15 @@
+// Host stand-in for the Theme base class of display.h, the rest of Display is not needed by the tests.
+#pragma once
+
+#include <string>
+
+class Theme {
+public:
+    Theme(const std::string& name) : name_(name) {}
+    virtual ~Theme() = default;
+
+    inline std::string name() const { return name_; }
+
+private:
+    std::string name_;
+};
@@ -0,0 +1,4 @@
+// Host stand-in for esp_check.h: only the error codes, the hardware paths that use the macros are not built.
+#pragma once
+
+#include "esp_err.h"
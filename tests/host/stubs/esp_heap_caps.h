@@ -0,0 +1,15 @@
+// Host stand-in for the ESP-IDF capability allocator: every region is plain malloc.
+#pragma once
+
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_DMA      (1 << 3)
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+#define heap_caps_malloc(size, caps) malloc(size)
+#define heap_caps_calloc(n, size, caps) calloc(n, size)
+#define heap_caps_realloc(ptr, size, caps) realloc(ptr, size)
+#define heap_caps_free free
+#define heap_caps_get_free_size(caps) ((size_t)4 * 1024 * 1024)
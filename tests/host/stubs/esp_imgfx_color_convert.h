@@ -0,0 +1,57 @@
+// Host stand-in for the esp_imgfx color converter: RGB to YUYV with the full range BT.601 (JFIF)
+// matrix in plain C (esp_imgfx_host.cc).
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    ESP_IMGFX_ERR_OK = 0,
+    ESP_IMGFX_ERR_FAIL = -1,
+    ESP_IMGFX_ERR_MEM_LACK = -2,
+    ESP_IMGFX_ERR_INVALID_PARAMETER = -3,
+    ESP_IMGFX_ERR_NOT_SUPPORT = -4,
+} esp_imgfx_err_t;
+
+typedef enum {
+    ESP_IMGFX_PIXEL_FMT_RGB565_LE = 1,
+    ESP_IMGFX_PIXEL_FMT_RGB565_BE = 2,
+    ESP_IMGFX_PIXEL_FMT_RGB888 = 3,
+    ESP_IMGFX_PIXEL_FMT_YUYV = 4,
+} esp_imgfx_pixel_fmt_t;
+
+typedef enum {
+    ESP_IMGFX_COLOR_SPACE_STD_BT601 = 0,
+    ESP_IMGFX_COLOR_SPACE_STD_BT709 = 1,
+} esp_imgfx_color_space_std_t;
+
+typedef struct {
+    int16_t width;
+    int16_t height;
+} esp_imgfx_resolution_t;
+
+typedef struct {
+    esp_imgfx_resolution_t in_res;
+    esp_imgfx_pixel_fmt_t in_pixel_fmt;
+    esp_imgfx_pixel_fmt_t out_pixel_fmt;
+    esp_imgfx_color_space_std_t color_space_std;
+} esp_imgfx_color_convert_cfg_t;
+
+typedef struct {
+    uint8_t* data;
+    uint32_t data_len;
+} esp_imgfx_data_t;
+
+typedef void* esp_imgfx_color_convert_handle_t;
+
+esp_imgfx_err_t esp_imgfx_color_convert_open(esp_imgfx_color_convert_cfg_t* cfg, esp_imgfx_color_convert_handle_t* handle);
+esp_imgfx_err_t esp_imgfx_color_convert_process(esp_imgfx_color_convert_handle_t handle, esp_imgfx_data_t* in_image,
+                                                esp_imgfx_data_t* out_image);
+esp_imgfx_err_t esp_imgfx_color_convert_close(esp_imgfx_color_convert_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,71 @@
+// Host esp_imgfx color converter: RGB565 (either byte order) or RGB888 to YUYV, one pixel pair at a time.
+#include "esp_imgfx_color_convert.h"
+
+#include <stddef.h>
+
+struct Converter {
+    esp_imgfx_color_convert_cfg_t cfg;
+};
+
+static inline void Yuv(int r, int g, int b, int* y, int* u, int* v) {
+    *y = (77 * r + 150 * g + 29 * b) >> 8;
+    *u = ((-43 * r - 85 * g + 128 * b) >> 8) + 128;
+    *v = ((128 * r - 107 * g - 21 * b) >> 8) + 128;
+}
+
+static inline void Rgb(esp_imgfx_pixel_fmt_t format, const uint8_t* p, int* r, int* g, int* b) {
+    if (format == ESP_IMGFX_PIXEL_FMT_RGB888) {
+        *r = p[0];
+        *g = p[1];
+        *b = p[2];
+        return;
+    }
+    uint16_t c = format == ESP_IMGFX_PIXEL_FMT_RGB565_LE ? (p[0] | p[1] << 8) : (p[0] << 8 | p[1]);
+    *r = (c >> 11) << 3 | (c >> 13);
+    *g = ((c >> 5) & 0x3F) << 2 | ((c >> 9) & 0x03);
+    *b = (c & 0x1F) << 3 | ((c >> 2) & 0x07);
+}
+
+esp_imgfx_err_t esp_imgfx_color_convert_open(esp_imgfx_color_convert_cfg_t* cfg, esp_imgfx_color_convert_handle_t* handle) {
+    if (cfg == nullptr || handle == nullptr || cfg->in_res.width <= 0 || cfg->in_res.width % 2 != 0 ||
+        cfg->in_res.height <= 0) {
+        return ESP_IMGFX_ERR_INVALID_PARAMETER;
+    }
+    if (cfg->out_pixel_fmt != ESP_IMGFX_PIXEL_FMT_YUYV || cfg->in_pixel_fmt == ESP_IMGFX_PIXEL_FMT_YUYV) {
+        return ESP_IMGFX_ERR_NOT_SUPPORT;
+    }
+    *handle = new Converter{ *cfg };
+    return ESP_IMGFX_ERR_OK;
+}
+
+esp_imgfx_err_t esp_imgfx_color_convert_process(esp_imgfx_color_convert_handle_t handle, esp_imgfx_data_t* in_image,
+                                                esp_imgfx_data_t* out_image) {
+    auto converter = static_cast<Converter*>(handle);
+    const auto& cfg = converter->cfg;
+    size_t pixels = (size_t)cfg.in_res.width * cfg.in_res.height;
+    size_t in_bpp = cfg.in_pixel_fmt == ESP_IMGFX_PIXEL_FMT_RGB888 ? 3 : 2;
+    if (in_image->data_len < pixels * in_bpp || out_image->data_len < pixels * 2) {
+        return ESP_IMGFX_ERR_INVALID_PARAMETER;
+    }
+    const uint8_t* src = in_image->data;
+    uint8_t* dst = out_image->data;
+    for (size_t i = 0; i < pixels; i += 2) {
+        int r0, g0, b0, r1, g1, b1, y0, u0, v0, y1, u1, v1;
+        Rgb(cfg.in_pixel_fmt, src, &r0, &g0, &b0);
+        Rgb(cfg.in_pixel_fmt, src + in_bpp, &r1, &g1, &b1);
+        Yuv(r0, g0, b0, &y0, &u0, &v0);
+        Yuv(r1, g1, b1, &y1, &u1, &v1);
+        dst[0] = (uint8_t)y0;
+        dst[1] = (uint8_t)((u0 + u1 + 1) >> 1);
+        dst[2] = (uint8_t)y1;
+        dst[3] = (uint8_t)((v0 + v1 + 1) >> 1);
+        src += in_bpp * 2;
+        dst += 4;
+    }
+    return ESP_IMGFX_ERR_OK;
+}
+
+esp_imgfx_err_t esp_imgfx_color_convert_close(esp_imgfx_color_convert_handle_t handle) {
+    delete static_cast<Converter*>(handle);
+    return ESP_IMGFX_ERR_OK;
+}
@@ -0,0 +1,52 @@
+// Host stand-in for the esp_new_jpeg common definitions (esp_jpeg_host.cc).
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    JPEG_ERR_OK = 0,
+    JPEG_ERR_FAIL = -1,
+    JPEG_ERR_NO_MEM = -2,
+    JPEG_ERR_NO_MORE_DATA = -3,
+    JPEG_ERR_INVALID_PARAM = -4,
+    JPEG_ERR_BAD_DATA = -5,
+    JPEG_ERR_UNSUPPORT_FMT = -6,
+    JPEG_ERR_UNSUPPORT_STD = -7,
+} jpeg_error_t;
+
+typedef enum {
+    JPEG_PIXEL_FORMAT_GRAY = 0,
+    JPEG_PIXEL_FORMAT_RGB888 = 1,
+    JPEG_PIXEL_FORMAT_RGBA = 2,
+    JPEG_PIXEL_FORMAT_YCbYCr = 3,
+    JPEG_PIXEL_FORMAT_YCbY2YCrY2 = 4,
+    JPEG_PIXEL_FORMAT_RGB565_BE = 5,
+    JPEG_PIXEL_FORMAT_RGB565_LE = 6,
+    JPEG_PIXEL_FORMAT_CbYCrY = 7,
+} jpeg_pixel_format_t;
+
+typedef enum {
+    JPEG_SUBSAMPLE_GRAY = 0,
+    JPEG_SUBSAMPLE_444 = 1,
+    JPEG_SUBSAMPLE_422 = 2,
+    JPEG_SUBSAMPLE_420 = 3,
+} jpeg_subsampling_t;
+
+typedef enum {
+    JPEG_ROTATE_0D = 0,
+    JPEG_ROTATE_90D = 1,
+    JPEG_ROTATE_180D = 2,
+    JPEG_ROTATE_270D = 3,
+} jpeg_rotate_t;
+
+void* jpeg_calloc_align(size_t size, int aligned);
+void jpeg_free_align(void* data);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,61 @@
+// Host stand-in for the esp_new_jpeg decoder (esp_jpeg_dec_host.cc): baseline Huffman JPEG, gray or YCbCr
+// with 4:4:4, 4:2:2 or 4:2:0 sampling, RGB565 output and 1/2, 1/4, 1/8 IDCT scaling.
+#pragma once
+
+#include <stdbool.h>
+
+#include "esp_jpeg_common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void* jpeg_dec_handle_t;
+
+typedef struct {
+    int width;
+    int height;
+} jpeg_resolution_t;
+
+typedef struct {
+    jpeg_pixel_format_t output_type;
+    jpeg_resolution_t scale;    // 0 x 0 for full size, otherwise 1/2, 1/4 or 1/8 of it in multiples of 8
+    jpeg_resolution_t clipper;
+    jpeg_rotate_t rotate;
+    bool block_enable;
+} jpeg_dec_config_t;
+
+#define DEFAULT_JPEG_DEC_CONFIG() {                 \
+    .output_type = JPEG_PIXEL_FORMAT_RGB565_LE,     \
+    .scale = {.width = 0, .height = 0},             \
+    .clipper = {.width = 0, .height = 0},           \
+    .rotate = JPEG_ROTATE_0D,                       \
+    .block_enable = false,                          \
+}
+
+typedef struct {
+    int width;
+    int height;
+    uint8_t component_num;
+} jpeg_dec_header_info_t;
+
+typedef struct {
+    uint8_t* inbuf;
+    int inbuf_len;
+    int inbuf_remain;
+    uint8_t* outbuf;
+    int out_size;
+} jpeg_dec_io_t;
+
+jpeg_error_t jpeg_dec_open(jpeg_dec_config_t* config, jpeg_dec_handle_t* jpeg_dec);
+
+jpeg_error_t jpeg_dec_parse_header(jpeg_dec_handle_t jpeg_dec, jpeg_dec_io_t* io, jpeg_dec_header_info_t* out_info);
+
+// Decodes the whole image into io->outbuf, which holds the (scaled) width x height in RGB565
+jpeg_error_t jpeg_dec_process(jpeg_dec_handle_t jpeg_dec, jpeg_dec_io_t* io);
+
+jpeg_error_t jpeg_dec_close(jpeg_dec_handle_t jpeg_dec);
+
+#ifdef __cplusplus
+}
+#endif
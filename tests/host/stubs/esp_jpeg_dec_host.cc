@@ -0,0 +1,473 @@
+// Host esp_new_jpeg decoder: baseline Huffman JPEG to RGB565 with reduced-size IDCT, so scaled decoding
+// costs less than full-size decoding the way it does with the real library. Chroma is upsampled by
+// repeating samples.
+#include "esp_jpeg_dec.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+static const uint8_t kZigzag[64] = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,  12, 19, 26, 33, 40, 48,
+    41, 34, 27, 20, 13, 6,  7,  14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23,
+    30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+struct Huffman {
+    bool defined = false;
+    int32_t max_code[18];
+    int32_t value_offset[17];
+    uint8_t values[256];
+};
+
+struct Component {
+    int id;
+    int h;
+    int v;
+    int quant;
+    int dc_table;
+    int ac_table;
+    int dc_pred;
+    std::vector<uint8_t> plane;   // Samples at the output scale, whole MCUs
+    int plane_width;
+};
+
+struct Decoder {
+    jpeg_dec_config_t cfg;
+    bool parsed = false;
+    int width = 0;
+    int height = 0;
+    int restart_interval = 0;
+    uint16_t quant[4][64];        // Natural order
+    bool quant_defined[4] = {};
+    Huffman dc[4];
+    Huffman ac[4];
+    std::vector<Component> components;
+    const uint8_t* scan = nullptr;
+    const uint8_t* end = nullptr;
+};
+
+static void BuildHuffman(Huffman* table, const uint8_t counts[16], const uint8_t* values, int total) {
+    memcpy(table->values, values, total);
+    int32_t code = 0;
+    int k = 0;
+    for (int length = 1; length <= 16; length++) {
+        table->value_offset[length] = k - code;
+        code += counts[length - 1];
+        k += counts[length - 1];
+        table->max_code[length] = counts[length - 1] ? code - 1 : -1;
+        code <<= 1;
+    }
+    table->max_code[17] = INT32_MAX;
+    table->defined = true;
+}
+
+static int Read16(const uint8_t* p) {
+    return (p[0] << 8) | p[1];
+}
+
+// Reads the markers up to the start of the entropy coded data
+static jpeg_error_t ParseHeader(Decoder* dec, const uint8_t* data, int len) {
+    const uint8_t* p = data;
+    const uint8_t* end = data + len;
+    if (len < 4 || p[0] != 0xFF || p[1] != 0xD8) {
+        return JPEG_ERR_BAD_DATA;
+    }
+    p += 2;
+    dec->components.clear();
+    while (p + 4 <= end) {
+        if (p[0] != 0xFF) {
+            return JPEG_ERR_BAD_DATA;
+        }
+        uint8_t marker = p[1];
+        if (marker == 0xFF) {
+            p++;
+            continue;
+        }
+        int length = Read16(p + 2);
+        const uint8_t* segment = p + 4;
+        const uint8_t* next = p + 2 + length;
+        if (length < 2 || next > end) {
+            return JPEG_ERR_BAD_DATA;
+        }
+        switch (marker) {
+            case 0xDB:  // DQT
+                for (const uint8_t* q = segment; q < next;) {
+                    int precision = q[0] >> 4, id = q[0] & 3;
+                    int size = precision ? 129 : 65;
+                    if (q + size > next) {
+                        return JPEG_ERR_BAD_DATA;
+                    }
+                    for (int i = 0; i < 64; i++) {
+                        dec->quant[id][kZigzag[i]] = precision ? Read16(q + 1 + 2 * i) : q[1 + i];
+                    }
+                    dec->quant_defined[id] = true;
+                    q += size;
+                }
+                break;
+            case 0xC4:  // DHT
+                for (const uint8_t* q = segment; q < next;) {
+                    if (q + 17 > next) {
+                        return JPEG_ERR_BAD_DATA;
+                    }
+                    int total = 0;
+                    for (int i = 0; i < 16; i++) {
+                        total += q[1 + i];
+                    }
+                    if (total > 256 || q + 17 + total > next) {
+                        return JPEG_ERR_BAD_DATA;
+                    }
+                    Huffman* table = (q[0] >> 4) ? &dec->ac[q[0] & 3] : &dec->dc[q[0] & 3];
+                    BuildHuffman(table, q + 1, q + 17, total);
+                    q += 17 + total;
+                }
+                break;
+            case 0xC0:  // SOF0 and SOF1, baseline and extended Huffman
+            case 0xC1: {
+                if (length < 8 || segment[0] != 8) {
+                    return JPEG_ERR_UNSUPPORT_FMT;
+                }
+                dec->height = Read16(segment + 1);
+                dec->width = Read16(segment + 3);
+                int count = segment[5];
+                if ((count != 1 && count != 3) || length < 8 + 3 * count || dec->width == 0 || dec->height == 0) {
+                    return JPEG_ERR_UNSUPPORT_FMT;
+                }
+                for (int i = 0; i < count; i++) {
+                    const uint8_t* c = segment + 6 + 3 * i;
+                    Component component = {};
+                    component.id = c[0];
+                    component.h = c[1] >> 4;
+                    component.v = c[1] & 15;
+                    component.quant = c[2] & 3;
+                    dec->components.push_back(component);
+                }
+                // Luma 1x1, 2x1 or 2x2, chroma 1x1
+                auto& luma = dec->components[0];
+                if (luma.h < 1 || luma.h > 2 || luma.v < 1 || luma.v > luma.h) {
+                    return JPEG_ERR_UNSUPPORT_FMT;
+                }
+                for (size_t i = 1; i < dec->components.size(); i++) {
+                    if (dec->components[i].h != 1 || dec->components[i].v != 1) {
+                        return JPEG_ERR_UNSUPPORT_FMT;
+                    }
+                }
+                if (count == 1) {
+                    luma.h = luma.v = 1;
+                }
+                break;
+            }
+            case 0xC2:
+            case 0xC3:
+            case 0xC9:
+            case 0xCA:
+                return JPEG_ERR_UNSUPPORT_STD;
+            case 0xDD:  // DRI
+                dec->restart_interval = Read16(segment);
+                break;
+            case 0xDA: {  // SOS
+                int count = segment[0];
+                if (dec->components.empty() || count != (int)dec->components.size() || length < 6 + 2 * count) {
+                    return JPEG_ERR_UNSUPPORT_FMT;
+                }
+                for (int i = 0; i < count; i++) {
+                    auto& component = dec->components[i];
+                    if (segment[1 + 2 * i] != component.id) {
+                        return JPEG_ERR_BAD_DATA;
+                    }
+                    component.dc_table = segment[2 + 2 * i] >> 4 & 3;
+                    component.ac_table = segment[2 + 2 * i] & 3;
+                    if (!dec->dc[component.dc_table].defined || !dec->ac[component.ac_table].defined ||
+                        !dec->quant_defined[component.quant]) {
+                        return JPEG_ERR_BAD_DATA;
+                    }
+                }
+                dec->scan = next;
+                dec->end = end;
+                dec->parsed = true;
+                return JPEG_ERR_OK;
+            }
+            default:
+                break;
+        }
+        p = next;
+    }
+    return JPEG_ERR_BAD_DATA;
+}
+
+struct BitReader {
+    const uint8_t* p;
+    const uint8_t* end;
+    uint32_t buffer = 0;
+    int count = 0;
+    bool marker = false;    // Hit a marker, the rest reads as zeros
+
+    int Bit() {
+        if (count == 0) {
+            uint8_t byte = 0;
+            if (!marker && p < end) {
+                byte = *p;
+                if (byte == 0xFF) {
+                    if (p + 1 < end && p[1] == 0x00) {
+                        p += 2;
+                    } else {
+                        marker = true;
+                        byte = 0;
+                    }
+                } else {
+                    p++;
+                }
+            }
+            buffer = byte;
+            count = 8;
+        }
+        count--;
+        return (buffer >> count) & 1;
+    }
+
+    int Bits(int n) {
+        int value = 0;
+        for (int i = 0; i < n; i++) {
+            value = (value << 1) | Bit();
+        }
+        return value;
+    }
+
+    // Skips to the next restart marker
+    bool Restart() {
+        count = 0;
+        marker = false;
+        if (p + 1 < end && p[0] == 0xFF && p[1] >= 0xD0 && p[1] <= 0xD7) {
+            p += 2;
+            return true;
+        }
+        return false;
+    }
+};
+
+static int Decode(BitReader* bits, const Huffman& table) {
+    int32_t code = bits->Bit();
+    int length = 1;
+    while (code > table.max_code[length]) {
+        code = (code << 1) | bits->Bit();
+        if (++length > 16) {
+            return -1;
+        }
+    }
+    return table.values[code + table.value_offset[length]];
+}
+
+static int Extend(int value, int size) {
+    return value < (1 << (size - 1)) ? value - (1 << size) + 1 : value;
+}
+
+// IDCT of the lowest n x n coefficients to n x n samples, n is 1, 2, 4 or 8
+static void Idct(const float* coefficients, int n, uint8_t* out, int stride) {
+    static float basis[9][8][8];  // [n][sample][frequency]
+    static bool ready = false;
+    if (!ready) {
+        for (int size = 1; size <= 8; size *= 2) {
+            for (int i = 0; i < size; i++) {
+                for (int u = 0; u < size; u++) {
+                    float c = u == 0 ? (float)M_SQRT1_2 : 1.0f;
+                    basis[size][i][u] = 0.5f * c * cosf((2 * i + 1) * u * (float)M_PI / (2 * size));
+                }
+            }
+        }
+        ready = true;
+    }
+    float rows[8][8];
+    for (int v = 0; v < n; v++) {
+        for (int i = 0; i < n; i++) {
+            float sum = 0;
+            for (int u = 0; u < n; u++) {
+                sum += basis[n][i][u] * coefficients[v * 8 + u];
+            }
+            rows[v][i] = sum;
+        }
+    }
+    for (int j = 0; j < n; j++) {
+        for (int i = 0; i < n; i++) {
+            float sum = 0;
+            for (int v = 0; v < n; v++) {
+                sum += basis[n][j][v] * rows[v][i];
+            }
+            int sample = (int)lrintf(sum + 128.0f);
+            out[j * stride + i] = (uint8_t)std::min(255, std::max(0, sample));
+        }
+    }
+}
+
+static jpeg_error_t DecodeScan(Decoder* dec, int n) {
+    const int hmax = dec->components[0].h;
+    const int vmax = dec->components[0].v;
+    const int mcus_x = (dec->width + 8 * hmax - 1) / (8 * hmax);
+    const int mcus_y = (dec->height + 8 * vmax - 1) / (8 * vmax);
+    for (auto& component : dec->components) {
+        component.plane_width = mcus_x * component.h * n;
+        component.plane.assign((size_t)component.plane_width * mcus_y * component.v * n, 0);
+        component.dc_pred = 0;
+    }
+
+    BitReader bits = { dec->scan, dec->end };
+    int until_restart = dec->restart_interval;
+    float coefficients[64];
+    for (int my = 0; my < mcus_y; my++) {
+        for (int mx = 0; mx < mcus_x; mx++) {
+            if (dec->restart_interval != 0) {
+                if (until_restart == 0) {
+                    if (!bits.Restart()) {
+                        return JPEG_ERR_BAD_DATA;
+                    }
+                    for (auto& component : dec->components) {
+                        component.dc_pred = 0;
+                    }
+                    until_restart = dec->restart_interval;
+                }
+                until_restart--;
+            }
+            for (auto& component : dec->components) {
+                const uint16_t* quant = dec->quant[component.quant];
+                for (int by = 0; by < component.v; by++) {
+                    for (int bx = 0; bx < component.h; bx++) {
+                        std::fill(coefficients, coefficients + 64, 0.0f);
+                        int size = Decode(&bits, dec->dc[component.dc_table]);
+                        if (size < 0 || size > 11) {
+                            return JPEG_ERR_BAD_DATA;
+                        }
+                        component.dc_pred += size ? Extend(bits.Bits(size), size) : 0;
+                        coefficients[0] = (float)(component.dc_pred * quant[0]);
+                        for (int k = 1; k < 64;) {
+                            int symbol = Decode(&bits, dec->ac[component.ac_table]);
+                            if (symbol < 0) {
+                                return JPEG_ERR_BAD_DATA;
+                            }
+                            int run = symbol >> 4;
+                            size = symbol & 15;
+                            if (size == 0) {
+                                if (run != 15) {
+                                    break;  // End of block
+                                }
+                                k += 16;
+                                continue;
+                            }
+                            k += run;
+                            if (k > 63) {
+                                return JPEG_ERR_BAD_DATA;
+                            }
+                            coefficients[kZigzag[k]] = (float)(Extend(bits.Bits(size), size) * quant[kZigzag[k]]);
+                            k++;
+                        }
+                        int x = (mx * component.h + bx) * n;
+                        int y = (my * component.v + by) * n;
+                        Idct(coefficients, n, component.plane.data() + (size_t)y * component.plane_width + x,
+                             component.plane_width);
+                    }
+                }
+            }
+        }
+    }
+    return JPEG_ERR_OK;
+}
+
+extern "C" {
+
+jpeg_error_t jpeg_dec_open(jpeg_dec_config_t* config, jpeg_dec_handle_t* jpeg_dec) {
+    if (config == nullptr || jpeg_dec == nullptr) {
+        return JPEG_ERR_INVALID_PARAM;
+    }
+    if ((config->output_type != JPEG_PIXEL_FORMAT_RGB565_LE && config->output_type != JPEG_PIXEL_FORMAT_RGB565_BE) ||
+        config->rotate != JPEG_ROTATE_0D || config->clipper.width != 0 || config->clipper.height != 0) {
+        return JPEG_ERR_UNSUPPORT_FMT;
+    }
+    auto dec = new Decoder();
+    dec->cfg = *config;
+    *jpeg_dec = dec;
+    return JPEG_ERR_OK;
+}
+
+jpeg_error_t jpeg_dec_parse_header(jpeg_dec_handle_t jpeg_dec, jpeg_dec_io_t* io, jpeg_dec_header_info_t* out_info) {
+    auto dec = static_cast<Decoder*>(jpeg_dec);
+    if (dec == nullptr || io == nullptr || io->inbuf == nullptr || out_info == nullptr) {
+        return JPEG_ERR_INVALID_PARAM;
+    }
+    jpeg_error_t ret = ParseHeader(dec, io->inbuf, io->inbuf_len);
+    if (ret != JPEG_ERR_OK) {
+        return ret;
+    }
+    out_info->width = dec->width;
+    out_info->height = dec->height;
+    out_info->component_num = (uint8_t)dec->components.size();
+    io->inbuf_remain = (int)(dec->end - dec->scan);
+    return JPEG_ERR_OK;
+}
+
+jpeg_error_t jpeg_dec_process(jpeg_dec_handle_t jpeg_dec, jpeg_dec_io_t* io) {
+    auto dec = static_cast<Decoder*>(jpeg_dec);
+    if (dec == nullptr || io == nullptr || io->outbuf == nullptr || !dec->parsed) {
+        return JPEG_ERR_INVALID_PARAM;
+    }
+
+    // Like the real decoder: an exact 1/2, 1/4 or 1/8 of the size, in multiples of 8
+    int n = 8;
+    int out_width = dec->width;
+    int out_height = dec->height;
+    if (dec->cfg.scale.width != 0 || dec->cfg.scale.height != 0) {
+        out_width = dec->cfg.scale.width;
+        out_height = dec->cfg.scale.height;
+        int shift = 1;
+        while (shift <= 3 && (dec->width >> shift) != out_width) {
+            shift++;
+        }
+        if (shift > 3 || (dec->height >> shift) != out_height || out_width % 8 != 0 || out_height % 8 != 0) {
+            return JPEG_ERR_INVALID_PARAM;
+        }
+        n = 8 >> shift;
+    }
+
+    jpeg_error_t ret = DecodeScan(dec, n);
+    if (ret != JPEG_ERR_OK) {
+        return ret;
+    }
+
+    const int hmax = dec->components[0].h;
+    const int vmax = dec->components[0].v;
+    const bool big_endian = dec->cfg.output_type == JPEG_PIXEL_FORMAT_RGB565_BE;
+    uint8_t* out = io->outbuf;
+    for (int y = 0; y < out_height; y++) {
+        const Component& luma = dec->components[0];
+        const uint8_t* luma_row = luma.plane.data() + (size_t)y * luma.plane_width;
+        for (int x = 0; x < out_width; x++) {
+            int r, g, b;
+            int l = luma_row[x];
+            if (dec->components.size() == 1) {
+                r = g = b = l;
+            } else {
+                size_t chroma = (size_t)(y / vmax) * dec->components[1].plane_width + x / hmax;
+                float cb = dec->components[1].plane[chroma] - 128.0f;
+                float cr = dec->components[2].plane[chroma] - 128.0f;
+                r = (int)lrintf(l + 1.402f * cr);
+                g = (int)lrintf(l - 0.344136f * cb - 0.714136f * cr);
+                b = (int)lrintf(l + 1.772f * cb);
+            }
+            r = std::min(255, std::max(0, r));
+            g = std::min(255, std::max(0, g));
+            b = std::min(255, std::max(0, b));
+            uint16_t pixel = (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+            out[0] = big_endian ? pixel >> 8 : pixel & 0xFF;
+            out[1] = big_endian ? pixel & 0xFF : pixel >> 8;
+            out += 2;
+        }
+    }
+    io->out_size = out_width * out_height * 2;
+    return JPEG_ERR_OK;
+}
+
+jpeg_error_t jpeg_dec_close(jpeg_dec_handle_t jpeg_dec) {
+    delete static_cast<Decoder*>(jpeg_dec);
+    return JPEG_ERR_OK;
+}
+
+}  // extern "C"
@@ -0,0 +1,56 @@
+// Host stand-in for the esp_new_jpeg encoder: a baseline encoder with the same block interface
+// (esp_jpeg_host.cc). Input is GRAY or YCbYCr, output is 4:2:0 or grayscale with the standard tables.
+#pragma once
+
+#include <stdbool.h>
+
+#include "esp_jpeg_common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void* jpeg_enc_handle_t;
+
+typedef struct {
+    int width;
+    int height;
+    jpeg_pixel_format_t src_type;
+    jpeg_subsampling_t subsampling;
+    uint8_t quality;
+    jpeg_rotate_t rotate;
+    bool task_enable;
+    uint8_t hfm_task_priority;
+    uint8_t hfm_task_core;
+} jpeg_enc_config_t;
+
+#define DEFAULT_JPEG_ENC_CONFIG() {                 \
+    .width = 320,                                   \
+    .height = 240,                                  \
+    .src_type = JPEG_PIXEL_FORMAT_YCbYCr,           \
+    .subsampling = JPEG_SUBSAMPLE_420,              \
+    .quality = 40,                                  \
+    .rotate = JPEG_ROTATE_0D,                       \
+    .task_enable = false,                           \
+    .hfm_task_priority = 13,                        \
+    .hfm_task_core = 1,                             \
+}
+
+jpeg_error_t jpeg_enc_open(jpeg_enc_config_t* info, jpeg_enc_handle_t* jpeg_enc);
+
+// Bytes of input per call: 16 rows (8 for GRAY) of the full image width
+int jpeg_enc_get_block_size(jpeg_enc_handle_t jpeg_enc);
+
+// Encodes one block of rows, the headers come with the first block and the end of image with the last
+jpeg_error_t jpeg_enc_process_with_block(jpeg_enc_handle_t jpeg_enc, const uint8_t* in_buf, int inbuf_size,
+                                         uint8_t* outbuf, int outbuf_size, int* out_size);
+
+// Encodes a whole image in one call, rows past the bottom edge repeat the last row
+jpeg_error_t jpeg_enc_process(jpeg_enc_handle_t jpeg_enc, const uint8_t* in_buf, int inbuf_size, uint8_t* outbuf,
+                              int outbuf_size, int* out_size);
+
+jpeg_error_t jpeg_enc_close(jpeg_enc_handle_t jpeg_enc);
+
+#ifdef __cplusplus
+}
+#endif
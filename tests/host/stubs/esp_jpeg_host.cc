@@ -0,0 +1,375 @@
+// Host esp_new_jpeg encoder: baseline JPEG with the Annex K tables, an AAN float DCT and the block interface of
+// the real library, so the code that feeds it runs unchanged and costs what a DCT encoder costs.
+#include "esp_jpeg_enc.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+void* jpeg_calloc_align(size_t size, int aligned) {
+    size = (size + aligned - 1) / aligned * aligned;
+    void* ptr = aligned_alloc(aligned, size);
+    if (ptr != nullptr) {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+void jpeg_free_align(void* data) {
+    free(data);
+}
+
+static const uint8_t kZigzag[64] = {
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5, 12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+static const uint8_t kLumaQuant[64] = {
+    16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55, 14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+    18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92, 49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99,
+};
+
+static const uint8_t kChromaQuant[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99, 24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+static const uint8_t kDcLumaBits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t kDcChromaBits[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static const uint8_t kDcValues[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t kAcLumaBits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+static const uint8_t kAcLumaValues[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81,
+    0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18,
+    0x19, 0x1a, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75,
+    0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99,
+    0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5,
+    0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa,
+};
+
+static const uint8_t kAcChromaBits[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static const uint8_t kAcChromaValues[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08,
+    0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25,
+    0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47,
+    0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74,
+    0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97,
+    0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba,
+    0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe2, 0xe3, 0xe4,
+    0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa,
+};
+
+struct HuffmanTable {
+    uint16_t code[256];
+    uint8_t size[256];
+};
+
+static void BuildHuffman(HuffmanTable* table, const uint8_t bits[16], const uint8_t* values) {
+    uint16_t code = 0;
+    int k = 0;
+    for (int length = 1; length <= 16; length++) {
+        for (int i = 0; i < bits[length - 1]; i++) {
+            table->code[values[k]] = code++;
+            table->size[values[k]] = length;
+            k++;
+        }
+        code <<= 1;
+    }
+}
+
+struct Encoder {
+    jpeg_enc_config_t cfg;
+    bool gray;
+    int mcu_size;           // 8 for GRAY, 16 for 4:2:0
+    int next_row = 0;
+    uint8_t quant[2][64];   // Zigzag order, as written to DQT
+    float divisor[2][64];   // Natural order, with the AAN scale factors folded in
+    HuffmanTable dc[2];
+    HuffmanTable ac[2];
+    int last_dc[3] = { 0, 0, 0 };
+    uint32_t bit_buffer = 0;
+    int bit_count = 0;
+    std::vector<uint8_t> out;
+};
+
+static void PutBits(Encoder* enc, uint32_t bits, int count) {
+    enc->bit_buffer = (enc->bit_buffer << count) | (bits & ((1u << count) - 1));
+    enc->bit_count += count;
+    while (enc->bit_count >= 8) {
+        uint8_t byte = (uint8_t)(enc->bit_buffer >> (enc->bit_count - 8));
+        enc->out.push_back(byte);
+        if (byte == 0xFF) {
+            enc->out.push_back(0);
+        }
+        enc->bit_count -= 8;
+    }
+}
+
+static void PutMarker(Encoder* enc, uint8_t marker, const std::vector<uint8_t>& payload) {
+    enc->out.insert(enc->out.end(), { 0xFF, marker, (uint8_t)((payload.size() + 2) >> 8), (uint8_t)(payload.size() + 2) });
+    enc->out.insert(enc->out.end(), payload.begin(), payload.end());
+}
+
+static void WriteHeaders(Encoder* enc) {
+    enc->out.insert(enc->out.end(), { 0xFF, 0xD8 });
+    PutMarker(enc, 0xE0, { 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0 });
+
+    int tables = enc->gray ? 1 : 2;
+    for (int t = 0; t < tables; t++) {
+        std::vector<uint8_t> dqt = { (uint8_t)t };
+        dqt.insert(dqt.end(), enc->quant[t], enc->quant[t] + 64);
+        PutMarker(enc, 0xDB, dqt);
+    }
+
+    uint16_t w = enc->cfg.width, h = enc->cfg.height;
+    std::vector<uint8_t> sof = { 8, (uint8_t)(h >> 8), (uint8_t)h, (uint8_t)(w >> 8), (uint8_t)w };
+    if (enc->gray) {
+        sof.insert(sof.end(), { 1, 1, 0x11, 0 });
+    } else {
+        sof.insert(sof.end(), { 3, 1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1 });
+    }
+    PutMarker(enc, 0xC0, sof);
+
+    for (int t = 0; t < tables; t++) {
+        const uint8_t* dc_bits = t == 0 ? kDcLumaBits : kDcChromaBits;
+        const uint8_t* ac_bits = t == 0 ? kAcLumaBits : kAcChromaBits;
+        std::vector<uint8_t> dht = { (uint8_t)t };
+        dht.insert(dht.end(), dc_bits, dc_bits + 16);
+        dht.insert(dht.end(), kDcValues, kDcValues + 12);
+        PutMarker(enc, 0xC4, dht);
+        dht = { (uint8_t)(0x10 | t) };
+        dht.insert(dht.end(), ac_bits, ac_bits + 16);
+        const uint8_t* ac_values = t == 0 ? kAcLumaValues : kAcChromaValues;
+        dht.insert(dht.end(), ac_values, ac_values + 162);
+        PutMarker(enc, 0xC4, dht);
+    }
+
+    if (enc->gray) {
+        PutMarker(enc, 0xDA, { 1, 1, 0x00, 0, 63, 0 });
+    } else {
+        PutMarker(enc, 0xDA, { 3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0 });
+    }
+}
+
+// AAN forward DCT on 8 values `stride` apart, scaled by the factors folded into the divisors
+static void Fdct8(float* d, int stride) {
+    float t0 = d[0] + d[7 * stride], t7 = d[0] - d[7 * stride];
+    float t1 = d[stride] + d[6 * stride], t6 = d[stride] - d[6 * stride];
+    float t2 = d[2 * stride] + d[5 * stride], t5 = d[2 * stride] - d[5 * stride];
+    float t3 = d[3 * stride] + d[4 * stride], t4 = d[3 * stride] - d[4 * stride];
+
+    float t10 = t0 + t3, t13 = t0 - t3, t11 = t1 + t2, t12 = t1 - t2;
+    d[0] = t10 + t11;
+    d[4 * stride] = t10 - t11;
+    float z1 = (t12 + t13) * 0.707106781f;
+    d[2 * stride] = t13 + z1;
+    d[6 * stride] = t13 - z1;
+
+    t10 = t4 + t5;
+    t11 = t5 + t6;
+    t12 = t6 + t7;
+    float z5 = (t10 - t12) * 0.382683433f;
+    float z2 = 0.541196100f * t10 + z5;
+    float z4 = 1.306562965f * t12 + z5;
+    float z3 = t11 * 0.707106781f;
+    float z11 = t7 + z3, z13 = t7 - z3;
+    d[5 * stride] = z13 + z2;
+    d[3 * stride] = z13 - z2;
+    d[stride] = z11 + z4;
+    d[7 * stride] = z11 - z4;
+}
+
+static void EncodeBlock(Encoder* enc, float block[64], int component) {
+    int table = component == 0 ? 0 : 1;
+    for (int i = 0; i < 8; i++) {
+        Fdct8(block + i * 8, 1);
+    }
+    for (int i = 0; i < 8; i++) {
+        Fdct8(block + i, 8);
+    }
+
+    int coefficients[64];
+    for (int i = 0; i < 64; i++) {
+        coefficients[i] = (int)lrintf(block[kZigzag[i]] / enc->divisor[table][kZigzag[i]]);
+    }
+
+    auto put_value = [enc](const HuffmanTable& huffman, int value, int run) {
+        int magnitude = value < 0 ? -value : value;
+        int size = 0;
+        while (magnitude >> size) {
+            size++;
+        }
+        int symbol = (run << 4) | size;
+        PutBits(enc, huffman.code[symbol], huffman.size[symbol]);
+        if (size > 0) {
+            PutBits(enc, value < 0 ? value - 1 : value, size);
+        }
+    };
+
+    int diff = coefficients[0] - enc->last_dc[component];
+    enc->last_dc[component] = coefficients[0];
+    put_value(enc->dc[table], diff, 0);
+
+    int run = 0;
+    for (int i = 1; i < 64; i++) {
+        if (coefficients[i] == 0) {
+            run++;
+            continue;
+        }
+        while (run > 15) {
+            PutBits(enc, enc->ac[table].code[0xF0], enc->ac[table].size[0xF0]);
+            run -= 16;
+        }
+        put_value(enc->ac[table], coefficients[i], run);
+        run = 0;
+    }
+    if (run > 0) {
+        PutBits(enc, enc->ac[table].code[0x00], enc->ac[table].size[0x00]);
+    }
+}
+
+jpeg_error_t jpeg_enc_open(jpeg_enc_config_t* info, jpeg_enc_handle_t* jpeg_enc) {
+    if (info == nullptr || jpeg_enc == nullptr || info->width <= 0 || info->height <= 0 ||
+        info->width > 65535 || info->height > 65535) {
+        return JPEG_ERR_INVALID_PARAM;
+    }
+    bool gray = info->src_type == JPEG_PIXEL_FORMAT_GRAY;
+    if ((!gray && info->src_type != JPEG_PIXEL_FORMAT_YCbYCr) ||
+        (gray ? info->subsampling != JPEG_SUBSAMPLE_GRAY : info->subsampling != JPEG_SUBSAMPLE_420) ||
+        (!gray && info->width % 2 != 0) || info->rotate != JPEG_ROTATE_0D) {
+        return JPEG_ERR_UNSUPPORT_FMT;
+    }
+
+    auto enc = new Encoder();
+    enc->cfg = *info;
+    enc->gray = gray;
+    enc->mcu_size = gray ? 8 : 16;
+
+    // Quality scaling as in the IJG library
+    int quality = info->quality < 1 ? 1 : info->quality > 100 ? 100 : info->quality;
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    static const float kAan[8] = { 1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+                                   1.0f, 0.785694958f, 0.541196100f, 0.275899379f };
+    for (int t = 0; t < 2; t++) {
+        const uint8_t* base = t == 0 ? kLumaQuant : kChromaQuant;
+        for (int i = 0; i < 64; i++) {
+            int q = (base[kZigzag[i]] * scale + 50) / 100;
+            q = q < 1 ? 1 : q > 255 ? 255 : q;
+            enc->quant[t][i] = (uint8_t)q;
+            int natural = kZigzag[i];
+            enc->divisor[t][natural] = q * kAan[natural / 8] * kAan[natural % 8] * 8.0f;
+        }
+    }
+    BuildHuffman(&enc->dc[0], kDcLumaBits, kDcValues);
+    BuildHuffman(&enc->dc[1], kDcChromaBits, kDcValues);
+    BuildHuffman(&enc->ac[0], kAcLumaBits, kAcLumaValues);
+    BuildHuffman(&enc->ac[1], kAcChromaBits, kAcChromaValues);
+
+    WriteHeaders(enc);
+    *jpeg_enc = enc;
+    return JPEG_ERR_OK;
+}
+
+int jpeg_enc_get_block_size(jpeg_enc_handle_t jpeg_enc) {
+    auto enc = static_cast<Encoder*>(jpeg_enc);
+    return enc->cfg.width * enc->mcu_size * (enc->gray ? 1 : 2);
+}
+
+jpeg_error_t jpeg_enc_process_with_block(jpeg_enc_handle_t jpeg_enc, const uint8_t* in_buf, int inbuf_size,
+                                         uint8_t* outbuf, int outbuf_size, int* out_size) {
+    auto enc = static_cast<Encoder*>(jpeg_enc);
+    if (in_buf == nullptr || outbuf == nullptr || out_size == nullptr ||
+        inbuf_size != jpeg_enc_get_block_size(jpeg_enc) || enc->next_row >= enc->cfg.height) {
+        return JPEG_ERR_INVALID_PARAM;
+    }
+
+    const int width = enc->cfg.width;
+    const int mcu = enc->mcu_size;
+    // Pixels past the right edge repeat the last column
+    auto luma = [&](int x, int y) -> float {
+        x = x < width ? x : width - 1;
+        return enc->gray ? in_buf[y * width + x] : in_buf[(y * width + x) * 2];
+    };
+    // U and V are shared by a pixel pair, rows are averaged in pairs
+    auto chroma = [&](int x, int y, int offset) -> float {
+        int pair = (x < width / 2 ? x : width / 2 - 1) * 4;
+        const uint8_t* row0 = in_buf + (size_t)(2 * y) * width * 2;
+        const uint8_t* row1 = row0 + (size_t)width * 2;
+        return (row0[pair + offset] + row1[pair + offset]) * 0.5f;
+    };
+
+    float block[64];
+    for (int mx = 0; mx < width; mx += mcu) {
+        for (int by = 0; by < mcu; by += 8) {
+            for (int bx = 0; bx < mcu; bx += 8) {
+                for (int i = 0; i < 64; i++) {
+                    block[i] = luma(mx + bx + i % 8, by + i / 8) - 128.0f;
+                }
+                EncodeBlock(enc, block, 0);
+            }
+        }
+        if (!enc->gray) {
+            for (int component = 1; component <= 2; component++) {
+                for (int i = 0; i < 64; i++) {
+                    block[i] = chroma(mx / 2 + i % 8, i / 8, component == 1 ? 1 : 3) - 128.0f;
+                }
+                EncodeBlock(enc, block, component);
+            }
+        }
+    }
+
+    enc->next_row += mcu;
+    if (enc->next_row >= enc->cfg.height) {
+        // Pad the last byte with ones, then the end of image
+        if (enc->bit_count > 0) {
+            PutBits(enc, 0x7F, 8 - enc->bit_count);
+        }
+        enc->out.insert(enc->out.end(), { 0xFF, 0xD9 });
+    }
+
+    if ((int)enc->out.size() > outbuf_size) {
+        return JPEG_ERR_NO_MEM;
+    }
+    memcpy(outbuf, enc->out.data(), enc->out.size());
+    *out_size = (int)enc->out.size();
+    enc->out.clear();
+    return JPEG_ERR_OK;
+}
+
+jpeg_error_t jpeg_enc_process(jpeg_enc_handle_t jpeg_enc, const uint8_t* in_buf, int inbuf_size, uint8_t* outbuf,
+                              int outbuf_size, int* out_size) {
+    auto enc = static_cast<Encoder*>(jpeg_enc);
+    const size_t row_size = (size_t)enc->cfg.width * (enc->gray ? 1 : 2);
+    if (in_buf == nullptr || outbuf == nullptr || out_size == nullptr ||
+        inbuf_size < (int)(row_size * enc->cfg.height)) {
+        return JPEG_ERR_INVALID_PARAM;
+    }
+    std::vector<uint8_t> block(jpeg_enc_get_block_size(jpeg_enc));
+    int total = 0;
+    while (enc->next_row < enc->cfg.height) {
+        for (int r = 0; r < enc->mcu_size; r++) {
+            int y = std::min(enc->next_row + r, enc->cfg.height - 1);
+            memcpy(block.data() + r * row_size, in_buf + y * row_size, row_size);
+        }
+        int written = 0;
+        jpeg_error_t ret = jpeg_enc_process_with_block(jpeg_enc, block.data(), (int)block.size(), outbuf + total,
+                                                       outbuf_size - total, &written);
+        if (ret != JPEG_ERR_OK) {
+            return ret;
+        }
+        total += written;
+    }
+    *out_size = total;
+    return JPEG_ERR_OK;
+}
+
+jpeg_error_t jpeg_enc_close(jpeg_enc_handle_t jpeg_enc) {
+    delete static_cast<Encoder*>(jpeg_enc);
+    return JPEG_ERR_OK;
+}
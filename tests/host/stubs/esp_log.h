@@ -0,0 +1,13 @@
+// Host stand-in for ESP-IDF logging: warnings and errors go to stderr, the rest is dropped.
+#pragma once
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) do { if (0) fprintf(stderr, "%s" fmt, tag, ##__VA_ARGS__); } while (0)
+#define ESP_LOGD ESP_LOGI
+#define ESP_LOGV ESP_LOGI
+
+#define ESP_LOG_DEBUG 4
+#define ESP_LOG_BUFFER_HEXDUMP(tag, buffer, length, level) do { (void)(buffer); (void)(length); } while (0)
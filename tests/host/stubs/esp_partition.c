@@ -0,0 +1,56 @@
+// 主机版分区：按 NOR flash 的规则检查擦除对齐，写入只能把 1 变成 0
+#include "esp_partition.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#define SECTOR_SIZE 4096
+
+// 模拟 flash 耗时：每擦除一个扇区、每写入 1 KB 各睡多久
+static uint32_t erase_sector_us_ = 0;
+static uint32_t write_kb_us_ = 0;
+
+void esp_partition_host_set_timing(uint32_t erase_sector_us, uint32_t write_kb_us) {
+    erase_sector_us_ = erase_sector_us;
+    write_kb_us_ = write_kb_us;
+}
+
+uint32_t esp_partition_get_main_flash_sector_size(void) {
+    return SECTOR_SIZE;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size) {
+    if (src_offset > partition->size || size > partition->size - src_offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, partition->host_data + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dst_offset, const void* src, size_t size) {
+    if (dst_offset > partition->size || size > partition->size - dst_offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    const uint8_t* bytes = (const uint8_t*)src;
+    for (size_t i = 0; i < size; i++) {
+        partition->host_data[dst_offset + i] &= bytes[i];
+    }
+    if (write_kb_us_ > 0) {
+        usleep((useconds_t)((uint64_t)write_kb_us_ * size / 1024));
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+    if (offset % SECTOR_SIZE != 0 || size % SECTOR_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset > partition->size || size > partition->size - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memset(partition->host_data + offset, 0xFF, size);
+    if (erase_sector_us_ > 0) {
+        usleep((useconds_t)((uint64_t)erase_sector_us_ * (size / SECTOR_SIZE)));
+    }
+    return ESP_OK;
+}
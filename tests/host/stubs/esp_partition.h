@@ -0,0 +1,36 @@
+// Host stand-in for esp_partition: a partition is a RAM buffer that behaves like NOR flash, erasing
+// sets bytes to 0xFF and writing can only clear bits (esp_partition.c).
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    // unsigned long like uint32_t on the target, so the sources' printf formats match
+    unsigned long address;
+    unsigned long size;
+    unsigned long erase_size;
+    char label[17];
+    bool encrypted;
+    bool readonly;
+    uint8_t* host_data;  // Host only: `size` bytes of flash contents
+} esp_partition_t;
+
+uint32_t esp_partition_get_main_flash_sector_size(void);
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dst_offset, const void* src, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size);
+
+// Host only: make erasing and writing take time like real flash, 0 for no delay
+void esp_partition_host_set_timing(uint32_t erase_sector_us, uint32_t write_kb_us);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,10 @@
+// Host stand-in for esp_system.h: shutdown handlers are accepted and never run.
+#pragma once
+
+#include "esp_err.h"
+
+typedef void (*shutdown_handler_t)(void);
+
+static inline esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler) {
+    return ESP_OK;
+}
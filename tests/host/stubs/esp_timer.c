@@ -0,0 +1,70 @@
+// 主机版 esp_timer：只记录状态，由测试调用 esp_timer_host_fire() 触发回调
+#include "esp_timer.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct esp_timer {
+    esp_timer_create_args_t args;
+    // 被测模块可能在另一个任务里启动或停止定时器
+    atomic_bool armed;
+    atomic_int start_count;
+    struct esp_timer* next;
+};
+
+// 所有创建过的定时器，供测试按名称查找
+static esp_timer_handle_t s_timers;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle) {
+    esp_timer_handle_t timer = calloc(1, sizeof(struct esp_timer));
+    if (timer == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    timer->args = *create_args;
+    timer->next = s_timers;
+    s_timers = timer;
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    // 与 ESP-IDF 一致：已启动的定时器不能再次启动
+    if (atomic_exchange(&timer->armed, true)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->start_count++;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (!atomic_exchange(&timer->armed, false)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    return timer->armed;
+}
+
+esp_timer_handle_t esp_timer_host_find(const char* name) {
+    for (esp_timer_handle_t timer = s_timers; timer != NULL; timer = timer->next) {
+        if (timer->args.name != NULL && strcmp(timer->args.name, name) == 0) {
+            return timer;
+        }
+    }
+    return NULL;
+}
+
+int esp_timer_host_start_count(esp_timer_handle_t timer) {
+    return timer->start_count;
+}
+
+bool esp_timer_host_fire(esp_timer_handle_t timer) {
+    if (!atomic_exchange(&timer->armed, false)) {
+        return false;
+    }
+    timer->args.callback(timer->args.arg);
+    return true;
+}
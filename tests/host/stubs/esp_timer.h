@@ -0,0 +1,51 @@
+// Host stand-in for esp_timer: esp_timer_get_time() reads the monotonic clock, timers never fire
+// on their own. Tests fire due one shot timers with esp_timer_host_fire() (esp_timer.c).
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline int64_t esp_timer_get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+typedef struct esp_timer* esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void* arg);
+
+typedef enum {
+    ESP_TIMER_TASK,
+    ESP_TIMER_ISR,
+} esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void* arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char* name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+bool esp_timer_is_active(esp_timer_handle_t timer);
+
+// Host only: the last timer created with `name`, NULL if there is none
+esp_timer_handle_t esp_timer_host_find(const char* name);
+// Host only: the number of times `timer` has been started
+int esp_timer_host_start_count(esp_timer_handle_t timer);
+// Host only: run the callback of `timer` now if it is armed, returns whether it ran
+bool esp_timer_host_fire(esp_timer_handle_t timer);
+
+#ifdef __cplusplus
+}
+#endif
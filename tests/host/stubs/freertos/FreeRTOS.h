@@ -0,0 +1,22 @@
+// Host stand-in for FreeRTOS: tasks are std::threads, queues and semaphores are built on a mutex
+// (freertos_host.cc). One tick is one millisecond.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portNUM_PROCESSORS 2
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+typedef struct QueueDefinition* QueueHandle_t;
+typedef QueueHandle_t SemaphoreHandle_t;
+typedef void* TaskHandle_t;
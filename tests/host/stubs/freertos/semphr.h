@@ -0,0 +1,8 @@
+#pragma once
+
+#include "queue.h"
+
+#define xSemaphoreCreateBinary() xQueueCreate(1, 0)
+#define vSemaphoreDelete(semaphore) vQueueDelete(semaphore)
+#define xSemaphoreGive(semaphore) xQueueSend((semaphore), NULL, 0)
+#define xSemaphoreTake(semaphore, ticks_to_wait) xQueueReceive((semaphore), NULL, (ticks_to_wait))
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+#define tskNO_AFFINITY ((BaseType_t)0x7fffffff)
+
+typedef void (*TaskFunction_t)(void*);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth, void* parameters,
+    UBaseType_t priority, TaskHandle_t* created_task);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth,
+    void* parameters, UBaseType_t priority, TaskHandle_t* created_task, BaseType_t core_id);
+// Only vTaskDelete(NULL) at the end of a task function is supported
+void vTaskDelete(TaskHandle_t task);
+// Yields without waiting, so retry backoffs do not slow the tests down
+void vTaskDelay(TickType_t ticks);
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task);
+
+// Host only: fail the next `count` task creations, as when the heap is exhausted
+void freertos_host_fail_task_creation(int count);
+
+#ifdef __cplusplus
+}
+#endif
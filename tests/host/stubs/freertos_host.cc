@@ -0,0 +1,108 @@
+// 主机版 FreeRTOS：任务用分离的 std::thread，队列用互斥锁和条件变量实现
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct QueueDefinition {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t length;
+    UBaseType_t item_size;
+};
+
+static std::atomic<int> s_task_creation_failures{0};
+
+// portMAX_DELAY 表示一直等待，否则最多等待 ticks 毫秒
+template <typename Predicate>
+static bool WaitFor(QueueDefinition* queue, std::unique_lock<std::mutex>& lock, TickType_t ticks, Predicate ready) {
+    if (ticks == portMAX_DELAY) {
+        queue->changed.wait(lock, ready);
+        return true;
+    }
+    return queue->changed.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    auto queue = new QueueDefinition;
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!WaitFor(queue, lock, ticks_to_wait, [queue] { return queue->items.size() < queue->length; })) {
+        return pdFALSE;
+    }
+    auto bytes = static_cast<const uint8_t*>(item);
+    queue->items.emplace_back(bytes, bytes + (bytes != nullptr ? queue->item_size : 0));
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!WaitFor(queue, lock, ticks_to_wait, [queue] { return !queue->items.empty(); })) {
+        return pdFALSE;
+    }
+    if (buffer != nullptr) {
+        memcpy(buffer, queue->items.front().data(), queue->item_size);
+    }
+    queue->items.pop_front();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->items.size();
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth,
+    void* parameters, UBaseType_t priority, TaskHandle_t* created_task, BaseType_t core_id) {
+    int failures = s_task_creation_failures.load();
+    while (failures > 0) {
+        if (s_task_creation_failures.compare_exchange_weak(failures, failures - 1)) {
+            return pdFAIL;
+        }
+    }
+    std::thread(function, parameters).detach();
+    if (created_task != nullptr) {
+        *created_task = nullptr;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth, void* parameters,
+    UBaseType_t priority, TaskHandle_t* created_task) {
+    return xTaskCreatePinnedToCore(function, name, stack_depth, parameters, priority, created_task, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::yield();
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task) {
+    return 5;
+}
+
+void freertos_host_fail_task_creation(int count) {
+    s_task_creation_failures = count;
+}
@@ -0,0 +1,24 @@
+// Host stand-in for the esp-ml307 Http interface, implemented by the tests.
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+class Http {
+public:
+    virtual ~Http() = default;
+
+    virtual void SetTimeout(int timeout_ms) {}
+    virtual void SetHeader(const std::string& key, const std::string& value) = 0;
+    virtual void SetContent(std::string&& content) {}
+    virtual bool Open(const std::string& method, const std::string& url) = 0;
+    virtual void Close() = 0;
+    virtual int Read(char* buffer, size_t buffer_size) = 0;
+    virtual int Write(const char* buffer, size_t buffer_size) { return -1; }
+    virtual int GetStatusCode() = 0;
+    virtual std::string GetResponseHeader(const std::string& key) const { return ""; }
+    virtual size_t GetBodyLength() = 0;
+    virtual std::string ReadAll() { return ""; }
+    virtual int GetLastError() { return 0; }
+};
@@ -0,0 +1,234 @@
+// Host stand-in for the parts of LVGL used by gifdec, the GIF frame cache, the chat message list,
+// LvglImage and the glyph atlas.
+// Objects, labels, layout and scrolling are modelled in lvgl_host.cc.
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <limits.h>
+
+typedef enum {
+    LV_COLOR_FORMAT_RAW_ALPHA = 0x02,
+    LV_COLOR_FORMAT_A8 = 0x0E,
+    LV_COLOR_FORMAT_ARGB8888 = 0x10,
+    LV_COLOR_FORMAT_RGB565 = 0x12,
+    LV_COLOR_FORMAT_RGB565A8 = 0x14,
+} lv_color_format_t;
+
+typedef struct {
+    uint32_t magic : 8;
+    uint32_t cf : 8;
+    uint32_t flags : 16;
+    uint32_t w : 16;
+    uint32_t h : 16;
+    uint32_t stride : 16;
+    uint32_t reserved : 16;
+} lv_image_header_t;
+
+typedef struct {
+    lv_image_header_t header;
+    uint32_t data_size;
+    const uint8_t* data;
+} lv_img_dsc_t;
+
+#define LV_IMAGE_HEADER_MAGIC 0x19
+#define LV_IMAGE_FLAGS_MODIFIABLE 1
+
+#define lv_malloc malloc
+#define lv_free free
+#define lv_realloc realloc
+
+#define LV_GIF_CACHE_DECODE_DATA 0
+#define LV_USE_DRAW_SW_ASM 0
+#define LV_DRAW_SW_ASM_HELIUM 2
+
+typedef int lv_fs_file_t;
+typedef int lv_fs_res_t;
+#define LV_FS_RES_OK 0
+#define LV_FS_MODE_RD 1
+#define LV_FS_SEEK_SET 0
+#define LV_FS_SEEK_CUR 1
+#define LV_FS_SEEK_END 2
+
+// No file system on the host: GIFs are always opened from memory
+static inline lv_fs_res_t lv_fs_open(lv_fs_file_t* f, const char* path, int mode) { return 1; }
+static inline lv_fs_res_t lv_fs_read(lv_fs_file_t* f, void* buf, uint32_t n, uint32_t* read) { return 1; }
+static inline lv_fs_res_t lv_fs_seek(lv_fs_file_t* f, uint32_t pos, int whence) { return 1; }
+static inline lv_fs_res_t lv_fs_tell(lv_fs_file_t* f, uint32_t* pos) { *pos = 0; return 1; }
+static inline lv_fs_res_t lv_fs_close(lv_fs_file_t* f) { return 1; }
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Object model: children stack vertically, labels wrap at their width, the parent scrolls
+typedef struct _lv_obj_t lv_obj_t;
+typedef struct _lv_event_t lv_event_t;
+typedef struct _lv_font_glyph_dsc_t lv_font_glyph_dsc_t;
+typedef struct _lv_draw_buf_t lv_draw_buf_t;
+
+// The host font of the object model measures ASCII glyphs 8 px wide and others 16 px, the pair "AV" is
+// kerned by -2 px. Fonts that draw glyphs fill in the callbacks (cbin_font_host.cc).
+typedef struct _lv_font_t {
+    int32_t line_height;
+    bool (*get_glyph_dsc)(const struct _lv_font_t* font, lv_font_glyph_dsc_t* g_dsc, uint32_t letter,
+                          uint32_t letter_next);
+    const void* (*get_glyph_bitmap)(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf);
+    const void* dsc;
+    void* user_data;
+} lv_font_t;
+
+struct _lv_font_glyph_dsc_t {
+    const lv_font_t* resolved_font;
+    uint16_t adv_w;
+    uint16_t box_w;
+    uint16_t box_h;
+    int16_t ofs_x;
+    int16_t ofs_y;
+    union {
+        uint32_t index;
+        const void* src;
+    } gid;
+};
+
+struct _lv_draw_buf_t {
+    lv_image_header_t header;
+    uint32_t data_size;
+    uint8_t* data;
+};
+
+typedef struct {
+    uint8_t blue;
+    uint8_t green;
+    uint8_t red;
+} lv_color_t;
+
+typedef struct {
+    int32_t x;
+    int32_t y;
+} lv_point_t;
+
+typedef uint32_t lv_style_selector_t;
+typedef uint8_t lv_opa_t;
+typedef void (*lv_event_cb_t)(lv_event_t* e);
+typedef void (*lv_async_cb_t)(void* user_data);
+typedef int lv_result_t;
+
+typedef enum {
+    LV_EVENT_SCROLL = 10,
+    LV_EVENT_DELETE = 40,
+} lv_event_code_t;
+
+typedef enum {
+    LV_OBJ_FLAG_HIDDEN = 1 << 0,
+    LV_OBJ_FLAG_SCROLLABLE = 1 << 4,
+} lv_obj_flag_t;
+
+typedef enum {
+    LV_ALIGN_CENTER = 9,
+    LV_ALIGN_LEFT_MID = 7,
+    LV_ALIGN_RIGHT_MID = 8,
+} lv_align_t;
+
+#define LV_RESULT_INVALID 0
+#define LV_RESULT_OK 1
+#define LV_PART_MAIN 0
+#define LV_OPA_TRANSP 0
+#define LV_OPA_70 178
+#define LV_SCROLLBAR_MODE_OFF 0
+#define LV_LABEL_LONG_WRAP 0
+#define LV_ANIM_OFF 0
+#define LV_ANIM_ON 1
+#define LV_TEXT_FLAG_NONE 0
+#define LV_COORD_MAX ((int32_t)((1 << 29) - 1))
+#define LV_SIZE_CONTENT ((int32_t)(1 << 29 | 2001))
+#define LV_HOR_RES 320
+
+// No image decoders on the host
+static inline lv_result_t lv_image_decoder_get_info(const void* src, lv_image_header_t* header) {
+    return LV_RESULT_INVALID;
+}
+
+lv_obj_t* lv_obj_create(lv_obj_t* parent);
+lv_obj_t* lv_label_create(lv_obj_t* parent);
+void lv_obj_delete(lv_obj_t* obj);
+
+uint32_t lv_obj_get_child_cnt(const lv_obj_t* obj);
+lv_obj_t* lv_obj_get_child(const lv_obj_t* obj, int32_t index);
+int32_t lv_obj_get_index(const lv_obj_t* obj);
+void lv_obj_move_to_index(lv_obj_t* obj, int32_t index);
+
+void lv_obj_add_flag(lv_obj_t* obj, lv_obj_flag_t flag);
+void lv_obj_remove_flag(lv_obj_t* obj, lv_obj_flag_t flag);
+bool lv_obj_has_flag(const lv_obj_t* obj, lv_obj_flag_t flag);
+void* lv_obj_get_user_data(lv_obj_t* obj);
+void lv_obj_set_user_data(lv_obj_t* obj, void* user_data);
+
+void lv_obj_add_event_cb(lv_obj_t* obj, lv_event_cb_t cb, lv_event_code_t code, void* user_data);
+void* lv_event_get_user_data(lv_event_t* e);
+lv_result_t lv_async_call(lv_async_cb_t cb, void* user_data);
+lv_result_t lv_async_call_cancel(lv_async_cb_t cb, void* user_data);
+
+void lv_obj_set_width(lv_obj_t* obj, int32_t width);
+void lv_obj_set_height(lv_obj_t* obj, int32_t height);
+void lv_obj_set_size(lv_obj_t* obj, int32_t width, int32_t height);
+void lv_obj_align(lv_obj_t* obj, lv_align_t align, int32_t x, int32_t y);
+void lv_obj_set_scrollbar_mode(lv_obj_t* obj, int mode);
+void lv_obj_set_style_bg_opa(lv_obj_t* obj, lv_opa_t opa, lv_style_selector_t selector);
+void lv_obj_set_style_bg_color(lv_obj_t* obj, lv_color_t color, lv_style_selector_t selector);
+void lv_obj_set_style_text_color(lv_obj_t* obj, lv_color_t color, lv_style_selector_t selector);
+void lv_obj_set_style_border_width(lv_obj_t* obj, int32_t width, lv_style_selector_t selector);
+void lv_obj_set_style_radius(lv_obj_t* obj, int32_t radius, lv_style_selector_t selector);
+void lv_obj_set_style_pad_all(lv_obj_t* obj, int32_t pad, lv_style_selector_t selector);
+int32_t lv_obj_get_style_width(const lv_obj_t* obj, lv_style_selector_t part);
+const lv_font_t* lv_obj_get_style_text_font(const lv_obj_t* obj, lv_style_selector_t part);
+int32_t lv_obj_get_style_text_letter_space(const lv_obj_t* obj, lv_style_selector_t part);
+
+void lv_label_set_long_mode(lv_obj_t* obj, int mode);
+void lv_label_set_text(lv_obj_t* obj, const char* text);
+void lv_label_set_text_static(lv_obj_t* obj, const char* text);
+const char* lv_label_get_text(const lv_obj_t* obj);
+void lv_text_get_size(lv_point_t* size_res, const char* text, const lv_font_t* font, int32_t letter_space,
+                      int32_t line_space, int32_t max_width, int flag);
+
+void lv_obj_update_layout(const lv_obj_t* obj);
+int32_t lv_obj_get_y(const lv_obj_t* obj);
+int32_t lv_obj_get_height(const lv_obj_t* obj);
+int32_t lv_obj_get_scroll_y(const lv_obj_t* obj);
+int32_t lv_obj_get_scroll_top(lv_obj_t* obj);
+int32_t lv_obj_get_scroll_bottom(lv_obj_t* obj);
+void lv_obj_scroll_to_y(lv_obj_t* obj, int32_t y, int anim);
+void lv_obj_scroll_to_view_recursive(lv_obj_t* obj, int anim);
+
+// Draw buffers and glyphs, as used by label drawing
+#define LV_STRIDE_AUTO 0
+lv_draw_buf_t* lv_draw_buf_create(uint32_t w, uint32_t h, lv_color_format_t cf, uint32_t stride);
+void lv_draw_buf_destroy(lv_draw_buf_t* draw_buf);
+// NULL if the new shape does not fit in the buffer
+lv_draw_buf_t* lv_draw_buf_reshape(lv_draw_buf_t* draw_buf, lv_color_format_t cf, uint32_t w, uint32_t h,
+                                   uint32_t stride);
+bool lv_font_get_glyph_dsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc_out, uint32_t letter,
+                           uint32_t letter_next);
+const void* lv_font_get_glyph_bitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf);
+uint32_t lv_text_encoded_next(const char* txt, uint32_t* i);
+
+// Host only: run the pending async calls, like one pass of lv_timer_handler
+void lv_host_run_async(void);
+
+// Host only: what the code under test cost
+typedef struct {
+    uint32_t objects_alive;
+    uint32_t objects_created;
+    uint32_t text_measures;     // lv_text_get_size calls
+    uint32_t layouts;           // lv_obj_update_layout calls
+    uint64_t children_visited;  // Children walked to compute positions and content heights
+} lv_host_stats_t;
+
+lv_host_stats_t lv_host_get_stats(void);
+void lv_host_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
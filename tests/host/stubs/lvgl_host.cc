@@ -0,0 +1,428 @@
+// Host LVGL object model: just enough layout and scrolling to run list views against, with counters
+// for what a real LVGL would have to walk. Children of an object stack vertically without gaps, an
+// object of LV_SIZE_CONTENT height is as tall as its visible children plus padding, and a label is
+// as many lines tall as its text needs at the label width.
+#include "lvgl.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct Handler {
+    lv_event_cb_t cb;
+    lv_event_code_t code;
+    void* user_data;
+};
+
+struct _lv_obj_t {
+    lv_obj_t* parent = nullptr;
+    std::vector<lv_obj_t*> children;
+    std::vector<Handler> handlers;
+    bool label = false;
+    std::string text;
+    const char* static_text = nullptr;
+    uint32_t flags = LV_OBJ_FLAG_SCROLLABLE;
+    void* user_data = nullptr;
+    int32_t width = 0;
+    int32_t height = LV_SIZE_CONTENT;
+    int32_t pad = 0;
+    int32_t scroll_y = 0;
+};
+
+struct _lv_event_t {
+    lv_event_code_t code;
+    void* user_data;
+};
+
+static const lv_font_t host_font = { 20, nullptr, nullptr, nullptr, nullptr };
+static lv_host_stats_t stats;
+static std::vector<std::pair<lv_async_cb_t, void*>> async_calls;
+
+static void Send(lv_obj_t* obj, lv_event_code_t code) {
+    // A handler may delete its own list, so walk a copy
+    auto handlers = obj->handlers;
+    for (auto& handler : handlers) {
+        if (handler.code == code) {
+            lv_event_t e = { code, handler.user_data };
+            handler.cb(&e);
+        }
+    }
+}
+
+static const char* Text(const lv_obj_t* obj) {
+    return obj->static_text != nullptr ? obj->static_text : obj->text.c_str();
+}
+
+// Widths of the lines of `text`, kerning and letter space included
+static std::vector<int32_t> LineWidths(const char* text, int32_t letter_space) {
+    std::vector<int32_t> widths = { 0 };
+    uint32_t previous = 0;
+    for (const unsigned char* p = (const unsigned char*)text; *p != '\0'; p++) {
+        if (*p == '\n') {
+            widths.push_back(0);
+            previous = 0;
+            continue;
+        }
+        if ((*p & 0xC0) == 0x80) {
+            continue;
+        }
+        int32_t& width = widths.back();
+        if (previous != 0) {
+            width += letter_space;
+        }
+        width += *p < 0x80 ? 8 : 16;
+        if (previous == 'A' && *p == 'V') {
+            width -= 2;
+        }
+        previous = *p;
+    }
+    return widths;
+}
+
+static int32_t Height(const lv_obj_t* obj) {
+    if (obj->label) {
+        int32_t wrap = obj->width > 0 ? obj->width : LV_HOR_RES;
+        int32_t lines = 0;
+        for (int32_t width : LineWidths(Text(obj), 0)) {
+            lines += std::max<int32_t>(1, (width + wrap - 1) / wrap);
+        }
+        return lines * host_font.line_height;
+    }
+    if (obj->height != LV_SIZE_CONTENT) {
+        return obj->height;
+    }
+    int32_t height = 2 * obj->pad;
+    for (auto child : obj->children) {
+        stats.children_visited++;
+        if (!(child->flags & LV_OBJ_FLAG_HIDDEN)) {
+            height += Height(child);
+        }
+    }
+    return height;
+}
+
+static int32_t ContentHeight(const lv_obj_t* obj) {
+    int32_t height = 2 * obj->pad;
+    for (auto child : obj->children) {
+        stats.children_visited++;
+        if (!(child->flags & LV_OBJ_FLAG_HIDDEN)) {
+            height += Height(child);
+        }
+    }
+    return height;
+}
+
+static lv_obj_t* Create(lv_obj_t* parent, bool label) {
+    auto obj = new lv_obj_t();
+    obj->parent = parent;
+    obj->label = label;
+    if (parent != nullptr) {
+        parent->children.push_back(obj);
+    }
+    stats.objects_alive++;
+    stats.objects_created++;
+    return obj;
+}
+
+extern "C" {
+
+lv_obj_t* lv_obj_create(lv_obj_t* parent) {
+    return Create(parent, false);
+}
+
+lv_obj_t* lv_label_create(lv_obj_t* parent) {
+    return Create(parent, true);
+}
+
+void lv_obj_delete(lv_obj_t* obj) {
+    Send(obj, LV_EVENT_DELETE);
+    while (!obj->children.empty()) {
+        lv_obj_delete(obj->children.back());
+    }
+    if (obj->parent != nullptr) {
+        auto& siblings = obj->parent->children;
+        siblings.erase(std::find(siblings.begin(), siblings.end(), obj));
+    }
+    stats.objects_alive--;
+    delete obj;
+}
+
+uint32_t lv_obj_get_child_cnt(const lv_obj_t* obj) {
+    return obj->children.size();
+}
+
+lv_obj_t* lv_obj_get_child(const lv_obj_t* obj, int32_t index) {
+    int32_t count = obj->children.size();
+    if (index < 0) {
+        index += count;
+    }
+    return index >= 0 && index < count ? obj->children[index] : nullptr;
+}
+
+int32_t lv_obj_get_index(const lv_obj_t* obj) {
+    auto& siblings = obj->parent->children;
+    return std::find(siblings.begin(), siblings.end(), obj) - siblings.begin();
+}
+
+// Same rules as LVGL: negative indexes count from the end, out of range indexes are ignored
+void lv_obj_move_to_index(lv_obj_t* obj, int32_t index) {
+    auto& siblings = obj->parent->children;
+    if (index < 0) {
+        index += siblings.size();
+    }
+    int32_t old_index = lv_obj_get_index(obj);
+    if (index < 0 || index >= (int32_t)siblings.size() || index == old_index) {
+        return;
+    }
+    siblings.erase(siblings.begin() + old_index);
+    siblings.insert(siblings.begin() + index, obj);
+}
+
+void lv_obj_add_flag(lv_obj_t* obj, lv_obj_flag_t flag) {
+    obj->flags |= flag;
+}
+
+void lv_obj_remove_flag(lv_obj_t* obj, lv_obj_flag_t flag) {
+    obj->flags &= ~(uint32_t)flag;
+}
+
+bool lv_obj_has_flag(const lv_obj_t* obj, lv_obj_flag_t flag) {
+    return (obj->flags & flag) == (uint32_t)flag;
+}
+
+void* lv_obj_get_user_data(lv_obj_t* obj) {
+    return obj->user_data;
+}
+
+void lv_obj_set_user_data(lv_obj_t* obj, void* user_data) {
+    obj->user_data = user_data;
+}
+
+void lv_obj_add_event_cb(lv_obj_t* obj, lv_event_cb_t cb, lv_event_code_t code, void* user_data) {
+    obj->handlers.push_back({ cb, code, user_data });
+}
+
+void* lv_event_get_user_data(lv_event_t* e) {
+    return e->user_data;
+}
+
+lv_result_t lv_async_call(lv_async_cb_t cb, void* user_data) {
+    async_calls.emplace_back(cb, user_data);
+    return LV_RESULT_OK;
+}
+
+lv_result_t lv_async_call_cancel(lv_async_cb_t cb, void* user_data) {
+    auto it = std::find(async_calls.begin(), async_calls.end(), std::make_pair(cb, user_data));
+    if (it == async_calls.end()) {
+        return LV_RESULT_INVALID;
+    }
+    async_calls.erase(it);
+    return LV_RESULT_OK;
+}
+
+void lv_host_run_async(void) {
+    auto calls = std::move(async_calls);
+    async_calls.clear();
+    for (auto& call : calls) {
+        call.first(call.second);
+    }
+}
+
+void lv_obj_set_width(lv_obj_t* obj, int32_t width) {
+    obj->width = width;
+}
+
+void lv_obj_set_height(lv_obj_t* obj, int32_t height) {
+    obj->height = height;
+}
+
+void lv_obj_set_size(lv_obj_t* obj, int32_t width, int32_t height) {
+    obj->width = width;
+    obj->height = height;
+}
+
+void lv_obj_align(lv_obj_t* obj, lv_align_t align, int32_t x, int32_t y) {}
+void lv_obj_set_scrollbar_mode(lv_obj_t* obj, int mode) {}
+void lv_obj_set_style_bg_opa(lv_obj_t* obj, lv_opa_t opa, lv_style_selector_t selector) {}
+void lv_obj_set_style_bg_color(lv_obj_t* obj, lv_color_t color, lv_style_selector_t selector) {}
+void lv_obj_set_style_text_color(lv_obj_t* obj, lv_color_t color, lv_style_selector_t selector) {}
+void lv_obj_set_style_border_width(lv_obj_t* obj, int32_t width, lv_style_selector_t selector) {}
+void lv_obj_set_style_radius(lv_obj_t* obj, int32_t radius, lv_style_selector_t selector) {}
+
+void lv_obj_set_style_pad_all(lv_obj_t* obj, int32_t pad, lv_style_selector_t selector) {
+    obj->pad = pad;
+}
+
+int32_t lv_obj_get_style_width(const lv_obj_t* obj, lv_style_selector_t part) {
+    return obj->width;
+}
+
+const lv_font_t* lv_obj_get_style_text_font(const lv_obj_t* obj, lv_style_selector_t part) {
+    return &host_font;
+}
+
+int32_t lv_obj_get_style_text_letter_space(const lv_obj_t* obj, lv_style_selector_t part) {
+    return 0;
+}
+
+void lv_label_set_long_mode(lv_obj_t* obj, int mode) {}
+
+void lv_label_set_text(lv_obj_t* obj, const char* text) {
+    obj->text = text;
+    obj->static_text = nullptr;
+}
+
+void lv_label_set_text_static(lv_obj_t* obj, const char* text) {
+    obj->static_text = text;
+}
+
+const char* lv_label_get_text(const lv_obj_t* obj) {
+    return Text(obj);
+}
+
+void lv_text_get_size(lv_point_t* size_res, const char* text, const lv_font_t* font, int32_t letter_space,
+                      int32_t line_space, int32_t max_width, int flag) {
+    stats.text_measures++;
+    auto widths = LineWidths(text, letter_space);
+    size_res->x = std::min(*std::max_element(widths.begin(), widths.end()), max_width);
+    size_res->y = (int32_t)widths.size() * (font->line_height + line_space) - line_space;
+}
+
+void lv_obj_update_layout(const lv_obj_t* obj) {
+    stats.layouts++;
+}
+
+int32_t lv_obj_get_y(const lv_obj_t* obj) {
+    int32_t y = obj->parent->pad;
+    for (auto sibling : obj->parent->children) {
+        stats.children_visited++;
+        if (sibling == obj) {
+            break;
+        }
+        if (!(sibling->flags & LV_OBJ_FLAG_HIDDEN)) {
+            y += Height(sibling);
+        }
+    }
+    return y;
+}
+
+int32_t lv_obj_get_height(const lv_obj_t* obj) {
+    return Height(obj);
+}
+
+int32_t lv_obj_get_scroll_y(const lv_obj_t* obj) {
+    return obj->scroll_y;
+}
+
+int32_t lv_obj_get_scroll_top(lv_obj_t* obj) {
+    return obj->scroll_y;
+}
+
+int32_t lv_obj_get_scroll_bottom(lv_obj_t* obj) {
+    // Negative when the content shrank below the scroll position, like in LVGL
+    return ContentHeight(obj) - Height(obj) - obj->scroll_y;
+}
+
+// Bounded by the content like LVGL, scroll events are sent before this returns
+void lv_obj_scroll_to_y(lv_obj_t* obj, int32_t y, int anim) {
+    int32_t max_y = std::max<int32_t>(ContentHeight(obj) - Height(obj), 0);
+    y = std::min(std::max<int32_t>(y, 0), max_y);
+    if (y != obj->scroll_y) {
+        obj->scroll_y = y;
+        Send(obj, LV_EVENT_SCROLL);
+    }
+}
+
+void lv_obj_scroll_to_view_recursive(lv_obj_t* obj, int anim) {
+    lv_obj_t* parent = obj->parent;
+    int32_t top = lv_obj_get_y(obj);
+    int32_t bottom = top + Height(obj);
+    int32_t view = Height(parent);
+    if (bottom > parent->scroll_y + view) {
+        lv_obj_scroll_to_y(parent, bottom - view, anim);
+    } else if (top < parent->scroll_y) {
+        lv_obj_scroll_to_y(parent, top, anim);
+    }
+}
+
+static uint32_t Stride(lv_color_format_t cf, uint32_t w, uint32_t stride) {
+    if (stride != LV_STRIDE_AUTO) {
+        return stride;
+    }
+    return cf == LV_COLOR_FORMAT_A8 ? w : cf == LV_COLOR_FORMAT_RGB565 ? w * 2 : w * 4;
+}
+
+lv_draw_buf_t* lv_draw_buf_create(uint32_t w, uint32_t h, lv_color_format_t cf, uint32_t stride) {
+    auto draw_buf = new lv_draw_buf_t();
+    stride = Stride(cf, w, stride);
+    draw_buf->header.magic = LV_IMAGE_HEADER_MAGIC;
+    draw_buf->header.cf = cf;
+    draw_buf->header.w = w;
+    draw_buf->header.h = h;
+    draw_buf->header.stride = stride;
+    draw_buf->data_size = stride * h;
+    draw_buf->data = new uint8_t[draw_buf->data_size > 0 ? draw_buf->data_size : 1];
+    return draw_buf;
+}
+
+void lv_draw_buf_destroy(lv_draw_buf_t* draw_buf) {
+    delete[] draw_buf->data;
+    delete draw_buf;
+}
+
+lv_draw_buf_t* lv_draw_buf_reshape(lv_draw_buf_t* draw_buf, lv_color_format_t cf, uint32_t w, uint32_t h,
+                                   uint32_t stride) {
+    stride = Stride(cf, w, stride);
+    if (draw_buf == nullptr || stride * h > draw_buf->data_size) {
+        return nullptr;
+    }
+    draw_buf->header.cf = cf;
+    draw_buf->header.w = w;
+    draw_buf->header.h = h;
+    draw_buf->header.stride = stride;
+    return draw_buf;
+}
+
+bool lv_font_get_glyph_dsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc_out, uint32_t letter,
+                           uint32_t letter_next) {
+    *dsc_out = lv_font_glyph_dsc_t();
+    if (font == nullptr || font->get_glyph_dsc == nullptr || !font->get_glyph_dsc(font, dsc_out, letter, letter_next)) {
+        return false;
+    }
+    dsc_out->resolved_font = font;
+    return true;
+}
+
+const void* lv_font_get_glyph_bitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf) {
+    const lv_font_t* font = g_dsc->resolved_font;
+    return font != nullptr && font->get_glyph_bitmap != nullptr ? font->get_glyph_bitmap(g_dsc, draw_buf) : nullptr;
+}
+
+// UTF-8, invalid bytes are returned as they are
+uint32_t lv_text_encoded_next(const char* txt, uint32_t* i) {
+    const unsigned char* p = (const unsigned char*)txt + *i;
+    int length = p[0] < 0x80 ? 1 : (p[0] & 0xE0) == 0xC0 ? 2 : (p[0] & 0xF0) == 0xE0 ? 3 : (p[0] & 0xF8) == 0xF0 ? 4 : 1;
+    uint32_t letter = length == 1 ? p[0] : p[0] & (0x7F >> length);
+    for (int k = 1; k < length; k++) {
+        if ((p[k] & 0xC0) != 0x80) {
+            *i += 1;
+            return p[0];
+        }
+        letter = (letter << 6) | (p[k] & 0x3F);
+    }
+    *i += length;
+    return letter;
+}
+
+lv_host_stats_t lv_host_get_stats(void) {
+    return stats;
+}
+
+void lv_host_reset_stats(void) {
+    uint32_t alive = stats.objects_alive;
+    stats = lv_host_stats_t();
+    stats.objects_alive = alive;
+}
+
+}  // extern "C"
@@ -0,0 +1,27 @@
+// Host stand-in for mbedtls SHA-256, a plain implementation in sha256.c.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t total;
+    uint8_t buffer[64];
+} mbedtls_sha256_context;
+
+void mbedtls_sha256_init(mbedtls_sha256_context* ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context* ctx);
+// Only SHA-256 is supported, `is224` must be 0
+int mbedtls_sha256_starts(mbedtls_sha256_context* ctx, int is224);
+int mbedtls_sha256_update(mbedtls_sha256_context* ctx, const unsigned char* input, size_t ilen);
+int mbedtls_sha256_finish(mbedtls_sha256_context* ctx, unsigned char output[32]);
+int mbedtls_sha256(const unsigned char* input, size_t ilen, unsigned char output[32], int is224);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,69 @@
+// Host stand-in for NVS: namespaces live in RAM, writes are staged per handle until nvs_commit()
+// (nvs_host.cc). Tests fill and inspect "flash" through the normal API.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_ERR_NVS_BASE 0x1100
+#define ESP_ERR_NVS_NOT_FOUND (ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_NOT_ENOUGH_SPACE (ESP_ERR_NVS_BASE + 0x05)
+#define NVS_DEFAULT_PART_NAME "nvs"
+#define NVS_KEY_NAME_MAX_SIZE 16
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum {
+    NVS_READONLY,
+    NVS_READWRITE,
+} nvs_open_mode_t;
+
+typedef enum {
+    NVS_TYPE_U8 = 0x01,
+    NVS_TYPE_I32 = 0x14,
+    NVS_TYPE_STR = 0x21,
+    NVS_TYPE_BLOB = 0x42,
+    NVS_TYPE_ANY = 0xff,
+} nvs_type_t;
+
+typedef struct {
+    char namespace_name[16];
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_type_t type;
+} nvs_entry_info_t;
+
+typedef struct nvs_opaque_iterator_t* nvs_iterator_t;
+
+esp_err_t nvs_open(const char* namespace_name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle);
+void nvs_close(nvs_handle_t handle);
+esp_err_t nvs_commit(nvs_handle_t handle);
+esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out_value, size_t* length);
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char* key, int32_t* out_value);
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out_value);
+esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value);
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char* key, int32_t value);
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value);
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key);
+esp_err_t nvs_erase_all(nvs_handle_t handle);
+esp_err_t nvs_entry_find(const char* part_name, const char* namespace_name, nvs_type_t type, nvs_iterator_t* output_iterator);
+esp_err_t nvs_entry_next(nvs_iterator_t* iterator);
+esp_err_t nvs_entry_info(nvs_iterator_t iterator, nvs_entry_info_t* out_info);
+void nvs_release_iterator(nvs_iterator_t iterator);
+
+// Host only: counters of nvs_get_* and nvs_commit calls
+int nvs_host_read_count(void);
+int nvs_host_commit_count(void);
+// Host only: make every write, erase and commit return `err` until called again with ESP_OK
+void nvs_host_fail_writes(esp_err_t err);
+// Host only: make nvs_commit() take `ms` like a commit that has to erase a flash sector
+void nvs_host_set_commit_delay_ms(int ms);
+
+#ifdef __cplusplus
+}
+#endif
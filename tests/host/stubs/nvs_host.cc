@@ -0,0 +1,233 @@
+// 主机版 NVS：已提交的数据保存在 s_flash，句柄上的修改在 nvs_commit 时写回
+#include "nvs_flash.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace {
+
+struct Value {
+    nvs_type_t type;
+    int32_t number;
+    std::string text;
+};
+
+using Space = std::map<std::string, Value>;
+
+struct Handle {
+    std::string ns;
+    bool writable;
+    Space staged;
+};
+
+std::mutex s_mutex;
+std::map<std::string, Space> s_flash;
+std::map<nvs_handle_t, Handle> s_handles;
+nvs_handle_t s_next_handle = 1;
+int s_reads = 0;
+int s_commits = 0;
+esp_err_t s_write_error = ESP_OK;
+std::atomic<int> s_commit_delay_ms{0};
+
+Handle* FindHandle(nvs_handle_t handle) {
+    auto it = s_handles.find(handle);
+    return it != s_handles.end() ? &it->second : nullptr;
+}
+
+const Value* GetValue(nvs_handle_t handle, const char* key, nvs_type_t type) {
+    s_reads++;
+    auto h = FindHandle(handle);
+    if (h == nullptr) {
+        return nullptr;
+    }
+    auto it = h->staged.find(key);
+    return it != h->staged.end() && it->second.type == type ? &it->second : nullptr;
+}
+
+esp_err_t SetValue(nvs_handle_t handle, const char* key, Value value) {
+    auto h = FindHandle(handle);
+    if (h == nullptr || !h->writable) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_write_error != ESP_OK) {
+        return s_write_error;
+    }
+    h->staged[key] = std::move(value);
+    return ESP_OK;
+}
+
+} // namespace
+
+struct nvs_opaque_iterator_t {
+    std::string ns;
+    Space entries;
+    Space::const_iterator position;
+};
+
+esp_err_t nvs_open(const char* namespace_name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto it = s_flash.find(namespace_name);
+    if (it == s_flash.end() && open_mode == NVS_READONLY) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    Handle h = {namespace_name, open_mode == NVS_READWRITE, it != s_flash.end() ? it->second : Space()};
+    *out_handle = s_next_handle++;
+    s_handles.emplace(*out_handle, std::move(h));
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_handles.erase(handle);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    if (s_commit_delay_ms > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(s_commit_delay_ms.load()));
+    }
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto h = FindHandle(handle);
+    if (h == nullptr || !h->writable) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_write_error != ESP_OK) {
+        return s_write_error;
+    }
+    s_flash[h->ns] = h->staged;
+    s_commits++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out_value, size_t* length) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto value = GetValue(handle, key, NVS_TYPE_STR);
+    if (value == nullptr) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    size_t required = value->text.size() + 1;
+    if (out_value != nullptr) {
+        if (*length < required) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(out_value, value->text.c_str(), required);
+    }
+    *length = required;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char* key, int32_t* out_value) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto value = GetValue(handle, key, NVS_TYPE_I32);
+    if (value == nullptr) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *out_value = value->number;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out_value) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto value = GetValue(handle, key, NVS_TYPE_U8);
+    if (value == nullptr) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *out_value = (uint8_t)value->number;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    return SetValue(handle, key, {NVS_TYPE_STR, 0, value});
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char* key, int32_t value) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    return SetValue(handle, key, {NVS_TYPE_I32, value, ""});
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    return SetValue(handle, key, {NVS_TYPE_U8, value, ""});
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto h = FindHandle(handle);
+    if (h == nullptr || !h->writable) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_write_error != ESP_OK) {
+        return s_write_error;
+    }
+    return h->staged.erase(key) > 0 ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto h = FindHandle(handle);
+    if (h == nullptr || !h->writable) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_write_error != ESP_OK) {
+        return s_write_error;
+    }
+    h->staged.clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_find(const char* part_name, const char* namespace_name, nvs_type_t type, nvs_iterator_t* output_iterator) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    *output_iterator = nullptr;
+    auto it = s_flash.find(namespace_name);
+    if (it == s_flash.end() || it->second.empty()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    auto iterator = new nvs_opaque_iterator_t{namespace_name, it->second, {}};
+    iterator->position = iterator->entries.begin();
+    *output_iterator = iterator;
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_next(nvs_iterator_t* iterator) {
+    if (++(*iterator)->position == (*iterator)->entries.end()) {
+        delete *iterator;
+        *iterator = nullptr;
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_info(nvs_iterator_t iterator, nvs_entry_info_t* out_info) {
+    snprintf(out_info->namespace_name, sizeof(out_info->namespace_name), "%s", iterator->ns.c_str());
+    snprintf(out_info->key, sizeof(out_info->key), "%s", iterator->position->first.c_str());
+    out_info->type = iterator->position->second.type;
+    return ESP_OK;
+}
+
+void nvs_release_iterator(nvs_iterator_t iterator) {
+    delete iterator;
+}
+
+int nvs_host_read_count(void) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    return s_reads;
+}
+
+int nvs_host_commit_count(void) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    return s_commits;
+}
+
+void nvs_host_fail_writes(esp_err_t err) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_write_error = err;
+}
+
+void nvs_host_set_commit_delay_ms(int ms) {
+    s_commit_delay_ms = ms;
+}
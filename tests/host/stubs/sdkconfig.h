@@ -0,0 +1,2 @@
+// Host builds take CONFIG_* values from target_compile_definitions() in CMakeLists.txt.
+#pragma once